@@ -16,18 +16,8 @@ GNU General Public License for more details.
 #include "common.h"
 #include "client.h"
 #include "net_encode.h"
-
-#define dem_unknown		0	// unknown command
-#define dem_norewind	1	// startup message
-#define dem_read		2	// it's a normal network packet
-#define dem_jumptime	3	// move the demostart time value forward by this amount
-#define dem_userdata	4	// userdata from the client.dll
-#define dem_usercmd		5	// read usercmd_t
-#define dem_stop		6	// end of time
-#define dem_lastcmd		dem_stop
-
-#define DEMO_STARTUP	0	// this lump contains startup info needed to spawn into the server
-#define DEMO_NORMAL		1	// this lump contains playback info of messages, etc., needed during playback.
+#include "demofile.h"
+#include "sound.h"		// S_GetCurrentStaticSounds
 
 // Demo flags
 #define FDEMO_TITLE		0x01	// Show title
@@ -37,8 +27,7 @@ GNU General Public License for more details.
 #define FDEMO_FADE_OUT_SLOW	0x20	// Fade out (slow)
 #define FDEMO_FADE_OUT_FAST	0x40	// Fade out (fast)
 
-#define IDEMOHEADER		(('M'<<24)+('E'<<16)+('D'<<8)+'I') // little-endian "IDEM"
-#define DEMO_PROTOCOL	3
+CVAR_DEFINE_AUTO( cl_demo_keyframe_interval, "10", FCVAR_ARCHIVE, "seconds between keyframes in recorded demos, used for seeking, 0 to disable" );
 
 const char *demo_cmd[dem_lastcmd+1] =
 {
@@ -51,31 +40,6 @@ const char *demo_cmd[dem_lastcmd+1] =
 	"dem_stop",
 };
 
-#pragma pack( push, 1 )
-typedef struct
-{
-	int		id;		// should be IDEM
-	int		dem_protocol;	// should be DEMO_PROTOCOL
-	int		net_protocol;	// should be PROTOCOL_VERSION
-	double		host_fps;		// fps for demo playing
-	char		mapname[64];	// name of map
-	char		comment[64];	// comment for demo
-	char		gamedir[64];	// name of game directory (FS_Gamedir())
-	int		directory_offset;	// offset of Entry Directory.
-} demoheader_t;
-#pragma pack( pop )
-
-typedef struct
-{
-	int		entrytype;	// DEMO_STARTUP or DEMO_NORMAL
-	float		playback_time;	// time of track
-	int		playback_frames;	// # of frames in track
-	int		offset;		// file offset of track data
-	int		length;		// length of track
-	int		flags;		// FX-flags
-	char		description[64];	// entry description
-} demoentry_t;
-
 typedef struct
 {
 	demoentry_t	*entries;		// track entry info
@@ -105,6 +69,28 @@ struct
 	// interpolation stuff
 	demoangle_t	cmds[ANGLE_BACKUP];
 	int		angle_position;
+
+	// keyframes and seeking
+	demokeyframe_t	*keyframes;
+	int		numkeyframes;
+	int		maxkeyframes;	// while recording
+	float		lastkeyframe;	// time of the last keyframe written
+	file_t		*statefile;	// keyframe states while recording
+	int		statebase;	// offset of keyframe states while playing
+	sizebuf_t		statelog;		// commands keyframes can't restore
+	byte		*statelogdata;
+	int		statelogsize;
+	qboolean		statelogfull;	// keyframes after it would miss commands
+	int		logstart;		// where the current level starts in the state log
+	float		timebase;		// times of all previous levels
+	float		lastdt;		// time of the last network message
+	int		level;
+	float		seektime;
+
+	// command that wasn't time to execute yet
+	qboolean		havepeek;
+	byte		peekcmd;
+	float		peektime;
 } demo;
 
 /*
@@ -182,7 +168,7 @@ overwrite host.frametime
 */
 double CL_GetDemoFramerate( void )
 {
-	if( cls.timedemo )
+	if( cls.timedemo || cls.demoseeking )
 		return 0.0;
 	return bound( MIN_FPS, demo.header.host_fps, MAX_FPS );
 }
@@ -221,6 +207,12 @@ void CL_WriteDemoJumpTime( void )
 	if( cls.demowaiting || !cls.demofile )
 		return;
 
+	// keyframe times continue from the previous level
+	demo.timebase += demo.lastdt;
+	demo.lastdt = 0.0f;
+	demo.level++;
+	demo.lastkeyframe = demo.timebase - cl_demo_keyframe_interval.value; // first one as soon as possible
+
 	demo.starttime = CL_GetDemoRecordClock(); // setup the demo starttime
 
 	// demo playback should read this as an incoming message.
@@ -280,6 +272,261 @@ void CL_WriteDemoSequence( file_t *file )
 	FS_Write( file, &cls.netchan.last_reliable_sequence, sizeof( int ));
 }
 
+/*
+====================
+CL_DemoRecordCommand
+
+copy just parsed command to the state log,
+it's replayed from the level start when jumping to a keyframe
+====================
+*/
+void CL_DemoRecordCommand( sizebuf_t *msg, int cmd, int startbit )
+{
+	byte	chunk[256];
+	sizebuf_t	src;
+	int	bits, size, pos;
+
+	if( !cls.demorecording || cls.legacymode || !demo.statelogdata )
+		return;
+
+	if( cmd == svc_serverdata )
+	{
+		demo.logstart = MSG_GetNumBitsWritten( &demo.statelog );
+		return;
+	}
+
+	if( demo.statelogfull || !Demo_IsStateCommand( cmd, CL_MsgInfo( cmd )))
+		return;
+
+	bits = MSG_GetNumBitsRead( msg ) - startbit;
+	pos = MSG_GetNumBitsWritten( &demo.statelog );
+
+	if( bits <= 0 || msg->bOverflow )
+		return;
+
+	if( pos + bits > demo.statelogsize * 8 )
+	{
+		size = Q_max( demo.statelogsize * 2, PAD_NUMBER( BitByte( pos + bits ), 4 ));
+
+		if( size > DEMO_MAX_STATE_LOG )
+		{
+			Con_Printf( S_WARN "%s: state log is full, no more keyframes are written\n", __func__ );
+			demo.statelogfull = true;
+			return;
+		}
+
+		demo.statelogdata = Mem_Realloc( cls.mempool, demo.statelogdata, size );
+		demo.statelogsize = size;
+		MSG_Init( &demo.statelog, "DemoStateLog", demo.statelogdata, size );
+		MSG_SeekToBit( &demo.statelog, pos, SEEK_SET );
+	}
+
+	src = *msg;
+	MSG_SeekToBit( &src, startbit, SEEK_SET );
+
+	while( bits > 0 )
+	{
+		size = Q_min( bits, (int)sizeof( chunk ) * 8 );
+		MSG_ReadBits( &src, chunk, size );
+		MSG_WriteBits( &demo.statelog, chunk, size );
+		bits -= size;
+	}
+}
+
+/*
+====================
+CL_WriteDemoSounds
+
+restart looping sounds after the jump,
+one shot sounds are short enough to lose them
+====================
+*/
+static void CL_WriteDemoSounds( sizebuf_t *msg )
+{
+	soundlist_t	sounds[MAX_CHANNELS];
+	soundlist_t	*snd;
+	int		i, j, count, flags, vol;
+
+	count = S_GetCurrentStaticSounds( sounds, MAX_CHANNELS );
+	count += S_GetCurrentDynamicSounds( sounds + count, MAX_CHANNELS - count );
+
+	for( i = 0, snd = sounds; i < count; i++, snd++ )
+	{
+		if( !snd->looping || snd->name[0] == '!' || snd->name[0] == '#' )
+			continue;
+
+		// server has to send sounds by precache index
+		for( j = 1; j < MAX_SOUNDS && cl.sound_precache[j][0]; j++ )
+		{
+			if( !Q_stricmp( cl.sound_precache[j], snd->name ))
+				break;
+		}
+
+		if( j == MAX_SOUNDS || !cl.sound_precache[j][0] )
+			continue;
+
+		flags = 0;
+		vol = bound( 0, (int)( snd->volume * 255.0f ), 255 );
+		if( vol != 255 ) SetBits( flags, SND_VOLUME );
+		if( snd->attenuation != ATTN_NONE ) SetBits( flags, SND_ATTENUATION );
+		if( snd->pitch != PITCH_NORM ) SetBits( flags, SND_PITCH );
+
+		MSG_BeginServerCmd( msg, svc_restoresound );
+		MSG_WriteUBitLong( msg, flags, MAX_SND_FLAGS_BITS );
+		MSG_WriteUBitLong( msg, j, MAX_SOUND_BITS );
+		MSG_WriteUBitLong( msg, snd->channel, MAX_SND_CHAN_BITS );
+		if( FBitSet( flags, SND_VOLUME )) MSG_WriteByte( msg, vol );
+		if( FBitSet( flags, SND_ATTENUATION )) MSG_WriteByte( msg, bound( 0, (int)( snd->attenuation * 64.0f ), 255 ));
+		if( FBitSet( flags, SND_PITCH )) MSG_WriteByte( msg, snd->pitch );
+		MSG_WriteUBitLong( msg, Q_max( snd->entnum, 0 ), MAX_ENTITY_BITS );
+		MSG_WriteVec3Coord( msg, snd->origin );
+		MSG_WriteByte( msg, snd->wordIndex );
+		MSG_WriteBytes( msg, &snd->samplePos, sizeof( snd->samplePos ));
+		MSG_WriteBytes( msg, &snd->forcedEnd, sizeof( snd->forcedEnd ));
+	}
+}
+
+/*
+====================
+CL_WriteDemoState
+
+build full update from the client state,
+it's parsed as if the server sent it
+====================
+*/
+static void CL_WriteDemoState( sizebuf_t *msg )
+{
+	frame_t		*frame = &cl.frames[cl.parsecountmod];
+	weapon_data_t	nullwd;
+	clientdata_t	nullcd;
+	movevars_t	nullmv;
+	entity_state_t	*state;
+	player_info_t	*player;
+	int		i;
+
+	MSG_BeginServerCmd( msg, svc_time );
+	MSG_WriteFloat( msg, cl.mtime[0] );
+
+	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
+	{
+		MSG_BeginServerCmd( msg, svc_lightstyle );
+		MSG_WriteByte( msg, i );
+		MSG_WriteString( msg, cl.lightstyles[i].pattern );
+		MSG_WriteFloat( msg, cl.lightstyles[i].time );
+	}
+
+	for( i = 0; i < cl.maxclients; i++ )
+	{
+		player = &cl.players[i];
+
+		MSG_BeginServerCmd( msg, svc_updateuserinfo );
+		MSG_WriteUBitLong( msg, i, MAX_CLIENT_BITS );
+		MSG_WriteLong( msg, player->userid );
+
+		if( player->name[0] )
+		{
+			MSG_WriteOneBit( msg, 1 );
+			MSG_WriteString( msg, player->userinfo );
+			MSG_WriteBytes( msg, player->hashedcdkey, sizeof( player->hashedcdkey ));
+		}
+		else MSG_WriteOneBit( msg, 0 );
+	}
+
+	memset( &nullmv, 0, sizeof( nullmv ));
+	MSG_WriteDeltaMovevars( msg, &nullmv, &clgame.movevars );
+
+	CL_WriteDemoSounds( msg );
+
+	MSG_BeginServerCmd( msg, svc_clientdata );
+
+	if( !cls.spectator )
+	{
+		memset( &nullcd, 0, sizeof( nullcd ));
+		memset( &nullwd, 0, sizeof( nullwd ));
+
+		MSG_WriteOneBit( msg, 0 ); // no delta-compression
+		MSG_WriteClientData( msg, &nullcd, &frame->clientdata, cl.mtime[0] );
+
+		for( i = 0; i < MAX_LOCAL_WEAPONS; i++ )
+			MSG_WriteWeaponData( msg, &nullwd, &frame->weapondata[i], cl.mtime[0], i );
+
+		MSG_WriteOneBit( msg, 0 ); // end marker
+	}
+
+	MSG_BeginServerCmd( msg, svc_packetentities );
+	MSG_WriteUBitLong( msg, frame->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
+
+	for( i = 0; i < frame->num_entities; i++ )
+	{
+		state = &cls.packet_entities[(frame->first_entity + i) % cls.num_client_entities];
+		MSG_WriteDeltaEntity( &CL_EDICT_NUM( state->number )->baseline, state, msg, true,
+			CL_IsPlayerIndex( state->number ) ? DELTA_PLAYER : DELTA_ENTITY, cl.mtime[0], 0 );
+	}
+
+	MSG_WriteUBitLong( msg, LAST_EDICT, MAX_ENTITY_BITS ); // end of packetentities
+}
+
+/*
+====================
+CL_WriteDemoKeyframe
+
+keyframe is a full update written aside, so
+the demo stream itself stays delta compressed
+====================
+*/
+static void CL_WriteDemoKeyframe( void )
+{
+	demokeyframe_t	*k;
+	sizebuf_t		buf;
+	byte		*data;
+	int		len;
+
+	// seeking there couldn't restore HUD state
+	if( demo.statelogfull )
+		return;
+
+	// entities must come from the message that was just written
+	if( cl.validsequence != cls.netchan.incoming_sequence || cl.parsecount != cls.netchan.incoming_sequence )
+		return;
+
+	if( !cl.frames[cl.parsecountmod].valid )
+		return;
+
+	data = Mem_Malloc( cls.mempool, NET_MAX_PAYLOAD );
+	MSG_Init( &buf, "DemoKeyframe", data, NET_MAX_PAYLOAD );
+	CL_WriteDemoState( &buf );
+
+	if( MSG_CheckOverflow( &buf ))
+	{
+		Con_Reportf( S_WARN "%s: full update overflowed, skipped\n", __func__ );
+		Mem_Free( data );
+		return;
+	}
+
+	if( demo.numkeyframes >= demo.maxkeyframes )
+	{
+		demo.maxkeyframes = Q_max( 64, demo.maxkeyframes * 2 );
+		demo.keyframes = Mem_Realloc( cls.mempool, demo.keyframes, sizeof( *demo.keyframes ) * demo.maxkeyframes );
+	}
+
+	k = &demo.keyframes[demo.numkeyframes++];
+	k->timestamp = demo.lastdt;
+	k->time = demo.timebase + k->timestamp;
+	k->offset = FS_Tell( cls.demofile );
+	k->level = demo.level;
+	k->logstart = demo.logstart;
+	k->logend = MSG_GetNumBitsWritten( &demo.statelog );
+	k->stateofs = FS_Tell( demo.statefile );
+
+	len = MSG_GetNumBytesWritten( &buf );
+	CL_WriteDemoSequence( demo.statefile );
+	FS_Write( demo.statefile, data, len );
+	k->statelen = FS_Tell( demo.statefile ) - k->stateofs;
+
+	demo.lastkeyframe = k->time;
+	Mem_Free( data );
+}
+
 /*
 ====================
 CL_WriteDemoMessage
@@ -302,7 +549,11 @@ void CL_WriteDemoMessage( qboolean startup, int start, sizebuf_t *msg )
 	swlen = MSG_GetNumBytesWritten( msg ) - start;
 	if( swlen <= 0 ) return;
 
-	if( !startup ) demo.framecount++;
+	if( !startup )
+	{
+		demo.framecount++;
+		demo.lastdt = CL_GetDemoRecordClock() - demo.starttime;
+	}
 
 	// demo playback should read this as an incoming message.
 	c = (cls.state != ca_active) ? dem_norewind : dem_read;
@@ -315,6 +566,10 @@ void CL_WriteDemoMessage( qboolean startup, int start, sizebuf_t *msg )
 
 	// output the buffer. Skip the network packet stuff.
 	FS_Write( file, MSG_GetData( msg ) + start, swlen );
+
+	if( !startup && c == dem_read && demo.statefile && !cls.legacymode && cl_demo_keyframe_interval.value > 0.0f
+		&& demo.timebase + demo.lastdt - demo.lastkeyframe >= cl_demo_keyframe_interval.value )
+		CL_WriteDemoKeyframe();
 }
 
 /*
@@ -405,6 +660,24 @@ void CL_WriteDemoHeader( const char *name )
 	demo.starttime = CL_GetDemoRecordClock();	// setup the demo starttime
 	demo.realstarttime = demo.starttime;
 	demo.framecount = 0;
+	demo.numkeyframes = 0;
+	demo.timebase = 0.0f;
+	demo.lastdt = 0.0f;
+	demo.level = 1; // jumptime below
+	demo.lastkeyframe = -cl_demo_keyframe_interval.value;
+	demo.logstart = 0;
+	demo.statelogfull = false;
+
+	// keyframe states are appended to the demo when recording is done
+	demo.statefile = FS_Open( "demokeyframes.tmp", "w+b", true );
+
+	if( demo.statefile )
+	{
+		demo.statelogsize = 64 * 1024;
+		demo.statelogdata = Mem_Malloc( cls.mempool, demo.statelogsize );
+		MSG_Init( &demo.statelog, "DemoStateLog", demo.statelogdata, demo.statelogsize );
+	}
+	else Con_DPrintf( S_ERROR "couldn't open temporary keyframes file.\n" );
 	cls.td_startframe = host.framecount;
 	cls.td_lastframe = -1;			// get a new message this frame
 
@@ -464,6 +737,39 @@ void CL_StopRecord( void )
 	Mem_Free( demo.directory.entries );
 	demo.directory.numentries = 0;
 
+	// keyframe index goes right after the directory
+	if( demo.numkeyframes > 0 )
+	{
+		int	id = IDEMOINDEX;
+		int	logbytes = MSG_GetNumBytesWritten( &demo.statelog );
+
+		FS_Write( cls.demofile, &id, sizeof( int ));
+		FS_Write( cls.demofile, &demo.numkeyframes, sizeof( int ));
+		FS_Write( cls.demofile, demo.keyframes, sizeof( demokeyframe_t ) * demo.numkeyframes );
+		FS_Write( cls.demofile, &logbytes, sizeof( int ));
+		FS_Write( cls.demofile, demo.statelogdata, logbytes );
+
+		FS_Seek( demo.statefile, 0, SEEK_SET );
+		FS_FileCopy( cls.demofile, demo.statefile, FS_FileLength( demo.statefile ));
+	}
+
+	if( demo.statefile )
+	{
+		FS_Close( demo.statefile );
+		FS_Delete( "demokeyframes.tmp" );
+	}
+	demo.statefile = NULL;
+
+	if( demo.statelogdata )
+		Mem_Free( demo.statelogdata );
+	demo.statelogdata = NULL;
+	demo.statelogsize = 0;
+
+	if( demo.keyframes )
+		Mem_Free( demo.keyframes );
+	demo.keyframes = NULL;
+	demo.numkeyframes = demo.maxkeyframes = 0;
+
 	demo.header.directory_offset = curpos;
 	FS_Seek( cls.demofile, 0, SEEK_SET );
 	FS_Write( cls.demofile, &demo.header, sizeof( demo.header ));
@@ -520,6 +826,15 @@ read the demo command
 */
 qboolean CL_ReadDemoCmdHeader( byte *cmd, float *dt )
 {
+	// command was put back, no need to read it again
+	if( demo.havepeek )
+	{
+		demo.havepeek = false;
+		*cmd = demo.peekcmd;
+		*dt = demo.peektime;
+		return true;
+	}
+
 	// read the command
 	// HACKHACK: skip NOPs
 	do
@@ -540,6 +855,20 @@ qboolean CL_ReadDemoCmdHeader( byte *cmd, float *dt )
 	return true;
 }
 
+/*
+=================
+CL_UnreadDemoCmdHeader
+
+put the command back until it's time for it
+=================
+*/
+static void CL_UnreadDemoCmdHeader( byte cmd, float dt )
+{
+	demo.havepeek = true;
+	demo.peekcmd = cmd;
+	demo.peektime = dt;
+}
+
 /*
 =================
 CL_ReadDemoUserCmd
@@ -679,6 +1008,11 @@ void CL_DemoStartPlayback( int mode )
 	memset( demo.cmds, 0, sizeof( demo.cmds ));
 	demo.angle_position = 1;
 	demo.framecount = 0;
+	demo.timebase = 0.0f;
+	demo.lastdt = 0.0f;
+	demo.level = 0;
+	demo.havepeek = false;
+	cls.demoseeking = false;
 	cls.lastoutgoingcommand = -1;
  	cls.nextcmdtime = host.realtime;
 	cl.last_command_ack = -1;
@@ -743,6 +1077,7 @@ qboolean CL_DemoMoveToNextSection( void )
 
 	// ready to continue reading, reset clock.
 	FS_Seek( cls.demofile, demo.entry->offset, SEEK_SET );
+	demo.havepeek = false;
 
 	// time is now relative to this chunk's clock.
 	demo.starttime = CL_GetDemoPlaybackClock();
@@ -897,7 +1232,7 @@ reads demo data and write it to client
 */
 qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 {
-	size_t		curpos = 0, lastpos = 0;
+	qboolean		haveusercmd = false;
 	float		fElapsedTime = 0.0f;
 	qboolean		swallowmessages = true;
 	static int	tdlastdemoframe = 0;
@@ -911,7 +1246,8 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 		return false;
 	}
 
-	if(( !cl.background && ( cl.paused || cls.key_dest != key_game )) || cls.key_dest == key_console )
+	// seeking is usually started from console, don't pause it
+	if( !cls.demoseeking && (( !cl.background && ( cl.paused || cls.key_dest != key_game )) || cls.key_dest == key_console ))
 	{
 		demo.starttime += host.frametime;
 		return false; // paused
@@ -925,35 +1261,41 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 		qboolean	bSkipMessage = false;
 
 		if( !cls.demofile ) break;
-		curpos = FS_Tell( cls.demofile );
 
 		if( !CL_ReadDemoCmdHeader( &cmd, &demo.timestamp ))
 			return false;
 
+		// reached the seek target, continue playing in real time from here
+		if( cls.demoseeking && ( cmd == dem_read || cmd == dem_norewind ) && demo.timebase + demo.timestamp >= demo.seektime )
+		{
+			cls.demoseeking = false;
+			demo.starttime = CL_GetDemoPlaybackClock() - demo.timestamp;
+		}
+
 		fElapsedTime = CL_GetDemoPlaybackClock() - demo.starttime;
-		if( !cls.timedemo ) bSkipMessage = ((demo.timestamp - cl_serverframetime()) >= fElapsedTime) ? true : false;
+		if( !cls.timedemo && !cls.demoseeking ) bSkipMessage = ((demo.timestamp - cl_serverframetime()) >= fElapsedTime) ? true : false;
 		if( cls.changelevel ) demo.framecount = 1;
 
 		// changelevel issues
 		if( demo.framecount <= 2 && ( fElapsedTime - demo.timestamp ) > host.frametime )
 			demo.starttime = CL_GetDemoPlaybackClock();
 
-		// not ready for a message yet, put it back on the file.
+		// not ready for a message yet, put it back.
 		if( cmd != dem_norewind && cmd != dem_stop && bSkipMessage )
 		{
 			// never skip first message
 			if( demo.framecount != 0 )
 			{
-				FS_Seek( cls.demofile, curpos, SEEK_SET );
+				CL_UnreadDemoCmdHeader( cmd, demo.timestamp );
 				return false; // not time yet.
 			}
 		}
 
 		// we already have the usercmd_t for this frame
 		// don't read next usercmd_t so predicting will work properly
-		if( cmd == dem_usercmd && lastpos != 0 && demo.framecount != 0 )
+		if( cmd == dem_usercmd && haveusercmd && demo.framecount != 0 )
 		{
-			FS_Seek( cls.demofile, lastpos, SEEK_SET );
+			CL_UnreadDemoCmdHeader( cmd, demo.timestamp );
 			return false; // not time yet.
 		}
 
@@ -961,6 +1303,9 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 		switch( cmd )
 		{
 		case dem_jumptime:
+			demo.timebase += demo.lastdt;
+			demo.lastdt = 0.0f;
+			demo.level++;
 			demo.starttime = CL_GetDemoPlaybackClock();
 			return false; // time is changed, skip frame
 		case dem_stop:
@@ -978,7 +1323,7 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 			break;
 		case dem_usercmd:
 			CL_ReadDemoUserCmd( false );
-			lastpos = FS_Tell( cls.demofile );
+			haveusercmd = true;
 			break;
 		default:
 			swallowmessages = false;
@@ -990,7 +1335,7 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 	//  frame update for this host_frame tag, then we'll just skip this message.
 	if( cls.timedemo && ( tdlastdemoframe == host.framecount ))
 	{
-		FS_Seek( cls.demofile, FS_Tell ( cls.demofile ) - 5, SEEK_SET );
+		CL_UnreadDemoCmdHeader( cmd, demo.timestamp );
 		return false;
 	}
 
@@ -1012,6 +1357,7 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length )
 	}
 
 	demo.framecount++;
+	demo.lastdt = demo.timestamp;
 	CL_ReadDemoSequence( false );
 
 	return CL_ReadRawNetworkData( buffer, length );
@@ -1105,6 +1451,230 @@ void CL_DemoInterpolateAngles( void )
 		VectorCopy( cl.cmd->viewangles, cl.viewangles );
 }
 
+/*
+=======================================================================
+
+TIMEDEMO STATISTICS
+
+=======================================================================
+*/
+typedef struct
+{
+	float		stage[TIMEDEMO_STAGES];	// msec
+	float		frametime;		// msec, whole engine frame
+} timedemo_frame_t;
+
+static const char *timedemo_stage_names[TIMEDEMO_STAGES] =
+{
+	"client",
+	"packets",
+	"predict",
+	"entities",
+	"render",
+	"sound",
+};
+
+static struct
+{
+	timedemo_frame_t	*frames;
+	int		numframes;
+	int		maxframes;
+	timedemo_frame_t	cur;
+	double		mark;
+	string		output;		// base name for csv and json files
+} timedemo;
+
+/*
+==============
+CL_TimeDemoBeginFrame
+==============
+*/
+void CL_TimeDemoBeginFrame( void )
+{
+	if( !cls.timedemo )
+		return;
+
+	memset( &timedemo.cur, 0, sizeof( timedemo.cur ));
+	timedemo.mark = Sys_DoubleTime();
+}
+
+/*
+==============
+CL_TimeDemoStage
+
+time since the previous mark goes to the stage
+==============
+*/
+void CL_TimeDemoStage( timedemo_stage_t stage )
+{
+	double	now;
+
+	if( !cls.timedemo )
+		return;
+
+	now = Sys_DoubleTime();
+	timedemo.cur.stage[stage] += ( now - timedemo.mark ) * 1000.0;
+	timedemo.mark = now;
+}
+
+/*
+==============
+CL_TimeDemoEndFrame
+==============
+*/
+void CL_TimeDemoEndFrame( void )
+{
+	if( !cls.timedemo )
+		return;
+
+	CL_TimeDemoStage( TIMEDEMO_CLIENT );
+
+	// loading isn't counted
+	if( cls.state != ca_active )
+		return;
+
+	if( timedemo.numframes >= timedemo.maxframes )
+	{
+		timedemo.maxframes = Q_max( 1024, timedemo.maxframes * 2 );
+		timedemo.frames = Mem_Realloc( cls.mempool, timedemo.frames, sizeof( *timedemo.frames ) * timedemo.maxframes );
+	}
+
+	timedemo.cur.frametime = host.realframetime * 1000.0;
+	timedemo.frames[timedemo.numframes++] = timedemo.cur;
+}
+
+static int CL_TimeDemoCompare( const void *a, const void *b )
+{
+	float	fa = *(const float *)a, fb = *(const float *)b;
+
+	return ( fa > fb ) - ( fa < fb );
+}
+
+/*
+==============
+CL_TimeDemoPercentiles
+
+mean, p50, p90, p95, p99 and max of one column
+==============
+*/
+static void CL_TimeDemoPercentiles( int column, float *sorted, float out[6] )
+{
+	const float	percents[] = { 50.0f, 90.0f, 95.0f, 99.0f };
+	double	sum = 0.0;
+	int	i, n = timedemo.numframes;
+
+	for( i = 0; i < n; i++ )
+	{
+		const timedemo_frame_t *f = &timedemo.frames[i];
+
+		sorted[i] = column < TIMEDEMO_STAGES ? f->stage[column] : f->frametime;
+		sum += sorted[i];
+	}
+
+	qsort( sorted, n, sizeof( float ), CL_TimeDemoCompare );
+
+	out[0] = sum / n;
+
+	// nearest rank
+	for( i = 0; i < 4; i++ )
+		out[i + 1] = sorted[Q_max( 0, (int)ceil( percents[i] / 100.0f * n ) - 1 )];
+
+	out[5] = sorted[n - 1];
+}
+
+/*
+==============
+CL_TimeDemoWriteStats
+
+per-frame csv and percentiles in json
+==============
+*/
+static void CL_TimeDemoWriteStats( float stats[TIMEDEMO_STAGES + 1][6], int frames, double time )
+{
+	const char	*names[] = { "mean", "p50", "p90", "p95", "p99", "max" };
+	char		filename[MAX_QPATH];
+	file_t		*f;
+	int		i, j;
+
+	Q_snprintf( filename, sizeof( filename ), "%s.csv", timedemo.output );
+
+	if(( f = FS_Open( filename, "w", true )) != NULL )
+	{
+		FS_Printf( f, "frame" );
+		for( j = 0; j < TIMEDEMO_STAGES; j++ )
+			FS_Printf( f, ",%s", timedemo_stage_names[j] );
+		FS_Printf( f, ",frametime\n" );
+
+		for( i = 0; i < timedemo.numframes; i++ )
+		{
+			FS_Printf( f, "%i", i );
+			for( j = 0; j < TIMEDEMO_STAGES; j++ )
+				FS_Printf( f, ",%.4f", timedemo.frames[i].stage[j] );
+			FS_Printf( f, ",%.4f\n", timedemo.frames[i].frametime );
+		}
+
+		FS_Close( f );
+		Con_Printf( "timedemo: wrote %s\n", filename );
+	}
+	else Con_Printf( S_ERROR "timedemo: couldn't write %s\n", filename );
+
+	Q_snprintf( filename, sizeof( filename ), "%s.json", timedemo.output );
+
+	if(( f = FS_Open( filename, "w", true )) != NULL )
+	{
+		FS_Printf( f, "{\n\t\"demo\": \"%s\",\n\t\"frames\": %i,\n\t\"seconds\": %.3f,\n\t\"fps\": %.3f,\n\t\"stages\": {\n",
+			cls.demoname, frames, time, frames / time );
+
+		for( i = 0; i <= TIMEDEMO_STAGES; i++ )
+		{
+			FS_Printf( f, "\t\t\"%s\": { ", i < TIMEDEMO_STAGES ? timedemo_stage_names[i] : "frametime" );
+			for( j = 0; j < 6; j++ )
+				FS_Printf( f, "\"%s\": %.4f%s", names[j], stats[i][j], j < 5 ? ", " : "" );
+			FS_Printf( f, " }%s\n", i < TIMEDEMO_STAGES ? "," : "" );
+		}
+
+		FS_Printf( f, "\t}\n}\n" );
+		FS_Close( f );
+		Con_Printf( "timedemo: wrote %s\n", filename );
+	}
+	else Con_Printf( S_ERROR "timedemo: couldn't write %s\n", filename );
+}
+
+/*
+==============
+CL_TimeDemoReport
+==============
+*/
+static void CL_TimeDemoReport( int frames, double time )
+{
+	float	stats[TIMEDEMO_STAGES + 1][6];
+	float	*sorted;
+	int	i;
+
+	if( timedemo.numframes > 0 )
+	{
+		sorted = Mem_Malloc( cls.mempool, sizeof( float ) * timedemo.numframes );
+
+		Con_Printf( "%-10s %8s %8s %8s %8s %8s %8s (msec)\n", "stage", "mean", "p50", "p90", "p95", "p99", "max" );
+
+		for( i = 0; i <= TIMEDEMO_STAGES; i++ )
+		{
+			CL_TimeDemoPercentiles( i, sorted, stats[i] );
+			Con_Printf( "%-10s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", i < TIMEDEMO_STAGES ? timedemo_stage_names[i] : "frametime",
+				stats[i][0], stats[i][1], stats[i][2], stats[i][3], stats[i][4], stats[i][5] );
+		}
+
+		Mem_Free( sorted );
+
+		if( COM_CheckStringEmpty( timedemo.output ))
+			CL_TimeDemoWriteStats( stats, frames, time );
+	}
+
+	if( timedemo.frames )
+		Mem_Free( timedemo.frames );
+	memset( &timedemo, 0, sizeof( timedemo ));
+}
+
 /*
 ==============
 CL_FinishTimeDemo
@@ -1125,6 +1695,7 @@ void CL_FinishTimeDemo( void )
 	if( !time ) time = 1.0;
 
 	Con_Printf( "timedemo result: %i frames %5.3f seconds %5.3f fps\n", frames, time, frames / time );
+	CL_TimeDemoReport( frames, time );
 
 	if( Sys_CheckParm( "-timedemo" ))
 		CL_Quit_f();
@@ -1156,6 +1727,17 @@ void CL_StopPlayback( void )
 	demo.header.host_fps = 0.0;
 	demo.entry = NULL;
 
+	if( demo.keyframes != NULL )
+		Mem_Free( demo.keyframes );
+	demo.keyframes = NULL;
+	demo.numkeyframes = 0;
+	if( demo.statelogdata != NULL )
+		Mem_Free( demo.statelogdata );
+	demo.statelogdata = NULL;
+	demo.statelogsize = 0;
+	demo.havepeek = false;
+	cls.demoseeking = false;
+
 	cls.demoname[0] = '\0';	// clear demoname too
 	gameui.globals->demoname[0] = '\0';
 
@@ -1413,6 +1995,57 @@ void CL_Record_f( void )
 	CL_WriteDemoHeader( demopath );
 }
 
+/*
+====================
+CL_ReadDemoKeyframes
+
+demos from older versions don't have the index
+====================
+*/
+static void CL_ReadDemoKeyframes( void )
+{
+	int	id = 0, count = 0, logbytes;
+	fs_offset_t	left;
+
+	if( FS_Read( cls.demofile, &id, sizeof( int )) != sizeof( int ) || id != IDEMOINDEX )
+		return;
+
+	if( FS_Read( cls.demofile, &count, sizeof( int )) != sizeof( int ))
+		return;
+
+	left = FS_FileLength( cls.demofile ) - FS_Tell( cls.demofile );
+
+	if( count <= 0 || count > left / (fs_offset_t)sizeof( demokeyframe_t ))
+	{
+		Con_Printf( S_WARN "demo has bogus # of keyframes: %i\n", count );
+		return;
+	}
+
+	demo.keyframes = Mem_Malloc( cls.mempool, sizeof( demokeyframe_t ) * count );
+	FS_Read( cls.demofile, demo.keyframes, sizeof( demokeyframe_t ) * count );
+	demo.numkeyframes = count;
+
+	if( FS_Read( cls.demofile, &logbytes, sizeof( int )) != sizeof( int ))
+		logbytes = 0;
+
+	left = FS_FileLength( cls.demofile ) - FS_Tell( cls.demofile );
+
+	if( logbytes < 0 || logbytes > DEMO_MAX_STATE_LOG || logbytes > left )
+	{
+		Con_Printf( S_WARN "demo has bogus state log size: %i\n", logbytes );
+		logbytes = 0;
+	}
+
+	if( logbytes > 0 )
+	{
+		demo.statelogsize = PAD_NUMBER( logbytes, 4 );
+		demo.statelogdata = Mem_Calloc( cls.mempool, demo.statelogsize );
+		FS_Read( cls.demofile, demo.statelogdata, logbytes );
+	}
+
+	demo.statebase = FS_Tell( cls.demofile );
+}
+
 /*
 ====================
 CL_PlayDemo_f
@@ -1532,6 +2165,8 @@ void CL_PlayDemo_f( void )
 		FS_Read( cls.demofile, &demo.directory.entries[i], sizeof( demoentry_t ));
 	}
 
+	CL_ReadDemoKeyframes();
+
 	demo.entryIndex = 0;
 	demo.entry = &demo.directory.entries[demo.entryIndex];
 
@@ -1555,8 +2190,24 @@ timedemo <demoname>
 */
 void CL_TimeDemo_f( void )
 {
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "%s <demoname> [statsname]\n", Cmd_Argv( 0 ));
+		return;
+	}
+
 	CL_PlayDemo_f ();
 
+	if( !cls.demoplayback )
+		return;
+
+	// per-frame stats are written to statsname.csv and statsname.json
+	if( timedemo.frames )
+		Mem_Free( timedemo.frames );
+	memset( &timedemo, 0, sizeof( timedemo ));
+	if( Cmd_Argc() > 2 )
+		Q_strncpy( timedemo.output, Cmd_Argv( 2 ), sizeof( timedemo.output ));
+
 	// cls.td_starttime will be grabbed at the second frame of the demo, so
 	// all the loading time doesn't get counted
 	cls.timedemo = true;
@@ -1565,6 +2216,181 @@ void CL_TimeDemo_f( void )
 	cls.td_lastframe = -1;		// get a new message this frame
 }
 
+/*
+====================
+CL_ParseDemoTime
+
+seconds or mm:ss
+====================
+*/
+static float CL_ParseDemoTime( const char *s )
+{
+	const char *colon = Q_strchr( s, ':' );
+
+	if( colon )
+		return Q_atoi( s ) * 60.0f + Q_atof( colon + 1 );
+
+	return Q_atof( s );
+}
+
+/*
+====================
+CL_FindDemoKeyframe
+
+last keyframe not later than time, keyframe times only grow
+====================
+*/
+static demokeyframe_t *CL_FindDemoKeyframe( float time )
+{
+	int	lo = 0, hi = demo.numkeyframes - 1, mid;
+
+	if( !demo.numkeyframes || demo.keyframes[0].time > time )
+		return NULL;
+
+	while( lo < hi )
+	{
+		mid = ( lo + hi + 1 ) / 2;
+
+		if( demo.keyframes[mid].time <= time )
+			lo = mid;
+		else hi = mid - 1;
+	}
+
+	return &demo.keyframes[lo];
+}
+
+/*
+====================
+CL_DemoJumpToKeyframe
+
+continue reading from full update, everything that
+was built from previous updates is thrown away
+====================
+*/
+static void CL_DemoJumpToKeyframe( const demokeyframe_t *k )
+{
+	int	seqlen = DEMO_SEQUENCE_INTS * sizeof( int );
+	sizebuf_t	buf;
+	byte	*data;
+	int	i, len;
+
+	demo.havepeek = false;
+	demo.timebase = k->time - k->timestamp;
+	demo.lastdt = k->timestamp;
+
+	memset( demo.cmds, 0, sizeof( demo.cmds ));
+	demo.angle_position = 1;
+	demo.lasttime = 0.0f;
+
+	for( i = 0; i < MULTIPLAYER_BACKUP; i++ )
+		cl.frames[i].valid = false;
+	cl.validsequence = 0;
+	cl.last_command_ack = -1;
+
+	CL_ClearTempEnts();
+	CL_ClearViewBeams();
+	CL_ClearParticles();
+	S_StopAllSounds( false );
+
+	// full update writes movevars from null
+	memset( &clgame.oldmovevars, 0, sizeof( clgame.oldmovevars ));
+
+	// rebuild the state left behind by reliable messages of this level
+	if( demo.statelogdata && k->logstart >= 0 && k->logstart <= k->logend && k->logend <= demo.statelogsize * 8 )
+	{
+		cl.viewentity = cl.playernum + 1;
+		cl.intermission = 0;
+		VectorClear( cl.crosshairangle );
+		Cvar_SetValue( "room_type", 0 );
+		S_StopBackgroundTrack();
+		if( clgame.hInstance ) clgame.dllFuncs.pfnReset();
+
+		MSG_StartReading( &buf, demo.statelogdata, demo.statelogsize, k->logstart, k->logend );
+		buf.pDebugName = "DemoStateLog";
+		CL_ParseServerMessage( &buf, false );
+	}
+
+	// client side full update, server demos have it in the stream
+	if( k->statelen > seqlen && k->statelen <= NET_MAX_PAYLOAD + seqlen )
+	{
+		len = k->statelen - seqlen;
+		data = Mem_Malloc( cls.mempool, PAD_NUMBER( len, 4 ));
+
+		FS_Seek( cls.demofile, demo.statebase + k->stateofs, SEEK_SET );
+		CL_ReadDemoSequence( false );
+
+		if( FS_Read( cls.demofile, data, len ) == len )
+		{
+			MSG_StartReading( &buf, data, PAD_NUMBER( len, 4 ), 0, len * 8 );
+			buf.pDebugName = "DemoKeyframe";
+			CL_ParseServerMessage( &buf, true );
+		}
+
+		Mem_Free( data );
+	}
+
+	FS_Seek( cls.demofile, k->offset, SEEK_SET );
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demo_seek [+|-]<seconds|mm:ss>
+====================
+*/
+void CL_DemoSeek_f( void )
+{
+	const char	*arg;
+	demokeyframe_t	*k;
+	float		current, target;
+
+	if( Cmd_Argc() != 2 )
+	{
+		Con_Printf( S_USAGE "demo_seek [+|-]<seconds|mm:ss>\n" );
+		return;
+	}
+
+	if( cls.demoplayback != DEMO_XASH3D || cls.timedemo || !cls.demofile || cls.state != ca_active )
+	{
+		Con_Printf( "demo_seek: not playing a demo\n" );
+		return;
+	}
+
+	arg = Cmd_Argv( 1 );
+	current = demo.timebase + demo.lastdt;
+
+	if( arg[0] == '+' || arg[0] == '-' )
+		target = CL_ParseDemoTime( arg + 1 );
+	else target = CL_ParseDemoTime( arg );
+
+	if( arg[0] == '+' )
+		target = current + target;
+	else if( arg[0] == '-' )
+		target = current - target;
+
+	target = Q_max( target, 0.0f );
+	k = CL_FindDemoKeyframe( target );
+
+	// keyframes are usable only on the current level, further levels are fast-forwarded to
+	if( k && k->level == demo.level && ( target < current || k->time > current ))
+	{
+		// no sounds while the state is rebuilt
+		cls.demoseeking = true;
+		CL_DemoJumpToKeyframe( k );
+	}
+	else if( target < current )
+	{
+		Con_Printf( "demo_seek: no keyframe to go back to %02d:%02d\n", (int)( target / 60.0f ), (int)fmod( target, 60.0f ));
+		return;
+	}
+
+	Con_Printf( "seeking to %02d:%02d\n", (int)( target / 60.0f ), (int)fmod( target, 60.0f ));
+
+	demo.seektime = target;
+	cls.demoseeking = true;
+}
+
 /*
 ==================
 CL_StartDemos_f
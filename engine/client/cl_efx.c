@@ -13,6 +13,12 @@
 
 PARTICLES MANAGEMENT
 
+particle_t stays the storage because game dlls keep pointers they
+get from R_AllocParticle, but live particles are listed in a dense
+array instead of a linked list. Every frame the array is compacted
+in place, live particles are packed for the renderer and grouped
+by motion type, then each built-in type is moved in its own loop.
+pt_clientcustom particles keep calling their callbacks
 ==============================================================
 */
 // particle ramps
@@ -25,10 +31,14 @@ static CVAR_DEFINE_AUTO( tracerspeed, "6000", 0, "tracer speed" );
 static CVAR_DEFINE_AUTO( tracerlength, "0.8", 0, "tracer length factor" );
 static CVAR_DEFINE_AUTO( traceroffset, "30", 0, "tracer starting offset" );
 
-particle_t	*cl_active_particles;
 particle_t	*cl_active_tracers;
 particle_t	*cl_free_particles;
 particle_t	*cl_particles = NULL;	// particle pool
+static particle_t	**cl_partactive;	// live particles in allocation order
+static int	cl_numpartactive;
+static particle_t	**cl_partgroups;	// live particles grouped by type, for simulation
+static ref_particle_t *cl_partdraw;	// packed for the renderer
+static void CL_SimulateParticles( double frametime );
 static vec3_t	cl_avelocities[NUMVERTEXNORMALS];
 static float	cl_lasttimewarn = 0.0f;
 
@@ -90,6 +100,9 @@ void CL_InitParticles( void )
 	int	i;
 
 	cl_particles = Mem_Calloc( cls.mempool, sizeof( particle_t ) * GI->max_particles );
+	cl_partactive = Mem_Calloc( cls.mempool, sizeof( *cl_partactive ) * GI->max_particles );
+	cl_partgroups = Mem_Calloc( cls.mempool, sizeof( *cl_partgroups ) * GI->max_particles );
+	cl_partdraw = Mem_Calloc( cls.mempool, sizeof( *cl_partdraw ) * GI->max_particles );
 	CL_ClearParticles ();
 
 	// this is used for EF_BRIGHTFIELD
@@ -118,7 +131,7 @@ void CL_ClearParticles( void )
 	if( !cl_particles ) return;
 
 	cl_free_particles = cl_particles;
-	cl_active_particles = NULL;
+	cl_numpartactive = 0;
 	cl_active_tracers = NULL;
 
 	for( i = 0; i < GI->max_particles - 1; i++ )
@@ -138,6 +151,20 @@ void CL_FreeParticles( void )
 	if( cl_particles )
 		Mem_Free( cl_particles );
 	cl_particles = NULL;
+
+	if( cl_partactive )
+		Mem_Free( cl_partactive );
+	cl_partactive = NULL;
+
+	if( cl_partgroups )
+		Mem_Free( cl_partgroups );
+	cl_partgroups = NULL;
+
+	if( cl_partdraw )
+		Mem_Free( cl_partdraw );
+	cl_partdraw = NULL;
+
+	cl_numpartactive = 0;
 }
 
 /*
@@ -190,8 +217,8 @@ particle_t * GAME_EXPORT R_AllocParticle( void (*callback)( particle_t*, float )
 
 	p = cl_free_particles;
 	cl_free_particles = p->next;
-	p->next = cl_active_particles;
-	cl_active_particles = p;
+	p->next = NULL;
+	cl_partactive[cl_numpartactive++] = p;
 
 	// clear old particle
 	p->type = pt_static;
@@ -2023,8 +2050,8 @@ void CL_ReadPointFile_f( void )
 		// may be executed from the console, while frametime is 0
 		p = cl_free_particles;
 		cl_free_particles = p->next;
-		p->next = cl_active_particles;
-		cl_active_particles = p;
+		p->next = NULL;
+		cl_partactive[cl_numpartactive++] = p;
 
 		p->ramp = 0;
 		p->type = pt_static;
@@ -2040,6 +2067,60 @@ void CL_ReadPointFile_f( void )
 	else Con_Printf( "map %s has no leaks!\n", clgame.mapname );
 }
 
+/*
+==============
+CL_FreeDeadParticles
+
+drops expired particles from the live array keeping the order
+of the others. With 'draw' set the live ones are packed into
+cl_partdraw, returns how many were packed
+==============
+*/
+static int CL_FreeDeadParticles( qboolean draw )
+{
+	int	i, count = cl_numpartactive;
+	int	live = 0, numdraw = 0;
+
+	for( i = 0; i < count; i++ )
+	{
+		particle_t *p = cl_partactive[i];
+
+		if( p->die < cl.time )
+		{
+			if( p->deathfunc )
+				p->deathfunc( p );
+			p->deathfunc = NULL;
+			p->next = cl_free_particles;
+			cl_free_particles = p;
+			continue;
+		}
+
+		cl_partactive[live++] = p;
+
+		if( draw && (( p->type != pt_blob ) || ( p->packedColor == 255 )))
+		{
+			ref_particle_t *out = &cl_partdraw[numdraw++];
+			int alpha;
+
+			p->color = bound( 0, p->color, 255 );
+			VectorCopy( p->org, out->org );
+			out->color = clgame.palette[p->color];
+
+			alpha = 255 * ( p->die - refState.time ) * 16.0f;
+			if( alpha > 255 || p->type == pt_static )
+				alpha = 255;
+			out->alpha = alpha;
+		}
+	}
+
+	// death functions could spawn particles behind the old end
+	if( cl_numpartactive > count )
+		memmove( &cl_partactive[live], &cl_partactive[count], ( cl_numpartactive - count ) * sizeof( *cl_partactive ));
+	cl_numpartactive = live + cl_numpartactive - count;
+
+	return numdraw;
+}
+
 void CL_FreeDeadBeams( void )
 {
 	BEAM *pBeam, *pNext, *pPrev = NULL;
@@ -2075,9 +2156,15 @@ void CL_DrawEFX( float time, qboolean fTrans )
 
 	if( fTrans )
 	{
-		R_FreeDeadParticles( &cl_active_particles );
+		int numdraw = CL_FreeDeadParticles( cl_draw_particles.value != 0.0f );
+
 		if( cl_draw_particles.value )
-			ref.dllFuncs.CL_DrawParticles( time, cl_active_particles, PART_SIZE );
+		{
+			// particles are drawn before they move, like they used to
+			if( numdraw ) ref.dllFuncs.CL_DrawParticles( cl_partdraw, numdraw, PART_SIZE );
+			CL_SimulateParticles( time );
+		}
+
 		R_FreeDeadParticles( &cl_active_tracers );
 		if( cl_draw_tracers.value )
 			ref.dllFuncs.CL_DrawTracers( time, cl_active_tracers );
@@ -2169,3 +2256,344 @@ void CL_ThinkParticle( double frametime, particle_t *p )
 	}
 }
 
+// unknown types only move, like pt_static
+#define PARTICLE_GROUP( p )	((uint)( p )->type <= pt_clientcustom ? ( p )->type : pt_static )
+
+/*
+==============
+CL_ThinkParticles
+
+moves a batch of particles of one type, same math as
+CL_ThinkParticle without switching on every particle.
+Blobs may change their type, they still go one by one
+==============
+*/
+static void CL_ThinkParticles( double frametime, particle_t **list, int count, int type )
+{
+	float	time3 = 15.0f * frametime;
+	float	time2 = 10.0f * frametime;
+	float	time1 = 5.0f * frametime;
+	float	dvel = 4.0f * frametime;
+	float	grav = frametime * clgame.movevars.gravity * 0.05f;
+	particle_t	*p;
+	int	i;
+
+	switch( type )
+	{
+	case pt_static:
+		for( i = 0; i < count; i++ )
+		{
+			p = list[i];
+			VectorMA( p->org, frametime, p->vel, p->org );
+		}
+		break;
+	case pt_fire:
+		for( i = 0; i < count; i++ )
+		{
+			p = list[i];
+			VectorMA( p->org, frametime, p->vel, p->org );
+			p->ramp += time1;
+			if( p->ramp >= 6.0f ) p->die = -1.0f;
+			else p->color = ramp3[(int)p->ramp];
+			p->vel[2] += grav;
+		}
+		break;
+	case pt_explode:
+		for( i = 0; i < count; i++ )
+		{
+			p = list[i];
+			VectorMA( p->org, frametime, p->vel, p->org );
+			p->ramp += time2;
+			if( p->ramp >= 8.0f ) p->die = -1.0f;
+			else p->color = ramp1[(int)p->ramp];
+			VectorMA( p->vel, dvel, p->vel, p->vel );
+			p->vel[2] -= grav;
+		}
+		break;
+	case pt_explode2:
+		for( i = 0; i < count; i++ )
+		{
+			p = list[i];
+			VectorMA( p->org, frametime, p->vel, p->org );
+			p->ramp += time3;
+			if( p->ramp >= 8.0f ) p->die = -1.0f;
+			else p->color = ramp2[(int)p->ramp];
+			VectorMA( p->vel, -frametime, p->vel, p->vel );
+			p->vel[2] -= grav;
+		}
+		break;
+	case pt_grav:
+	case pt_slowgrav:
+	case pt_vox_grav:
+	case pt_vox_slowgrav:
+		if( type == pt_grav ) grav *= 20.0f;
+		else if( type == pt_vox_grav ) grav *= 8.0f;
+		else if( type == pt_vox_slowgrav ) grav *= 4.0f;
+
+		for( i = 0; i < count; i++ )
+		{
+			p = list[i];
+			VectorMA( p->org, frametime, p->vel, p->org );
+			p->vel[2] -= grav;
+		}
+		break;
+	default:
+		for( i = 0; i < count; i++ )
+			CL_ThinkParticle( frametime, list[i] );
+		break;
+	}
+}
+
+/*
+==============
+CL_SimulateParticles
+
+groups live particles by type with a counting sort
+and runs each group through CL_ThinkParticles
+==============
+*/
+static void CL_SimulateParticles( double frametime )
+{
+	int	counts[pt_clientcustom + 1];
+	int	offsets[pt_clientcustom + 1];
+	int	i, type, count = cl_numpartactive;
+
+	memset( counts, 0, sizeof( counts ));
+
+	for( i = 0; i < count; i++ )
+		counts[PARTICLE_GROUP( cl_partactive[i] )]++;
+
+	for( i = type = 0; type <= pt_clientcustom; type++ )
+	{
+		offsets[type] = i;
+		i += counts[type];
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		particle_t *p = cl_partactive[i];
+		cl_partgroups[offsets[PARTICLE_GROUP( p )]++] = p;
+	}
+
+	// callbacks may spawn new particles, they are not in the groups
+	for( i = type = 0; type <= pt_clientcustom; type++ )
+	{
+		if( counts[type] )
+			CL_ThinkParticles( frametime, &cl_partgroups[i], counts[type], type );
+		i += counts[type];
+	}
+}
+
+/*
+==============
+CL_ParticleBench_f
+
+fills the pool with funnels and explosions, then times moving
+it particle by particle and in type batches. Both runs start
+from the same state and must end in the same one. Particles
+that were alive before are put back afterwards
+==============
+*/
+void CL_ParticleBench_f( void )
+{
+	static const char *names[] = { "per particle", "batched" };
+	size_t	poolsize = sizeof( particle_t ) * GI->max_particles;
+	particle_t	*saved, *start, *result;
+	particle_t	**savedactive;
+	particle_t	*savedfree, *savedtracers;
+	int	savedcount, frames = 100, i, j, k;
+	vec3_t	org;
+
+	if( Cmd_Argc() > 1 )
+		frames = Q_max( 1, Q_atoi( Cmd_Argv( 1 )));
+
+	if( !cl_particles || !cl_draw_particles.value )
+	{
+		Con_Printf( "cl_particlebench: particles are disabled\n" );
+		return;
+	}
+
+	saved = Z_Malloc( poolsize );
+	start = Z_Malloc( poolsize );
+	result = Z_Malloc( poolsize );
+	savedactive = Z_Malloc( sizeof( *cl_partactive ) * GI->max_particles );
+
+	memcpy( saved, cl_particles, poolsize );
+	memcpy( savedactive, cl_partactive, sizeof( *cl_partactive ) * cl_numpartactive );
+	savedcount = cl_numpartactive;
+	savedfree = cl_free_particles;
+	savedtracers = cl_active_tracers;
+
+	CL_ClearParticles();
+
+	for( i = 0; cl_free_particles; i++ )
+	{
+		VectorSet( org, ( i & 7 ) * 256.0f, (( i >> 3 ) & 7 ) * 256.0f, 0.0f );
+
+		if( i & 1 ) R_ParticleExplosion( org );
+		else R_LargeFunnel( org, i & 2 );
+	}
+
+	memcpy( start, cl_particles, poolsize );
+
+	Con_Printf( "particles %i, %i frames\n", cl_numpartactive, frames );
+
+	for( i = 0; i < 2; i++ )
+	{
+		double time;
+
+		memcpy( cl_particles, start, poolsize );
+
+		time = Sys_DoubleTime();
+		for( j = 0; j < frames; j++ )
+		{
+			if( i == 0 )
+			{
+				for( k = 0; k < cl_numpartactive; k++ )
+					CL_ThinkParticle( 1.0 / 60.0, cl_partactive[k] );
+			}
+			else CL_SimulateParticles( 1.0 / 60.0 );
+		}
+		time = Sys_DoubleTime() - time;
+
+		if( i == 0 )
+			memcpy( result, cl_particles, poolsize );
+
+		Con_Printf( "%16s: %.3f ms%s\n", names[i], time * 1000.0 / frames,
+			( i > 0 && memcmp( result, cl_particles, poolsize )) ? ", MISMATCH" : "" );
+	}
+
+	memcpy( cl_particles, saved, poolsize );
+	memcpy( cl_partactive, savedactive, sizeof( *cl_partactive ) * savedcount );
+	cl_numpartactive = savedcount;
+	cl_free_particles = savedfree;
+	cl_active_tracers = savedtracers;
+
+	Z_Free( saved );
+	Z_Free( start );
+	Z_Free( result );
+	Z_Free( savedactive );
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_PARTICLES	1024
+
+static int test_deaths;
+
+static void Test_ParticleDeath( particle_t *p )
+{
+	test_deaths++;
+}
+
+static void Test_ParticleCallback( particle_t *p, float frametime )
+{
+	p->org[0] += 1.0f;
+}
+
+/*
+batched simulation must give the same particles as moving
+them one by one, dead particles leave in order
+*/
+static void Test_ParticleBatches( void )
+{
+	particle_t	*pool = Z_Calloc( sizeof( particle_t ) * TEST_PARTICLES * 2 );
+	particle_t	*single = pool + TEST_PARTICLES;
+	particle_t	**oldactive = cl_partactive, **oldgroups = cl_partgroups;
+	particle_t	*oldfree = cl_free_particles;
+	ref_particle_t	*olddraw = cl_partdraw;
+	int	oldcount = cl_numpartactive;
+	float	oldgravity = clgame.movevars.gravity;
+	double	oldtime = cl.time;
+	int	i, j, numdraw;
+
+	cl_partactive = Z_Calloc( sizeof( *cl_partactive ) * TEST_PARTICLES );
+	cl_partgroups = Z_Calloc( sizeof( *cl_partgroups ) * TEST_PARTICLES );
+	cl_partdraw = Z_Calloc( sizeof( *cl_partdraw ) * TEST_PARTICLES );
+	cl_numpartactive = TEST_PARTICLES;
+	cl_free_particles = NULL;
+	clgame.movevars.gravity = 800.0f;
+	cl.time = 10.0;
+
+	for( i = 0; i < TEST_PARTICLES; i++ )
+	{
+		particle_t *p = &pool[i];
+
+		// blobs without packedColor 255 are random, leave them out
+		p->type = i % ( pt_clientcustom + 2 );
+		if( p->type == pt_blob || p->type == pt_blob2 )
+			p->packedColor = 255;
+		if( p->type == pt_clientcustom )
+			p->callback = Test_ParticleCallback;
+
+		VectorSet( p->org, i * 3.0f, i * -2.0f, i * 0.5f );
+		VectorSet( p->vel, 100.0f - i, i * 0.25f, 50.0f );
+		p->ramp = ( i % 7 ) * 1.25f;
+		p->color = i & 255;
+		p->die = 20.0f;
+		cl_partactive[i] = p;
+	}
+
+	memcpy( single, pool, sizeof( particle_t ) * TEST_PARTICLES );
+
+	for( j = 0; j < 30; j++ )
+	{
+		CL_SimulateParticles( 1.0 / 30.0 );
+
+		for( i = 0; i < TEST_PARTICLES; i++ )
+			CL_ThinkParticle( 1.0 / 30.0, &single[i] );
+	}
+
+	for( i = 0; i < TEST_PARTICLES; i++ )
+	{
+		_TASSERT( memcmp( &pool[i], &single[i], sizeof( particle_t )),
+			Msg( S_ERROR "particle %d of type %d differs\n", i, single[i].type ))
+	}
+
+	// every third one dies, survivors keep their order
+	for( i = 0; i < TEST_PARTICLES; i++ )
+	{
+		pool[i].die = ( i % 3 ) ? 20.0f : 5.0f;
+		pool[i].deathfunc = Test_ParticleDeath;
+		pool[i].type = pt_grav;
+		cl_partactive[i] = &pool[i];
+	}
+
+	test_deaths = 0;
+	numdraw = CL_FreeDeadParticles( true );
+
+	TASSERT_EQi( test_deaths, TEST_PARTICLES / 3 + 1 );
+	TASSERT_EQi( cl_numpartactive, TEST_PARTICLES - test_deaths );
+	TASSERT_EQi( numdraw, cl_numpartactive );
+
+	for( i = j = 0; i < TEST_PARTICLES; i++ )
+	{
+		if( i % 3 )
+		{
+			TASSERT( cl_partactive[j] == &pool[i] );
+			TASSERT( cl_partdraw[j].org[0] == pool[i].org[0] );
+			j++;
+		}
+	}
+
+	Z_Free( cl_partactive );
+	Z_Free( cl_partgroups );
+	Z_Free( cl_partdraw );
+	Z_Free( pool );
+
+	cl_partactive = oldactive;
+	cl_partgroups = oldgroups;
+	cl_partdraw = olddraw;
+	cl_numpartactive = oldcount;
+	cl_free_particles = oldfree;
+	clgame.movevars.gravity = oldgravity;
+	cl.time = oldtime;
+}
+
+void Test_RunParticles( void )
+{
+	TRUN( Test_ParticleBatches() );
+}
+#endif /* XASH_ENGINE_TESTS */
+
@@ -45,6 +45,15 @@ FRAME INTERPOLATION
 
 =========================================================================
 */
+// model lerp waiting for CL_LerpModels
+typedef struct
+{
+	cl_entity_t		*ent;
+	const position_history_t	*ph0;	// lerp end
+	const position_history_t	*ph1;	// lerp start
+	float			frac;
+} entlerp_t;
+
 /*
 ==================
 CL_UpdatePositions
@@ -347,35 +356,68 @@ void CL_ProcessEntityUpdate( cl_entity_t *ent )
 CL_FindInterpolationUpdates
 
 find two timestamps
+
+going back from current_position the history is in time order
+and ends with empty slots, which are older than anything, so
+deep lookups don't have to walk the whole history
 ==================
 */
 qboolean CL_FindInterpolationUpdates( cl_entity_t *ent, float targettime, position_history_t **ph0, position_history_t **ph1 )
 {
 	qboolean	extrapolate = true;
-	uint		i, i0, i1, imod;
+	uint		i, lo, hi, mid, imod;
 	float	at;
 
 	imod = ent->current_position;
-	i0 = (imod - 0) & HISTORY_MASK;	// curpos (lerp end)
-	i1 = (imod - 1) & HISTORY_MASK;	// oldpos (lerp start)
+	i = 0;
 
-	for( i = 1; i < HISTORY_MAX - 1; i++ )
+	// the target is usually a few updates back, so those are scanned directly
+	for( lo = 1; lo < 8; lo++ )
 	{
-		at = ent->ph[( imod - i ) & HISTORY_MASK].animtime;
-		if( at == 0.0f ) break;
+		at = ent->ph[( imod - lo ) & HISTORY_MASK].animtime;
+
+		if( at == 0.0f )
+			break;
 
 		if( targettime > at )
 		{
-			// found it
-			i0 = (( imod - i ) + 1 ) & HISTORY_MASK;
-			i1 = (( imod - i ) + 0 ) & HISTORY_MASK;
-			extrapolate = false;
+			i = lo;
 			break;
 		}
 	}
 
-	if( ph0 != NULL ) *ph0 = &ent->ph[i0];
-	if( ph1 != NULL ) *ph1 = &ent->ph[i1];
+	// past that the history is in time order, so gallop back 16, 32
+	// updates until the target is passed and bisect the last gap
+	if( lo == 8 )
+	{
+		for( hi = 8; hi < HISTORY_MAX - 1; lo = hi + 1, hi <<= 1 )
+		{
+			if( targettime > ent->ph[( imod - hi ) & HISTORY_MASK].animtime )
+				break;
+		}
+
+		hi = Q_min( hi, HISTORY_MAX - 1 );
+
+		while( lo < hi )
+		{
+			mid = ( lo + hi ) >> 1;
+
+			if( targettime > ent->ph[( imod - mid ) & HISTORY_MASK].animtime )
+				hi = mid;
+			else lo = mid + 1;
+		}
+
+		// found it, unless we ran into empty slots
+		if( lo < HISTORY_MAX - 1 && ent->ph[( imod - lo ) & HISTORY_MASK].animtime != 0.0f )
+			i = lo;
+	}
+
+	if( i != 0 )
+		extrapolate = false;
+	else i = 1; // extrapolate from the last two updates
+
+	if( ph0 != NULL ) *ph0 = &ent->ph[( imod - i + 1 ) & HISTORY_MASK];	// lerp end
+	if( ph1 != NULL ) *ph1 = &ent->ph[( imod - i ) & HISTORY_MASK];	// lerp start
 
 	return extrapolate;
 }
@@ -432,15 +474,16 @@ void CL_PureOrigin( cl_entity_t *ent, float t, vec3_t outorigin, vec3_t outangle
 
 /*
 ==================
-CL_InterpolateModel
+CL_FindModelLerp
 
-non-players interpolation
+first half of CL_InterpolateModel, picks the updates
+to lerp between. Returns -1 when 'lerp' has to be
+finished by CL_LerpModels, otherwise the result
 ==================
 */
-int CL_InterpolateModel( cl_entity_t *e )
+static int CL_FindModelLerp( cl_entity_t *e, entlerp_t *lerp )
 {
 	position_history_t  *ph0 = NULL, *ph1 = NULL;
-	vec3_t		origin, angles, delta;
 	float		t, t1, t2, frac;
 	vec4_t		q, q1, q2;
 
@@ -498,7 +541,6 @@ int CL_InterpolateModel( cl_entity_t *e )
 		return 1;
 	}
 
-	VectorSubtract( ph0->origin, ph1->origin, delta );
 	frac = (t - t1) / (t2 - t1);
 
 	if( frac < 0.0f )
@@ -507,15 +549,59 @@ int CL_InterpolateModel( cl_entity_t *e )
 	if( frac > 1.0f )
 		frac = 1.0f;
 
-	VectorMA( ph1->origin, frac, delta, origin );
+	lerp->ent = e;
+	lerp->ph0 = ph0;
+	lerp->ph1 = ph1;
+	lerp->frac = frac;
+
+	return -1;
+}
+
+/*
+==================
+CL_LerpModels
+
+second half of CL_InterpolateModel, a tight loop
+over all the models that have their updates found
+==================
+*/
+static void CL_LerpModels( const entlerp_t *lerps, int count )
+{
+	vec4_t	q, q1, q2;
+	vec3_t	delta;
+	int	i;
+
+	for( i = 0; i < count; i++ )
+	{
+		const entlerp_t *lerp = &lerps[i];
+		cl_entity_t *e = lerp->ent;
+
+		VectorSubtract( lerp->ph0->origin, lerp->ph1->origin, delta );
+		VectorMA( lerp->ph1->origin, lerp->frac, delta, e->origin );
+
+		AngleQuaternion( lerp->ph0->angles, q1, false );
+		AngleQuaternion( lerp->ph1->angles, q2, false );
+		QuaternionSlerp( q2, q1, lerp->frac, q );
+		QuaternionAngle( q, e->angles );
+	}
+}
+
+/*
+==================
+CL_InterpolateModel
+
+non-players interpolation
+==================
+*/
+int CL_InterpolateModel( cl_entity_t *e )
+{
+	entlerp_t	lerp;
+	int	result = CL_FindModelLerp( e, &lerp );
 
-	AngleQuaternion( ph0->angles, q1, false );
-	AngleQuaternion( ph1->angles, q2, false );
-	QuaternionSlerp( q2, q1, frac, q );
-	QuaternionAngle( q, angles );
+	if( result >= 0 )
+		return result;
 
-	VectorCopy( origin, e->origin );
-	VectorCopy( angles, e->angles );
+	CL_LerpModels( &lerp, 1 );
 
 	return 1;
 }
@@ -824,6 +910,14 @@ int CL_ParsePacketEntities( sizebuf_t *msg, qboolean delta )
 
 		oldframe = &cl.frames[oldpacket & CL_UPDATE_MASK];
 
+		if( !oldframe->valid )
+		{
+			// demo jumped past the frame this one deltas from
+			Con_NPrintf( 2, "^3Warning:^1 delta from invalid frame^7\n" );
+			CL_FlushEntityPacket( msg );
+			return playerbytes;
+		}
+
 		if(( cls.next_client_entities - oldframe->first_entity ) > ( cls.num_client_entities - NUM_PACKET_ENTITIES ))
 		{
 			Con_NPrintf( 2, "^3Warning:^1 delta frame is too old^7\n" );
@@ -1141,10 +1235,24 @@ void CL_LinkPlayers( frame_t *frame )
 	if( cl.local.apply_effects ) CL_AddEntityEffects( CL_GetLocalPlayer( ));
 }
 
+// entity that got through the first pass of CL_LinkPacketEntities
+typedef struct
+{
+	cl_entity_t	*ent;
+	entity_state_t	*state;
+	qboolean		interpolate;
+} linkent_t;
+
+static linkent_t	cl_linkents[MAX_VISIBLE_PACKET];
+static entlerp_t	cl_linklerps[MAX_VISIBLE_PACKET];
+
 /*
 ===============
 CL_LinkPacketEntities
 
+goes in three passes: entity states are checked and the updates
+to interpolate between are found, then all the lerps are done in
+one loop, then entities are added to the scene in packet order
 ===============
 */
 void CL_LinkPacketEntities( frame_t *frame )
@@ -1153,9 +1261,11 @@ void CL_LinkPacketEntities( frame_t *frame )
 	entity_state_t	*state;
 	qboolean		parametric;
 	qboolean		interpolate;
-	int		i;
+	int		numlinks = 0;
+	int		numlerps = 0;
+	int		i, result;
 
-	for( i = 0; i < frame->num_entities; i++ )
+	for( i = 0; i < frame->num_entities && numlinks < MAX_VISIBLE_PACKET; i++ )
 	{
 		state = &cls.packet_entities[(frame->first_entity + i) % cls.num_client_entities];
 
@@ -1231,39 +1341,50 @@ void CL_LinkPacketEntities( frame_t *frame )
 
 		if( ent->model->type == mod_brush )
 		{
-			CL_InterpolateModel( ent );
+			if( CL_FindModelLerp( ent, &cl_linklerps[numlerps] ) < 0 )
+				numlerps++;
+		}
+		else if( parametric )
+		{
+			CL_ParametricMove( ent );
+
+			VectorCopy( ent->curstate.origin, ent->origin );
+			VectorCopy( ent->curstate.angles, ent->angles );
+		}
+		else if( CL_EntityCustomLerp( ent ) || ( ent->curstate.movetype == MOVETYPE_STEP && !NET_IsLocalAddress( cls.netchan.remote_address )))
+		{
+			result = CL_FindModelLerp( ent, &cl_linklerps[numlerps] );
+
+			if( result == 0 )
+				continue;
+
+			if( result < 0 )
+				numlerps++;
 		}
 		else
 		{
-			if( parametric )
-			{
-				CL_ParametricMove( ent );
+			// no interpolation right now
+			VectorCopy( ent->curstate.origin, ent->origin );
+			VectorCopy( ent->curstate.angles, ent->angles );
+		}
 
-				VectorCopy( ent->curstate.origin, ent->origin );
-				VectorCopy( ent->curstate.angles, ent->angles );
-			}
-			else if( CL_EntityCustomLerp( ent ))
-			{
-				if ( !CL_InterpolateModel( ent ))
-					continue;
-			}
-			else if( ent->curstate.movetype == MOVETYPE_STEP && !NET_IsLocalAddress( cls.netchan.remote_address ))
-			{
-				if( !CL_InterpolateModel( ent ))
-					continue;
-			}
-			else
-			{
-				// no interpolation right now
-				VectorCopy( ent->curstate.origin, ent->origin );
-				VectorCopy( ent->curstate.angles, ent->angles );
-			}
+		cl_linkents[numlinks].ent = ent;
+		cl_linkents[numlinks].state = state;
+		cl_linkents[numlinks].interpolate = interpolate;
+		numlinks++;
+	}
 
-			if( ent->model->type == mod_studio )
-			{
-				if( interpolate && FBitSet( host.features, ENGINE_COMPUTE_STUDIO_LERP ))
-					ref.dllFuncs.R_StudioLerpMovement( ent, cl.time, ent->origin, ent->angles );
-			}
+	CL_LerpModels( cl_linklerps, numlerps );
+
+	for( i = 0; i < numlinks; i++ )
+	{
+		ent = cl_linkents[i].ent;
+		state = cl_linkents[i].state;
+
+		if( ent->model->type == mod_studio )
+		{
+			if( cl_linkents[i].interpolate && FBitSet( host.features, ENGINE_COMPUTE_STUDIO_LERP ))
+				ref.dllFuncs.R_StudioLerpMovement( ent, cl.time, ent->origin, ent->angles );
 		}
 
 		if( !FBitSet( state->entityType, ENTITY_NORMAL ))
@@ -1359,13 +1480,17 @@ void CL_EmitEntities( void )
 	CL_LinkPlayers ( &cl.frames[cl.parsecountmod] );
 
 	// link all the entities that actually have update
+	CL_ProfileBegin( "CL_LinkPacketEntities" );
 	CL_LinkPacketEntities ( &cl.frames[cl.parsecountmod] );
+	CL_ProfileEnd();
 
 	// link custom user temp entities
 	clgame.dllFuncs.pfnCreateEntities();
 
 	// evaluate temp entities
+	CL_ProfileBegin( "CL_TempEntUpdate" );
 	CL_TempEntUpdate ();
+	CL_ProfileEnd();
 
 	// fire events (client and server)
 	CL_FireEvents ();
@@ -1453,3 +1578,83 @@ void CL_ExtraUpdate( void )
 	clgame.dllFuncs.IN_Accumulate();
 	S_ExtraUpdate();
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+/*
+reference version, walks the history one update at a time
+*/
+static int Test_FindUpdateLinear( const cl_entity_t *ent, float targettime )
+{
+	uint	i, imod = ent->current_position;
+	float	at;
+
+	for( i = 1; i < HISTORY_MAX - 1; i++ )
+	{
+		at = ent->ph[( imod - i ) & HISTORY_MASK].animtime;
+
+		if( at == 0.0f )
+			break;
+
+		if( targettime > at )
+			return i;
+	}
+
+	return 0;
+}
+
+/*
+galloping search must pick the same pair of updates as the
+linear walk, with partially filled and wrapped histories
+*/
+static void Test_InterpolationSearch( void )
+{
+	cl_entity_t	*ent = Z_Calloc( sizeof( *ent ));
+	int	trial, j, k, mismatches = 0;
+
+	for( trial = 0; trial < 1000; trial++ )
+	{
+		int	updates = trial % ( HISTORY_MAX + 8 );
+		float	time = 1.0f;
+
+		memset( ent->ph, 0, sizeof( ent->ph ));
+		ent->current_position = trial & HISTORY_MASK;
+
+		for( k = 0; k < updates; k++ )
+		{
+			ent->current_position = ( ent->current_position + 1 ) & HISTORY_MASK;
+			time += ( k * 7 + trial ) % 4 * 0.01f; // some updates share a time
+			ent->ph[ent->current_position].animtime = time;
+		}
+
+		for( j = 0; j < 80; j++ )
+		{
+			float	targettime = time - j * 0.02f;
+			int	i = Test_FindUpdateLinear( ent, targettime );
+			position_history_t	*ph0, *ph1;
+			qboolean	extrapolate;
+
+			extrapolate = CL_FindInterpolationUpdates( ent, targettime, &ph0, &ph1 );
+
+			if( extrapolate != ( i == 0 ))
+				mismatches++;
+
+			if( i == 0 ) i = 1;
+			if( ph0 != &ent->ph[( ent->current_position - i + 1 ) & HISTORY_MASK] )
+				mismatches++;
+			if( ph1 != &ent->ph[( ent->current_position - i ) & HISTORY_MASK] )
+				mismatches++;
+		}
+	}
+
+	TASSERT_EQi( mismatches, 0 );
+
+	Z_Free( ent );
+}
+
+void Test_RunInterpolation( void )
+{
+	TRUN( Test_InterpolationSearch() );
+}
+#endif /* XASH_ENGINE_TESTS */
@@ -249,7 +249,7 @@ static float CL_LerpPoint( void )
 	double f = cl_serverframetime();
 	double frac;
 
-	if( f == 0.0 || cls.timedemo )
+	if( f == 0.0 || cls.timedemo || cls.demoseeking )
 	{
 		double fgap = cl_clientframetime();
 		cl.time = cl.mtime[0];
@@ -598,7 +598,7 @@ void CL_CreateCmd( void )
 	ms = bound( 1, host.frametime * 1000, 255 );
 	input_override = 0;
 
-	CL_SetSolidEntities();
+	CL_CheckSolidEntities();
 	CL_PushPMStates();
 	CL_SetSolidPlayers( cl.playernum );
 
@@ -650,7 +650,9 @@ void CL_CreateCmd( void )
 	if( !cls.demoplayback ) cl.cmd = &pcmd->cmd;
 
 	// predict all unacknowledged movements
+	CL_ProfileBegin( "CL_PredictMovement" );
 	CL_PredictMovement( false );
+	CL_ProfileEnd();
 }
 
 void CL_WriteUsercmd( sizebuf_t *msg, int from, int to )
@@ -2292,7 +2294,7 @@ void CL_ReadNetMessage( void )
 	}
 
 	// build list of all solid entities per next frame (exclude clients)
-	CL_SetSolidEntities();
+	CL_CheckSolidEntities();
 
 	// check for fragmentation/reassembly related packets.
 	if( cls.state != ca_disconnected && Netchan_IncomingReady( &cls.netchan ))
@@ -2658,10 +2660,44 @@ void CL_Physinfo_f( void )
 	Con_Printf( "Total %i symbols\n", Q_strlen( cls.physinfo ));
 }
 
+/*
+==================
+CL_PrefetchResources
+
+start reading models and sounds in background
+while world is being loaded
+==================
+*/
+static void CL_PrefetchResources( void )
+{
+	resource_t	*pRes;
+
+	for( pRes = cl.resourcesonhand.pNext; pRes && pRes != &cl.resourcesonhand; pRes = pRes->pNext )
+	{
+		if( FBitSet( pRes->ucFlags, RES_PRECACHED|RES_WASMISSING ))
+			continue;
+
+		switch( pRes->type )
+		{
+		case t_sound:
+			S_PrefetchSound( pRes->szFileName );
+			break;
+		case t_model:
+			if( pRes->nIndex != WORLD_INDEX && pRes->nIndex != -1 )
+				Mod_PrefetchModel( pRes->szFileName );
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 qboolean CL_PrecacheResources( void )
 {
 	resource_t	*pRes;
 
+	CL_PrefetchResources();
+
 	// NOTE: world need to be loaded as first model
 	for( pRes = cl.resourcesonhand.pNext; pRes && pRes != &cl.resourcesonhand; pRes = pRes->pNext )
 	{
@@ -2695,6 +2731,7 @@ qboolean CL_PrecacheResources( void )
 
 				if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 				{
+					FS_ClearPrefetch();
 					CL_Disconnect_f();
 					return false;
 				}
@@ -2732,6 +2769,7 @@ qboolean CL_PrecacheResources( void )
 						if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 						{
 							S_EndRegistration();
+							FS_ClearPrefetch();
 							CL_Disconnect_f();
 							return false;
 						}
@@ -2759,6 +2797,7 @@ qboolean CL_PrecacheResources( void )
 						if( FBitSet( pRes->ucFlags, RES_FATALIFMISSING ))
 						{
 							S_EndRegistration();
+							FS_ClearPrefetch();
 							CL_Disconnect_f();
 							return false;
 						}
@@ -2796,6 +2835,9 @@ qboolean CL_PrecacheResources( void )
 	if( cls.state != ca_active )
 		S_EndRegistration();
 
+	// drop whatever wasn't used
+	FS_ClearPrefetch();
+
 	return true;
 }
 
@@ -2917,6 +2959,7 @@ void CL_InitLocal( void )
 	Cvar_RegisterVariable( &cl_showevents );
 	Cvar_Get( "lastdemo", "", FCVAR_ARCHIVE, "last played demo" );
 	Cvar_RegisterVariable( &ui_renderworld );
+	Cvar_RegisterVariable( &cl_demo_keyframe_interval );
 
 	// these two added to shut up CS 1.5 about 'unknown' commands
 	Cvar_Get( "lightgamma", "1", FCVAR_ARCHIVE, "ambient lighting level (legacy, unused)" );
@@ -2954,6 +2997,7 @@ void CL_InitLocal( void )
 	Cmd_AddCommand ("record", CL_Record_f, "record a demo" );
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f, "play a demo" );
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f, "demo benchmark" );
+	Cmd_AddCommand ("demo_seek", CL_DemoSeek_f, "jump to specified time in playing demo" );
 	Cmd_AddCommand ("killdemo", CL_DeleteDemo_f, "delete a specified demo file" );
 	Cmd_AddCommand ("startdemos", CL_StartDemos_f, "start playing back the selected demos sequentially" );
 	Cmd_AddCommand ("demos", CL_Demos_f, "restart looping demos defined by the last startdemos command" );
@@ -2964,6 +3008,7 @@ void CL_InitLocal( void )
 	Cmd_AddCommand ("togglemenu", CL_Escape_f, "toggle between game and menu" );
 	Cmd_AddCommand ("pointfile", CL_ReadPointFile_f, "show leaks on a map (if present of course)" );
 	Cmd_AddCommand ("linefile", CL_ReadLineFile_f, "show leaks on a map (if present of course)" );
+	Cmd_AddCommand ("cl_particlebench", CL_ParticleBench_f, "time particle simulation per particle and in batches with funnel and explosion spam" );
 	Cmd_AddCommand ("fullserverinfo", CL_FullServerinfo_f, "sent by server when serverinfo changes" );
 	Cmd_AddCommand ("upload", CL_BeginUpload_f, "uploading file to the server" );
 
@@ -3031,6 +3076,9 @@ Host_ClientBegin
 */
 void Host_ClientBegin( void )
 {
+	// listen server frame runs inside the profiled frame
+	CL_ProfileBeginFrame ();
+
 	// exec console commands
 	Cbuf_Execute ();
 
@@ -3044,7 +3092,12 @@ void Host_ClientBegin( void )
 	CL_UpdateClientData();
 
 	// if running the server locally, make intentions now
-	if( SV_Active( )) CL_SendCommand ();
+	if( SV_Active( ))
+	{
+		CL_ProfileBegin( "CL_SendCommand" );
+		CL_SendCommand ();
+		CL_ProfileEnd();
+	}
 }
 
 /*
@@ -3058,27 +3111,46 @@ void Host_ClientFrame( void )
 	// if client is not active, do nothing
 	if( !cls.initialized ) return;
 
+	CL_TimeDemoBeginFrame ();
+
 	// if running the server remotely, send intentions now after
 	// the incoming messages have been read
-	if( !SV_Active( )) CL_SendCommand ();
+	if( !SV_Active( ))
+	{
+		CL_ProfileBegin( "CL_SendCommand" );
+		CL_SendCommand ();
+		CL_ProfileEnd();
+	}
 
+	CL_ProfileBegin( "HUD_Frame" );
 	clgame.dllFuncs.pfnFrame( host.frametime );
+	CL_ProfileEnd();
 
 	// remember last received framenum
 	CL_SetLastUpdate ();
+	CL_TimeDemoStage( TIMEDEMO_CLIENT );
 
 	// read updates from server
+	CL_ProfileBegin( "CL_ReadPackets" );
 	CL_ReadPackets ();
+	CL_ProfileEnd();
+	CL_TimeDemoStage( TIMEDEMO_PACKETS );
 
 	// do prediction again in case we got
 	// a new portion updates from server
+	CL_ProfileBegin( "CL_RedoPrediction" );
 	CL_RedoPrediction ();
+	CL_ProfileEnd();
+	CL_TimeDemoStage( TIMEDEMO_PREDICT );
 
 	// update voice
 	Voice_Idle( host.frametime );
 
 	// emit visible entities
+	CL_ProfileBegin( "CL_EmitEntities" );
 	CL_EmitEntities ();
+	CL_ProfileEnd();
+	CL_TimeDemoStage( TIMEDEMO_ENTITIES );
 
 	// in case we lost connection
 	CL_CheckForResend ();
@@ -3094,18 +3166,32 @@ void Host_ClientFrame( void )
 
 	// catch changes video settings
 	VID_CheckChanges();
+	CL_TimeDemoStage( TIMEDEMO_CLIENT );
 
-	// update the screen
-	SCR_UpdateScreen ();
+	// update the screen, unless demo is fast-forwarded
+	if( !cls.demoseeking )
+	{
+		CL_ProfileBegin( "SCR_UpdateScreen" );
+		SCR_UpdateScreen ();
+		CL_ProfileEnd();
+	}
+	CL_TimeDemoStage( TIMEDEMO_RENDER );
 
 	// update audio
+	CL_ProfileBegin( "SND_UpdateSound" );
 	SND_UpdateSound ();
+	CL_ProfileEnd();
+	CL_TimeDemoStage( TIMEDEMO_SOUND );
 
 	// play avi-files
 	SCR_RunCinematic ();
 
 	// adjust client time
 	CL_AdjustClock ();
+
+	CL_TimeDemoEndFrame ();
+
+	CL_ProfileEndFrame ();
 }
 
 //============================================================================
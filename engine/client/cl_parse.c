@@ -2215,6 +2215,7 @@ void CL_ParseServerMessage( sizebuf_t *msg, qboolean normal_message )
 	size_t		bufStart, playerbytes;
 	int		cmd, param1, param2;
 	int		old_background;
+	int		startbit;
 	const char	*s;
 
 	cls.starting_count = MSG_GetNumBytesRead( msg );	// updates each frame
@@ -2250,6 +2251,7 @@ void CL_ParseServerMessage( sizebuf_t *msg, qboolean normal_message )
 		if( MSG_GetNumBitsLeft( msg ) < 8 )
 			break;
 
+		startbit = MSG_GetNumBitsRead( msg );
 		cmd = MSG_ReadServerCmd( msg );
 
 		// record command for debugging spew on parse problem
@@ -2426,12 +2428,16 @@ void CL_ParseServerMessage( sizebuf_t *msg, qboolean normal_message )
 			CL_RegisterUserMessage( msg );
 			break;
 		case svc_packetentities:
+			CL_ProfileBegin( "CL_ParsePacketEntities" );
 			playerbytes = CL_ParsePacketEntities( msg, false );
+			CL_ProfileEnd();
 			cl.frames[cl.parsecountmod].graphdata.players += playerbytes;
 			cl.frames[cl.parsecountmod].graphdata.entities += MSG_GetNumBytesRead( msg ) - bufStart - playerbytes;
 			break;
 		case svc_deltapacketentities:
+			CL_ProfileBegin( "CL_ParsePacketEntities" );
 			playerbytes = CL_ParsePacketEntities( msg, true );
+			CL_ProfileEnd();
 			cl.frames[cl.parsecountmod].graphdata.players += playerbytes;
 			cl.frames[cl.parsecountmod].graphdata.entities += MSG_GetNumBytesRead( msg ) - bufStart - playerbytes;
 			break;
@@ -2490,6 +2496,9 @@ void CL_ParseServerMessage( sizebuf_t *msg, qboolean normal_message )
 			cl.frames[cl.parsecountmod].graphdata.usr += MSG_GetNumBytesRead( msg ) - bufStart;
 			break;
 		}
+
+		// keep state that demo keyframes can't restore
+		CL_DemoRecordCommand( msg, cmd, startbit );
 	}
 
 	cl.frames[cl.parsecountmod].graphdata.msgbytes += MSG_GetNumBytesRead( msg ) - cls.starting_count;
@@ -549,12 +549,16 @@ void CL_ParseLegacyServerMessage( sizebuf_t *msg, qboolean normal_message )
 			CL_RegisterUserMessage( msg );
 			break;
 		case svc_packetentities:
+			CL_ProfileBegin( "CL_ParsePacketEntities" );
 			playerbytes = CL_ParsePacketEntities( msg, false );
+			CL_ProfileEnd();
 			cl.frames[cl.parsecountmod].graphdata.players += playerbytes;
 			cl.frames[cl.parsecountmod].graphdata.entities += MSG_GetNumBytesRead( msg ) - bufStart - playerbytes;
 			break;
 		case svc_deltapacketentities:
+			CL_ProfileBegin( "CL_ParsePacketEntities" );
 			playerbytes = CL_ParsePacketEntities( msg, true );
+			CL_ProfileEnd();
 			cl.frames[cl.parsecountmod].graphdata.players += playerbytes;
 			cl.frames[cl.parsecountmod].graphdata.entities += MSG_GetNumBytesRead( msg ) - bufStart - playerbytes;
 			break;
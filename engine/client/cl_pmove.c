@@ -25,6 +25,7 @@ GNU General Public License for more details.
 #define MIN_CORRECTION_DISTANCE	0.25f	// use smoothing if error is > this
 #define MIN_PREDICTION_EPSILON	0.5f	// complain if error is > this and we have cl_showerror set
 #define MAX_PREDICTION_ERROR		64.0f	// above this is assumed to be a teleport, don't smooth, etc.
+#define PREDICTED_MOVE_PAD		32.0f	// stepping, ground and stuck checks may look this far around the move
 
 /*
 =============
@@ -114,7 +115,9 @@ void CL_RedoPrediction( void )
 {
 	if ( cls.netchan.incoming_sequence != cls.lastupdate_sequence )
 	{
+		CL_ProfileBegin( "CL_PredictMovement" );
 		CL_PredictMovement( true );
+		CL_ProfileEnd();
 		CL_CheckPredictionError();
 	}
 }
@@ -514,6 +517,33 @@ void CL_SetSolidEntities( void )
 
 	// add all other entities exlucde players
 	CL_AddLinksToPmove( &cl.frames[cl.parsecountmod] );
+
+	cl.local.physents_valid = true;
+	cl.local.physents_parsecount = cl.parsecount;
+	cl.local.numphysent = clgame.pmove->numphysent;
+	cl.local.numvisent = clgame.pmove->numvisent;
+	cl.local.nummoveent = clgame.pmove->nummoveent;
+}
+
+/*
+===============
+CL_CheckSolidEntities
+
+physents only change with a new server frame, build them
+again if it has arrived or someone left extra entities in
+the lists
+===============
+*/
+void CL_CheckSolidEntities( void )
+{
+	const playermove_t *pmove = clgame.pmove;
+
+	if( cl.local.physents_valid && cl.local.physents_parsecount == cl.parsecount
+		&& pmove->numphysent == cl.local.numphysent && pmove->numvisent == cl.local.numvisent
+		&& pmove->nummoveent == cl.local.nummoveent && pmove->physents[0].model == cl.worldmodel )
+		return;
+
+	CL_SetSolidEntities();
 }
 
 /*
@@ -997,11 +1027,89 @@ void CL_MoveSpectatorCamera( void )
 	VectorCopy( cls.spectator_state.client.view_ofs, cl.viewheight );
 }
 
+/*
+=================
+CL_PredictedMoveBounds
+
+box around the move of one command, other players
+outside of it can't change its predicted state
+=================
+*/
+static void CL_PredictedMoveBounds( const local_state_t *from, const local_state_t *to, vec3_t mins, vec3_t maxs )
+{
+	const playermove_t *pmove = clgame.pmove;
+	int	i, j;
+
+	ClearBounds( mins, maxs );
+	AddPointToBounds( from->playerstate.origin, mins, maxs );
+	AddPointToBounds( to->playerstate.origin, mins, maxs );
+
+	for( i = 0; i < 3; i++ )
+	{
+		float lo = 0.0f, hi = 0.0f;
+
+		// usehull may change while moving
+		for( j = 0; j < 4; j++ )
+		{
+			lo = Q_min( lo, pmove->player_mins[j][i] );
+			hi = Q_max( hi, pmove->player_maxs[j][i] );
+		}
+
+		mins[i] += lo - PREDICTED_MOVE_PAD;
+		maxs[i] += hi + PREDICTED_MOVE_PAD;
+	}
+}
+
+/*
+=================
+CL_PredictedMovePlayers
+
+checksum of the solid players touching the box,
+physents from the first one are added by CL_SetSolidPlayers
+=================
+*/
+static uint CL_PredictedMovePlayers( int first, const vec3_t mins, const vec3_t maxs )
+{
+	const playermove_t *pmove = clgame.pmove;
+	vec3_t	absmin, absmax;
+	uint32_t	crc;
+	int	i;
+
+	CRC32_Init( &crc );
+
+	for( i = first; i < pmove->numphysent; i++ )
+	{
+		const physent_t *pe = &pmove->physents[i];
+
+		VectorAdd( pe->origin, pe->mins, absmin );
+		VectorAdd( pe->origin, pe->maxs, absmax );
+
+		if( !BoundsIntersect( mins, maxs, absmin, absmax ))
+			continue;
+
+		CRC32_ProcessBuffer( &crc, &pe->info, sizeof( pe->info ));
+		CRC32_ProcessBuffer( &crc, pe->origin, sizeof( pe->origin ));
+		CRC32_ProcessBuffer( &crc, pe->angles, sizeof( pe->angles ));
+		CRC32_ProcessBuffer( &crc, pe->mins, sizeof( pe->mins ));
+		CRC32_ProcessBuffer( &crc, pe->maxs, sizeof( pe->maxs ));
+		CRC32_ProcessBuffer( &crc, &pe->solid, sizeof( pe->solid ));
+		CRC32_ProcessBuffer( &crc, &pe->movetype, sizeof( pe->movetype ));
+	}
+
+	return CRC32_Final( crc );
+}
+
 /*
 =================
 CL_PredictMovement
 
 Sets cl.predicted.origin and cl.predicted.angles
+
+Commands that were sent can't change, so until the next server
+frame arrives their predicted states are reused and only the
+newer commands are run. Other players move every frame, so a
+state is reused only if the players around its move are the same,
+otherwise it and all commands after it are run again
 =================
 */
 void CL_PredictMovement( qboolean repredicting )
@@ -1010,9 +1118,14 @@ void CL_PredictMovement( qboolean repredicting )
 	local_state_t	*from = NULL, *to = NULL;
 	frame_t *frame = NULL;
 	uint		i, stoppoint;
+	uint		cached, valid;
+	int		players;
 	double		f = 1.0;
 	double		time;
 
+	if( !repredicting )
+		cl.local.predicted_cmds = cl.local.cached_cmds = 0;
+
 	if( cls.state != ca_active || cls.spectator )
 		return;
 
@@ -1056,8 +1169,18 @@ void CL_PredictMovement( qboolean repredicting )
 	cl.local.repredicting = repredicting;
 	cl.local.onground = -1;
 
+	// reuse what was predicted from the same server frame,
+	// demo playback may put commands anywhere
+	if( cl.local.predicted_parsecount == cl.parsecount && cl.local.predicted_ack == cls.netchan.incoming_acknowledged
+		&& cl.local.predicted_pmove == CL_IsPredicted( ) && !cls.demoplayback )
+		cached = cl.local.predicted_count;
+	else cached = 0;
+
+	valid = 0;
+
 	// predict forward until cl.time <= to->senttime
 	CL_PushPMStates();
+	players = clgame.pmove->numphysent;
 	CL_SetSolidPlayers( cl.playernum );
 
 	for( i = 1; i < CL_UPDATE_MASK && cls.netchan.incoming_acknowledged + i < cls.netchan.outgoing_sequence + stoppoint; i++ )
@@ -1071,11 +1194,38 @@ void CL_PredictMovement( qboolean repredicting )
 
 		to = &cl.predicted_frames[(cl.parsecountmod + i) & CL_UPDATE_MASK];
 		to_cmd = &cl.commands[current_command_mod];
-		runfuncs = ( !repredicting && !to_cmd->processedfuncs );
 
-		CL_RunUsercmd( from, to, &to_cmd->cmd, runfuncs, &time, current_command );
-		VectorCopy( to->playerstate.origin, cl.local.predicted_origins[current_command_mod] );
-		to_cmd->processedfuncs = true;
+		// the rest depends on this one
+		if( i <= cached && CL_PredictedMovePlayers( players, cl.local.predicted_mins[current_command_mod],
+			cl.local.predicted_maxs[current_command_mod] ) != cl.local.predicted_nearby[current_command_mod] )
+			cached = 0;
+
+		if( i <= cached && current_command < cls.netchan.outgoing_sequence )
+		{
+			// funcs were run the first time
+			time = cl.local.predicted_times[current_command_mod];
+			cl.local.lastground = cl.local.predicted_grounds[current_command_mod];
+			cl.local.cached_cmds++;
+		}
+		else
+		{
+			runfuncs = ( !repredicting && !to_cmd->processedfuncs );
+
+			CL_RunUsercmd( from, to, &to_cmd->cmd, runfuncs, &time, current_command );
+			VectorCopy( to->playerstate.origin, cl.local.predicted_origins[current_command_mod] );
+			to_cmd->processedfuncs = true;
+
+			cl.local.predicted_times[current_command_mod] = time;
+			cl.local.predicted_grounds[current_command_mod] = cl.local.lastground;
+			CL_PredictedMoveBounds( from, to, cl.local.predicted_mins[current_command_mod], cl.local.predicted_maxs[current_command_mod] );
+			cl.local.predicted_nearby[current_command_mod] = CL_PredictedMovePlayers( players,
+				cl.local.predicted_mins[current_command_mod], cl.local.predicted_maxs[current_command_mod] );
+			cl.local.predicted_cmds++;
+		}
+
+		// the one being built may change until it's sent
+		if( current_command < cls.netchan.outgoing_sequence )
+			valid = i;
 
 		if( to_cmd->senttime >= host.realtime )
 			break;
@@ -1086,6 +1236,11 @@ void CL_PredictMovement( qboolean repredicting )
 
 	CL_PopPMStates();
 
+	cl.local.predicted_parsecount = cl.parsecount;
+	cl.local.predicted_ack = cls.netchan.incoming_acknowledged;
+	cl.local.predicted_pmove = CL_IsPredicted( );
+	cl.local.predicted_count = valid;
+
 	if(( i == CL_UPDATE_MASK ) || ( !to && !repredicting ))
 	{
 		cl.local.repredicting = false;
@@ -0,0 +1,514 @@
+/*
+cl_profile.c - client frame profiler
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "client.h"
+
+#if XASH_LOW_MEMORY == 0
+#define PROFILE_FRAMES		128
+#define PROFILE_MAX_EVENTS		512
+#else
+#define PROFILE_FRAMES		32
+#define PROFILE_MAX_EVENTS		128
+#endif
+#define PROFILE_FRAMES_MASK		(PROFILE_FRAMES - 1)
+#define PROFILE_MAX_ZONES		64
+#define PROFILE_MAX_DEPTH		16
+#define PROFILE_ZONE_NAME		32
+#define PROFILE_GRAPH_HEIGHT		96
+#define PROFILE_GRAPH_STEP		2
+#define PROFILE_TRACE			"cl_profile.json"
+
+// top level zones use console colors 1-6, so the text matches the graph
+#define PROFILE_COLOR( zone )		( 1 + ( zone ) % 6 )
+
+static CVAR_DEFINE_AUTO( cl_profile, "0", 0, "time the client frame and draw the results: 1 - graph and averages" );
+static CVAR_DEFINE_AUTO( cl_profile_range, "33.3", FCVAR_ARCHIVE, "milliseconds shown by the full height of the profiler graph" );
+
+typedef struct
+{
+	const char	*key;	// pointer given to CL_ProfileBegin
+	char		name[PROFILE_ZONE_NAME];
+	int		depth;	// where it was seen first
+	float		time[PROFILE_FRAMES];	// milliseconds spent in every recorded frame
+} profzone_t;
+
+typedef struct
+{
+	word		zone;
+	word		depth;
+	float		start;	// microseconds since the frame start
+	float		length;	// microseconds
+} profevent_t;
+
+typedef struct
+{
+	double		start;
+	float		length;	// milliseconds
+	int		numevents;
+	profevent_t	events[PROFILE_MAX_EVENTS];
+} profframe_t;
+
+typedef struct
+{
+	int		zone;
+	int		event;	// -1 if the frame ran out of events
+	double		start;
+} profscope_t;
+
+static struct
+{
+	qboolean		active;	// current frame is recorded
+	uint		framecount;	// current frame is framecount & PROFILE_FRAMES_MASK
+	int		recorded;	// complete frames in history, one slot is for the current frame
+	int		depth;
+	int		numzones;
+	int		dumpframes;	// frames left before the trace is written
+	string		dumpfile;
+	profscope_t	stack[PROFILE_MAX_DEPTH];
+	profzone_t	zones[PROFILE_MAX_ZONES];
+	profframe_t	*frames;
+} cl_prof;
+
+/*
+==========
+CL_ProfileZone
+
+finds zone by the name pointer, the text is checked too,
+because the renderer may be reloaded with strings at the
+same addresses
+==========
+*/
+static int CL_ProfileZone( const char *name, int depth )
+{
+	profzone_t	*zone;
+	int		i;
+
+	for( i = 0; i < cl_prof.numzones; i++ )
+	{
+		if( cl_prof.zones[i].key == name && !Q_strcmp( cl_prof.zones[i].name, name ))
+			return i;
+	}
+
+	for( i = 0; i < cl_prof.numzones; i++ )
+	{
+		if( !Q_strcmp( cl_prof.zones[i].name, name ))
+		{
+			cl_prof.zones[i].key = name;
+			return i;
+		}
+	}
+
+	if( cl_prof.numzones == PROFILE_MAX_ZONES )
+		return PROFILE_MAX_ZONES - 1; // shared by everything that didn't fit
+
+	zone = &cl_prof.zones[cl_prof.numzones];
+	memset( zone, 0, sizeof( *zone ));
+	zone->key = name;
+	zone->depth = depth;
+	Q_strncpy( zone->name, name, sizeof( zone->name ));
+
+	// names go to the trace as they are
+	for( i = 0; zone->name[i]; i++ )
+	{
+		if( zone->name[i] == '"' || zone->name[i] == '\\' || (byte)zone->name[i] < ' ' )
+			zone->name[i] = '_';
+	}
+
+	return cl_prof.numzones++;
+}
+
+/*
+==========
+CL_ProfileBegin
+
+opens a zone inside the current one, every zone must be
+closed by CL_ProfileEnd in the same frame. Main thread only
+==========
+*/
+void CL_ProfileBegin( const char *name )
+{
+	profframe_t	*frame;
+	profscope_t	*scope;
+	int		depth;
+
+	if( !cl_prof.active )
+		return;
+
+	depth = cl_prof.depth++;
+	if( depth >= PROFILE_MAX_DEPTH )
+		return;
+
+	frame = &cl_prof.frames[cl_prof.framecount & PROFILE_FRAMES_MASK];
+	scope = &cl_prof.stack[depth];
+	scope->zone = CL_ProfileZone( name, depth );
+	scope->start = Sys_DoubleTime();
+	scope->event = -1;
+
+	if( frame->numevents < PROFILE_MAX_EVENTS )
+	{
+		profevent_t *ev = &frame->events[frame->numevents];
+
+		ev->zone = scope->zone;
+		ev->depth = depth;
+		ev->start = ( scope->start - frame->start ) * 1000000.0;
+		ev->length = 0.0f;
+		scope->event = frame->numevents++;
+	}
+}
+
+/*
+==========
+CL_ProfileEnd
+==========
+*/
+void CL_ProfileEnd( void )
+{
+	profframe_t	*frame;
+	profscope_t	*scope;
+	double		length;
+	uint		slot;
+
+	if( !cl_prof.active || cl_prof.depth <= 0 )
+		return;
+
+	if( --cl_prof.depth >= PROFILE_MAX_DEPTH )
+		return;
+
+	slot = cl_prof.framecount & PROFILE_FRAMES_MASK;
+	frame = &cl_prof.frames[slot];
+	scope = &cl_prof.stack[cl_prof.depth];
+	length = Sys_DoubleTime() - scope->start;
+
+	cl_prof.zones[scope->zone].time[slot] += length * 1000.0;
+
+	if( scope->event >= 0 )
+		frame->events[scope->event].length = length * 1000000.0;
+}
+
+/*
+==========
+CL_ProfileWriteTrace
+
+Chrome trace event format, can be opened
+in chrome://tracing or ui.perfetto.dev
+==========
+*/
+static void CL_ProfileWriteTrace( const char *filename, int numframes )
+{
+	double	base;
+	file_t	*f;
+	int	i, j;
+
+	numframes = Q_min( numframes, cl_prof.recorded );
+
+	if( numframes <= 0 )
+	{
+		Con_Printf( "cl_profile_dump: nothing recorded\n" );
+		return;
+	}
+
+	f = FS_Open( filename, "w", true );
+
+	if( !f )
+	{
+		Con_Printf( S_ERROR "cl_profile_dump: can't write %s\n", filename );
+		return;
+	}
+
+	base = cl_prof.frames[( cl_prof.framecount - numframes ) & PROFILE_FRAMES_MASK].start;
+
+	FS_Printf( f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	FS_Printf( f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}" );
+
+	for( i = numframes; i > 0; i-- )
+	{
+		uint		num = cl_prof.framecount - i;
+		const profframe_t	*frame = &cl_prof.frames[num & PROFILE_FRAMES_MASK];
+		double		start = ( frame->start - base ) * 1000000.0;
+
+		FS_Printf( f, ",\n{\"name\":\"frame %u\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			num, start, frame->length * 1000.0 );
+
+		for( j = 0; j < frame->numevents; j++ )
+		{
+			const profevent_t *ev = &frame->events[j];
+
+			FS_Printf( f, ",\n{\"name\":\"%s\",\"cat\":\"client\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+				cl_prof.zones[ev->zone].name, start + ev->start, ev->length );
+		}
+	}
+
+	FS_Printf( f, "\n]}\n" );
+	FS_Close( f );
+
+	Con_Printf( "cl_profile_dump: %i frames written to %s\n", numframes, filename );
+}
+
+/*
+==========
+CL_ProfileFinishFrame
+==========
+*/
+static void CL_ProfileFinishFrame( void )
+{
+	profframe_t *frame = &cl_prof.frames[cl_prof.framecount & PROFILE_FRAMES_MASK];
+
+	// client frame may have been aborted by Host_Error
+	while( cl_prof.depth > 0 )
+		CL_ProfileEnd();
+
+	frame->length = ( Sys_DoubleTime() - frame->start ) * 1000.0;
+
+	cl_prof.framecount++;
+	cl_prof.recorded = Q_min( cl_prof.recorded + 1, PROFILE_FRAMES - 1 );
+	cl_prof.active = false;
+
+	if( cl_prof.dumpframes > 0 && --cl_prof.dumpframes == 0 )
+		CL_ProfileWriteTrace( cl_prof.dumpfile, cl_prof.recorded );
+}
+
+/*
+==========
+CL_ProfileBeginFrame
+
+called before anything else in the client frame
+==========
+*/
+void CL_ProfileBeginFrame( void )
+{
+	profframe_t	*frame;
+	uint		slot;
+	int		i;
+
+	if( cl_prof.active )
+		CL_ProfileFinishFrame();
+
+	if( !cl_profile.value && cl_prof.dumpframes <= 0 )
+	{
+		cl_prof.recorded = 0;
+		return;
+	}
+
+	if( !cl_prof.frames )
+		cl_prof.frames = Mem_Calloc( host.mempool, sizeof( *cl_prof.frames ) * PROFILE_FRAMES );
+
+	slot = cl_prof.framecount & PROFILE_FRAMES_MASK;
+	frame = &cl_prof.frames[slot];
+	frame->numevents = 0;
+	frame->length = 0.0f;
+
+	for( i = 0; i < cl_prof.numzones; i++ )
+		cl_prof.zones[i].time[slot] = 0.0f;
+
+	cl_prof.depth = 0;
+	cl_prof.active = true;
+	frame->start = Sys_DoubleTime();
+}
+
+/*
+==========
+CL_ProfileEndFrame
+
+called after everything else in the client frame
+==========
+*/
+void CL_ProfileEndFrame( void )
+{
+	if( cl_prof.active )
+		CL_ProfileFinishFrame();
+}
+
+/*
+==========
+CL_ProfileDump_f
+
+cl_profile_dump [file] [frames]
+
+writes the frames kept by cl_profile, if it's off
+records the given number of frames first
+==========
+*/
+static void CL_ProfileDump_f( void )
+{
+	const char	*filename = PROFILE_TRACE;
+	int		frames = PROFILE_FRAMES - 1;
+
+	if( Cmd_Argc() > 1 )
+		filename = Cmd_Argv( 1 );
+
+	if( Cmd_Argc() > 2 )
+		frames = bound( 1, Q_atoi( Cmd_Argv( 2 )), PROFILE_FRAMES - 1 );
+
+	if( cl_profile.value && cl_prof.recorded > 0 )
+	{
+		CL_ProfileWriteTrace( filename, frames );
+		return;
+	}
+
+	Q_strncpy( cl_prof.dumpfile, filename, sizeof( cl_prof.dumpfile ));
+	cl_prof.dumpframes = frames;
+	cl_prof.recorded = 0;
+
+	Con_Printf( "cl_profile_dump: recording %i frames\n", frames );
+}
+
+/*
+==========
+CL_ProfileDrawRect
+==========
+*/
+static void CL_ProfileDrawRect( int x, int y, int w, int h, const byte color[4] )
+{
+	ref.dllFuncs.Color4ub( color[0], color[1], color[2], color[3] );
+	ref.dllFuncs.Vertex3f( x, y, 0 );
+	ref.dllFuncs.Vertex3f( x + w, y, 0 );
+	ref.dllFuncs.Vertex3f( x + w, y + h, 0 );
+	ref.dllFuncs.Vertex3f( x, y + h, 0 );
+}
+
+/*
+==========
+CL_ProfileDrawGraph
+
+one column per frame, top level zones are stacked
+from the bottom, the rest of the frame is grey
+==========
+*/
+static void CL_ProfileDrawGraph( int x, int y, int count )
+{
+	static const byte	back[4] = { 0, 0, 0, 128 };
+	static const byte	other[4] = { 96, 96, 96, 255 };
+	static const byte	line[4] = { 255, 255, 255, 96 };
+	float		scale = PROFILE_GRAPH_HEIGHT / Q_max( cl_profile_range.value, 1.0f );
+	int		i, j;
+
+	ref.dllFuncs.GL_SetRenderMode( kRenderTransColor );
+	ref.dllFuncs.GL_Bind( XASH_TEXTURE0, R_GetBuiltinTexture( REF_WHITE_TEXTURE ));
+	ref.dllFuncs.Begin( TRI_QUADS );
+
+	CL_ProfileDrawRect( x, y, PROFILE_FRAMES * PROFILE_GRAPH_STEP, PROFILE_GRAPH_HEIGHT, back );
+
+	for( i = 0; i < count; i++ )
+	{
+		uint	slot = ( cl_prof.framecount - count + i ) & PROFILE_FRAMES_MASK;
+		int	column = x + ( PROFILE_FRAMES - count + i ) * PROFILE_GRAPH_STEP;
+		int	bottom = y + PROFILE_GRAPH_HEIGHT, h;
+
+		for( j = 0; j < cl_prof.numzones && bottom > y; j++ )
+		{
+			const profzone_t *zone = &cl_prof.zones[j];
+
+			if( zone->depth != 0 )
+				continue;
+
+			h = Q_min( Q_rint( zone->time[slot] * scale ), bottom - y );
+			CL_ProfileDrawRect( column, bottom - h, PROFILE_GRAPH_STEP, h, g_color_table[PROFILE_COLOR( j )] );
+			bottom -= h;
+		}
+
+		h = Q_min( Q_rint( cl_prof.frames[slot].length * scale ), PROFILE_GRAPH_HEIGHT );
+		h = Q_max( y + PROFILE_GRAPH_HEIGHT - h, y );
+		if( h < bottom ) CL_ProfileDrawRect( column, h, PROFILE_GRAPH_STEP, bottom - h, other );
+	}
+
+	// half and full range
+	CL_ProfileDrawRect( x, y, PROFILE_FRAMES * PROFILE_GRAPH_STEP, 1, line );
+	CL_ProfileDrawRect( x, y + PROFILE_GRAPH_HEIGHT / 2, PROFILE_FRAMES * PROFILE_GRAPH_STEP, 1, line );
+
+	ref.dllFuncs.End();
+	ref.dllFuncs.Color4ub( 255, 255, 255, 255 );
+	ref.dllFuncs.GL_SetRenderMode( kRenderNormal );
+}
+
+/*
+==========
+CL_DrawProfile
+
+graph and the zones of the last frame in call order
+with averages and maximums over the history
+==========
+*/
+void CL_DrawProfile( void )
+{
+	cl_font_t		*font = Con_GetCurFont();
+	const profframe_t	*last;
+	qboolean		shown[PROFILE_MAX_ZONES];
+	char		msg[4096];
+	float		avg, peak;
+	int		x, y, i, j, count, len;
+	rgba_t		color;
+
+	if( !host.allow_console || !cl_profile.value || !cl_prof.frames )
+		return;
+
+	count = cl_prof.recorded;
+	if( count <= 0 )
+		return;
+
+	x = 16 * font->scale;
+	y = 96;
+
+	CL_ProfileDrawGraph( x, y, count );
+	y += PROFILE_GRAPH_HEIGHT + 4;
+
+	for( i = 0, avg = peak = 0.0f; i < count; i++ )
+	{
+		float length = cl_prof.frames[( cl_prof.framecount - 1 - i ) & PROFILE_FRAMES_MASK].length;
+
+		avg += length;
+		peak = Q_max( peak, length );
+	}
+
+	len = Q_snprintf( msg, sizeof( msg ), "client frame: %.2f ms avg, %.2f max, %i frames\n", avg / count, peak, count );
+
+	memset( shown, 0, sizeof( shown ));
+	last = &cl_prof.frames[( cl_prof.framecount - 1 ) & PROFILE_FRAMES_MASK];
+
+	for( i = 0; i < last->numevents && len < sizeof( msg ) - 128; i++ )
+	{
+		const profevent_t	*ev = &last->events[i];
+		const profzone_t	*zone = &cl_prof.zones[ev->zone];
+
+		if( shown[ev->zone] )
+			continue;
+		shown[ev->zone] = true;
+
+		for( j = 0, avg = peak = 0.0f; j < count; j++ )
+		{
+			float time = zone->time[( cl_prof.framecount - 1 - j ) & PROFILE_FRAMES_MASK];
+
+			avg += time;
+			peak = Q_max( peak, time );
+		}
+
+		if( zone->depth == 0 )
+			len += Q_snprintf( msg + len, sizeof( msg ) - len, "^%i", PROFILE_COLOR( ev->zone ));
+
+		len += Q_snprintf( msg + len, sizeof( msg ) - len, "%*s%s: %.2f avg, %.2f max\n", ev->depth * 2, "",
+			zone->name, avg / count, peak );
+	}
+
+	MakeRGBA( color, 255, 255, 255, 255 );
+	CL_DrawString( x, y, msg, color, font, FONT_DRAW_RESETCOLORONLF );
+}
+
+void CL_InitProfile( void )
+{
+	Cvar_RegisterVariable( &cl_profile );
+	Cvar_RegisterVariable( &cl_profile_range );
+
+	Cmd_AddCommand( "cl_profile_dump", CL_ProfileDump_f, "write client frame timings as Chrome trace: cl_profile_dump [file] [frames]" );
+}
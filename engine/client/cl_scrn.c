@@ -188,12 +188,14 @@ void SCR_NetSpeeds( void )
 		"Client FPS: ^1%i min, ^3%3i cur, ^2%3i max\n"
 		"Game Time: %02d:%02d\n"
 		"Total received from server: %s\n"
-		"Total sent to server: %s\n",
+		"Total sent to server: %s\n"
+		"Predicted commands: %i run, %i cached\n",
 		min_svfps, cur_svfps, max_svfps,
 		min_clfps, cur_clfps, max_clfps,
 		(int)(time / 60.0f ), (int)fmod( time, 60.0f ),
 		Q_memprint( cls.netchan.total_received ),
-		Q_memprint( cls.netchan.total_sended )
+		Q_memprint( cls.netchan.total_sended ),
+		cl.local.predicted_cmds, cl.local.cached_cmds
 	);
 
 	x = refState.width - 320 * font->scale;
@@ -534,7 +536,9 @@ void SCR_UpdateScreen( void )
 		break;
 	case ca_active:
 		Con_RunConsole ();
+		CL_ProfileBegin( "V_RenderView" );
 		V_RenderView();
+		CL_ProfileEnd();
 		break;
 	case ca_cinematic:
 		SCR_DrawCinematic();
@@ -770,6 +774,7 @@ void SCR_Init( void )
 	SCR_InstallParticlePalette ();
 	SCR_InitCinematic();
 	CL_InitNetgraph();
+	CL_InitProfile();
 
 	if( host.allow_console && Sys_CheckParm( "-toconsole" ))
 		Cbuf_AddText( "toggleconsole\n" );
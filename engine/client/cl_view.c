@@ -532,6 +532,7 @@ void V_PostRender( void )
 		SCR_NetSpeeds();
 		SCR_DrawPos();
 		SCR_DrawNetGraph();
+		CL_DrawProfile();
 		SV_DrawOrthoTriangles();
 		CL_DrawDemoRecording();
 		CL_DrawHUD( CL_CHANGELEVEL );
@@ -549,5 +550,8 @@ void V_PostRender( void )
 
 	SCR_MakeScreenShot();
 	ref.dllFuncs.R_AllowFog( true );
+
+	CL_ProfileBegin( "R_EndFrame" );
 	ref.dllFuncs.R_EndFrame();
+	CL_ProfileEnd();
 }
@@ -124,6 +124,25 @@ typedef struct
 	vec3_t		lastorigin;
 	int		lastground;
 
+	// states in cl.predicted_frames of the commands that were sent
+	// stay valid until the next server frame and aren't run again
+	int		predicted_parsecount;	// server frame they were predicted from
+	uint		predicted_ack;		// last acknowledged command at that time
+	uint		predicted_count;		// commands after predicted_ack with valid states
+	qboolean		predicted_pmove;		// CL_IsPredicted at that time
+	double		predicted_times[CMD_BACKUP];	// time after the command
+	int		predicted_grounds[CMD_BACKUP];	// lastground after the command
+	vec3_t		predicted_mins[CMD_BACKUP];	// box around the move of the command
+	vec3_t		predicted_maxs[CMD_BACKUP];
+	uint		predicted_nearby[CMD_BACKUP];	// checksum of the solid players in that box
+	int		predicted_cmds;		// commands run this frame, for net_speeds
+	int		cached_cmds;		// commands taken from the cache this frame
+
+	// physents are built once per server frame
+	qboolean		physents_valid;
+	int		physents_parsecount;
+	int		numphysent, numvisent, nummoveent;	// what was built
+
 	// interp info
 	float		interp_amount;
 
@@ -301,6 +320,18 @@ typedef enum
 	CL_CHANGELEVEL,	// draw 'loading' during changelevel
 } scrstate_t;
 
+// timedemo frame stages, see Host_ClientFrame
+typedef enum
+{
+	TIMEDEMO_CLIENT = 0,	// client.dll frame, commands and everything else
+	TIMEDEMO_PACKETS,	// reading and parsing server messages
+	TIMEDEMO_PREDICT,
+	TIMEDEMO_ENTITIES,	// voice and entity emitting
+	TIMEDEMO_RENDER,
+	TIMEDEMO_SOUND,
+	TIMEDEMO_STAGES
+} timedemo_stage_t;
+
 typedef struct
 {
 	char		name[32];
@@ -611,6 +642,7 @@ typedef struct
 	int			demoplayback;
 	qboolean		demowaiting;		// don't record until a non-delta message is received
 	qboolean		timedemo;
+	qboolean		demoseeking;		// fast-forwarding demo, no rendering and sounds
 	string		demoname;			// for demo looping
 	double		demotime;			// recording time
 	qboolean		set_lastdemo;		// store name of last played demo into the cvar
@@ -694,6 +726,7 @@ extern convar_t	rate;
 extern convar_t	m_ignore;
 extern convar_t	r_showtree;
 extern convar_t	ui_renderworld;
+extern convar_t	cl_demo_keyframe_interval;
 
 //=============================================================================
 
@@ -772,12 +805,17 @@ qboolean CL_DemoReadMessage( byte *buffer, size_t *length );
 void CL_DemoInterpolateAngles( void );
 void CL_CheckStartupDemos( void );
 void CL_WriteDemoJumpTime( void );
+void CL_DemoRecordCommand( sizebuf_t *msg, int cmd, int startbit );
 void CL_CloseDemoHeader( void );
 void CL_DemoCompleted( void );
 void CL_StopPlayback( void );
 void CL_StopRecord( void );
 void CL_PlayDemo_f( void );
 void CL_TimeDemo_f( void );
+void CL_DemoSeek_f( void );
+void CL_TimeDemoBeginFrame( void );
+void CL_TimeDemoStage( timedemo_stage_t stage );
+void CL_TimeDemoEndFrame( void );
 void CL_StartDemos_f( void );
 void CL_Demos_f( void );
 void CL_DeleteDemo_f( void );
@@ -935,6 +973,16 @@ void SCR_DrawPos( void );
 void CL_InitNetgraph( void );
 void SCR_DrawNetGraph( void );
 
+//
+// cl_profile.c
+//
+void CL_InitProfile( void );
+void CL_ProfileBeginFrame( void );
+void CL_ProfileEndFrame( void );
+void CL_ProfileBegin( const char *name );
+void CL_ProfileEnd( void );
+void CL_DrawProfile( void );
+
 //
 // cl_view.c
 //
@@ -949,6 +997,7 @@ void V_RenderView( void );
 // cl_pmove.c
 //
 void CL_SetSolidEntities( void );
+void CL_CheckSolidEntities( void );
 void CL_SetSolidPlayers( int playernum );
 void CL_InitClientMove( void );
 void CL_PredictMovement( qboolean repredicting );
@@ -1044,6 +1093,7 @@ void CL_KillDeadBeams( cl_entity_t *pDeadEntity );
 void CL_ParseViewBeam( sizebuf_t *msg, int beamType );
 void CL_LoadClientSprites( void );
 void CL_ReadPointFile_f( void );
+void CL_ParticleBench_f( void );
 void CL_DrawEFX( float time, qboolean fTrans );
 void CL_ThinkParticle( double frametime, particle_t *p );
 void CL_ReadLineFile_f( void );
@@ -361,6 +361,12 @@ static ref_api_t gEngfuncs =
 	XVK_GetInstanceExtensions,
 	XVK_GetVkGetInstanceProcAddr,
 	XVK_CreateSurface,
+
+	Job_ParallelFor,
+	Job_NumWorkers,
+
+	CL_ProfileBegin,
+	CL_ProfileEnd,
 };
 
 static void R_UnloadProgs( void )
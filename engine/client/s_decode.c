@@ -0,0 +1,501 @@
+/*
+s_decode.c - sound decoding thread
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "sound.h"
+
+/*
+==============================================================
+
+Background music and sounds that are too long to keep in memory
+are read through a stream. Main thread opens and closes streams,
+decoder thread keeps a ring of decoded pcm filled for each of them
+and whoever plays the stream takes data out of the ring: raw music
+channel on main thread or a channel on mixer thread.
+
+Streams are referenced by handles, slot index in low bits and open
+counter in the others, so a handle of a closed stream never matches
+a slot that was reused. Slots are filled under decoder lock and
+closed with both mixer lock and decoder lock held, so mixer can
+check a handle any time and decoder can while holding its lock.
+
+Mixer needs a few samples before its position for resampling and
+mouth movement, so channels read through a window, a linear copy
+of the ring start that is shifted as the channel moves forward.
+==============================================================
+*/
+
+#define MAX_SOUND_STREAMS	16	// must be a power of two
+#define SND_STREAM_RING	(128 * 1024)	// about 0.75 second of 44k 16 bit stereo
+#define SND_STREAM_CHUNK	(16 * 1024)	// decoded at once, multiple of any sample size
+#define SND_STREAM_WINDOW	4096	// samples mixer can address at once
+#define SND_DECODER_MSEC	20	// decoder wakes up at least that often
+
+#define STREAM_SLOT( handle )	( &snd_decoder.streams[( handle ) & ( MAX_SOUND_STREAMS - 1 )] )
+
+typedef struct
+{
+	int		handle;		// zero if slot is free
+	stream_t		*stream;
+	wavdata_t		info;
+	int		samplesize;
+	qboolean		mixer;		// played by a channel, 8 bit data is made signed
+	int		eof;		// atomic, decoder has reached end of the stream
+	ringbuffer_t	ring;		// decoder -> player
+
+	// player only
+	byte		*window;
+	int		window_start;	// sample number of window[0]
+	int		window_count;	// samples in window
+} sndstream_t;
+
+static struct
+{
+	sys_mutex_t	*lock;
+	sys_sem_t		*wakeup;
+	sys_thread_t	*thread;
+	int		shutdown;		// atomic
+	int		opened;		// counter for handles
+	sndstream_t	streams[MAX_SOUND_STREAMS];
+} snd_decoder;
+
+/*
+=================
+S_DecodeChunk
+
+decode next piece of the stream into its ring, called with decoder
+lock held, returns false if there is no room or nothing to decode
+=================
+*/
+static qboolean S_DecodeChunk( sndstream_t *s )
+{
+	byte	buf[SND_STREAM_CHUNK];
+	int	i, r;
+
+	if( !s->handle || Sys_AtomicLoad( &s->eof ))
+		return false;
+
+	if( s->ring.size - Ring_Used( &s->ring ) < sizeof( buf ))
+		return false;
+
+	r = FS_ReadStream( s->stream, sizeof( buf ), buf );
+	r -= r % s->samplesize;
+
+	if( r <= 0 )
+	{
+		Sys_AtomicStore( &s->eof, 1 );
+		return false;
+	}
+
+	// same as Sound_LoadWAV does
+	if( s->mixer && s->info.width == 1 && s->info.type == WF_PCMDATA )
+	{
+		for( i = 0; i < r; i++ )
+			buf[i] ^= 0x80;
+	}
+
+	Ring_Write( &s->ring, buf, r );
+	return true;
+}
+
+/*
+=================
+S_DecodeStreams
+
+one pass over all streams, lock is released after every chunk
+so main thread is never kept waiting for long
+=================
+*/
+static void S_DecodeStreams( void )
+{
+	qboolean	work = true;
+	int	i;
+
+	while( work && !Sys_AtomicLoad( &snd_decoder.shutdown ))
+	{
+		work = false;
+
+		for( i = 0; i < MAX_SOUND_STREAMS; i++ )
+		{
+			Sys_LockMutex( snd_decoder.lock );
+			if( S_DecodeChunk( &snd_decoder.streams[i] ))
+				work = true;
+			Sys_UnlockMutex( snd_decoder.lock );
+		}
+	}
+}
+
+/*
+=================
+S_DecoderThread
+
+=================
+*/
+static void S_DecoderThread( void *data )
+{
+	while( !Sys_AtomicLoad( &snd_decoder.shutdown ))
+	{
+		Sys_SemaphoreTimedWait( snd_decoder.wakeup, SND_DECODER_MSEC );
+		S_DecodeStreams();
+	}
+}
+
+/*
+=================
+S_FindStream
+
+=================
+*/
+static sndstream_t *S_FindStream( int handle )
+{
+	sndstream_t	*s;
+
+	if( !handle || !snd_decoder.lock )
+		return NULL;
+
+	s = STREAM_SLOT( handle );
+
+	if( s->handle != handle )
+		return NULL;
+
+	return s;
+}
+
+/*
+=================
+S_OpenSoundStream
+
+position is in stream units, as returned by S_SoundStreamPosition,
+mixer streams are read with S_GetStreamData, others with S_ReadSoundStream
+=================
+*/
+int S_OpenSoundStream( const char *filename, int position, qboolean mixer )
+{
+	sndstream_t	*s = NULL;
+	stream_t		*stream;
+	int		i;
+
+	if( !snd_decoder.lock )
+		return 0;
+
+	for( i = 0; i < MAX_SOUND_STREAMS; i++ )
+	{
+		if( !snd_decoder.streams[i].handle )
+		{
+			s = &snd_decoder.streams[i];
+			break;
+		}
+	}
+
+	if( !s )
+	{
+		Con_DPrintf( S_WARN "%s: too many streams, can't play %s\n", __func__, filename );
+		return 0;
+	}
+
+	if(( stream = FS_OpenStream( filename )) == NULL )
+		return 0;
+
+	if( position && !FS_SetStreamPos( stream, position ))
+		position = 0;
+
+	Sys_LockMutex( snd_decoder.lock );
+
+	s->info = *FS_StreamInfo( stream );
+	s->samplesize = s->info.width * s->info.channels;
+	s->stream = stream;
+	s->mixer = mixer;
+
+	if( s->samplesize <= 0 || !Ring_Init( &s->ring, SND_STREAM_RING ))
+	{
+		FS_FreeStream( stream );
+		memset( s, 0, sizeof( *s ));
+		Sys_UnlockMutex( snd_decoder.lock );
+		return 0;
+	}
+
+	if( mixer )
+	{
+		s->window = Mem_Malloc( sndpool, SND_STREAM_WINDOW * s->samplesize );
+		s->window_start = position / s->samplesize;
+	}
+
+	if( ++snd_decoder.opened >= INT_MAX / MAX_SOUND_STREAMS )
+		snd_decoder.opened = 1;
+	s->handle = snd_decoder.opened * MAX_SOUND_STREAMS + (int)( s - snd_decoder.streams );
+
+	// have something to play right away
+	S_DecodeChunk( s );
+
+	Sys_UnlockMutex( snd_decoder.lock );
+
+	if( snd_decoder.thread )
+		Sys_SemaphorePost( snd_decoder.wakeup );
+
+	return s->handle;
+}
+
+/*
+=================
+S_CloseSoundStream
+
+=================
+*/
+void S_CloseSoundStream( int handle )
+{
+	sndstream_t	*s;
+
+	if(( s = S_FindStream( handle )) == NULL )
+		return;
+
+	// wait until mixer and decoder are done with it
+	S_LockMixer();
+	Sys_LockMutex( snd_decoder.lock );
+
+	FS_FreeStream( s->stream );
+	Ring_Free( &s->ring );
+	if( s->window ) Mem_Free( s->window );
+	memset( s, 0, sizeof( *s ));
+
+	Sys_UnlockMutex( snd_decoder.lock );
+	S_UnlockMixer();
+}
+
+/*
+=================
+S_SoundStreamInfo
+
+=================
+*/
+const wavdata_t *S_SoundStreamInfo( int handle )
+{
+	sndstream_t	*s = S_FindStream( handle );
+
+	return s ? &s->info : NULL;
+}
+
+/*
+=================
+S_SoundStreamFinished
+
+everything was decoded and played, false on underrun
+=================
+*/
+qboolean S_SoundStreamFinished( int handle )
+{
+	sndstream_t	*s = S_FindStream( handle );
+
+	if( !s ) return true;
+
+	// eof is set after the last write
+	return Sys_AtomicLoad( &s->eof ) && !Ring_Used( &s->ring );
+}
+
+/*
+=================
+S_SoundStreamPosition
+
+position of the data that wasn't played yet, in stream units
+=================
+*/
+int S_SoundStreamPosition( int handle )
+{
+	sndstream_t	*s = S_FindStream( handle );
+	int		position;
+
+	if( !s ) return 0;
+
+	Sys_LockMutex( snd_decoder.lock );
+	position = FS_GetStreamPos( s->stream );
+
+	// mpeg position is not in bytes, music just skips what's in the ring
+	if( s->info.type == WF_PCMDATA )
+		position = Q_max( 0, position - (int)Ring_Used( &s->ring ));
+	Sys_UnlockMutex( snd_decoder.lock );
+
+	return position;
+}
+
+/*
+=================
+S_ReadSoundStream
+
+returns number of bytes copied, zero if decoder didn't keep up
+or stream is over, see S_SoundStreamFinished
+=================
+*/
+int S_ReadSoundStream( int handle, void *buffer, int bytes )
+{
+	sndstream_t	*s = S_FindStream( handle );
+
+	if( !s || s->mixer )
+		return 0;
+
+	bytes -= bytes % s->samplesize;
+
+	return Ring_Read( &s->ring, buffer, bytes );
+}
+
+/*
+=================
+S_GetStreamData
+
+mixer side of S_GetOutputData, mixer can't seek back, position
+before the window start is treated as the window start
+=================
+*/
+int S_GetStreamData( int handle, void **pData, int samplePosition, int sampleCount )
+{
+	sndstream_t	*s = S_FindStream( handle );
+	int		skip, need, got;
+
+	if( !s || !s->mixer )
+		return 0;
+
+	// drop what mixer has moved past
+	skip = bound( 0, samplePosition - s->window_start, s->window_count );
+
+	if( skip )
+	{
+		s->window_count -= skip;
+		memmove( s->window, s->window + skip * s->samplesize, s->window_count * s->samplesize );
+	}
+
+	s->window_start += skip;
+
+	// moved past the window, throw away the decoded data too
+	while( s->window_start < samplePosition )
+	{
+		skip = Q_min( samplePosition - s->window_start, SND_STREAM_WINDOW );
+		got = Ring_Read( &s->ring, s->window, skip * s->samplesize ) / s->samplesize;
+
+		if( !got ) return 0;
+
+		s->window_start += got;
+	}
+
+	s->window_start = samplePosition;
+
+	// refill
+	need = Q_min( sampleCount, SND_STREAM_WINDOW ) - s->window_count;
+
+	if( need > 0 )
+	{
+		got = Ring_Read( &s->ring, s->window + s->window_count * s->samplesize, need * s->samplesize );
+		s->window_count += got / s->samplesize;
+	}
+
+	sampleCount = Q_min( sampleCount, s->window_count );
+
+	if( sampleCount > 0 )
+		*pData = s->window;
+
+	return sampleCount;
+}
+
+/*
+=================
+S_UpdateSoundStreams
+
+decoding on main thread when there is no decoder thread
+=================
+*/
+void S_UpdateSoundStreams( void )
+{
+	if( snd_decoder.lock && !snd_decoder.thread )
+		S_DecodeStreams();
+}
+
+/*
+=================
+S_NumSoundStreams
+
+=================
+*/
+int S_NumSoundStreams( void )
+{
+	int	i, count = 0;
+
+	for( i = 0; i < MAX_SOUND_STREAMS; i++ )
+	{
+		if( snd_decoder.streams[i].handle )
+			count++;
+	}
+
+	return count;
+}
+
+/*
+=================
+S_DecoderThreaded
+
+=================
+*/
+qboolean S_DecoderThreaded( void )
+{
+	return snd_decoder.thread != NULL;
+}
+
+/*
+=================
+S_InitDecoder
+
+=================
+*/
+void S_InitDecoder( void )
+{
+	memset( &snd_decoder, 0, sizeof( snd_decoder ));
+
+	snd_decoder.lock = Sys_CreateMutex();
+	snd_decoder.wakeup = Sys_CreateSemaphore( 0 );
+
+	if( !snd_decoder.lock || !snd_decoder.wakeup )
+		Sys_Error( "%s: can't create decoder lock\n", __func__ );
+
+	if( Sys_CheckParm( "-nosoundthread" ))
+		return;
+
+	snd_decoder.thread = Sys_CreateThread( S_DecoderThread, NULL );
+
+	if( !snd_decoder.thread )
+		Con_Reportf( "%s: decoder thread is not available, decoding on main thread\n", __func__ );
+}
+
+/*
+=================
+S_ShutdownDecoder
+
+=================
+*/
+void S_ShutdownDecoder( void )
+{
+	int	i;
+
+	if( snd_decoder.thread )
+	{
+		Sys_AtomicStore( &snd_decoder.shutdown, 1 );
+		Sys_SemaphorePost( snd_decoder.wakeup );
+		Sys_JoinThread( snd_decoder.thread );
+		snd_decoder.thread = NULL;
+	}
+
+	for( i = 0; i < MAX_SOUND_STREAMS; i++ )
+		S_CloseSoundStream( snd_decoder.streams[i].handle );
+
+	Sys_DestroySemaphore( snd_decoder.wakeup );
+	Sys_DestroyMutex( snd_decoder.lock );
+	snd_decoder.wakeup = NULL;
+	snd_decoder.lock = NULL;
+}
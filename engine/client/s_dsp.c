@@ -16,6 +16,7 @@ GNU General Public License for more details.
 #include "common.h"
 #include "client.h"
 #include "sound.h"
+#include "xash3d_simd.h"
 
 #define MAX_DELAY		0.4f
 #define MAX_ROOM_TYPES	ARRAYSIZE( rgsxpre )
@@ -342,6 +343,209 @@ _inline void DLY_MovePointer( dly_t *dly )
 		dly->idelayoutput = 0;
 }
 
+#if XASH_SIMD
+/*
+==============================================================================
+
+VECTORIZED DELAY LINES
+
+four samples at once, output and delay line state must be exactly the same
+as after four iterations of the plain C loops, so these are only used when
+pointers don't wrap inside the block and the block doesn't read a value
+written by itself (delay of 1, 2 or 3 samples)
+==============================================================================
+*/
+#if XASH_SIMD_SSE2
+typedef __m128i dspvec_t;
+
+static inline dspvec_t DSP_Load( const int *p )
+{
+	return _mm_loadu_si128((const __m128i *)p );
+}
+
+static inline void DSP_Store( int *p, dspvec_t v )
+{
+	_mm_storeu_si128((__m128i *)p, v );
+}
+
+static inline dspvec_t DSP_IsZero( dspvec_t v )
+{
+	return _mm_cmpeq_epi32( v, _mm_setzero_si128( ));
+}
+
+// mask ? a : b
+static inline dspvec_t DSP_Select( dspvec_t mask, dspvec_t a, dspvec_t b )
+{
+	return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ));
+}
+
+static inline qboolean DSP_AnyMask( dspvec_t mask )
+{
+	return _mm_movemask_epi8( mask ) != 0;
+}
+
+// low 32 bits of v * n, there is no pmulld in SSE2
+static inline dspvec_t DSP_MulN( dspvec_t v, int n )
+{
+	__m128i	vn = _mm_set1_epi32( n );
+	__m128i	even = _mm_mul_epu32( v, vn );
+	__m128i	odd = _mm_mul_epu32( _mm_srli_epi64( v, 32 ), vn );
+
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 )), _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 )));
+}
+
+static inline dspvec_t DSP_Clip( dspvec_t v )
+{
+	const __m128i	hi = _mm_set1_epi32( 32760 );
+	const __m128i	lo = _mm_set1_epi32( -32760 );
+
+	v = DSP_Select( _mm_cmpgt_epi32( v, hi ), hi, v );
+	return DSP_Select( _mm_cmplt_epi32( v, lo ), lo, v );
+}
+
+// x v0 v1 v2
+static inline dspvec_t DSP_ShiftIn( dspvec_t v, int x )
+{
+	return _mm_or_si128( _mm_slli_si128( v, 4 ), _mm_cvtsi32_si128( x ));
+}
+
+static inline int DSP_Last( dspvec_t v )
+{
+	return _mm_cvtsi128_si32( _mm_shuffle_epi32( v, _MM_SHUFFLE( 3, 3, 3, 3 )));
+}
+
+static inline void DSP_LoadPairs( const portable_samplepair_t *p, dspvec_t *l, dspvec_t *r )
+{
+	__m128	a = _mm_castsi128_ps( _mm_loadu_si128((const __m128i *)p ));
+	__m128	b = _mm_castsi128_ps( _mm_loadu_si128((const __m128i *)( p + 2 )));
+
+	*l = _mm_castps_si128( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 )));
+	*r = _mm_castps_si128( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 )));
+}
+
+static inline void DSP_StorePairs( portable_samplepair_t *p, dspvec_t l, dspvec_t r )
+{
+	_mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi32( l, r ));
+	_mm_storeu_si128((__m128i *)( p + 2 ), _mm_unpackhi_epi32( l, r ));
+}
+
+#define DSP_Add( a, b )	_mm_add_epi32(( a ), ( b ))
+#define DSP_Shr( v, n )	_mm_srai_epi32(( v ), ( n ))
+#define DSP_Shl( v, n )	_mm_slli_epi32(( v ), ( n ))
+#define DSP_Or( a, b )	_mm_or_si128(( a ), ( b ))
+#define DSP_AndNot( mask, v )	_mm_andnot_si128(( mask ), ( v ))
+#else
+typedef int32x4_t dspvec_t;
+
+static inline dspvec_t DSP_Load( const int *p )
+{
+	return vld1q_s32((const int32_t *)p );
+}
+
+static inline void DSP_Store( int *p, dspvec_t v )
+{
+	vst1q_s32((int32_t *)p, v );
+}
+
+static inline dspvec_t DSP_IsZero( dspvec_t v )
+{
+	return vreinterpretq_s32_u32( vceqq_s32( v, vdupq_n_s32( 0 )));
+}
+
+// mask ? a : b
+static inline dspvec_t DSP_Select( dspvec_t mask, dspvec_t a, dspvec_t b )
+{
+	return vbslq_s32( vreinterpretq_u32_s32( mask ), a, b );
+}
+
+static inline qboolean DSP_AnyMask( dspvec_t mask )
+{
+	uint32x2_t m = vorr_u32( vget_low_u32( vreinterpretq_u32_s32( mask )), vget_high_u32( vreinterpretq_u32_s32( mask )));
+
+	return ( vget_lane_u32( m, 0 ) | vget_lane_u32( m, 1 )) != 0;
+}
+
+static inline dspvec_t DSP_MulN( dspvec_t v, int n )
+{
+	return vmulq_n_s32( v, n );
+}
+
+static inline dspvec_t DSP_Clip( dspvec_t v )
+{
+	return vmaxq_s32( vminq_s32( v, vdupq_n_s32( 32760 )), vdupq_n_s32( -32760 ));
+}
+
+// x v0 v1 v2
+static inline dspvec_t DSP_ShiftIn( dspvec_t v, int x )
+{
+	return vextq_s32( vdupq_n_s32( x ), v, 3 );
+}
+
+static inline int DSP_Last( dspvec_t v )
+{
+	return vgetq_lane_s32( v, 3 );
+}
+
+static inline void DSP_LoadPairs( const portable_samplepair_t *p, dspvec_t *l, dspvec_t *r )
+{
+	int32x4x2_t v = vld2q_s32((const int32_t *)p );
+
+	*l = v.val[0];
+	*r = v.val[1];
+}
+
+static inline void DSP_StorePairs( portable_samplepair_t *p, dspvec_t l, dspvec_t r )
+{
+	int32x4x2_t v;
+
+	v.val[0] = l;
+	v.val[1] = r;
+	vst2q_s32((int32_t *)p, v );
+}
+
+#define DSP_Add( a, b )	vaddq_s32(( a ), ( b ))
+#define DSP_Shr( v, n )	vshrq_n_s32(( v ), ( n ))
+#define DSP_Shl( v, n )	vshlq_n_s32(( v ), ( n ))
+#define DSP_Or( a, b )	vorrq_s32(( a ), ( b ))
+#define DSP_AndNot( mask, v )	vbicq_s32(( v ), ( mask ))
+#endif // XASH_SIMD_SSE2
+
+/*
+============
+DLY_CanDoBlock
+
+Checks that next four samples can be processed at once
+============
+*/
+static qboolean DLY_CanDoBlock( const dly_t *dly )
+{
+	size_t	dist;
+
+	if( dly->idelayinput + 4 > dly->cdelaysamplesmax || dly->idelayoutput + 4 > dly->cdelaysamplesmax )
+		return false;
+
+	dist = ( dly->idelayinput + dly->cdelaysamplesmax - dly->idelayoutput ) % dly->cdelaysamplesmax;
+
+	return dist == 0 || dist > 3;
+}
+
+/*
+============
+DLY_MovePointerBlock
+
+Moves pointers by four samples, they never wrap in the middle of a block
+============
+*/
+static void DLY_MovePointerBlock( dly_t *dly )
+{
+	if(( dly->idelayinput += 4 ) >= dly->cdelaysamplesmax )
+		dly->idelayinput = 0;
+
+	if(( dly->idelayoutput += 4 ) >= dly->cdelaysamplesmax )
+		dly->idelayoutput = 0;
+}
+#endif // XASH_SIMD
+
 /*
 =============
 DLY_CheckNewStereoDelayVal
@@ -501,6 +705,45 @@ static void DLY_CheckNewDelayVal( void )
 	dly->delayfeedback = 255 * sxdly_feedback.value;
 }
 
+#if XASH_SIMD
+/*
+=============
+DLY_DoDelaySIMD
+
+Delay processing without lowpass, returns how many samples were done
+=============
+*/
+static int DLY_DoDelaySIMD( dly_t *dly, portable_samplepair_t *paint, int count )
+{
+	int	i;
+
+	for( i = 0; i + 4 <= count && DLY_CanDoBlock( dly ); i += 4 )
+	{
+		dspvec_t	l, r, delay, val, inactive;
+
+		DSP_LoadPairs( paint + i, &l, &r );
+		delay = DSP_Load( dly->lpdelayline + dly->idelayoutput );
+		inactive = DSP_IsZero( DSP_Or( delay, DSP_Or( l, r )));
+
+		val = DSP_Shr( DSP_Add( l, r ), 1 );
+		val = DSP_Clip( DSP_Add( val, DSP_Shr( DSP_MulN( delay, dly->delayfeedback ), 8 )));
+		val = DSP_AndNot( inactive, val );
+		DSP_Store( dly->lpdelayline + dly->idelayinput, val );
+
+		// inactive samples are zero, so it's fine to add to them
+		val = DSP_Shr( val, 2 );
+		DSP_StorePairs( paint + i, DSP_Clip( DSP_Add( l, val )), DSP_Clip( DSP_Add( r, val )));
+
+		if( DSP_AnyMask( inactive ))
+			dly->lp0 = dly->lp1 = dly->lp2 = 0;
+
+		DLY_MovePointerBlock( dly );
+	}
+
+	return i;
+}
+#endif // XASH_SIMD
+
 /*
 =============
 DLY_DoDelay
@@ -517,6 +760,16 @@ static void DLY_DoDelay( int count )
 	if( !dly->lpdelayline || !count )
 		return; // inactive
 
+#if XASH_SIMD
+	if( s_simd && !dly->lp )
+	{
+		int	done = DLY_DoDelaySIMD( dly, paint, count );
+
+		paint += done;
+		count -= done;
+	}
+#endif
+
 	for( ; count; count--, paint++ )
 	{
 		delay = dly->lpdelayline[dly->idelayoutput];
@@ -693,6 +946,87 @@ static int RVB_DoReverbForOneDly( dly_t *dly, const int vlr, const portable_samp
 
 }
 
+#if XASH_SIMD
+/*
+===========
+RVB_DoReverbBlock
+
+RVB_DoReverbForOneDly for four samples, without crossfade
+===========
+*/
+static dspvec_t RVB_DoReverbBlock( dly_t *dly, dspvec_t vlr, dspvec_t lr )
+{
+	dspvec_t	delay, val, inactive;
+	int	i;
+
+	for( i = 0; i < 4; i++ )
+	{
+		if( --dly->modcur < 0 )
+			dly->modcur = dly->mod;
+	}
+
+	delay = DSP_Load( dly->lpdelayline + dly->idelayoutput );
+	inactive = DSP_IsZero( DSP_Or( delay, lr ));
+
+	val = DSP_Clip( DSP_Add( vlr, DSP_Shr( DSP_MulN( delay, dly->delayfeedback ), 8 )));
+	val = DSP_Select( DSP_IsZero( delay ), vlr, val );
+
+	// lowpass buffer is cleared by inactive samples
+	val = DSP_AndNot( inactive, val );
+
+	if( dly->lp )
+	{
+		dspvec_t prev = DSP_ShiftIn( val, dly->lp0 );
+
+		dly->lp0 = DSP_Last( val );
+		val = DSP_AndNot( inactive, DSP_Shr( DSP_Add( prev, val ), 1 ));
+	}
+	else if( DSP_AnyMask( inactive ))
+		dly->lp0 = 0;
+
+	DSP_Store( dly->lpdelayline + dly->idelayinput, val );
+	DLY_MovePointerBlock( dly );
+
+	return val;
+}
+
+/*
+===========
+RVB_DoReverbSIMD
+
+Reverberation with modulated delay rate, returns how many samples were done
+===========
+*/
+static int RVB_DoReverbSIMD( dly_t *dly1, dly_t *dly2, portable_samplepair_t *paint, int count )
+{
+	int	i;
+
+	if( !dly1->mod || !dly2->mod )
+		return 0; // randomized on every sample
+
+	for( i = 0; i + 4 <= count; i += 4 )
+	{
+		dspvec_t	l, r, vlr, lr, voutm;
+
+		if( dly1->xfade || dly2->xfade || !DLY_CanDoBlock( dly1 ) || !DLY_CanDoBlock( dly2 ))
+			break;
+
+		DSP_LoadPairs( paint + i, &l, &r );
+		vlr = DSP_Shr( DSP_Add( l, r ), 1 );
+		lr = DSP_Or( l, r );
+
+		voutm = DSP_Add( RVB_DoReverbBlock( dly1, vlr, lr ), RVB_DoReverbBlock( dly2, vlr, lr ));
+
+		// ( 11 * voutm ) >> 6
+		voutm = DSP_Shr( DSP_Add( DSP_Add( DSP_Shl( voutm, 3 ), DSP_Shl( voutm, 1 )), voutm ), 6 );
+
+		DSP_StorePairs( paint + i, DSP_Clip( DSP_Add( l, voutm )), DSP_Clip( DSP_Add( r, voutm )));
+	}
+
+	return i;
+}
+#endif // XASH_SIMD
+
 /*
 ===========
 RVB_DoReverb
@@ -710,8 +1044,21 @@ static void RVB_DoReverb( int count )
 	if( !dly1->lpdelayline )
 		return;
 
-	for( ; count; count--, paint++ )
+	while( count )
 	{
+#if XASH_SIMD
+		if( s_simd && dsp_coeff_table.value != 1.0f )
+		{
+			int	done = RVB_DoReverbSIMD( dly1, dly2, paint, count );
+
+			if( done )
+			{
+				paint += done;
+				count -= done;
+				continue;
+			}
+		}
+#endif
 		vlr = ( paint->left + paint->right ) >> 1;
 
 		voutm = RVB_DoReverbForOneDly( dly1, vlr, paint );
@@ -723,6 +1070,9 @@ static void RVB_DoReverb( int count )
 
 		paint->left = CLIP( paint->left + voutm );
 		paint->right = CLIP( paint->right + voutm );
+
+		paint++;
+		count--;
 	}
 }
 
@@ -812,7 +1162,7 @@ void DSP_Process( int idsp, portable_samplepair_t *pbfront, int sampleCount )
 		return;
 
 	// don't process DSP while in menu
-	if( cls.key_dest == key_menu || !sampleCount )
+	if( snd_mixer.listener.inmenu || !sampleCount )
 		return;
 
 	// preset is already installed by CheckNewDspPresets
@@ -952,3 +1302,190 @@ static void SX_Profiling_f( void )
 		CheckNewDspPresets();
 	}
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+typedef struct
+{
+	int	size;
+	int	delaysamples;
+	int	input;
+	int	feedback;
+	int	lp;
+	int	mod;
+	int	xfade;
+} test_dly_t;
+
+static void Test_DSP_Fill( int *buf, int count, int range )
+{
+	int	i;
+
+	// leave runs of silence, so inactive samples are tested too
+	for( i = 0; i < count; i++ )
+		buf[i] = (( i / 7 ) % 3 ) ? COM_RandomLong( -range, range ) : 0;
+}
+
+/*
+run reverb or mono delay with plain C and vectorized code from the same state
+and compare output, delay lines and state bit for bit
+*/
+static void Test_DSPCase( const char *name, qboolean reverb, const test_dly_t *t, int count, int iterations )
+{
+	const int first = reverb ? REVERBPOS : MONODLY;
+	const int ndly = reverb ? 2 : 1;
+	qboolean oldsimd = s_simd;
+	dly_t saved[MAXDLY];
+	dly_t state[2][2];
+	int *lines[2][2], *line0[2];
+	portable_samplepair_t *paint[2], *paint0;
+	double time[2];
+	int i, j, k;
+
+	memcpy( saved, rgsxdly, sizeof( saved ));
+
+	paint0 = Z_Malloc( count * sizeof( *paint0 ));
+	Test_DSP_Fill( (int *)paint0, count * 2, 40000 );
+
+	for( j = 0; j < ndly; j++ )
+	{
+		line0[j] = Z_Malloc( t[j].size * sizeof( int ));
+		Test_DSP_Fill( line0[j], t[j].size, 40000 );
+	}
+
+	for( i = 0; i < 2; i++ )
+	{
+		for( j = 0; j < ndly; j++ )
+		{
+			dly_t *dly = &rgsxdly[first + j];
+
+			memset( dly, 0, sizeof( *dly ));
+			dly->cdelaysamplesmax = t[j].size;
+			dly->lpdelayline = lines[i][j] = Z_Malloc( t[j].size * sizeof( int ));
+			memcpy( dly->lpdelayline, line0[j], t[j].size * sizeof( int ));
+			dly->delaysamples = t[j].delaysamples;
+			dly->idelayinput = t[j].input;
+			dly->idelayoutput = ( t[j].input + t[j].size - t[j].delaysamples ) % t[j].size;
+			dly->idelayoutputxf = ( dly->idelayoutput + 100 ) % t[j].size;
+			dly->xfade = t[j].xfade;
+			dly->delayfeedback = t[j].feedback;
+			dly->lp = t[j].lp;
+			dly->lp0 = 1234;
+			dly->lp1 = -4321;
+			dly->lp2 = 77;
+			dly->mod = dly->modcur = t[j].mod;
+		}
+
+		paint[i] = Z_Malloc( count * sizeof( *paint[i] ));
+		memcpy( paint[i], paint0, count * sizeof( *paint[i] ));
+		paintto = paint[i];
+
+		// reverb without modulation is randomized
+		COM_SetRandomSeed( 1 );
+		s_simd = i;
+		time[i] = Sys_DoubleTime();
+
+		for( k = 0; k < ( iterations ? iterations : 1 ); k++ )
+		{
+			if( reverb ) RVB_DoReverb( count );
+			else DLY_DoDelay( count );
+		}
+
+		time[i] = Sys_DoubleTime() - time[i];
+
+		for( j = 0; j < ndly; j++ )
+			state[i][j] = rgsxdly[first + j];
+	}
+
+	s_simd = oldsimd;
+	memcpy( rgsxdly, saved, sizeof( saved ));
+
+	_TASSERT( memcmp( paint[0], paint[1], count * sizeof( *paint[0] )), Msg( S_ERROR "%s: vectorized output differs\n", name ))
+
+	for( j = 0; j < ndly; j++ )
+	{
+		const dly_t *a = &state[0][j], *b = &state[1][j];
+
+		_TASSERT( memcmp( lines[0][j], lines[1][j], t[j].size * sizeof( int )), Msg( S_ERROR "%s: delay line %d differs\n", name, j ))
+		_TASSERT( a->idelayinput != b->idelayinput || a->idelayoutput != b->idelayoutput || a->idelayoutputxf != b->idelayoutputxf
+			|| a->xfade != b->xfade || a->modcur != b->modcur || a->lp0 != b->lp0 || a->lp1 != b->lp1 || a->lp2 != b->lp2,
+			Msg( S_ERROR "%s: delay %d state differs\n", name, j ))
+
+		Z_Free( lines[0][j] );
+		Z_Free( lines[1][j] );
+		Z_Free( line0[j] );
+	}
+
+	if( iterations )
+		Con_Printf( "%s %d samples: %.2f us plain, %.2f us vectorized\n", name, count, time[0] * 1000000.0 / iterations, time[1] * 1000000.0 / iterations );
+
+	Z_Free( paint[0] );
+	Z_Free( paint[1] );
+	Z_Free( paint0 );
+}
+
+static void Test_DSP_Reverb( void )
+{
+	// size, delaysamples, input, feedback, lp, mod, xfade
+	test_dly_t t[2] =
+	{
+	{ 4411, 2205, 4405, 216, 1, 500, 0 },
+	{ 4411, 1565, 3, 216, 1, 700, 0 },
+	};
+	int i;
+
+	Test_DSPCase( "reverb", true, t, PAINTBUFFER_SIZE, 0 );
+	Test_DSPCase( "reverb", true, t, 37, 0 );
+
+	t[0].lp = t[1].lp = 0;
+	Test_DSPCase( "reverb without lowpass", true, t, PAINTBUFFER_SIZE, 0 );
+
+	t[0].lp = t[1].lp = 1;
+	t[1].xfade = 20;
+	Test_DSPCase( "reverb with crossfade", true, t, PAINTBUFFER_SIZE, 0 );
+
+	t[1].xfade = 0;
+	t[0].mod = 0;
+	Test_DSPCase( "reverb without modulation", true, t, PAINTBUFFER_SIZE, 0 );
+
+	// delay line reads back values written in the same block
+	t[0].mod = 500;
+	for( i = 1; i <= 5; i++ )
+	{
+		t[0].delaysamples = i;
+		Test_DSPCase( "reverb with short delay", true, t, PAINTBUFFER_SIZE, 0 );
+	}
+
+	t[0].delaysamples = 2205;
+	Test_DSPCase( "reverb", true, t, PAINTBUFFER_SIZE, 1000 );
+}
+
+static void Test_DSP_Delay( void )
+{
+	// size, delaysamples, input, feedback, lp, mod, xfade
+	test_dly_t t = { 17641, 2866, 17630, 196, 0, 0, 0 };
+	int i;
+
+	Test_DSPCase( "delay", false, &t, PAINTBUFFER_SIZE, 0 );
+	Test_DSPCase( "delay", false, &t, 37, 0 );
+
+	for( i = 1; i <= 5; i++ )
+	{
+		t.delaysamples = i;
+		Test_DSPCase( "delay with short delay", false, &t, PAINTBUFFER_SIZE, 0 );
+	}
+
+	t.delaysamples = 2866;
+	t.lp = 1;
+	Test_DSPCase( "delay with lowpass", false, &t, PAINTBUFFER_SIZE, 0 );
+
+	t.lp = 0;
+	Test_DSPCase( "delay", false, &t, PAINTBUFFER_SIZE, 1000 );
+}
+
+void Test_RunDSP( void )
+{
+	TRUN( Test_DSP_Reverb() );
+	TRUN( Test_DSP_Delay() );
+}
+#endif /* XASH_ENGINE_TESTS */
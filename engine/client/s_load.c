@@ -52,7 +52,8 @@ void S_SoundList_f( void )
 		{
 			totalSize += sc->size;
 
-			if( sc->loopStart >= 0 ) Con_Printf( "L" );
+			if( FBitSet( sc->flags, SOUND_STREAM )) Con_Printf( "S" );
+			else if( sc->loopStart >= 0 ) Con_Printf( "L" );
 			else Con_Printf( " " );
 			if( sfx->name[0] == '*' || !Q_strncmp( sfx->name, DEFAULT_SOUNDPATH, sizeof( DEFAULT_SOUNDPATH ) - 1 ))
 				Con_Printf( " (%2db) %s : %s\n", sc->width * 8, Q_memprint( sc->size ), sfx->name );
@@ -119,6 +120,413 @@ static wavdata_t *S_CreateDefaultSound( void )
 	return sc;
 }
 
+/*
+==============================================================
+
+SOUND CACHE
+
+sounds that had to be decoded from mp3 or resampled are stored
+in gamedir as ready to use pcm, so next map load can skip that
+work. Entry is valid while source file time and size match.
+Plain waves are only looked up if the cache directory had an
+entry with their name hash, so sounds at device rate cost nothing
+==============================================================
+*/
+#define SOUNDCACHE_IDENT	(('C'<<24)+('S'<<16)+('N'<<8)+'X') // little-endian "XNSC"
+#define SOUNDCACHE_VERSION	1	// bump when S_LoadSound processing changes
+#define SOUNDCACHE_PATH	"cache/sound/"
+#define SOUNDCACHE_FILTER	4096	// bits in cache directory filter, power of two
+
+typedef struct
+{
+	int	ident;
+	int	version;
+	int	filetime;		// source file modification time
+	int	filesize;		// source file size
+	char	name[MAX_QPATH];	// source file path, hash collisions are rejected
+	int	rate;		// after processing
+	int	width;
+	int	channels;
+	int	loopStart;
+	int	samples;
+	uint	type;
+	uint	flags;
+	uint	size;		// pcm data follows the header
+} dsoundcache_t;
+
+typedef struct
+{
+	char	name[MAX_QPATH];	// source file
+	char	cachename[MAX_QPATH];
+	uint32_t	hash;		// of lowercased source name
+	int	filetime;
+	int	filesize;		// -1 until S_SoundSourceSize is called
+} soundsource_t;
+
+static uint	s_cachefilter[SOUNDCACHE_FILTER / 32];	// name hashes present in cache directory
+
+CVAR_DEFINE_AUTO( s_cache, "1", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "keep decoded and resampled sounds in gamedir cache" );
+CVAR_DEFINE_AUTO( s_stream_size, "1024", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "wave files bigger than this many kilobytes are decoded while playing (0 - load all sounds)" );
+
+/*
+=================
+S_FindSoundSource
+
+resolve sound file in the same order as FS_LoadSound does,
+names without extension are not cached. Doesn't open the file
+=================
+*/
+static qboolean S_FindSoundSource( const char *name, soundsource_t *src )
+{
+	char	lwr[MAX_QPATH];
+	uint32_t	crc;
+
+	if( !Sound_SupportedFileFormat( COM_FileExtension( name )))
+		return false;
+
+	Q_snprintf( src->name, sizeof( src->name ), DEFAULT_SOUNDPATH "%s", name );
+	COM_FixSlashes( src->name );
+
+	if(( src->filetime = FS_FileTime( src->name, false )) == -1 )
+	{
+		Q_strncpy( src->name, name, sizeof( src->name ));
+		COM_FixSlashes( src->name );
+
+		if(( src->filetime = FS_FileTime( src->name, false )) == -1 )
+			return false;
+	}
+
+	src->filesize = -1;
+
+	Q_strnlwr( src->name, lwr, sizeof( lwr ));
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, lwr, strlen( lwr ));
+	src->hash = CRC32_Final( crc );
+	Q_snprintf( src->cachename, sizeof( src->cachename ), SOUNDCACHE_PATH "%08x.dat", src->hash );
+
+	return true;
+}
+
+/*
+=================
+S_SoundSourceSize
+
+=================
+*/
+static int S_SoundSourceSize( soundsource_t *src )
+{
+	if( src->filesize < 0 )
+		src->filesize = FS_FileSize( src->name, false );
+
+	return src->filesize;
+}
+
+/*
+=================
+S_ScanSoundCache
+
+remember which name hashes have cache files, called on registration
+=================
+*/
+static void S_ScanSoundCache( void )
+{
+	search_t	*t;
+	int	i;
+
+	memset( s_cachefilter, 0, sizeof( s_cachefilter ));
+
+	if( !s_cache.value || ( t = FS_Search( SOUNDCACHE_PATH "*.dat", true, true )) == NULL )
+		return;
+
+	for( i = 0; i < t->numfilenames; i++ )
+	{
+		uint	hash;
+
+		if( sscanf( COM_FileWithoutPath( t->filenames[i] ), "%x", &hash ) != 1 )
+			continue;
+
+		SetBits( s_cachefilter[( hash & ( SOUNDCACHE_FILTER - 1 )) >> 5], BIT( hash & 31 ));
+	}
+
+	Mem_Free( t );
+}
+
+/*
+=================
+S_UseSoundCache
+
+decoded formats are always cached, plain waves only when
+they were resampled before
+=================
+*/
+static qboolean S_UseSoundCache( const soundsource_t *src )
+{
+	uint	bit = src->hash & ( SOUNDCACHE_FILTER - 1 );
+
+	if( !s_cache.value )
+		return false;
+
+	if( Q_stricmp( COM_FileExtension( src->name ), "wav" ))
+		return true;
+
+	return FBitSet( s_cachefilter[bit >> 5], BIT( bit & 31 )) ? true : false;
+}
+
+/*
+=================
+S_LoadCachedSound
+
+pcm is read straight into sound buffer
+=================
+*/
+static wavdata_t *S_LoadCachedSound( soundsource_t *src )
+{
+	dsoundcache_t	hdr;
+	wavdata_t		*sc;
+	file_t		*f;
+
+	if(( f = FS_Open( src->cachename, "rb", true )) == NULL )
+		return NULL;
+
+	if( FS_Read( f, &hdr, sizeof( hdr )) != sizeof( hdr )
+		|| hdr.ident != SOUNDCACHE_IDENT || hdr.version != SOUNDCACHE_VERSION
+		|| hdr.filetime != src->filetime || hdr.filesize != S_SoundSourceSize( src )
+		|| Q_strnicmp( hdr.name, src->name, sizeof( hdr.name ))
+		|| hdr.width < 1 || hdr.width > 2 || hdr.channels < 1 || hdr.channels > 2
+		|| hdr.size == 0 || hdr.size != (uint)( hdr.samples * hdr.width * hdr.channels )
+		|| FS_FileLength( f ) != sizeof( hdr ) + hdr.size )
+	{
+		FS_Close( f );
+		return NULL;
+	}
+
+	sc = Mem_Calloc( sndpool, sizeof( wavdata_t ));
+	sc->rate = hdr.rate;
+	sc->width = hdr.width;
+	sc->channels = hdr.channels;
+	sc->loopStart = hdr.loopStart;
+	sc->samples = hdr.samples;
+	sc->type = hdr.type;
+	sc->flags = hdr.flags;
+	sc->size = hdr.size;
+	sc->buffer = Mem_Malloc( sndpool, sc->size );
+
+	if( FS_Read( f, sc->buffer, sc->size ) != sc->size )
+	{
+		FS_FreeSound( sc );
+		sc = NULL;
+	}
+
+	FS_Close( f );
+
+	return sc;
+}
+
+/*
+=================
+S_SaveCachedSound
+=================
+*/
+static void S_SaveCachedSound( soundsource_t *src, const wavdata_t *sc )
+{
+	dsoundcache_t	hdr;
+	file_t		*f;
+	uint		bit = src->hash & ( SOUNDCACHE_FILTER - 1 );
+
+	if( !sc->buffer || !sc->size || S_SoundSourceSize( src ) <= 0 )
+		return;
+
+	memset( &hdr, 0, sizeof( hdr ));
+	hdr.ident = SOUNDCACHE_IDENT;
+	hdr.version = SOUNDCACHE_VERSION;
+	hdr.filetime = src->filetime;
+	hdr.filesize = S_SoundSourceSize( src );
+	Q_strncpy( hdr.name, src->name, sizeof( hdr.name ));
+	hdr.rate = sc->rate;
+	hdr.width = sc->width;
+	hdr.channels = sc->channels;
+	hdr.loopStart = sc->loopStart;
+	hdr.samples = sc->samples;
+	hdr.type = sc->type;
+	hdr.flags = sc->flags;
+	hdr.size = sc->size;
+
+	if(( f = FS_Open( src->cachename, "wb", true )) == NULL )
+		return;
+
+	if( FS_Write( f, &hdr, sizeof( hdr )) != sizeof( hdr ) || FS_Write( f, sc->buffer, sc->size ) != sc->size )
+	{
+		FS_Close( f );
+		FS_Delete( src->cachename );
+		return;
+	}
+
+	FS_Close( f );
+	SetBits( s_cachefilter[bit >> 5], BIT( bit & 31 ));
+}
+
+/*
+==============================================================
+
+STREAMED SOUNDS
+
+long plain waves are not loaded, sfx only keeps the header and
+every channel playing it decodes its own copy, see s_decode.c
+==============================================================
+*/
+/*
+=================
+S_StreamableSource
+
+=================
+*/
+static qboolean S_StreamableSource( soundsource_t *src )
+{
+	if( s_stream_size.value <= 0 || Q_stricmp( COM_FileExtension( src->name ), "wav" ))
+		return false;
+
+	return S_SoundSourceSize( src ) >= s_stream_size.value * 1024;
+}
+
+/*
+=================
+S_LoadStreamedSound
+
+=================
+*/
+static wavdata_t *S_LoadStreamedSound( soundsource_t *src )
+{
+	const wavdata_t	*info;
+	wavdata_t		*sc = NULL;
+	stream_t		*stream;
+
+	if( !S_StreamableSource( src ))
+		return NULL;
+
+	if(( stream = FS_OpenStream( src->name )) == NULL )
+		return NULL;
+
+	info = FS_StreamInfo( stream );
+
+	// looped sounds would need to seek back, other rates are resampled at load
+	if( info->loopStart < 0 && info->type == WF_PCMDATA
+		&& ( info->rate == SOUND_11k || info->rate == SOUND_22k || info->rate == SOUND_44k )
+		&& ( info->width == 1 || info->width == 2 ) && ( info->channels == 1 || info->channels == 2 ))
+	{
+		sc = Mem_Calloc( sndpool, sizeof( wavdata_t ));
+		*sc = *info;
+		sc->samples = info->size / ( info->width * info->channels );
+		sc->size = 0; // nothing is kept in memory
+	}
+
+	FS_FreeStream( stream );
+
+	return sc;
+}
+
+/*
+=================
+S_OpenSfxStream
+
+start decoding streamed sound for a channel
+=================
+*/
+int S_OpenSfxStream( sfx_t *sfx, int sample )
+{
+	wavdata_t		*sc = sfx->cache;
+	soundsource_t	src;
+
+	if( !sc || !FBitSet( sc->flags, SOUND_STREAM ))
+		return 0;
+
+	if( !S_FindSoundSource( sfx->name[0] == '*' ? sfx->name + 1 : sfx->name, &src ))
+		return 0;
+
+	return S_OpenSoundStream( src.name, sample * sc->width * sc->channels, true );
+}
+
+/*
+=================
+S_PrefetchSound
+
+start reading sound file in background during
+registration, follows FS_LoadSound search order
+=================
+*/
+void S_PrefetchSound( const char *name )
+{
+	char	path[MAX_QPATH];
+	soundsource_t	src;
+
+	if( !COM_CheckString( name ) || !dma.initialized || S_TestSoundChar( name, '!' ))
+		return;
+
+	if( name[0] == '/' || name[0] == '\\' ) name++;
+	if( name[0] == '/' || name[0] == '\\' ) name++;
+	if( name[0] == '*' ) name++;
+
+	// only exact names, loader tries every format otherwise
+	if( !Sound_SupportedFileFormat( COM_FileExtension( name )))
+		return;
+
+	if( S_FindSoundSource( name, &src ))
+	{
+		// won't be loaded at all
+		if( S_StreamableSource( &src ))
+			return;
+
+		// cache file is smaller and will be read instead
+		if( S_UseSoundCache( &src ) && FS_FileExists( src.cachename, true ))
+			return;
+	}
+
+	Q_snprintf( path, sizeof( path ), DEFAULT_SOUNDPATH "%s", name );
+	COM_FixSlashes( path );
+
+	// if file is in pack it will be loaded as usual
+	if( FS_FileExists( path, false ))
+	{
+		FS_PrefetchFile( path );
+		return;
+	}
+
+	if( FS_FileExists( path + sizeof( DEFAULT_SOUNDPATH ) - 1, false ))
+		FS_PrefetchFile( path + sizeof( DEFAULT_SOUNDPATH ) - 1 );
+}
+
+/*
+=================
+S_LoadPrefetchedSound
+
+decode on main thread the file that S_PrefetchSound read ahead
+=================
+*/
+static wavdata_t *S_LoadPrefetchedSound( const char *name )
+{
+	char		path[MAX_QPATH];
+	fs_offset_t	size;
+	wavdata_t		*sc;
+	byte		*buf;
+
+	Q_snprintf( path, sizeof( path ), DEFAULT_SOUNDPATH "%s", name );
+	COM_FixSlashes( path );
+
+	buf = FS_LoadPrefetchedFile( path, &size );
+
+	if( !buf )
+		buf = FS_LoadPrefetchedFile( path + sizeof( DEFAULT_SOUNDPATH ) - 1, &size );
+
+	if( !buf )
+		return NULL;
+
+	// '#' tells soundlib to decode the buffer as is
+	Q_snprintf( path, sizeof( path ), "#%s", name );
+	sc = FS_LoadSound( path, buf, size );
+	Mem_Free( buf );
+
+	return sc;
+}
+
 /*
 =================
 S_LoadSound
@@ -127,6 +535,9 @@ S_LoadSound
 wavdata_t *S_LoadSound( sfx_t *sfx )
 {
 	wavdata_t	*sc = NULL;
+	soundsource_t	src;
+	qboolean	cacheable = false;
+	int	srcrate;
 
 	if( !sfx ) return NULL;
 
@@ -144,12 +555,40 @@ wavdata_t *S_LoadSound( sfx_t *sfx )
 		if( s_warn_late_precache.value > 0 && CL_Active() )
 			Con_Printf( S_WARN "S_LoadSound: late precache of %s\n", sfx->name );
 
-		if( sfx->name[0] == '*' )
-			sc = FS_LoadSound( sfx->name + 1, NULL, 0 );
-		else sc = FS_LoadSound( sfx->name, NULL, 0 );
+		if( S_FindSoundSource( sfx->name[0] == '*' ? sfx->name + 1 : sfx->name, &src ))
+		{
+			if(( sc = S_LoadStreamedSound( &src )) != NULL )
+			{
+				sfx->cache = sc;
+				return sfx->cache;
+			}
+
+			cacheable = s_cache.value ? true : false;
+
+			if( S_UseSoundCache( &src ) && ( sc = S_LoadCachedSound( &src )) != NULL )
+			{
+				sfx->cache = sc;
+				return sfx->cache;
+			}
+		}
+
+		sc = S_LoadPrefetchedSound( sfx->name[0] == '*' ? sfx->name + 1 : sfx->name );
+
+		if( !sc )
+		{
+			if( sfx->name[0] == '*' )
+				sc = FS_LoadSound( sfx->name + 1, NULL, 0 );
+			else sc = FS_LoadSound( sfx->name, NULL, 0 );
+		}
+	}
+
+	if( !sc )
+	{
+		sc = S_CreateDefaultSound();
+		cacheable = false;
 	}
 
-	if( !sc ) sc = S_CreateDefaultSound();
+	srcrate = sc->rate;
 
 	if( sc->rate < SOUND_11k ) // some bad sounds
 		Sound_Process( &sc, SOUND_11k, sc->width, SOUND_RESAMPLE );
@@ -158,6 +597,10 @@ wavdata_t *S_LoadSound( sfx_t *sfx )
 	else if( sc->rate > SOUND_22k && sc->rate <= SOUND_32k ) // some bad sounds
 		Sound_Process( &sc, SOUND_44k, sc->width, SOUND_RESAMPLE );
 
+	// plain waves are as fast to load as the cache itself
+	if( cacheable && ( sc->rate != srcrate || !Q_stricmp( COM_FileExtension( src.name ), "mp3" )))
+		S_SaveCachedSound( &src, sc );
+
 	sfx->cache = sc;
 
 	return sfx->cache;
@@ -258,9 +701,12 @@ void S_FreeSound( sfx_t *sfx )
 		prev = &hashSfx->hashNext;
 	}
 
+	// mixer may be playing it right now
+	S_LockMixer();
 	if( sfx->cache )
 		FS_FreeSound( sfx->cache );
 	memset( sfx, 0, sizeof( *sfx ));
+	S_UnlockMixer();
 }
 
 /*
@@ -275,6 +721,8 @@ void S_BeginRegistration( void )
 
 	snd_ambient = false;
 
+	S_ScanSoundCache();
+
 	// check for automatic ambient sounds
 	for( i = 0; i < NUM_AMBIENTS; i++ )
 	{
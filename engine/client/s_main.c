@@ -34,6 +34,12 @@ listener_t	s_listener;
 int		total_channels;
 int		soundtime;	// sample PAIRS
 int   		paintedtime; 	// sample PAIRS
+static qboolean	s_nulldevice;	// -nullsound, mixing into memory without output
+static double	s_nullstarttime;
+
+#define COMBINE_HASH_BITS	10	// more than twice of MAX_CHANNELS
+#define COMBINE_HASH_SIZE	( 1 << COMBINE_HASH_BITS )
+static channel_t	*combine_hash[COMBINE_HASH_SIZE];
 
 static CVAR_DEFINE( s_volume, "volume", "0.7", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "sound volume" );
 CVAR_DEFINE( s_musicvolume, "MP3Volume", "1.0", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "background music volume" );
@@ -108,15 +114,44 @@ S_FreeChannel
 */
 void S_FreeChannel( channel_t *ch )
 {
-	ch->sfx = NULL;
-	ch->name[0] = '\0';
-	ch->use_loop = false;
-	ch->isSentence = false;
+	S_CloseSoundStream( ch->stream );
+	MIX_FreeChannel( ch );
+	SND_CloseMouth( ch );
+}
 
-	// clear mixer
-	memset( &ch->pMixer, 0, sizeof( ch->pMixer ));
+/*
+=================
+S_StartChannel
 
-	SND_CloseMouth( ch );
+mixer thread will get a new copy of the channel
+=================
+*/
+static void S_StartChannel( channel_t *ch )
+{
+	static uint	serial;
+
+	// zero means never sent to the mixer
+	if( !++serial ) serial++;
+	ch->serial = serial;
+}
+
+/*
+=================
+S_StartChannelStream
+
+sounds too long to keep in memory are decoded
+while playing, starting from channel position
+=================
+*/
+static qboolean S_StartChannelStream( channel_t *ch, wavdata_t *pSource )
+{
+	if( ch->isSentence || !FBitSet( pSource->flags, SOUND_STREAM ))
+		return true;
+
+	S_CloseSoundStream( ch->stream );
+	ch->stream = S_OpenSfxStream( ch->sfx, ch->pMixer.sample );
+
+	return ch->stream != 0;
 }
 
 /*
@@ -569,6 +604,10 @@ void S_StartSound( const vec3_t pos, int ent, int chan, sound_t handle, float fv
 		// and we didn't find it (it's not playing), go ahead and start it up
 	}
 
+	// demo is fast-forwarded, nobody would hear it anyway,
+	// but ambient sounds keep playing after the seek
+	if( cls.demoseeking && chan != CHAN_STATIC ) return;
+
 	if( !pos ) pos = refState.vieworg;
 
 	if( chan == CHAN_STREAM )
@@ -599,6 +638,7 @@ void S_StartSound( const vec3_t pos, int ent, int chan, sound_t handle, float fv
 	target_chan->basePitch = pitch;
 	target_chan->isSentence = false;
 	target_chan->sfx = sfx;
+	S_StartChannel( target_chan );
 
 	pSource = NULL;
 
@@ -646,6 +686,12 @@ void S_StartSound( const vec3_t pos, int ent, int chan, sound_t handle, float fv
 		}
 	}
 
+	if( !S_StartChannelStream( target_chan, pSource ))
+	{
+		S_FreeChannel( target_chan );
+		return;
+	}
+
 	// Init client entity mouth movement vars
 	SND_InitMouth( ent, chan );
 
@@ -659,6 +705,7 @@ void S_StartSound( const vec3_t pos, int ent, int chan, sound_t handle, float fv
 			int skip = COM_RandomLong( 0, (long)( 0.1f * check->sfx->cache->rate ));
 
 			S_SetSampleStart( check, sfx->cache, skip );
+			S_StartChannel( check ); // it wasn't mixed yet, restart from the new position
 			break;
 		}
 	}
@@ -711,6 +758,7 @@ void S_RestoreSound( const vec3_t pos, int ent, int chan, sound_t handle, float
 	target_chan->basePitch = pitch;
 	target_chan->isSentence = false;
 	target_chan->sfx = sfx;
+	S_StartChannel( target_chan );
 
 	pSource = NULL;
 
@@ -766,6 +814,12 @@ void S_RestoreSound( const vec3_t pos, int ent, int chan, sound_t handle, float
 	target_chan->pMixer.sample = sample;
 	target_chan->pMixer.forcedEndSample = end;
 
+	if( !S_StartChannelStream( target_chan, pSource ))
+	{
+		S_FreeChannel( target_chan );
+		return;
+	}
+
 	// Init client entity mouth movement vars
 	SND_InitMouth( ent, chan );
 }
@@ -811,6 +865,7 @@ void S_AmbientSound( const vec3_t pos, int ent, sound_t handle, float fvol, floa
 
 	VectorCopy( pos, ch->origin );
 	ch->entnum = ent;
+	S_StartChannel( ch );
 
 	CL_GetEntitySpatialization( ch );
 
@@ -837,7 +892,7 @@ void S_AmbientSound( const vec3_t pos, int ent, sound_t handle, float fvol, floa
 		ch->name[0] = '\0';
 	}
 
-	if( !pSource )
+	if( !pSource || !S_StartChannelStream( ch, pSource ))
 	{
 		S_FreeChannel( ch );
 		return;
@@ -995,6 +1050,7 @@ void S_UpdateAmbientSounds( void )
 	float	vol;
 	int	ambient_channel;
 	channel_t	*chan;
+	sfx_t	*sfx;
 
 	if( !snd_ambient ) return;
 
@@ -1013,7 +1069,17 @@ void S_UpdateAmbientSounds( void )
 	for( ambient_channel = 0; ambient_channel < NUM_AMBIENTS; ambient_channel++ )
 	{
 		chan = &channels[ambient_channel];
-		chan->sfx = S_GetSfxByHandle( ambient_sfx[ambient_channel] );
+		sfx = S_GetSfxByHandle( ambient_sfx[ambient_channel] );
+
+		if( sfx != chan->sfx )
+		{
+			chan->sfx = sfx;
+
+			// ambients loop, they are never streamed
+			if( sfx && ( !S_LoadSound( sfx ) || FBitSet( sfx->cache->flags, SOUND_STREAM )))
+				chan->sfx = NULL;
+			S_StartChannel( chan );
+		}
 
 		// ambient is unused
 		if( !chan->sfx )
@@ -1052,6 +1118,9 @@ void S_UpdateAmbientSounds( void )
 /*
 ===================
 S_FindRawChannel
+
+raw channels are shared with mixer, everything
+it reads is changed with mixer lock held
 ===================
 */
 rawchan_t *S_FindRawChannel( int entnum, qboolean create )
@@ -1067,6 +1136,8 @@ rawchan_t *S_FindRawChannel( int entnum, qboolean create )
 	best_time = 0x7fffffff;
 	best = free = -1;
 
+	S_LockMixer();
+
 	for( i = 0; i < MAX_RAW_CHANNELS; i++ )
 	{
 		ch = raw_channels[i];
@@ -1081,7 +1152,10 @@ rawchan_t *S_FindRawChannel( int entnum, qboolean create )
 
 			// exact match
 			if( ch->entnum == entnum )
+			{
+				S_UnlockMixer();
 				return ch;
+			}
 
 			time = ch->s_rawend - paintedtime;
 			if( time < best_time )
@@ -1092,10 +1166,13 @@ rawchan_t *S_FindRawChannel( int entnum, qboolean create )
 		}
 	}
 
-	if( !create ) return NULL;
-
 	if( free >= 0 ) best = free;
-	if( best < 0 ) return NULL; // no free slots
+
+	if( !create || best < 0 ) // no free slots
+	{
+		S_UnlockMixer();
+		return NULL;
+	}
 
 	if( !raw_channels[best] )
 	{
@@ -1106,14 +1183,43 @@ rawchan_t *S_FindRawChannel( int entnum, qboolean create )
 	ch = raw_channels[best];
 	ch->max_samples = raw_samples;
 	ch->entnum = entnum;
+	ch->stream = entnum == S_RAW_SOUND_BACKGROUNDTRACK || CL_IsPlayerIndex( entnum );
 	ch->s_rawend = 0;
+	memset( &ch->mouth, 0, sizeof( ch->mouth ));
+
+	S_UnlockMixer();
 
 	return ch;
 }
 
+/*
+===================
+S_RawChannelSpace
+
+returns how many samples should be copied into the raw buffer
+===================
+*/
+int S_RawChannelSpace( rawchan_t *ch )
+{
+	int	space;
+
+	S_LockMixer();
+
+	if( ch->s_rawend < soundtime )
+		ch->s_rawend = soundtime;
+
+	space = ch->max_samples - ( ch->s_rawend - soundtime );
+
+	S_UnlockMixer();
+
+	return space;
+}
+
 /*
 ===================
 S_RawSamplesStereo
+
+called with mixer lock held
 ===================
 */
 static uint S_RawSamplesStereo( portable_samplepair_t *rawsamples, uint rawend, uint max_samples, uint samples, uint rate, word width, word channels, const byte *data )
@@ -1192,10 +1298,12 @@ void S_RawEntSamples( int entnum, uint samples, uint rate, word width, word chan
 	if( !( ch = S_FindRawChannel( entnum, true )))
 		return;
 
+	S_LockMixer();
 	ch->master_vol = snd_vol;
 	ch->dist_mult = (ATTN_NONE / SND_CLIP_DISTANCE);
 	ch->s_rawend = S_RawSamplesStereo( ch->rawsamples, ch->s_rawend, ch->max_samples, samples, rate, width, channels, data );
 	ch->leftvol = ch->rightvol = snd_vol;
+	S_UnlockMixer();
 }
 
 /*
@@ -1244,21 +1352,16 @@ void S_StreamAviSamples( void *Avi, int entnum, float fvol, float attn, float sy
 	ch->master_vol = bound( 0, fvol * 255, 255 );
 	ch->dist_mult = (attn / SND_CLIP_DISTANCE);
 
-	// see how many samples should be copied into the raw buffer
-	if( ch->s_rawend < soundtime )
-		ch->s_rawend = soundtime;
-
 	// position is changed, synchronization is lost etc
 	if( fabs( ch->oldtime - synctime ) > s_mixahead.value )
 		ch->sound_info.loopStart = AVI_TimeToSoundPosition( Avi, synctime * 1000 );
 	ch->oldtime = synctime; // keep actual time
 
-	while( ch->s_rawend < soundtime + ch->max_samples )
+	// see how many samples should be copied into the raw buffer
+	while(( bufferSamples = S_RawChannelSpace( ch )) > 0 )
 	{
 		wavdata_t	*info = &ch->sound_info;
 
-		bufferSamples = ch->max_samples - (ch->s_rawend - soundtime);
-
 		// decide how much data needs to be read from the file
 		fileSamples = bufferSamples * ((float)info->rate / SOUND_DMA_SPEED );
 		if( fileSamples <= 1 ) return; // no more samples need
@@ -1285,8 +1388,10 @@ void S_StreamAviSamples( void *Avi, int entnum, float fvol, float attn, float sy
 		if( r > 0 )
 		{
 			// add to raw buffer
+			S_LockMixer();
 			ch->s_rawend = S_RawSamplesStereo( ch->rawsamples, ch->s_rawend, ch->max_samples,
 			fileSamples, info->rate, info->width, info->channels, raw );
+			S_UnlockMixer();
 		}
 		else break; // no more samples for this frame
 	}
@@ -1303,6 +1408,8 @@ static void S_FreeIdleRawChannels( void )
 {
 	int	i;
 
+	S_LockMixer();
+
 	for( i = 0; i < MAX_RAW_CHANNELS; i++ )
 	{
 		rawchan_t	*ch = raw_channels[i];
@@ -1321,6 +1428,8 @@ static void S_FreeIdleRawChannels( void )
 			Mem_Free( ch );
 		}
 	}
+
+	S_UnlockMixer();
 }
 
 /*
@@ -1351,6 +1460,8 @@ static void S_SpatializeRawChannels( void )
 {
 	int	i;
 
+	S_LockMixer();
+
 	for( i = 0; i < MAX_RAW_CHANNELS; i++ )
 	{
 		rawchan_t	*ch = raw_channels[i];
@@ -1359,12 +1470,18 @@ static void S_SpatializeRawChannels( void )
 
 		if( !ch ) continue;
 
+		// mixer can't look at client state
+		ch->stream = ch->entnum == S_RAW_SOUND_BACKGROUNDTRACK || CL_IsPlayerIndex( ch->entnum );
+
 		if( ch->s_rawend < paintedtime )
 		{
 			ch->leftvol = ch->rightvol = 0;
 			continue;
 		}
 
+		if( ch->entnum > 0 )
+			SND_SetMouthOpen( ch->entnum, ch->mouth.mouthopen );
+
 		// spatialization
 		if( !S_IsClient( ch->entnum ) && ch->dist_mult && ch->entnum >= 0 && ch->entnum < GI->max_edicts )
 		{
@@ -1393,6 +1510,8 @@ static void S_SpatializeRawChannels( void )
 			ch->leftvol = ch->rightvol = ch->master_vol;
 		}
 	}
+
+	S_UnlockMixer();
 }
 
 /*
@@ -1418,20 +1537,29 @@ static void S_FreeRawChannels( void )
 
 /*
 ==================
-S_ClearBuffer
+S_ClearPaintBuffers
 ==================
 */
-void S_ClearBuffer( void )
+static void S_ClearPaintBuffers( void )
 {
-	S_ClearRawChannels();
-
-	SNDDMA_BeginPainting ();
+	if( !s_nulldevice ) SNDDMA_BeginPainting ();
 	if( dma.buffer ) memset( dma.buffer, 0, dma.samples * 2 );
-	SNDDMA_Submit ();
+	if( !s_nulldevice ) SNDDMA_Submit ();
 
 	MIX_ClearAllPaintBuffers( PAINTBUFFER_SIZE, true );
 }
 
+/*
+==================
+S_ClearBuffer
+==================
+*/
+void S_ClearBuffer( void )
+{
+	S_ClearRawChannels();
+	S_ClearPaintBuffers();
+}
+
 /*
 ==================
 S_StopSound
@@ -1458,6 +1586,8 @@ void S_StopAllSounds( qboolean ambient )
 	int	i;
 
 	if( !dma.initialized ) return;
+
+	S_LockMixer();
 	total_channels = MAX_DYNAMIC_CHANNELS;	// no statics
 
 	for( i = 0; i < MAX_CHANNELS; i++ )
@@ -1470,6 +1600,7 @@ void S_StopAllSounds( qboolean ambient )
 
 	// clear all the channels
 	memset( channels, 0, sizeof( channels ));
+	S_ClearMixer();
 
 	// restart the ambient sounds
 	if( ambient ) S_InitAmbientChannels ();
@@ -1478,6 +1609,7 @@ void S_StopAllSounds( qboolean ambient )
 
 	// clear any remaining soundfade
 	memset( &soundfade, 0, sizeof( soundfade ));
+	S_UnlockMixer();
 }
 
 /*
@@ -1492,10 +1624,14 @@ update global soundtime
 static int S_GetSoundtime( void )
 {
 	static int buffers, oldsamplepos;
-	int samplepos, fullsamples;
+	int samplepos, fullsamples, i;
 
 	fullsamples = dma.samples / 2;
 
+	// null device is "playing" in real time
+	if( s_nulldevice )
+		dma.samplepos = (int)((int64_t)(( Sys_DoubleTime() - s_nullstarttime ) * dma.format.speed ) * dma.format.channels % dma.samples );
+
 	// it is possible to miscount buffers
 	// if it has wrapped twice between
 	// calls to S_Update.  Oh well.
@@ -1510,7 +1646,22 @@ static int S_GetSoundtime( void )
 			// time to chop things off to avoid 32 bit limits
 			buffers     = 0;
 			paintedtime = fullsamples;
-			S_StopAllSounds( true );
+
+			// runs on the mixer thread, main thread will free
+			// its channels when they are reported as finished
+			for( i = 0; i < snd_mixer.total_channels; i++ )
+			{
+				if( snd_mixer.channels[i].sfx )
+					MIX_FreeChannel( &snd_mixer.channels[i] );
+			}
+
+			// main thread refills raw channels from the new soundtime
+			for( i = 0; i < MAX_RAW_CHANNELS; i++ )
+			{
+				if( raw_channels[i] )
+					raw_channels[i]->s_rawend = 0;
+			}
+			S_ClearPaintBuffers();
 		}
 	}
 
@@ -1525,7 +1676,7 @@ void S_UpdateChannels( void )
 	uint	endtime;
 	int	samps;
 
-	SNDDMA_BeginPainting();
+	if( !s_nulldevice ) SNDDMA_BeginPainting();
 
 	if( !dma.buffer ) return;
 
@@ -1550,7 +1701,7 @@ void S_UpdateChannels( void )
 
 	MIX_PaintChannels( endtime );
 
-	SNDDMA_Submit();
+	if( !s_nulldevice ) SNDDMA_Submit();
 }
 
 /*
@@ -1563,7 +1714,7 @@ Don't let sound skip if going slow
 void S_ExtraUpdate( void )
 {
 	if( !dma.initialized ) return;
-	S_UpdateChannels ();
+	S_MixerExtraUpdate ();
 }
 
 /*
@@ -1583,6 +1734,32 @@ void S_UpdateFrame( struct ref_viewpass_s *rvp )
 	s_listener.entnum = rvp->viewentity; // can be camera entity too
 }
 
+/*
+============
+S_FindCombineChannel
+
+returns first static channel playing the same sound,
+open addressing by sfx pointer, table is cleared every frame
+============
+*/
+static channel_t *S_FindCombineChannel( channel_t *ch )
+{
+	uint	hash = (uint)((size_t)ch->sfx >> 4 ) * 2654435761u;
+	int	i;
+
+	for( i = hash >> ( 32 - COMBINE_HASH_BITS ); ; i = ( i + 1 ) & ( COMBINE_HASH_SIZE - 1 ))
+	{
+		if( !combine_hash[i] )
+		{
+			combine_hash[i] = ch;
+			return ch;
+		}
+
+		if( combine_hash[i]->sfx == ch->sfx )
+			return combine_hash[i];
+	}
+}
+
 /*
 ============
 SND_UpdateSound
@@ -1592,12 +1769,15 @@ Called once each time through the main loop
 */
 void SND_UpdateSound( void )
 {
-	int		i, j, total;
+	int		i, total;
 	channel_t		*ch, *combine;
 	con_nprint_t	info;
 
 	if( !dma.initialized ) return;
 
+	// catch up with mixer, finished channels become free
+	S_ReadMixerStatus();
+
 	// if the loading plaque is up, clear everything
 	// out to make sure we aren't looping a dirty
 	// dma buffer while loading
@@ -1612,12 +1792,20 @@ void SND_UpdateSound( void )
 	s_listener.waterlevel = cl.local.waterlevel;
 	s_listener.active = CL_IsInGame();
 	s_listener.inmenu = CL_IsInMenu();
+	s_listener.inconsole = CL_IsInConsole();
+	s_listener.background = cl.background;
 	s_listener.paused = cl.paused;
 
+	// sets cvars, so it's done here and not in mixer
+	S_LockMixer();
+	CheckNewDspPresets();
+	S_UnlockMixer();
+
 	// update general area ambient sound sources
 	S_UpdateAmbientSounds();
 
-	combine = NULL;
+	if( s_combine_sounds.value )
+		memset( combine_hash, 0, sizeof( combine_hash ));
 
 	// update spatialization for static and dynamic sounds
 	for( i = NUM_AMBIENTS, ch = channels + NUM_AMBIENTS; i < total_channels; i++, ch++ )
@@ -1625,45 +1813,18 @@ void SND_UpdateSound( void )
 		if( !ch->sfx ) continue;
 		SND_Spatialize( ch ); // respatialize channel
 
-		if( !ch->leftvol && !ch->rightvol )
-			continue;
-
-		// try to combine static sounds with a previous channel of the same
+		// try to combine static sounds with the first channel of the same
 		// sound effect so we don't mix five torches every frame
 		// g-cont: perfomance option, probably kill stereo effect in most cases
 		if( i >= MAX_DYNAMIC_CHANNELS && s_combine_sounds.value )
 		{
-			// see if it can just use the last one
-			if( combine && combine->sfx == ch->sfx )
+			combine = S_FindCombineChannel( ch );
+
+			if( combine != ch )
 			{
 				combine->leftvol += ch->leftvol;
 				combine->rightvol += ch->rightvol;
 				ch->leftvol = ch->rightvol = 0;
-				continue;
-			}
-
-			// search for one
-			combine = channels + MAX_DYNAMIC_CHANNELS;
-
-			for( j = MAX_DYNAMIC_CHANNELS; j < i; j++, combine++ )
-			{
-				if( combine->sfx == ch->sfx )
-					break;
-			}
-
-			if( j == total_channels )
-			{
-				combine = NULL;
-			}
-			else
-			{
-				if( combine != ch )
-				{
-					combine->leftvol += ch->leftvol;
-					combine->rightvol += ch->rightvol;
-					ch->leftvol = ch->rightvol = 0;
-				}
-				continue;
 			}
 		}
 	}
@@ -1692,14 +1853,18 @@ void SND_UpdateSound( void )
 		VectorSet( info.color, 1.0f, 1.0f, 1.0f );
 		info.index = 0;
 
-		Con_NXPrintf( &info, "room_type: %i (%s) ----(%i)---- painted: %i\n", idsp_room, Cvar_VariableString( "dsp_coeff_table" ), total - 1, paintedtime );
+		S_LockMixer();
+		Con_NXPrintf( &info, "room_type: %i (%s) ----(%i)---- voices: %i real, %i virtual ---- painted: %i\n", idsp_room, Cvar_VariableString( "dsp_coeff_table" ),
+			total - 1, snd_mixer.realvoices, snd_mixer.virtualvoices, paintedtime );
+		S_UnlockMixer();
 	}
 
+	S_UpdateSoundStreams ();
 	S_StreamBackgroundTrack ();
 	S_StreamSoundTrack ();
 
-	// mix some sound
-	S_UpdateChannels ();
+	// send changes to mixer
+	S_SyncMixer ();
 }
 
 /*
@@ -1889,6 +2054,8 @@ void S_SoundInfo_f( void )
 	Con_Printf( "%5d bits/sample\n", 16 );
 	Con_Printf( "%5d bytes/sec\n", SOUND_DMA_SPEED );
 	Con_Printf( "%5d total_channels\n", total_channels );
+	Con_Printf( "Mixer thread: %s\n", S_MixerThreaded() ? "yes" : "no" );
+	Con_Printf( "Decoder thread: %s, %i stream(s)\n", S_DecoderThreaded() ? "yes" : "no", S_NumSoundStreams() );
 
 	S_PrintBackgroundTrackState ();
 }
@@ -1920,6 +2087,145 @@ void S_VoiceRecordStop_f( void )
 	Voice_RecordStop();
 }
 
+/*
+================
+S_InitNullDevice
+
+everything is mixed as usual but never played,
+for benchmarks on machines without audio
+================
+*/
+static qboolean S_InitNullDevice( void )
+{
+	dma.format.speed = SOUND_DMA_SPEED;
+	dma.format.channels = 2;
+	dma.format.width = 2;
+	dma.samples = 0x8000 * dma.format.channels;
+	dma.buffer = Z_Calloc( dma.samples * 2 );
+	dma.samplepos = 0;
+	dma.initialized = true;
+	dma.backendName = "Null";
+
+	s_nulldevice = true;
+	s_nullstarttime = Sys_DoubleTime();
+
+	return true;
+}
+
+#define MIXBENCH_SOURCES	12
+
+/*
+================
+S_MixBenchmark_f
+
+renders fixed set of channels into null device,
+prints mixing time and checksum of the output
+================
+*/
+static void S_MixBenchmark_f( void )
+{
+	sfx_t	sfx[MIXBENCH_SOURCES];
+	int	numchans, seconds, oldpaintedtime;
+	int	i, j, endtime;
+	double	start, total = 0.0;
+	uint32_t	crc;
+
+	if( !s_nulldevice )
+	{
+		Con_Printf( S_ERROR "s_mixbench: requires -nullsound\n" );
+		return;
+	}
+
+	numchans = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 128;
+	seconds = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 10;
+	numchans = bound( 1, numchans, MAX_CHANNELS );
+	seconds = bound( 1, seconds, 600 );
+
+	S_StopAllSounds( false );
+
+	// mixer thread waits until we're done
+	S_LockMixer();
+
+	// every combination of rate, width and channels, one second of noise
+	memset( sfx, 0, sizeof( sfx ));
+
+	for( i = 0; i < MIXBENCH_SOURCES; i++ )
+	{
+		wavdata_t	*wav = Mem_Calloc( sndpool, sizeof( *wav ));
+		uint	seed = i * 7919 + 1;
+
+		wav->rate = SOUND_11k << ( i % 3 );
+		wav->width = 1 + ( i / 3 ) % 2;
+		wav->channels = 1 + i / 6;
+		wav->samples = wav->rate;
+		wav->loopStart = 0;
+		wav->size = wav->samples * wav->width * wav->channels;
+		wav->buffer = Mem_Malloc( sndpool, wav->size );
+
+		for( j = 0; j < wav->size; j++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			wav->buffer[j] = seed >> 16;
+		}
+
+		Q_snprintf( sfx[i].name, sizeof( sfx[i].name ), "*mixbench%d", i );
+		sfx[i].cache = wav;
+	}
+
+	for( i = 0; i < numchans; i++ )
+	{
+		channel_t	*ch = &snd_mixer.channels[i];
+
+		ch->sfx = &sfx[i % MIXBENCH_SOURCES];
+		ch->entchannel = CHAN_STATIC;
+		ch->leftvol = 8 + ( i * 37 ) % 248;
+		ch->rightvol = 8 + ( i * 71 ) % 248;
+		ch->basePitch = ( i & 3 ) ? PITCH_NORM : 70 + ( i * 13 ) % 60;
+		ch->use_loop = true;
+		ch->staticsound = true;
+		ch->localsound = true;
+		ch->pMixer.sample = ( i * 997 ) % ch->sfx->cache->samples;
+	}
+
+	snd_mixer.total_channels = Q_max( numchans, MAX_DYNAMIC_CHANNELS );
+
+	memset( &snd_mixer.listener, 0, sizeof( snd_mixer.listener ));
+	snd_mixer.listener.active = true;
+	snd_mixer.mastervol = S_GetMasterVolume();
+	snd_mixer.musicvol = S_GetMusicVolume();
+	CheckNewDspPresets();
+
+	oldpaintedtime = paintedtime;
+	paintedtime = 0;
+	endtime = seconds * SOUND_DMA_SPEED;
+	CRC32_Init( &crc );
+
+	while( paintedtime < endtime )
+	{
+		int	pos = paintedtime & (( dma.samples >> 1 ) - 1 );
+		int	count = Q_min( Q_min( endtime - paintedtime, ( dma.samples >> 1 ) - pos ), 4096 );
+
+		start = Sys_DoubleTime();
+		MIX_PaintChannels( paintedtime + count );
+		total += Sys_DoubleTime() - start;
+
+		CRC32_ProcessBuffer( &crc, dma.buffer + pos * 4, count * 4 );
+	}
+
+	Con_Printf( "%d channels, %d seconds mixed in %.2f ms (%.1fx realtime), output crc %08x\n",
+		numchans, seconds, total * 1000.0, seconds / Q_max( total, 0.000001 ), CRC32_Final( crc ));
+
+	paintedtime = oldpaintedtime;
+	S_StopAllSounds( true );
+	S_UnlockMixer();
+
+	for( i = 0; i < MIXBENCH_SOURCES; i++ )
+	{
+		Mem_Free( sfx[i].cache->buffer );
+		Mem_Free( sfx[i].cache );
+	}
+}
+
 /*
 ================
 S_Init
@@ -1945,6 +2251,9 @@ qboolean S_Init( void )
 	Cvar_RegisterVariable( &s_test );
 	Cvar_RegisterVariable( &s_samplecount );
 	Cvar_RegisterVariable( &s_warn_late_precache );
+	Cvar_RegisterVariable( &s_cache );
+	Cvar_RegisterVariable( &s_stream_size );
+	Cvar_RegisterVariable( &s_max_voices );
 
 	Cmd_AddCommand( "play", S_Play_f, "playing a specified sound file" );
 	Cmd_AddCommand( "play2", S_Play2_f, "playing a group of specified sound files" ); // nehahra stuff
@@ -1954,13 +2263,18 @@ qboolean S_Init( void )
 	Cmd_AddCommand( "soundlist", S_SoundList_f, "display loaded sounds" );
 	Cmd_AddCommand( "s_info", S_SoundInfo_f, "print sound system information" );
 	Cmd_AddCommand( "s_fade", S_SoundFade_f, "fade all sounds then stop all" );
+	Cmd_AddCommand( "s_mixbench", S_MixBenchmark_f, "mix fixed set of channels into null device and print time and output checksum" );
 	Cmd_AddCommand( "+voicerecord", S_VoiceRecordStart_f, "start voice recording" );
 	Cmd_AddCommand( "-voicerecord", S_VoiceRecordStop_f, "stop voice recording" );
 	Cmd_AddCommand( "spk", S_SayReliable_f, "reliable play a specified sententce" );
 	Cmd_AddCommand( "speak", S_Say_f, "playing a specified sententce" );
 
 	dma.backendName = "None";
-	if( !SNDDMA_Init( ) )
+	if( Sys_CheckParm( "-nullsound" ))
+	{
+		S_InitNullDevice();
+	}
+	else if( !SNDDMA_Init( ) )
 	{
 		Con_Printf( "Audio: sound system can't be initialized\n" );
 		return false;
@@ -1979,6 +2293,8 @@ qboolean S_Init( void )
 	S_StopAllSounds ( true );
 	S_InitSounds ();
 	VOX_Init ();
+	S_InitDecoder ();
+	S_InitMixer ();
 
 	return true;
 }
@@ -1997,18 +2313,29 @@ void S_Shutdown( void )
 	Cmd_RemoveCommand( "soundlist" );
 	Cmd_RemoveCommand( "s_info" );
 	Cmd_RemoveCommand( "s_fade" );
+	Cmd_RemoveCommand( "s_mixbench" );
 	Cmd_RemoveCommand( "+voicerecord" );
 	Cmd_RemoveCommand( "-voicerecord" );
 	Cmd_RemoveCommand( "speak" );
 	Cmd_RemoveCommand( "spk" );
 
+	S_ShutdownMixer ();
 	S_StopAllSounds (false);
+	S_StopBackgroundTrack ();
+	S_ShutdownDecoder ();
 	S_FreeRawChannels ();
 	S_FreeSounds ();
 	VOX_Shutdown ();
 	SX_Free ();
 
-	SNDDMA_Shutdown ();
+	if( s_nulldevice )
+	{
+		Z_Free( dma.buffer );
+		dma.buffer = NULL;
+		dma.initialized = false;
+		s_nulldevice = false;
+	}
+	else SNDDMA_Shutdown ();
 	MIX_FreeAllPaintbuffers ();
 	Mem_FreePool( &sndpool );
 }
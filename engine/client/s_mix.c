@@ -16,6 +16,7 @@ GNU General Public License for more details.
 #include "common.h"
 #include "sound.h"
 #include "client.h"
+#include "xash3d_simd.h"
 
 #define IPAINTBUFFER	0
 #define IROOMBUFFER		1
@@ -31,6 +32,8 @@ GNU General Public License for more details.
 #define SND_SCALE_SHIFT	(8 - SND_SCALE_BITS)
 #define SND_SCALE_LEVELS	(1 << SND_SCALE_BITS)
 
+#define CMIXRATES		3	// 11k, 22k and 44k mixing passes
+
 portable_samplepair_t	*g_curpaintbuffer;
 portable_samplepair_t	streambuffer[(PAINTBUFFER_SIZE+1)];
 portable_samplepair_t	paintbuffer[(PAINTBUFFER_SIZE+1)];
@@ -41,6 +44,26 @@ paintbuffer_t		paintbuffers[CPAINTBUFFERS];
 
 int			snd_scaletable[SND_SCALE_LEVELS][256];
 
+qboolean			s_simd;	// use vectorized kernels
+
+#define VOICE_PRIORITY_BOOST	1024	// above any volume, these are never virtual
+
+typedef struct
+{
+	channel_t		*ch;
+	int		priority;
+	int		irate;
+} mixvoice_t;
+
+CVAR_DEFINE_AUTO( s_max_voices, "64", FCVAR_ARCHIVE|FCVAR_FILTERABLE, "how many channels are mixed at once, quieter ones only advance their position (0 - no limit)" );
+
+static const int		mix_rates[CMIXRATES] = { SOUND_11k, SOUND_22k, SOUND_44k };
+static channel_t		*mix_channels[CMIXRATES][MAX_CHANNELS];
+static int		mix_numchannels[CMIXRATES];
+static channel_t		*mix_virtual[CMIXRATES][MAX_CHANNELS];	// inaudible or culled channels
+static int		mix_numvirtual[CMIXRATES];
+static mixvoice_t		mix_voices[MAX_CHANNELS];
+
 void S_InitScaletable( void )
 {
 	int	i, j;
@@ -192,6 +215,10 @@ void MIX_InitAllPaintbuffers( void )
 	paintbuffers[ISTREAMBUFFER].pbuf = streambuffer;
 
 	MIX_SetCurrentPaintbuffer( IPAINTBUFFER );
+
+#if XASH_SIMD
+	s_simd = !Sys_CheckParm( "-nosimd" );
+#endif
 }
 
 /*
@@ -201,15 +228,170 @@ CHANNEL MIXING
 
 ===============================================================================
 */
+#if XASH_SIMD
+/*
+vectorized paint kernels, return how many samples were done,
+the rest is painted by plain C loops below with exactly the same output.
+8-bit samples are scaled through snd_scaletable, that is the same as
+multiplying them by volume with the lowest bits cleared
+*/
+#if XASH_SIMD_SSE2
+// add 4 sample pairs given as 16-bit words: l0 r0 l1 r1 ...
+static inline void S_AddPairs16_SSE2( portable_samplepair_t *pbuf, __m128i v )
+{
+	__m128i *p = (__m128i *)pbuf;
+
+	_mm_storeu_si128( p, _mm_add_epi32( _mm_loadu_si128( p ), _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 )));
+	_mm_storeu_si128( p + 1, _mm_add_epi32( _mm_loadu_si128( p + 1 ), _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 )));
+}
+
+// add ( s * vol ) >> 8 for 4 sample pairs, s and vol are 16-bit words: l0 r0 l1 r1 ...
+static inline void S_AddScaledPairs16_SSE2( portable_samplepair_t *pbuf, __m128i s, __m128i vol )
+{
+	__m128i *p = (__m128i *)pbuf;
+	__m128i lo = _mm_mullo_epi16( s, vol );
+	__m128i hi = _mm_mulhi_epi16( s, vol );
+
+	_mm_storeu_si128( p, _mm_add_epi32( _mm_loadu_si128( p ), _mm_srai_epi32( _mm_unpacklo_epi16( lo, hi ), 8 )));
+	_mm_storeu_si128( p + 1, _mm_add_epi32( _mm_loadu_si128( p + 1 ), _mm_srai_epi32( _mm_unpackhi_epi16( lo, hi ), 8 )));
+}
+
+// sign extend bytes to words
+#define S_Unpack8_SSE2( lohi, s ) _mm_srai_epi16( _mm_unpack##lohi##_epi8(( s ), ( s )), 8 )
+#endif // XASH_SIMD_SSE2
+
+static int S_PaintMonoFrom8SIMD( portable_samplepair_t *pbuf, const int *volume, const byte *pData, int outCount )
+{
+	int	lvol = ( volume[0] >> SND_SCALE_SHIFT ) << SND_SCALE_SHIFT;
+	int	rvol = ( volume[1] >> SND_SCALE_SHIFT ) << SND_SCALE_SHIFT;
+	int	i;
+#if XASH_SIMD_SSE2
+	__m128i	vol = _mm_set1_epi32(( rvol << 16 ) | ( lvol & 0xFFFF ));
+
+	for( i = 0; i + 8 <= outCount; i += 8 )
+	{
+		__m128i s = _mm_loadl_epi64((const __m128i *)( pData + i ));
+
+		s = S_Unpack8_SSE2( lo, s );
+		S_AddPairs16_SSE2( pbuf + i, _mm_mullo_epi16( _mm_unpacklo_epi16( s, s ), vol ));
+		S_AddPairs16_SSE2( pbuf + i + 4, _mm_mullo_epi16( _mm_unpackhi_epi16( s, s ), vol ));
+	}
+#else
+	for( i = 0; i + 8 <= outCount; i += 8 )
+	{
+		int16x8_t s = vmovl_s8( vld1_s8((const int8_t *)( pData + i )));
+		int32x4x2_t p0 = vld2q_s32((int32_t *)( pbuf + i ));
+		int32x4x2_t p1 = vld2q_s32((int32_t *)( pbuf + i + 4 ));
+
+		p0.val[0] = vaddq_s32( p0.val[0], vmull_n_s16( vget_low_s16( s ), lvol ));
+		p0.val[1] = vaddq_s32( p0.val[1], vmull_n_s16( vget_low_s16( s ), rvol ));
+		p1.val[0] = vaddq_s32( p1.val[0], vmull_n_s16( vget_high_s16( s ), lvol ));
+		p1.val[1] = vaddq_s32( p1.val[1], vmull_n_s16( vget_high_s16( s ), rvol ));
+		vst2q_s32((int32_t *)( pbuf + i ), p0 );
+		vst2q_s32((int32_t *)( pbuf + i + 4 ), p1 );
+	}
+#endif
+	return i;
+}
+
+static int S_PaintStereoFrom8SIMD( portable_samplepair_t *pbuf, const int *volume, const byte *pData, int outCount )
+{
+	int	lvol = ( volume[0] >> SND_SCALE_SHIFT ) << SND_SCALE_SHIFT;
+	int	rvol = ( volume[1] >> SND_SCALE_SHIFT ) << SND_SCALE_SHIFT;
+	int	i;
+#if XASH_SIMD_SSE2
+	__m128i	vol = _mm_set1_epi32(( rvol << 16 ) | ( lvol & 0xFFFF ));
+
+	for( i = 0; i + 8 <= outCount; i += 8 )
+	{
+		__m128i s = _mm_loadu_si128((const __m128i *)( pData + i * 2 ));
+
+		S_AddPairs16_SSE2( pbuf + i, _mm_mullo_epi16( S_Unpack8_SSE2( lo, s ), vol ));
+		S_AddPairs16_SSE2( pbuf + i + 4, _mm_mullo_epi16( S_Unpack8_SSE2( hi, s ), vol ));
+	}
+#else
+	for( i = 0; i + 8 <= outCount; i += 8 )
+	{
+		int8x8x2_t s = vld2_s8((const int8_t *)( pData + i * 2 ));
+		int16x8_t l = vmovl_s8( s.val[0] );
+		int16x8_t r = vmovl_s8( s.val[1] );
+		int32x4x2_t p0 = vld2q_s32((int32_t *)( pbuf + i ));
+		int32x4x2_t p1 = vld2q_s32((int32_t *)( pbuf + i + 4 ));
+
+		p0.val[0] = vaddq_s32( p0.val[0], vmull_n_s16( vget_low_s16( l ), lvol ));
+		p0.val[1] = vaddq_s32( p0.val[1], vmull_n_s16( vget_low_s16( r ), rvol ));
+		p1.val[0] = vaddq_s32( p1.val[0], vmull_n_s16( vget_high_s16( l ), lvol ));
+		p1.val[1] = vaddq_s32( p1.val[1], vmull_n_s16( vget_high_s16( r ), rvol ));
+		vst2q_s32((int32_t *)( pbuf + i ), p0 );
+		vst2q_s32((int32_t *)( pbuf + i + 4 ), p1 );
+	}
+#endif
+	return i;
+}
+
+static int S_PaintMonoFrom16SIMD( portable_samplepair_t *pbuf, const int *volume, const short *pData, int outCount )
+{
+	int	i;
+#if XASH_SIMD_SSE2
+	__m128i	vol = _mm_set1_epi32(( volume[1] << 16 ) | ( volume[0] & 0xFFFF ));
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		__m128i s = _mm_loadl_epi64((const __m128i *)( pData + i ));
+
+		S_AddScaledPairs16_SSE2( pbuf + i, _mm_unpacklo_epi16( s, s ), vol );
+	}
+#else
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		int16x4_t s = vld1_s16( pData + i );
+		int32x4x2_t p = vld2q_s32((int32_t *)( pbuf + i ));
+
+		p.val[0] = vaddq_s32( p.val[0], vshrq_n_s32( vmull_n_s16( s, volume[0] ), 8 ));
+		p.val[1] = vaddq_s32( p.val[1], vshrq_n_s32( vmull_n_s16( s, volume[1] ), 8 ));
+		vst2q_s32((int32_t *)( pbuf + i ), p );
+	}
+#endif
+	return i;
+}
+
+static int S_PaintStereoFrom16SIMD( portable_samplepair_t *pbuf, const int *volume, const short *pData, int outCount )
+{
+	int	i;
+#if XASH_SIMD_SSE2
+	__m128i	vol = _mm_set1_epi32(( volume[1] << 16 ) | ( volume[0] & 0xFFFF ));
+
+	for( i = 0; i + 4 <= outCount; i += 4 )
+		S_AddScaledPairs16_SSE2( pbuf + i, _mm_loadu_si128((const __m128i *)( pData + i * 2 )), vol );
+#else
+	for( i = 0; i + 4 <= outCount; i += 4 )
+	{
+		int16x4x2_t s = vld2_s16( pData + i * 2 );
+		int32x4x2_t p = vld2q_s32((int32_t *)( pbuf + i ));
+
+		p.val[0] = vaddq_s32( p.val[0], vshrq_n_s32( vmull_n_s16( s.val[0], volume[0] ), 8 ));
+		p.val[1] = vaddq_s32( p.val[1], vshrq_n_s32( vmull_n_s16( s.val[1], volume[1] ), 8 ));
+		vst2q_s32((int32_t *)( pbuf + i ), p );
+	}
+#endif
+	return i;
+}
+#endif // XASH_SIMD
+
 void S_PaintMonoFrom8( portable_samplepair_t *pbuf, int *volume, byte *pData, int outCount )
 {
 	int	*lscale, *rscale;
-	int 	i, data;
+	int 	i = 0, data;
 
 	lscale = snd_scaletable[volume[0] >> SND_SCALE_SHIFT];
 	rscale = snd_scaletable[volume[1] >> SND_SCALE_SHIFT];
 
-	for( i = 0; i < outCount; i++ )
+#if XASH_SIMD
+	if( s_simd )
+		i = S_PaintMonoFrom8SIMD( pbuf, volume, pData, outCount );
+#endif
+
+	for( ; i < outCount; i++ )
 	{
 		data = pData[i];
 		pbuf[i].left += lscale[data];
@@ -222,13 +404,21 @@ void S_PaintStereoFrom8( portable_samplepair_t *pbuf, int *volume, byte *pData,
 	int	*lscale, *rscale;
 	uint	left, right;
 	word	*data;
-	int	i;
+	int	i = 0;
 
 	lscale = snd_scaletable[volume[0] >> SND_SCALE_SHIFT];
 	rscale = snd_scaletable[volume[1] >> SND_SCALE_SHIFT];
 	data = (word *)pData;
 
-	for( i = 0; i < outCount; i++, data++ )
+#if XASH_SIMD
+	if( s_simd )
+	{
+		i = S_PaintStereoFrom8SIMD( pbuf, volume, pData, outCount );
+		data += i;
+	}
+#endif
+
+	for( ; i < outCount; i++, data++ )
 	{
 		left = (byte)((*data & 0x00FF));
 		right = (byte)((*data & 0xFF00) >> 8);
@@ -240,9 +430,14 @@ void S_PaintStereoFrom8( portable_samplepair_t *pbuf, int *volume, byte *pData,
 void S_PaintMonoFrom16( portable_samplepair_t *pbuf, int *volume, short *pData, int outCount )
 {
 	int	left, right;
-	int	i, data;
+	int	i = 0, data;
 
-	for( i = 0; i < outCount; i++ )
+#if XASH_SIMD
+	if( s_simd )
+		i = S_PaintMonoFrom16SIMD( pbuf, volume, pData, outCount );
+#endif
+
+	for( ; i < outCount; i++ )
 	{
 		data = pData[i];
 		left = ( data * volume[0]) >> 8;
@@ -256,11 +451,19 @@ void S_PaintStereoFrom16( portable_samplepair_t *pbuf, int *volume, short *pData
 {
 	uint	*data;
 	int	left, right;
-	int	i;
+	int	i = 0;
 
 	data = (uint *)pData;
 
-	for( i = 0; i < outCount; i++, data++ )
+#if XASH_SIMD
+	if( s_simd )
+	{
+		i = S_PaintStereoFrom16SIMD( pbuf, volume, pData, outCount );
+		data += i;
+	}
+#endif
+
+	for( ; i < outCount; i++, data++ )
 	{
 		left = (signed short)((*data & 0x0000FFFF));
 		right = (signed short)((*data & 0xFFFF0000) >> 16);
@@ -406,7 +609,8 @@ void S_MixChannel( channel_t *pChannel, void *pData, int outputOffset, int input
 	}
 }
 
-int S_MixDataToDevice( channel_t *pChannel, int sampleCount, int outRate, int outOffset, int timeCompress )
+// virtual channels go through the same steps, so they end exactly where a mixed one would
+static int S_AdvanceChannel( channel_t *pChannel, int sampleCount, int outRate, int outOffset, int timeCompress, qboolean paint )
 {
 	// save this to compute total output
 	int	startingOffset = outOffset;
@@ -445,7 +649,9 @@ int S_MixDataToDevice( channel_t *pChannel, int sampleCount, int outRate, int ou
 		double	end = pChannel->pMixer.sample + rate * sampleCount;
 		int	inputSampleCount = (int)(ceil( end ) - floor( pChannel->pMixer.sample ));
 
-		availableSamples = S_GetOutputData( pSource, &pData, pChannel->pMixer.sample, inputSampleCount, use_loop );
+		if( pChannel->stream )
+			availableSamples = S_GetStreamData( pChannel->stream, &pData, pChannel->pMixer.sample, inputSampleCount );
+		else availableSamples = S_GetOutputData( pSource, &pData, pChannel->pMixer.sample, inputSampleCount, use_loop );
 
 		// none available, bail out
 		if( !availableSamples ) break;
@@ -465,29 +671,33 @@ int S_MixDataToDevice( channel_t *pChannel, int sampleCount, int outRate, int ou
 		// Verify that we won't get a buffer overrun.
 		Assert( floor( sampleFrac + rate * ( outSampleCount - 1 )) <= availableSamples );
 
-		// save current paintbuffer
-		j = MIX_GetCurrentPaintbufferIndex();
-
-		for( i = 0; i < CPAINTBUFFERS; i++ )
+		if( paint )
 		{
-			if( !paintbuffers[i].factive )
-				continue;
+			// save current paintbuffer
+			j = MIX_GetCurrentPaintbufferIndex();
 
-			// mix chan into all active paintbuffers
-			MIX_SetCurrentPaintbuffer( i );
+			for( i = 0; i < CPAINTBUFFERS; i++ )
+			{
+				if( !paintbuffers[i].factive )
+					continue;
 
-			S_MixChannel( pChannel, pData, outOffset, FIX_FLOAT( sampleFrac ), FIX_FLOAT( rate ), outSampleCount, timeCompress );
-		}
+				// mix chan into all active paintbuffers
+				MIX_SetCurrentPaintbuffer( i );
 
-		MIX_SetCurrentPaintbuffer( j );
+				S_MixChannel( pChannel, pData, outOffset, FIX_FLOAT( sampleFrac ), FIX_FLOAT( rate ), outSampleCount, timeCompress );
+			}
+
+			MIX_SetCurrentPaintbuffer( j );
+		}
 
 		pChannel->pMixer.sample += outSampleCount * rate;
 		outOffset += outSampleCount;
 		sampleCount -= outSampleCount;
 	}
 
-	// Did we run out of samples? if so, mark finished
-	if( sampleCount > 0 )
+	// Did we run out of samples? if so, mark finished,
+	// unless decoder is late, then the channel waits for it
+	if( sampleCount > 0 && ( !pChannel->stream || S_SoundStreamFinished( pChannel->stream )))
 	{
 		pChannel->pMixer.finished = true;
 	}
@@ -496,6 +706,11 @@ int S_MixDataToDevice( channel_t *pChannel, int sampleCount, int outRate, int ou
 	return outOffset - startingOffset;
 }
 
+int S_MixDataToDevice( channel_t *pChannel, int sampleCount, int outRate, int outOffset, int timeCompress )
+{
+	return S_AdvanceChannel( pChannel, sampleCount, outRate, outOffset, timeCompress, true );
+}
+
 qboolean S_ShouldContinueMixing( channel_t *ch )
 {
 	if( ch->isSentence )
@@ -508,112 +723,204 @@ qboolean S_ShouldContinueMixing( channel_t *ch )
 	return !ch->pMixer.finished;
 }
 
-// Mix all channels into active paintbuffers until paintbuffer is full or 'endtime' is reached.
-// endtime: time in 44khz samples to mix
-// rate: ignore samples which are not natively at this rate (for multipass mixing/filtering)
-// if rate == SOUND_ALL_RATES then mix all samples this pass
-// flags: if SOUND_MIX_DRY, then mix only samples with channel flagged as 'dry'
-// outputRate: target mix rate for all samples.  Note, if outputRate = SOUND_DMA_SPEED, then
-// this routine will fill the paintbuffer to endtime.  Otherwise, fewer samples are mixed.
-// if( endtime - paintedtime ) is not aligned on boundaries of 4,
-// we'll miss data if outputRate < SOUND_DMA_SPEED!
-void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
+// release mixer copy of the channel, serial is kept so main
+// thread can see it's finished, see S_ReadMixerStatus
+void MIX_FreeChannel( channel_t *ch )
 {
-	channel_t *ch;
-	wavdata_t	*pSource;
-	int	i, sampleCount;
-	qboolean	bZeroVolume;
+	ch->sfx = NULL;
+	ch->name[0] = '\0';
+	ch->use_loop = false;
+	ch->isSentence = false;
+	ch->stream = 0; // closed by main thread copy
+
+	// clear mixer
+	memset( &ch->pMixer, 0, sizeof( ch->pMixer ));
+}
 
-	// mix each channel into paintbuffer
-	ch = channels;
+// louder channels win, channels that player must hear always win
+static int MIX_VoicePriority( const channel_t *ch )
+{
+	int	priority = Q_max( ch->leftvol, ch->rightvol );
 
-	// validate parameters
-	Assert( outputRate <= SOUND_DMA_SPEED );
+	// sentences can't be virtual, VOX must load next words
+	if( ch->isSentence || ch->localsound || ch->entchannel == CHAN_STREAM || ch->entchannel == CHAN_VOICE )
+		priority += VOICE_PRIORITY_BOOST;
+	else if( ch->entnum == snd_mixer.listener.entnum )
+		priority += VOICE_PRIORITY_BOOST;
 
-	// make sure we're not discarding data
-	Assert( !(( endtime - paintedtime ) & 0x3 ) || ( outputRate == SOUND_DMA_SPEED ));
+	return priority;
+}
 
-	// 44k: try to mix this many samples at outputRate
-	sampleCount = ( endtime - paintedtime ) / ( SOUND_DMA_SPEED / outputRate );
+static int MIX_CompareVoices( const void *a, const void *b )
+{
+	const mixvoice_t	*va = (const mixvoice_t *)a;
+	const mixvoice_t	*vb = (const mixvoice_t *)b;
 
-	if( sampleCount <= 0 ) return;
+	if( va->priority != vb->priority )
+		return vb->priority - va->priority;
+
+	// keep channel order for equal priority, so culling doesn't flicker
+	return va->ch - vb->ch;
+}
 
-	for( i = 0; i < total_channels; i++, ch++ )
+// select channels that will be mixed into paintbuffer, in a single pass
+// over all channels, and group them by sample rate of their source.
+// channels are mixed at their native rate, then paintbuffer is upsampled,
+// so all channels of one rate must be mixed before next upsampling pass.
+// channels below GoldSrc audibility threshold and the quietest ones over
+// s_max_voices are virtual: they are advanced without mixing
+static void MIX_SelectChannels( void )
+{
+	const listener_t	*listener;
+	channel_t *ch;
+	wavdata_t	*pSource;
+	int	i, irate, numvoices, maxvoices;
+	qboolean	bZeroVolume;
+
+	for( irate = 0; irate < CMIXRATES; irate++ )
+	{
+		mix_numchannels[irate] = 0;
+		mix_numvirtual[irate] = 0;
+	}
+
+	ch = snd_mixer.channels;
+	listener = &snd_mixer.listener;
+	numvoices = 0;
+
+	for( i = 0; i < snd_mixer.total_channels; i++, ch++ )
 	{
 		if( !ch->sfx ) continue;
 
 		// NOTE: background map is allow both type sounds: menu and game
-		if( !cl.background )
+		if( !listener->background )
 		{
-			if( cls.key_dest == key_console && ch->localsound )
+			if( listener->inconsole && ch->localsound )
 			{
 				// play, playvol
 			}
-			else if(( s_listener.inmenu || s_listener.paused ) && !ch->localsound )
+			else if(( listener->inmenu || listener->paused ) && !ch->localsound )
 			{
 				// play only local sounds, keep pause for other
 				continue;
 			}
-			else if( !s_listener.inmenu && !s_listener.active && !ch->staticsound )
+			else if( !listener->inmenu && !listener->active && !ch->staticsound )
 			{
 				// play only ambient sounds, keep pause for other
 				continue;
 			}
 		}
-		else if( cls.key_dest == key_console )
+		else if( listener->inconsole )
 			continue;	// silent mode in console
 
-		pSource = S_LoadSound( ch->sfx );
-
-		// Don't mix sound data for sounds with zero volume. If it's a non-looping sound,
-		// just remove the sound when its volume goes to zero.
-		bZeroVolume = !ch->leftvol && !ch->rightvol;
+		// sounds are loaded by main thread before channel is started
+		pSource = ch->sfx->cache;
 
-		if( !bZeroVolume )
+		if( !pSource )
 		{
-			// this values matched with GoldSrc
-			if( ch->leftvol < 8 && ch->rightvol < 8 )
-				bZeroVolume = true;
+			MIX_FreeChannel( ch );
+			continue;
 		}
 
-		if( !pSource || ( bZeroVolume && pSource->loopStart == -1 ))
+		// most sounds are resampled to one of the mixing rates on load,
+		// anything else (like 48khz) is mixed at the closest higher rate
+		for( irate = 0; irate < CMIXRATES - 1; irate++ )
 		{
-			if( !pSource )
-			{
-				S_FreeChannel( ch );
-				continue;
-			}
+			if( pSource->rate <= mix_rates[irate] )
+				break;
 		}
-		else if( bZeroVolume )
+
+		// this values matched with GoldSrc
+		bZeroVolume = ch->leftvol < 8 && ch->rightvol < 8;
+
+		if( bZeroVolume && !ch->isSentence )
 		{
+			mix_virtual[irate][mix_numvirtual[irate]++] = ch;
 			continue;
 		}
 
-		// multipass mixing - only mix samples of specified sample rate
-		switch( rate )
-		{
-		case SOUND_11k:
-		case SOUND_22k:
-		case SOUND_44k:
-			if( rate != pSource->rate )
-				continue;
-			break;
-		default:	break;
-		}
+		mix_voices[numvoices].ch = ch;
+		mix_voices[numvoices].priority = MIX_VoicePriority( ch );
+		mix_voices[numvoices].irate = irate;
+		numvoices++;
+	}
 
-		// get playback pitch
-		if( ch->isSentence )
-			ch->pitch = VOX_ModifyPitch( ch, ch->basePitch * 0.01f );
-		else ch->pitch = ch->basePitch * 0.01f;
+	maxvoices = s_max_voices.value > 0 ? (int)s_max_voices.value : numvoices;
 
-		ch->pitch *= ( sys_timescale.value + 1 ) / 2;
+	if( numvoices > maxvoices )
+		qsort( mix_voices, numvoices, sizeof( mix_voices[0] ), MIX_CompareVoices );
 
-		if( CL_GetEntityByIndex( ch->entnum ) && ( ch->entchannel == CHAN_VOICE || ch->entchannel == CHAN_STREAM ))
-		{
-			if( pSource->width == 1 )
-				SND_MoveMouth8( ch, pSource, sampleCount );
-			else SND_MoveMouth16( ch, pSource, sampleCount );
-		}
+	snd_mixer.realvoices = snd_mixer.virtualvoices = 0;
+
+	for( i = 0; i < numvoices; i++ )
+	{
+		ch = mix_voices[i].ch;
+		irate = mix_voices[i].irate;
+
+		if( i < maxvoices || ch->isSentence )
+			mix_channels[irate][mix_numchannels[irate]++] = ch;
+		else mix_virtual[irate][mix_numvirtual[irate]++] = ch;
+	}
+
+	for( irate = 0; irate < CMIXRATES; irate++ )
+	{
+		snd_mixer.realvoices += mix_numchannels[irate];
+		snd_mixer.virtualvoices += mix_numvirtual[irate];
+	}
+}
+
+// talking monsters move their mouths even when they're too far to be heard,
+// main thread copies it to the entity, see S_ReadMixerStatus
+static void MIX_MoveMouth( channel_t *ch, wavdata_t *pSource, int sampleCount )
+{
+	if( ch->entnum > 0 && ( ch->entchannel == CHAN_VOICE || ch->entchannel == CHAN_STREAM ))
+	{
+		if( pSource->width == 1 )
+			SND_MoveMouth8( ch, pSource, sampleCount );
+		else SND_MoveMouth16( ch, pSource, sampleCount );
+	}
+}
+
+// get playback pitch
+static void MIX_UpdatePitch( channel_t *ch )
+{
+	if( ch->isSentence )
+		ch->pitch = VOX_ModifyPitch( ch, ch->basePitch * 0.01f );
+	else ch->pitch = ch->basePitch * 0.01f;
+
+	ch->pitch *= ( sys_timescale.value + 1 ) / 2;
+}
+
+// Mix selected channels of one rate into active paintbuffers until paintbuffer is full or 'endtime' is reached.
+// endtime: time in 44khz samples to mix
+// irate: index of the channel group in mix_rates
+// outputRate: target mix rate for all samples.  Note, if outputRate = SOUND_DMA_SPEED, then
+// this routine will fill the paintbuffer to endtime.  Otherwise, fewer samples are mixed.
+// if( endtime - paintedtime ) is not aligned on boundaries of 4,
+// we'll miss data if outputRate < SOUND_DMA_SPEED!
+static void MIX_MixChannelsToPaintbuffer( int endtime, int irate, int outputRate )
+{
+	channel_t *ch;
+	wavdata_t	*pSource;
+	int	i, sampleCount;
+
+	// validate parameters
+	Assert( outputRate <= SOUND_DMA_SPEED );
+
+	// make sure we're not discarding data
+	Assert( !(( endtime - paintedtime ) & 0x3 ) || ( outputRate == SOUND_DMA_SPEED ));
+
+	// 44k: try to mix this many samples at outputRate
+	sampleCount = ( endtime - paintedtime ) / ( SOUND_DMA_SPEED / outputRate );
+
+	if( sampleCount <= 0 ) return;
+
+	for( i = 0; i < mix_numchannels[irate]; i++ )
+	{
+		ch = mix_channels[irate][i];
+		pSource = ch->sfx->cache;
+
+		MIX_UpdatePitch( ch );
+		MIX_MoveMouth( ch, pSource, sampleCount );
 
 		// mix channel to all active paintbuffers.
 		// NOTE: must be called once per channel only - consecutive calls retrieve additional data.
@@ -623,7 +930,24 @@ void MIX_MixChannelsToPaintbuffer( int endtime, int rate, int outputRate )
 
 		if( !S_ShouldContinueMixing( ch ))
 		{
-			S_FreeChannel( ch );
+			MIX_FreeChannel( ch );
+		}
+	}
+
+	// virtual channels keep playing, just nothing is painted
+	for( i = 0; i < mix_numvirtual[irate]; i++ )
+	{
+		ch = mix_virtual[irate][i];
+		pSource = ch->sfx->cache;
+
+		MIX_UpdatePitch( ch );
+		MIX_MoveMouth( ch, pSource, sampleCount );
+
+		S_AdvanceChannel( ch, sampleCount, outputRate, 0, 0, false );
+
+		if( !S_ShouldContinueMixing( ch ))
+		{
+			MIX_FreeChannel( ch );
 		}
 	}
 }
@@ -871,14 +1195,24 @@ void MIX_CompressPaintbuffer( int ipaint, int count )
 	}
 }
 
-void S_MixUpsample( int sampleCount, int filtertype )
+// silent: nothing was mixed into paintbuffer yet
+void S_MixUpsample( int sampleCount, int filtertype, qboolean silent )
 {
 	paintbuffer_t	*ppaint = MIX_GetCurrentPaintbufferPtr();
 	int		ifilter = ppaint->ifilter;
+	int		i;
 
 	Assert( ifilter < CPAINTFILTERS );
 
-	S_MixBufferUpsample2x( sampleCount, ppaint->pbuf, &(ppaint->fltmem[ifilter][0]), CPAINTFILTERMEM, filtertype );
+	// upsampled silence is silence, as long as filter has no tail from previous paint
+	for( i = 0; silent && i < CPAINTFILTERMEM; i++ )
+	{
+		if( ppaint->fltmem[ifilter][i].left || ppaint->fltmem[ifilter][i].right )
+			silent = false;
+	}
+
+	if( !silent )
+		S_MixBufferUpsample2x( sampleCount, ppaint->pbuf, &(ppaint->fltmem[ifilter][0]), CPAINTFILTERMEM, filtertype );
 
 	// make sure on next upsample pass for this paintbuffer, new filter memory is used
 	ppaint->ifilter++;
@@ -892,14 +1226,13 @@ void MIX_MixRawSamplesBuffer( int end )
 	roombuf = MIX_GetPFrontFromIPaint( IROOMBUFFER );
 	streambuf = MIX_GetPFrontFromIPaint( ISTREAMBUFFER );
 
-	if( s_listener.paused ) return;
+	if( snd_mixer.listener.paused ) return;
 
 	// paint in the raw channels
 	for( i = 0; i < MAX_RAW_CHANNELS; i++ )
 	{
 		// copy from the streaming sound source
 		rawchan_t *ch = raw_channels[i];
-		qboolean stream;
 
 		if( !ch )
 			continue;
@@ -908,9 +1241,9 @@ void MIX_MixRawSamplesBuffer( int end )
 		if( !ch->leftvol && !ch->rightvol )
 			continue;
 
-		stream = ch->entnum == S_RAW_SOUND_BACKGROUNDTRACK || CL_IsPlayerIndex( ch->entnum );
-		pbuf = stream ? streambuf : roombuf;
+		pbuf = ch->stream ? streambuf : roombuf;
 
+		// main thread writes samples with mixer lock held
 		stop = (end < ch->s_rawend) ? end : ch->s_rawend;
 
 		for( j = paintedtime; j < stop; j++ )
@@ -947,27 +1280,30 @@ void MIX_UpsampleAllPaintbuffers( int end, int count )
 	// only mix to roombuffer if dsp fx are on KDB: perf
 	MIX_ActivatePaintbuffer( IROOMBUFFER );	// operates on MIX_MixChannelsToPaintbuffer
 
+	// sort out channels once for all passes
+	MIX_SelectChannels();
+
 	// mix 11khz sounds:
-	MIX_MixChannelsToPaintbuffer( end, SOUND_11k, SOUND_11k );
+	MIX_MixChannelsToPaintbuffer( end, 0, SOUND_11k );
 
 #if SOUND_DMA_SPEED >= SOUND_22k
 	// upsample all 11khz buffers by 2x
 	// only upsample roombuffer if dsp fx are on KDB: perf
 	MIX_SetCurrentPaintbuffer( IROOMBUFFER ); // operates on MixUpSample
-	S_MixUpsample( count / ( SOUND_DMA_SPEED / SOUND_11k ), s_lerping.value );
+	S_MixUpsample( count / ( SOUND_DMA_SPEED / SOUND_11k ), s_lerping.value, !mix_numchannels[0] );
 
 	// mix 22khz sounds:
-	MIX_MixChannelsToPaintbuffer( end, SOUND_22k, SOUND_22k );
+	MIX_MixChannelsToPaintbuffer( end, 1, SOUND_22k );
 #endif
 
 #if SOUND_DMA_SPEED >= SOUND_44k
 	// upsample all 22khz buffers by 2x
 	// only upsample roombuffer if dsp fx are on KDB: perf
 	MIX_SetCurrentPaintbuffer( IROOMBUFFER );
-	S_MixUpsample( count / ( SOUND_DMA_SPEED / SOUND_22k ), s_lerping.value );
+	S_MixUpsample( count / ( SOUND_DMA_SPEED / SOUND_22k ), s_lerping.value, !mix_numchannels[0] && !mix_numchannels[1] );
 
 	// mix all 44khz sounds to all active paintbuffers
-	MIX_MixChannelsToPaintbuffer( end, SOUND_44k, SOUND_DMA_SPEED );
+	MIX_MixChannelsToPaintbuffer( end, 2, SOUND_DMA_SPEED );
 #endif
 
 	// mix raw samples from the video streams
@@ -981,8 +1317,6 @@ void MIX_PaintChannels( int endtime )
 {
 	int	end, count;
 
-	CheckNewDspPresets();
-
 	while( paintedtime < endtime )
 	{
 		// if paintbuffer is smaller than DMA buffer
@@ -1002,10 +1336,10 @@ void MIX_PaintChannels( int endtime )
 		DSP_Process( idsp_room, MIX_GetPFrontFromIPaint( IROOMBUFFER ), count );
 
 		// add music or soundtrack from movie (no dsp)
-		MIX_MixPaintbuffers( IPAINTBUFFER, IROOMBUFFER, IPAINTBUFFER, count, S_GetMasterVolume() );
+		MIX_MixPaintbuffers( IPAINTBUFFER, IROOMBUFFER, IPAINTBUFFER, count, snd_mixer.mastervol );
 
 		// add music or soundtrack from movie (no dsp)
-		MIX_MixPaintbuffers( IPAINTBUFFER, ISTREAMBUFFER, IPAINTBUFFER, count, S_GetMusicVolume() );
+		MIX_MixPaintbuffers( IPAINTBUFFER, ISTREAMBUFFER, IPAINTBUFFER, count, snd_mixer.musicvol );
 
 		// clip all values > 16 bit down to 16 bit
 		MIX_CompressPaintbuffer( IPAINTBUFFER, count );
@@ -1018,3 +1352,153 @@ void MIX_PaintChannels( int endtime )
 		paintedtime = end;
 	}
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_MIX_SAMPLES	4096
+
+static void Test_RunPaintKernel( int kernel, portable_samplepair_t *pbuf, int *volume, void *data, int count )
+{
+	switch( kernel )
+	{
+	case 0: S_PaintMonoFrom8( pbuf, volume, data, count ); break;
+	case 1: S_PaintStereoFrom8( pbuf, volume, data, count ); break;
+	case 2: S_PaintMonoFrom16( pbuf, volume, data, count ); break;
+	case 3: S_PaintStereoFrom16( pbuf, volume, data, count ); break;
+	}
+}
+
+/*
+compare vectorized paint kernels with plain C versions bit for bit,
+with 'iterations' set prints how long both of them took
+*/
+static void Test_PaintKernel( int kernel, int *volume, void *data, int count, int iterations )
+{
+	const char *names[] = { "S_PaintMonoFrom8", "S_PaintStereoFrom8", "S_PaintMonoFrom16", "S_PaintStereoFrom16" };
+	qboolean oldsimd = s_simd;
+	portable_samplepair_t *result[2];
+	double time[2];
+	int i, j;
+
+	for( i = 0; i < 2; i++ )
+	{
+		// leave one extra pair to catch writes past the end
+		result[i] = Z_Malloc(( count + 1 ) * sizeof( portable_samplepair_t ));
+
+		for( j = 0; j <= count; j++ )
+		{
+			result[i][j].left = ( j * 7919 ) % 70001 - 35000;
+			result[i][j].right = 35000 - ( j * 104729 ) % 70001;
+		}
+
+		s_simd = i;
+		time[i] = Sys_DoubleTime();
+
+		for( j = 0; j < ( iterations ? iterations : 1 ); j++ )
+			Test_RunPaintKernel( kernel, result[i], volume, data, count );
+
+		time[i] = Sys_DoubleTime() - time[i];
+	}
+
+	s_simd = oldsimd;
+
+	_TASSERT( memcmp( result[0], result[1], ( count + 1 ) * sizeof( portable_samplepair_t )), Msg( S_ERROR "%s: vectorized output differs (%d samples, volume %d %d)\n", names[kernel], count, volume[0], volume[1] ))
+
+	if( iterations )
+		Con_Printf( "%s %d samples: %.2f us plain, %.2f us vectorized\n", names[kernel], count, time[0] * 1000000.0 / iterations, time[1] * 1000000.0 / iterations );
+
+	Z_Free( result[0] );
+	Z_Free( result[1] );
+}
+
+static void Test_PaintKernels( void )
+{
+	const int volumes[][2] =
+	{
+	{ 0, 0 },
+	{ 1, 0 },
+	{ 7, 128 },
+	{ 255, 255 },
+	{ 128, 3 },
+	{ 254, 31 },
+	};
+	byte *data = Z_Malloc( TEST_MIX_SAMPLES * 4 );
+	int volume[2];
+	int i, j, count;
+
+	for( i = 0; i < TEST_MIX_SAMPLES * 4; i++ )
+		data[i] = COM_RandomLong( 0, 255 );
+
+	// extremes must be scaled the same way
+	data[0] = 0x80;
+	data[1] = 0x7f;
+	data[2] = 0x00;
+	data[3] = 0x80;
+
+	S_InitScaletable();
+
+	for( i = 0; i < 4; i++ )
+	{
+		for( j = 0; j < ARRAYSIZE( volumes ); j++ )
+		{
+			volume[0] = volumes[j][0];
+			volume[1] = volumes[j][1];
+
+			for( count = 0; count < 38; count++ )
+				Test_PaintKernel( i, volume, data, count, 0 );
+
+			// misaligned 8-bit source
+			if( i < 2 )
+				Test_PaintKernel( i, volume, data + 1, 37, 0 );
+		}
+
+		volume[0] = 200;
+		volume[1] = 100;
+		Test_PaintKernel( i, volume, data, TEST_MIX_SAMPLES, 1000 );
+	}
+
+	Z_Free( data );
+}
+
+static void Test_VoicePriority( void )
+{
+	channel_t		*ch = snd_mixer.channels;
+	mixvoice_t	voices[4];
+	int		i;
+
+	memset( ch, 0, sizeof( *ch ) * 4 );
+	snd_mixer.listener.entnum = 1;
+
+	ch[0].leftvol = 200; ch[0].rightvol = 40; ch[0].entnum = 5;
+	ch[1].leftvol = 10; ch[1].rightvol = 10; ch[1].localsound = true;
+	ch[2].leftvol = 100; ch[2].rightvol = 100; ch[2].entnum = 7;
+	ch[3].leftvol = 100; ch[3].rightvol = 100; ch[3].entnum = 6;
+
+	for( i = 0; i < 4; i++ )
+	{
+		voices[i].ch = &ch[3 - i];
+		voices[i].priority = MIX_VoicePriority( voices[i].ch );
+	}
+
+	TASSERT_EQi( MIX_VoicePriority( &ch[0] ), 200 );
+	TASSERT_EQi( MIX_VoicePriority( &ch[1] ), VOICE_PRIORITY_BOOST + 10 );
+
+	qsort( voices, 4, sizeof( voices[0] ), MIX_CompareVoices );
+
+	// local sound first, then loudest, equal ones in channel order
+	TASSERT( voices[0].ch == &ch[1] );
+	TASSERT( voices[1].ch == &ch[0] );
+	TASSERT( voices[2].ch == &ch[2] );
+	TASSERT( voices[3].ch == &ch[3] );
+
+	memset( ch, 0, sizeof( *ch ) * 4 );
+	snd_mixer.listener.entnum = 0;
+}
+
+void Test_RunSoundMix( void )
+{
+	TRUN( Test_PaintKernels() );
+	TRUN( Test_VoicePriority() );
+}
+#endif /* XASH_ENGINE_TESTS */
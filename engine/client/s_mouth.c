@@ -38,18 +38,12 @@ void SND_CloseMouth( channel_t *ch )
 
 void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count )
 {
-	cl_entity_t	*clientEntity;
 	signed char		*pdata = NULL;
-	mouth_t		*pMouth = NULL;
+	mouth_t		*pMouth = &ch->mouth; // mixer thread can't touch entities
 	int		scount, pos = 0;
 	int		savg, data;
 	uint 		i;
 
-	clientEntity = CL_GetEntityByIndex( ch->entnum );
-	if( !clientEntity ) return;
-
-	pMouth = &clientEntity->mouth;
-
 	if( ch->isSentence )
 	{
 		if( ch->currentWord )
@@ -57,7 +51,9 @@ void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count )
 	}
 	else pos = ch->pMixer.sample;
 
-	count = S_GetOutputData( pSource, (void**)&pdata, pos, count, ch->use_loop );
+	if( ch->stream )
+		count = S_GetStreamData( ch->stream, (void**)&pdata, pos, count );
+	else count = S_GetOutputData( pSource, (void**)&pdata, pos, count, ch->use_loop );
 	if( pdata == NULL ) return;
 
 	i = 0;
@@ -86,18 +82,12 @@ void SND_MoveMouth8( channel_t *ch, wavdata_t *pSource, int count )
 
 void SND_MoveMouth16( channel_t *ch, wavdata_t *pSource, int count )
 {
-	cl_entity_t	*clientEntity;
 	short		*pdata = NULL;
-	mouth_t		*pMouth = NULL;
+	mouth_t		*pMouth = &ch->mouth;
 	int		savg, data;
 	int		scount, pos = 0;
 	uint 		i;
 
-	clientEntity = CL_GetEntityByIndex( ch->entnum );
-	if( !clientEntity ) return;
-
-	pMouth = &clientEntity->mouth;
-
 	if( ch->isSentence )
 	{
 		if( ch->currentWord )
@@ -105,7 +95,9 @@ void SND_MoveMouth16( channel_t *ch, wavdata_t *pSource, int count )
 	}
 	else pos = ch->pMixer.sample;
 
-	count = S_GetOutputData( pSource, (void**)&pdata, pos, count, ch->use_loop );
+	if( ch->stream )
+		count = S_GetStreamData( ch->stream, (void**)&pdata, pos, count );
+	else count = S_GetOutputData( pSource, (void**)&pdata, pos, count, ch->use_loop );
 	if( pdata == NULL ) return;
 
 	i = 0;
@@ -157,19 +149,23 @@ void SND_ForceCloseMouth( int entnum )
 		clientEntity->mouth.mouthopen = 0;
 }
 
+void SND_SetMouthOpen( int entnum, byte mouthopen )
+{
+	cl_entity_t *clientEntity;
+
+	clientEntity = CL_GetEntityByIndex( entnum );
+
+	if( clientEntity )
+		clientEntity->mouth.mouthopen = mouthopen;
+}
+
 void SND_MoveMouthRaw( rawchan_t *ch, portable_samplepair_t *pData, int count )
 {
-	cl_entity_t	*clientEntity;
-	mouth_t		*pMouth = NULL;
+	mouth_t		*pMouth = &ch->mouth;
 	int		savg, data;
 	int		scount = 0;
 	uint 		i;
 
-	clientEntity = CL_GetEntityByIndex( ch->entnum );
-	if( !clientEntity ) return;
-
-	pMouth = &clientEntity->mouth;
-
 	if( pData == NULL )
 		return;
 
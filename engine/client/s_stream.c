@@ -94,17 +94,11 @@ void S_StartBackgroundTrack( const char *introTrack, const char *mainTrack, int
 		s_bgTrack.loopName[0] = '\0';
 	else Q_strncpy( s_bgTrack.loopName, mainTrack, sizeof( s_bgTrack.loopName ));
 
-	// open stream
-	s_bgTrack.stream = FS_OpenStream( introTrack );
+	// open stream, restore message also sets song position
+	s_bgTrack.stream = S_OpenSoundStream( introTrack, position, false );
 	Q_strncpy( s_bgTrack.current, introTrack, sizeof( s_bgTrack.current ));
 	memset( &musicfade, 0, sizeof( musicfade )); // clear any soundfade
 	s_bgTrack.source = cls.key_dest;
-
-	if( position != 0 )
-	{
-		// restore message, update song position
-		FS_SetStreamPos( s_bgTrack.stream, position );
-	}
 }
 
 /*
@@ -119,7 +113,7 @@ void S_StopBackgroundTrack( void )
 	if( !dma.initialized ) return;
 	if( !s_bgTrack.stream ) return;
 
-	FS_FreeStream( s_bgTrack.stream );
+	S_CloseSoundStream( s_bgTrack.stream );
 	memset( &s_bgTrack, 0, sizeof( bg_track_t ));
 	memset( &musicfade, 0, sizeof( musicfade ));
 }
@@ -161,7 +155,7 @@ qboolean S_StreamGetCurrentState( char *currentTrack, char *loopTrack, int *posi
 	}
 
 	if( position )
-		*position = FS_GetStreamPos( s_bgTrack.stream );
+		*position = S_SoundStreamPosition( s_bgTrack.stream );
 
 	return true;
 }
@@ -169,6 +163,8 @@ qboolean S_StreamGetCurrentState( char *currentTrack, char *loopTrack, int *posi
 /*
 =================
 S_StreamBackgroundTrack
+
+track is decoded by decoder thread, see s_decode.c
 =================
 */
 void S_StreamBackgroundTrack( void )
@@ -200,14 +196,11 @@ void S_StreamBackgroundTrack( void )
 	Assert( ch != NULL );
 
 	// see how many samples should be copied into the raw buffer
-	if( ch->s_rawend < soundtime )
-		ch->s_rawend = soundtime;
-
-	while( ch->s_rawend < soundtime + ch->max_samples )
+	while(( bufferSamples = S_RawChannelSpace( ch )) > 0 )
 	{
-		wavdata_t	*info = FS_StreamInfo( s_bgTrack.stream );
+		const wavdata_t	*info = S_SoundStreamInfo( s_bgTrack.stream );
 
-		bufferSamples = ch->max_samples - (ch->s_rawend - soundtime);
+		if( !info ) return;
 
 		// decide how much data needs to be read from the file
 		fileSamples = bufferSamples * ((float)info->rate / SOUND_DMA_SPEED );
@@ -223,7 +216,7 @@ void S_StreamBackgroundTrack( void )
 		}
 
 		// read
-		r = FS_ReadStream( s_bgTrack.stream, fileBytes, raw );
+		r = S_ReadSoundStream( s_bgTrack.stream, raw, fileBytes );
 
 		if( r < fileBytes )
 		{
@@ -236,13 +229,18 @@ void S_StreamBackgroundTrack( void )
 			// add to raw buffer
 			S_RawSamples( fileSamples, info->rate, info->width, info->channels, raw, S_RAW_SOUND_BACKGROUNDTRACK );
 		}
+		else if( !S_SoundStreamFinished( s_bgTrack.stream ))
+		{
+			// decoder is late, try next frame
+			return;
+		}
 		else
 		{
 			// loop
 			if( s_bgTrack.loopName[0] )
 			{
-				FS_FreeStream( s_bgTrack.stream );
-				s_bgTrack.stream = FS_OpenStream( s_bgTrack.loopName );
+				S_CloseSoundStream( s_bgTrack.stream );
+				s_bgTrack.stream = S_OpenSoundStream( s_bgTrack.loopName, 0, false );
 				Q_strncpy( s_bgTrack.current, s_bgTrack.loopName, sizeof( s_bgTrack.current ));
 
 				if( !s_bgTrack.stream ) return;
@@ -301,17 +299,12 @@ void S_StreamSoundTrack( void )
 	Assert( ch != NULL );
 
 	// see how many samples should be copied into the raw buffer
-	if( ch->s_rawend < soundtime )
-		ch->s_rawend = soundtime;
-
-	while( ch->s_rawend < soundtime + ch->max_samples )
+	while(( bufferSamples = S_RawChannelSpace( ch )) > 0 )
 	{
 		wavdata_t	*info = SCR_GetMovieInfo();
 
 		if( !info ) break;	// bad soundtrack?
 
-		bufferSamples = ch->max_samples - (ch->s_rawend - soundtime);
-
 		// decide how much data needs to be read from the file
 		fileSamples = bufferSamples * ((float)info->rate / SOUND_DMA_SPEED );
 		if( fileSamples <= 1 ) return; // no more samples need
@@ -0,0 +1,501 @@
+/*
+s_thread.c - sound mixer thread
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "sound.h"
+
+/*
+==============================================================
+
+Game code works with channels[] and s_listener on main thread,
+mixer has its own copy of them in snd_mixer. Once per frame the
+main thread compares channels with what it sent before and puts
+the changes into a command queue, mixer thread applies them
+before mixing. Mixer runs on its own timer, so long frames don't
+make it skip.
+
+Mixer reports playback positions back through a triple buffer,
+main thread copies them into channels[] at start of the frame.
+Every start of a channel gets a new serial, so stale reports for
+a channel that was restarted in meantime are ignored.
+
+Mixer lock is held by the mixer thread while mixing, main thread
+takes it for anything that frees memory mixer may be reading:
+sounds, raw channels, DSP buffers. Raw channels are not copied,
+main thread writes their samples and reads paintedtime and
+soundtime only with the lock held. Mixer never touches client
+entities, mouth movement goes back with the channel status.
+Without threads mixing runs on the main thread after the
+commands are queued.
+==============================================================
+*/
+
+#define SND_QUEUE_SIZE	(256 * 1024)
+#define SND_MIXER_MSEC	5	// mixer wakes up at least that often
+#define SND_STATUS_FRESH	4	// set in status_middle when mixer published new status
+
+typedef enum
+{
+	SND_CMD_START = 0,	// channel_t, words are only sent for sentences
+	SND_CMD_STOP,
+	SND_CMD_UPDATE,	// sndupdate_t
+	SND_CMD_LISTENER,	// sndlistener_t
+} sndcmdtype_t;
+
+typedef struct
+{
+	int		type;
+	int		index;		// channel number
+	int		len;		// payload length
+} sndcmd_t;
+
+typedef struct
+{
+	int		leftvol;
+	int		rightvol;
+	int		basePitch;
+} sndupdate_t;
+
+typedef struct
+{
+	listener_t	listener;
+	float		mastervol;
+	float		musicvol;
+	int		total_channels;
+} sndlistener_t;
+
+typedef struct
+{
+	uint		serial;		// zero if nothing was sent
+	sndupdate_t	update;
+} sndsent_t;
+
+typedef struct
+{
+	uint		serial;
+	sfx_t		*sfx;		// NULL if mixer has freed the channel
+	int		wordIndex;
+	qboolean		inword;		// currentWord is set
+	byte		mouthopen;
+	mixer_t		pMixer;
+} sndstatus_t;
+
+sndmixer_t	snd_mixer;
+
+static struct
+{
+	sys_mutex_t	*lock;
+	sys_sem_t		*wakeup;
+	sys_thread_t	*thread;
+	int		shutdown;		// atomic
+	ringbuffer_t	queue;		// main thread -> mixer
+	int		stalls;		// queue was full, main thread had to run commands itself
+
+	// main thread only
+	sndsent_t		sent[MAX_CHANNELS];
+	int		sent_total;
+	int		status_front;
+
+	// mixer thread only
+	int		status_back;
+
+	// mixer thread -> main thread
+	int		status_middle;	// atomic
+	sndstatus_t	status[3][MAX_CHANNELS];
+	int		status_total[3];
+} snd_thread;
+
+/*
+=================
+S_RunCommands
+
+mixer side of the queue, called with mixer lock held
+=================
+*/
+static void S_RunCommands( void )
+{
+	byte	payload[sizeof( channel_t )];
+	sndcmd_t	cmd;
+
+	if( !snd_thread.queue.data )
+		return;
+
+	// writer puts command with payload in one go, so it's all here
+	while( Ring_Read( &snd_thread.queue, &cmd, sizeof( cmd )) == sizeof( cmd ))
+	{
+		channel_t	*ch = &snd_mixer.channels[cmd.index];
+
+		if( cmd.len > 0 )
+			Ring_Read( &snd_thread.queue, payload, cmd.len );
+
+		switch( cmd.type )
+		{
+		case SND_CMD_START:
+			memcpy( ch, payload, cmd.len );
+
+			// pointed to the main thread copy
+			if( ch->currentWord )
+				ch->currentWord = &ch->pMixer;
+
+			memset( &ch->mouth, 0, sizeof( ch->mouth ));
+
+			snd_mixer.total_channels = Q_max( snd_mixer.total_channels, cmd.index + 1 );
+			break;
+		case SND_CMD_STOP:
+			if( ch->sfx ) MIX_FreeChannel( ch );
+			break;
+		case SND_CMD_UPDATE:
+			{
+				const sndupdate_t *update = (const sndupdate_t *)payload;
+
+				ch->leftvol = update->leftvol;
+				ch->rightvol = update->rightvol;
+				ch->basePitch = update->basePitch;
+			}
+			break;
+		case SND_CMD_LISTENER:
+			{
+				const sndlistener_t *listener = (const sndlistener_t *)payload;
+
+				snd_mixer.listener = listener->listener;
+				snd_mixer.mastervol = listener->mastervol;
+				snd_mixer.musicvol = listener->musicvol;
+				snd_mixer.total_channels = listener->total_channels;
+			}
+			break;
+		}
+	}
+}
+
+/*
+=================
+S_PushCommand
+
+main thread side of the queue
+=================
+*/
+static void S_PushCommand( int type, int index, const void *data, int len )
+{
+	byte	buf[sizeof( sndcmd_t ) + sizeof( channel_t )];
+	sndcmd_t	*cmd = (sndcmd_t *)buf;
+
+	cmd->type = type;
+	cmd->index = index;
+	cmd->len = len;
+
+	if( len > 0 )
+		memcpy( buf + sizeof( *cmd ), data, len );
+
+	if( Ring_Write( &snd_thread.queue, buf, sizeof( *cmd ) + len ))
+		return;
+
+	// mixer is far behind, locking it empties the queue
+	snd_thread.stalls++;
+	S_LockMixer();
+	Ring_Write( &snd_thread.queue, buf, sizeof( *cmd ) + len );
+	S_UnlockMixer();
+}
+
+/*
+=================
+S_PublishStatus
+
+mixer thread reports channel positions
+=================
+*/
+static void S_PublishStatus( void )
+{
+	int		back = snd_thread.status_back;
+	sndstatus_t	*st = snd_thread.status[back];
+	channel_t		*ch = snd_mixer.channels;
+	int		i;
+
+	for( i = 0; i < snd_mixer.total_channels; i++, ch++, st++ )
+	{
+		st->serial = ch->serial;
+		st->sfx = ch->sfx;
+		st->wordIndex = ch->wordIndex;
+		st->inword = ch->currentWord != NULL;
+		st->mouthopen = ch->mouth.mouthopen;
+		st->pMixer = ch->pMixer;
+	}
+
+	snd_thread.status_total[back] = snd_mixer.total_channels;
+	snd_thread.status_back = Sys_AtomicExchange( &snd_thread.status_middle, back | SND_STATUS_FRESH ) & ~SND_STATUS_FRESH;
+}
+
+/*
+=================
+S_MixerFrame
+
+=================
+*/
+static void S_MixerFrame( void )
+{
+	Sys_LockMutex( snd_thread.lock );
+	S_RunCommands();
+	S_UpdateChannels();
+	S_PublishStatus();
+	Sys_UnlockMutex( snd_thread.lock );
+}
+
+/*
+=================
+S_MixerThread
+
+=================
+*/
+static void S_MixerThread( void *data )
+{
+	while( !Sys_AtomicLoad( &snd_thread.shutdown ))
+	{
+		Sys_SemaphoreTimedWait( snd_thread.wakeup, SND_MIXER_MSEC );
+		S_MixerFrame();
+	}
+}
+
+/*
+=================
+S_ReadMixerStatus
+
+apply last mixer report to the main thread channels
+=================
+*/
+void S_ReadMixerStatus( void )
+{
+	const sndstatus_t	*st;
+	channel_t		*ch;
+	int		i, total;
+
+	if( !( Sys_AtomicLoad( &snd_thread.status_middle ) & SND_STATUS_FRESH ))
+		return;
+
+	snd_thread.status_front = Sys_AtomicExchange( &snd_thread.status_middle, snd_thread.status_front ) & ~SND_STATUS_FRESH;
+	st = snd_thread.status[snd_thread.status_front];
+	total = Q_min( snd_thread.status_total[snd_thread.status_front], total_channels );
+
+	for( i = 0, ch = channels; i < total; i++, ch++, st++ )
+	{
+		if( !ch->sfx || ch->serial != st->serial )
+			continue; // restarted or stopped since then
+
+		if( !st->sfx )
+		{
+			// finished playing, nothing to tell the mixer
+			S_FreeChannel( ch );
+			snd_thread.sent[i].serial = 0;
+			continue;
+		}
+
+		if( ch->isSentence )
+			ch->sfx = st->sfx;
+
+		ch->wordIndex = st->wordIndex;
+		ch->currentWord = st->inword ? &ch->pMixer : NULL;
+		ch->pMixer = st->pMixer;
+
+		if( ch->entnum > 0 && ( ch->entchannel == CHAN_VOICE || ch->entchannel == CHAN_STREAM ))
+			SND_SetMouthOpen( ch->entnum, st->mouthopen );
+	}
+}
+
+/*
+=================
+S_SyncMixer
+
+queue everything that changed since last frame
+=================
+*/
+void S_SyncMixer( void )
+{
+	sndlistener_t	listener;
+	channel_t		*ch;
+	sndsent_t		*sent;
+	int		i, total;
+
+	total = Q_max( total_channels, snd_thread.sent_total );
+
+	for( i = 0, ch = channels, sent = snd_thread.sent; i < total; i++, ch++, sent++ )
+	{
+		if( !ch->sfx )
+		{
+			if( sent->serial )
+				S_PushCommand( SND_CMD_STOP, i, NULL, 0 );
+			sent->serial = 0;
+			continue;
+		}
+
+		if( ch->serial == sent->serial && ch->leftvol == sent->update.leftvol
+			&& ch->rightvol == sent->update.rightvol && ch->basePitch == sent->update.basePitch )
+			continue;
+
+		sent->update.leftvol = ch->leftvol;
+		sent->update.rightvol = ch->rightvol;
+		sent->update.basePitch = ch->basePitch;
+
+		if( ch->serial != sent->serial )
+		{
+			// there are no words in regular sounds
+			S_PushCommand( SND_CMD_START, i, ch, ch->isSentence ? sizeof( *ch ) : offsetof( channel_t, words ));
+			sent->serial = ch->serial;
+		}
+		else S_PushCommand( SND_CMD_UPDATE, i, &sent->update, sizeof( sent->update ));
+	}
+
+	snd_thread.sent_total = total_channels;
+
+	listener.listener = s_listener;
+	listener.mastervol = S_GetMasterVolume();
+	listener.musicvol = S_GetMusicVolume();
+	listener.total_channels = total_channels;
+	S_PushCommand( SND_CMD_LISTENER, 0, &listener, sizeof( listener ));
+
+	if( snd_thread.thread )
+		Sys_SemaphorePost( snd_thread.wakeup );
+	else S_MixerFrame();
+}
+
+/*
+=================
+S_ClearMixer
+
+drop all channels on both sides, used by S_StopAllSounds
+=================
+*/
+void S_ClearMixer( void )
+{
+	S_LockMixer();
+
+	// serials are never reused, so old status records can't match anything
+	memset( snd_mixer.channels, 0, sizeof( snd_mixer.channels ));
+	memset( snd_thread.sent, 0, sizeof( snd_thread.sent ));
+	snd_mixer.total_channels = total_channels;
+	snd_thread.sent_total = total_channels;
+
+	S_UnlockMixer();
+}
+
+/*
+=================
+S_LockMixer
+
+waits until the mixer is done with current portion, when
+locked the mixer copy is up to date with the command queue
+=================
+*/
+void S_LockMixer( void )
+{
+	if( !snd_thread.lock )
+		return;
+
+	Sys_LockMutex( snd_thread.lock );
+	S_RunCommands();
+}
+
+/*
+=================
+S_UnlockMixer
+
+=================
+*/
+void S_UnlockMixer( void )
+{
+	if( !snd_thread.lock )
+		return;
+
+	Sys_UnlockMutex( snd_thread.lock );
+}
+
+/*
+=================
+S_MixerExtraUpdate
+
+mixer thread doesn't need any help to keep up
+=================
+*/
+void S_MixerExtraUpdate( void )
+{
+	if( snd_thread.thread || !snd_thread.lock )
+		return;
+
+	S_MixerFrame();
+}
+
+/*
+=================
+S_MixerThreaded
+
+=================
+*/
+qboolean S_MixerThreaded( void )
+{
+	return snd_thread.thread != NULL;
+}
+
+/*
+=================
+S_InitMixer
+
+=================
+*/
+void S_InitMixer( void )
+{
+	snd_thread.lock = Sys_CreateMutex();
+	snd_thread.wakeup = Sys_CreateSemaphore( 0 );
+	snd_thread.shutdown = 0;
+	snd_thread.stalls = 0;
+	snd_thread.status_back = 0;
+	snd_thread.status_middle = 1;
+	snd_thread.status_front = 2;
+
+	if( !snd_thread.lock || !snd_thread.wakeup || !Ring_Init( &snd_thread.queue, SND_QUEUE_SIZE ))
+		Sys_Error( "%s: can't allocate mixer queue\n", __func__ );
+
+	S_ClearMixer();
+
+	if( Sys_CheckParm( "-nosoundthread" ))
+		return;
+
+	snd_thread.thread = Sys_CreateThread( S_MixerThread, NULL );
+
+	if( !snd_thread.thread )
+		Con_Reportf( "%s: mixer thread is not available, mixing on main thread\n", __func__ );
+}
+
+/*
+=================
+S_ShutdownMixer
+
+=================
+*/
+void S_ShutdownMixer( void )
+{
+	if( snd_thread.thread )
+	{
+		Sys_AtomicStore( &snd_thread.shutdown, 1 );
+		Sys_SemaphorePost( snd_thread.wakeup );
+		Sys_JoinThread( snd_thread.thread );
+		snd_thread.thread = NULL;
+	}
+
+	if( snd_thread.stalls )
+		Con_Reportf( "%s: mixer queue was full %d times\n", __func__, snd_thread.stalls );
+
+	Ring_Free( &snd_thread.queue );
+	Sys_DestroySemaphore( snd_thread.wakeup );
+	Sys_DestroyMutex( snd_thread.lock );
+	snd_thread.wakeup = NULL;
+	snd_thread.lock = NULL;
+}
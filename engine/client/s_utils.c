@@ -27,7 +27,7 @@ GNU General Public License for more details.
 //-----------------------------------------------------------------------------
 int S_ZeroCrossingBefore( wavdata_t *pWaveData, int sample )
 {
-	if( pWaveData == NULL )
+	if( pWaveData == NULL || pWaveData->buffer == NULL )
 		return sample;
 
 	if( pWaveData->type == WF_PCMDATA )
@@ -124,7 +124,7 @@ int S_ZeroCrossingBefore( wavdata_t *pWaveData, int sample )
 //-----------------------------------------------------------------------------
 int S_ZeroCrossingAfter( wavdata_t *pWaveData, int sample )
 {
-	if( pWaveData == NULL )
+	if( pWaveData == NULL || pWaveData->buffer == NULL )
 		return sample;
 
 	if( pWaveData->type == WF_PCMDATA )
@@ -64,9 +64,11 @@ void VOX_LoadWord( channel_t *ch )
 	if( !word->sfx )
 		return;
 
-	data = S_LoadSound( word->sfx );
+	// preloaded by VOX_LoadSound, this runs on mixer thread
+	data = word->sfx->cache;
 
-	if( !data )
+	// words are never decoded while playing
+	if( !data || FBitSet( data->flags, SOUND_STREAM ))
 		return;
 
 	ch->currentWord = &ch->pMixer;
@@ -92,11 +94,8 @@ void VOX_FreeWord( channel_t *ch )
 	ch->currentWord = NULL;
 	memset( &ch->pMixer, 0, sizeof( ch->pMixer ));
 
-	if( !word->sfx && !word->fKeepCached )
-		return;
-
-	FS_FreeSound( word->sfx->cache );
-	word->sfx->cache = NULL;
+	// keep the sound cached, main thread may still use it,
+	// it's released with all other sounds at level change
 	word->sfx = NULL;
 }
 
@@ -386,6 +385,10 @@ void VOX_LoadSound( channel_t *ch, const char *pszin )
 
 		ch->words[j].sfx = S_FindName( pathbuffer, &ch->words[j].fKeepCached );
 
+		// mixer can't load sounds
+		if( ch->words[j].sfx )
+			S_LoadSound( ch->words[j].sfx );
+
 		j++;
 	}
 
@@ -140,6 +140,8 @@ typedef struct rawchan_s
 	float			dist_mult;	// distance multiplier (attenuation/clipK)
 	vec3_t			origin;		// only use if fixed_origin is set
 	volatile uint		s_rawend;
+	mouth_t			mouth;		// mixer side, copied to entity by main thread
+	qboolean			stream;		// music or voice, mixed without DSP
 	wavdata_t			sound_info;	// advance play position
 	float			oldtime;		// catch time jumps
 	size_t			max_samples;	// buffer length
@@ -165,6 +167,9 @@ typedef struct channel_s
 	qboolean		use_loop;		// don't loop default and local sounds
 	qboolean		staticsound;	// use origin instead of fetching entnum's origin
 	qboolean		localsound;	// it's a local menu sound (not looped, not paused)
+	uint		serial;		// changed every time channel is started, see s_thread.c
+	mouth_t		mouth;		// mixer side, reported back with playback position
+	int		stream;		// long sounds are decoded while playing, see s_decode.c
 	mixer_t		pMixer;
 
 	// sentence mixer
@@ -186,6 +191,8 @@ typedef struct
 	float		frametime;	// used for sound fade
 	qboolean		active;
 	qboolean		inmenu;		// listener in-menu ?
+	qboolean		inconsole;
+	qboolean		background;	// background map is running
 	qboolean		paused;
 	qboolean		streaming;	// playing AVI-file
 	qboolean		stream_paused;	// pause only background track
@@ -195,7 +202,7 @@ typedef struct
 {
 	string		current;		// a currently playing track
 	string		loopName;		// may be empty
-	stream_t		*stream;
+	int		stream;		// decoder handle
 	int		source;		// may be game, menu, etc
 } bg_track_t;
 
@@ -206,14 +213,28 @@ typedef struct
 #define MAX_RAW_CHANNELS	48
 #define MAX_RAW_SAMPLES	8192
 
+// mixer thread copy of the channels and listener, see s_thread.c
+typedef struct
+{
+	channel_t		channels[MAX_CHANNELS];
+	int		total_channels;
+	listener_t	listener;
+	float		mastervol;
+	float		musicvol;
+	int		realvoices;	// channels mixed in last pass
+	int		virtualvoices;	// channels only advanced in last pass
+} sndmixer_t;
+
 extern sound_t	ambient_sfx[NUM_AMBIENTS];
 extern qboolean	snd_ambient;
+extern qboolean	s_simd;
 extern channel_t	channels[MAX_CHANNELS];
 extern rawchan_t	*raw_channels[MAX_RAW_CHANNELS];
 extern int	total_channels;
 extern int	paintedtime;
 extern int	soundtime;
 extern listener_t	s_listener;
+extern sndmixer_t	snd_mixer;
 extern int	idsp_room;
 extern dma_t	dma;
 
@@ -223,9 +244,13 @@ extern convar_t	s_test;		// cvar to testify new effects
 extern convar_t s_samplecount;
 extern convar_t snd_mute_losefocus;
 extern convar_t s_warn_late_precache;
+extern convar_t s_cache;
+extern convar_t s_stream_size;
+extern convar_t s_max_voices;
 
 void S_InitScaletable( void );
 wavdata_t *S_LoadSound( sfx_t *sfx );
+void S_PrefetchSound( const char *name );
 float S_GetMasterVolume( void );
 float S_GetMusicVolume( void );
 
@@ -242,6 +267,7 @@ void MIX_ClearAllPaintBuffers( int SampleCount, qboolean clearFilters );
 void MIX_InitAllPaintbuffers( void );
 void MIX_FreeAllPaintbuffers( void );
 void MIX_PaintChannels( int endtime );
+void MIX_FreeChannel( channel_t *ch );
 
 // s_load.c
 qboolean S_TestSoundChar( const char *pch, char c );
@@ -250,6 +276,7 @@ sfx_t *S_FindName( const char *name, int *pfInCache );
 sound_t S_RegisterSound( const char *name );
 void S_FreeSound( sfx_t *sfx );
 void S_InitSounds( void );
+int S_OpenSfxStream( sfx_t *sfx, int sample );
 
 // s_dsp.c
 void SX_Init( void );
@@ -271,12 +298,43 @@ int S_GetCurrentStaticSounds( soundlist_t *pout, int size );
 int S_GetCurrentDynamicSounds( soundlist_t *pout, int size );
 sfx_t *S_GetSfxByHandle( sound_t handle );
 rawchan_t *S_FindRawChannel( int entnum, qboolean create );
+int S_RawChannelSpace( rawchan_t *ch );
 void S_RawEntSamples( int entnum, uint samples, uint rate, word width, word channels, const byte *data, int snd_vol );
 void S_RawSamples( uint samples, uint rate, word width, word channels, const byte *data, int entnum );
 void S_StopSound( int entnum, int channel, const char *soundname );
 void S_UpdateFrame( struct ref_viewpass_s *rvp );
 void S_StopAllSounds( qboolean ambient );
 void S_FreeSounds( void );
+void S_UpdateChannels( void );
+
+//
+// s_thread.c
+//
+void S_InitMixer( void );
+void S_ShutdownMixer( void );
+void S_LockMixer( void );
+void S_UnlockMixer( void );
+void S_ReadMixerStatus( void );
+void S_SyncMixer( void );
+void S_ClearMixer( void );
+void S_MixerExtraUpdate( void );
+qboolean S_MixerThreaded( void );
+
+//
+// s_decode.c
+//
+void S_InitDecoder( void );
+void S_ShutdownDecoder( void );
+int S_OpenSoundStream( const char *filename, int position, qboolean mixer );
+void S_CloseSoundStream( int handle );
+const wavdata_t *S_SoundStreamInfo( int handle );
+qboolean S_SoundStreamFinished( int handle );
+int S_SoundStreamPosition( int handle );
+int S_ReadSoundStream( int handle, void *buffer, int bytes );
+int S_GetStreamData( int handle, void **pData, int samplePosition, int sampleCount );
+void S_UpdateSoundStreams( void );
+int S_NumSoundStreams( void );
+qboolean S_DecoderThreaded( void );
 
 //
 // s_mouth.c
@@ -288,6 +346,7 @@ void SND_MoveMouth16( channel_t *ch, wavdata_t *pSource, int count );
 void SND_MoveMouthRaw( rawchan_t *ch, portable_samplepair_t *pData, int count );
 void SND_CloseMouth( channel_t *ch );
 void SND_ForceCloseMouth( int entnum );
+void SND_SetMouthOpen( int entnum, byte mouthopen );
 
 //
 // s_stream.c
@@ -0,0 +1,343 @@
+/*
+asyncload.c - background file read-ahead for resource precache
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+
+/*
+==============================================================
+
+Raw file read-ahead. Resources listed in signon are read into
+memory by worker threads while main thread is busy with the world
+model. Loaders then take buffers with FS_LoadPrefetchedFile instead
+of going to the disk. Nothing is decoded on workers, parsing and
+decoding the buffers stays with the loaders on main thread.
+
+Search paths, packs and archives are not thread-safe, so only plain
+files on disk are prefetched, with the path resolved on main thread.
+Everything else falls back to the usual synchronous loading.
+==============================================================
+*/
+
+#define MAX_PREFETCH		1024
+#define MAX_PREFETCH_HASH	(MAX_PREFETCH/4)
+#define MAX_PREFETCH_SIZE	(64 * 1024 * 1024) // don't let unused buffers eat all memory
+
+typedef enum
+{
+	PREFETCH_PENDING = 0,
+	PREFETCH_READY,
+	PREFETCH_FAILED,
+} prefetch_state_t;
+
+typedef struct prefetch_s
+{
+	char		name[MAX_QPATH];	// as requested by loader
+	char		diskpath[MAX_SYSPATH];
+	byte		*buffer;
+	fs_offset_t	size;
+	int		state;		// atomic, prefetch_state_t
+	sys_sem_t		*done;		// posted by worker when state is final
+	qboolean		taken;		// buffer was given away, free the slot on completion
+	qboolean		completed;	// completion callback was called
+	struct prefetch_s	*hashNext;
+} prefetch_t;
+
+static CVAR_DEFINE_AUTO( fs_prefetch, "1", FCVAR_ARCHIVE, "read files of precached resources ahead in background threads" );
+
+static struct
+{
+	poolhandle_t	mempool;
+	prefetch_t	*hash[MAX_PREFETCH_HASH];
+	int		count;
+	int		memory;		// atomic, reserved by workers before reading
+	int		hits;
+	int		misses;
+} prefetch;
+
+static prefetch_t *FS_FindPrefetch( const char *name, prefetch_t ***pprev )
+{
+	prefetch_t *p, **prev;
+
+	prev = &prefetch.hash[COM_HashKey( name, MAX_PREFETCH_HASH )];
+
+	for( p = *prev; p; prev = &p->hashNext, p = p->hashNext )
+	{
+		if( !Q_stricmp( p->name, name ))
+		{
+			if( pprev ) *pprev = prev;
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+static void FS_FreePrefetch( prefetch_t *p )
+{
+	prefetch_t **prev;
+
+	if( FS_FindPrefetch( p->name, &prev ) == p )
+		*prev = p->hashNext;
+
+	if( p->buffer )
+	{
+		Sys_AtomicAdd( &prefetch.memory, -(int)p->size );
+		Mem_Free( p->buffer );
+	}
+
+	Sys_DestroySemaphore( p->done );
+	prefetch.count--;
+	Mem_Free( p );
+}
+
+/*
+=================
+FS_PrefetchFinish
+
+publishes request result and wakes up loader waiting for it
+=================
+*/
+static void FS_PrefetchFinish( prefetch_t *p, int state )
+{
+	Sys_AtomicStore( &p->state, state );
+	Sys_SemaphorePost( p->done );
+}
+
+/*
+=================
+FS_PrefetchWork
+
+worker thread, must not touch anything but the request
+itself and the memory counter
+=================
+*/
+static void FS_PrefetchWork( void *data )
+{
+	prefetch_t *p = data;
+	FILE *f;
+	long size;
+
+	if(( f = fopen( p->diskpath, "rb" )) == NULL )
+	{
+		FS_PrefetchFinish( p, PREFETCH_FAILED );
+		return;
+	}
+
+	fseek( f, 0, SEEK_END );
+	size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+
+	if( size <= 0 || size > MAX_PREFETCH_SIZE )
+	{
+		fclose( f );
+		FS_PrefetchFinish( p, PREFETCH_FAILED );
+		return;
+	}
+
+	// reserve memory before allocating, so the limit holds for reads in flight
+	if( Sys_AtomicAdd( &prefetch.memory, (int)size ) > MAX_PREFETCH_SIZE )
+	{
+		Sys_AtomicAdd( &prefetch.memory, -(int)size );
+		fclose( f );
+		FS_PrefetchFinish( p, PREFETCH_FAILED );
+		return;
+	}
+
+	// keep the same contract as FS_LoadFile: buffer is null terminated
+	p->buffer = Mem_Malloc( prefetch.mempool, size + 1 );
+
+	if( fread( p->buffer, 1, size, f ) != (size_t)size )
+	{
+		Sys_AtomicAdd( &prefetch.memory, -(int)size );
+		Mem_Free( p->buffer );
+		p->buffer = NULL;
+		fclose( f );
+		FS_PrefetchFinish( p, PREFETCH_FAILED );
+		return;
+	}
+
+	fclose( f );
+	p->buffer[size] = 0;
+	p->size = size;
+	FS_PrefetchFinish( p, PREFETCH_READY );
+}
+
+/*
+=================
+FS_PrefetchDone
+
+main thread
+=================
+*/
+static void FS_PrefetchDone( void *data )
+{
+	prefetch_t *p = data;
+
+	p->completed = true;
+
+	if( p->taken )
+		FS_FreePrefetch( p );
+}
+
+/*
+=================
+FS_PrefetchFile
+
+starts reading raw file contents in background, returns false
+if file can't be prefetched and loader should read it as usual
+=================
+*/
+qboolean FS_PrefetchFile( const char *path )
+{
+	char diskpath[MAX_SYSPATH];
+	prefetch_t *p;
+	uint hash;
+
+	if( !fs_prefetch.value || !Job_NumWorkers( ))
+		return false;
+
+	if( !COM_CheckString( path ) || Q_strlen( path ) >= MAX_QPATH )
+		return false;
+
+	if( FS_FindPrefetch( path, NULL ))
+		return true;
+
+	if( prefetch.count >= MAX_PREFETCH || Sys_AtomicLoad( &prefetch.memory ) >= MAX_PREFETCH_SIZE )
+		return false;
+
+	// files in packs and archives are read on main thread
+	if( !g_fsapi.GetFullDiskPath( diskpath, sizeof( diskpath ), path, false ))
+		return false;
+
+	if( !prefetch.mempool )
+		prefetch.mempool = Mem_AllocPool( "Prefetch Zone" );
+
+	p = Mem_Calloc( prefetch.mempool, sizeof( *p ));
+
+	if(( p->done = Sys_CreateSemaphore( 0 )) == NULL )
+	{
+		Mem_Free( p );
+		return false;
+	}
+
+	Q_strncpy( p->name, path, sizeof( p->name ));
+	Q_strncpy( p->diskpath, diskpath, sizeof( p->diskpath ));
+	p->state = PREFETCH_PENDING;
+
+	hash = COM_HashKey( p->name, MAX_PREFETCH_HASH );
+	p->hashNext = prefetch.hash[hash];
+	prefetch.hash[hash] = p;
+	prefetch.count++;
+
+	Job_Add( FS_PrefetchWork, FS_PrefetchDone, p );
+
+	return true;
+}
+
+/*
+=================
+FS_LoadPrefetchedFile
+
+returns buffer allocated by prefetch, waiting for it if it's still in flight,
+or NULL if file wasn't requested or read has failed. Caller frees the buffer
+=================
+*/
+byte *FS_LoadPrefetchedFile( const char *path, fs_offset_t *filesizeptr )
+{
+	prefetch_t *p;
+	byte *buf;
+
+	if( filesizeptr ) *filesizeptr = 0;
+
+	if( !prefetch.count || !COM_CheckString( path ))
+		return NULL;
+
+	p = FS_FindPrefetch( path, NULL );
+
+	if( !p || p->taken )
+		return NULL;
+
+	// it's already being read, waiting is cheaper than reading it again
+	if( Sys_AtomicLoad( &p->state ) == PREFETCH_PENDING )
+		Sys_SemaphoreWait( p->done );
+
+	buf = p->buffer;
+
+	if( !buf )
+	{
+		prefetch.misses++;
+
+		if( p->completed )
+			FS_FreePrefetch( p );
+		else p->taken = true;
+
+		return NULL;
+	}
+
+	prefetch.hits++;
+
+	if( filesizeptr ) *filesizeptr = p->size;
+
+	Sys_AtomicAdd( &prefetch.memory, -(int)p->size );
+
+	// hand over buffer to the caller, so it's not freed with the request
+	p->buffer = NULL;
+	p->size = 0;
+
+	if( p->completed )
+		FS_FreePrefetch( p );
+	else p->taken = true;
+
+	return buf;
+}
+
+/*
+=================
+FS_ClearPrefetch
+
+release everything loaders didn't ask for
+=================
+*/
+void FS_ClearPrefetch( void )
+{
+	prefetch_t *p, *next;
+	int i;
+
+	if( !prefetch.mempool )
+		return;
+
+	// wait for reads in flight, their callbacks reference the requests
+	Job_WaitAll();
+
+	if( prefetch.hits || prefetch.misses || prefetch.count )
+		Con_Reportf( "FS_ClearPrefetch: %i hits, %i failed, %i unused\n", prefetch.hits, prefetch.misses, prefetch.count );
+
+	for( i = 0; i < MAX_PREFETCH_HASH; i++ )
+	{
+		for( p = prefetch.hash[i]; p; p = next )
+		{
+			next = p->hashNext;
+			FS_FreePrefetch( p );
+		}
+	}
+
+	Mem_FreePool( &prefetch.mempool );
+	memset( &prefetch, 0, sizeof( prefetch ));
+}
+
+void FS_InitPrefetch( void )
+{
+	Cvar_RegisterVariable( &fs_prefetch );
+}
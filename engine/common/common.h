@@ -105,6 +105,7 @@ typedef enum
 #endif
 
 #include "system.h"
+#include "threads.h"
 #include "com_model.h"
 #include "com_strings.h"
 #include "crtlib.h"
@@ -383,6 +384,14 @@ void FS_Init( void );
 void FS_Shutdown( void );
 void *FS_GetNativeObject( const char *obj );
 
+//
+// asyncload.c
+//
+void FS_InitPrefetch( void );
+qboolean FS_PrefetchFile( const char *path );
+byte *FS_LoadPrefetchedFile( const char *path, fs_offset_t *filesizeptr );
+void FS_ClearPrefetch( void );
+
 //
 // cmd.c
 //
@@ -0,0 +1,124 @@
+/*
+demofile.h - demo file format, shared by client and server recording
+Copyright (C) 2007 Uncle Mike
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef DEMOFILE_H
+#define DEMOFILE_H
+
+#include "protocol.h"
+
+#define dem_unknown		0	// unknown command
+#define dem_norewind	1	// startup message
+#define dem_read		2	// it's a normal network packet
+#define dem_jumptime	3	// move the demostart time value forward by this amount
+#define dem_userdata	4	// userdata from the client.dll
+#define dem_usercmd		5	// read usercmd_t
+#define dem_stop		6	// end of time
+#define dem_lastcmd		dem_stop
+
+#define DEMO_STARTUP	0	// this lump contains startup info needed to spawn into the server
+#define DEMO_NORMAL		1	// this lump contains playback info of messages, etc., needed during playback.
+
+#define IDEMOHEADER		(('M'<<24)+('E'<<16)+('D'<<8)+'I') // little-endian "IDEM"
+#define IDEMOINDEX		(('X'<<24)+('D'<<16)+('N'<<8)+'I') // little-endian "INDX"
+#define DEMO_PROTOCOL	3
+
+#pragma pack( push, 1 )
+typedef struct
+{
+	int		id;		// should be IDEM
+	int		dem_protocol;	// should be DEMO_PROTOCOL
+	int		net_protocol;	// should be PROTOCOL_VERSION
+	double		host_fps;		// fps for demo playing
+	char		mapname[64];	// name of map
+	char		comment[64];	// comment for demo
+	char		gamedir[64];	// name of game directory (FS_Gamedir())
+	int		directory_offset;	// offset of Entry Directory.
+} demoheader_t;
+#pragma pack( pop )
+
+typedef struct
+{
+	int		entrytype;	// DEMO_STARTUP or DEMO_NORMAL
+	float		playback_time;	// time of track
+	int		playback_frames;	// # of frames in track
+	int		offset;		// file offset of track data
+	int		length;		// length of track
+	int		flags;		// FX-flags
+	char		description[64];	// entry description
+} demoentry_t;
+
+// keyframe index is written after the directory, older engines don't read it
+// index is followed by the state log size and bits, then by keyframe states
+typedef struct
+{
+	float		time;		// since the demo start, across level changes
+	float		timestamp;	// message time as written, relative to level start
+	int		offset;		// file offset where reading continues after the jump
+	int		level;		// number of jumptimes before it
+	int		logstart;		// state log range of this level up to the keyframe, in bits
+	int		logend;
+	int		stateofs;		// client state message, relative to the end of the state log
+	int		statelen;		// 0 if the full update is in the demo stream
+} demokeyframe_t;
+
+// state log keeps commands that can't be restored from entities:
+// view entity, room type, HUD state user messages and so on. It's replayed
+// on seek, so one-shot events like chat, death notices, damage, pickups and
+// stufftext aren't kept, they would be shown or executed again
+#define DEMO_MAX_STATE_LOG	(16 * 1024 * 1024)
+
+static inline qboolean Demo_IsStateCommand( int cmd, const char *usermsg )
+{
+	static const char *const statemsgs[] =
+	{
+		"ResetHUD", "InitHUD", "Health", "Battery", "Flashlight", "FlashBat",
+		"CurWeapon", "WeaponList", "AmmoX", "HideWeapon", "SetFOV", "Train",
+		"Geiger", "Concuss", "ViewMode", "GameMode", "ServerName", "ScoreInfo",
+		"TeamInfo", "TeamScore", "TeamNames", "AllowSpec", "Spectator",
+		"Money", "ArmorType", "StatusIcon", "RoundTime", "ScoreAttrib",
+	};
+	size_t i;
+
+	switch( cmd )
+	{
+	case svc_setview:
+	case svc_intermission:
+	case svc_finale:
+	case svc_cdtrack:
+	case svc_cutscene:
+	case svc_roomtype:
+	case svc_crosshairangle:
+	case svc_director:
+		return true;
+	}
+
+	if( cmd <= svc_lastmsg || !usermsg )
+		return false;
+
+	for( i = 0; i < ARRAYSIZE( statemsgs ); i++ )
+	{
+		if( !Q_stricmp( usermsg, statemsgs[i] ))
+			return true;
+	}
+
+	return false;
+}
+
+// every message is followed by the netchan state at the time it was received:
+// incoming_sequence, incoming_acknowledged, incoming_reliable_acknowledged,
+// incoming_reliable_sequence, outgoing_sequence, reliable_sequence, last_reliable_sequence
+#define DEMO_SEQUENCE_INTS	7
+
+#endif // DEMOFILE_H
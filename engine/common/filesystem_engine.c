@@ -146,6 +146,8 @@ void FS_Init( void )
 
 	if( !Sys_GetParmFromCmdLine( "-clientlib", SI.clientlib ))
 		SI.clientlib[0] = 0;
+
+	FS_InitPrefetch();
 }
 
 /*
@@ -155,6 +157,8 @@ FS_Shutdown
 */
 void FS_Shutdown( void )
 {
+	FS_ClearPrefetch();
+
 	if( g_fsapi.ShutdownStdio )
 		g_fsapi.ShutdownStdio();
 
@@ -138,6 +138,7 @@ void Sys_PrintUsage( void )
 #if XASH_SDL == 2
 	O("-sdl_joy_old_api ","use SDL legacy joystick API")
 	O("-sdl_renderer <n>","use alternative SDL_Renderer for software")
+	O("-offscreen       ","render frames to memory without a display, use with -ref soft")
 #endif // XASH_SDL
 #if XASH_ANDROID
 	O("-nativeegl       ","use native egl implementation. Use if screen does not update or black")
@@ -705,6 +706,9 @@ void Host_Frame( float time )
 
 	t1 = Sys_DoubleTime();
 
+	// finish what worker threads have done for us
+	Job_RunCompletions();
+
 	if( host.framecount == 0 )
 		Con_DPrintf( "Time to first frame: %.3f seconds\n", t1 - host.starttime );
 
@@ -759,6 +763,9 @@ void GAME_EXPORT Host_Error( const char *error, ... )
 		else MSGBOX2( hosterror1 );
 	}
 
+	// don't leave the error in the log queue
+	Sys_FlushLog();
+
 	// host is shutting down. don't invoke infinite loop
 	if( host.status == HOST_SHUTDOWN ) return;
 
@@ -1097,6 +1104,8 @@ void Host_InitCommon( int argc, char **argv, const char *progname, qboolean bCha
 
 	Sys_InitLog();
 
+	Job_Init();
+
 	// print bugcompatibility level here, after log was initialized
 	if( host.bugcomp == BUGCOMP_GOLDSRC )
 	{
@@ -1146,6 +1155,7 @@ void Host_InitCommon( int argc, char **argv, const char *progname, qboolean bCha
 
 void Host_FreeCommon( void )
 {
+	Job_Shutdown();
 	Image_Shutdown();
 	Sound_Shutdown();
 	Netchan_Shutdown();
@@ -523,6 +523,9 @@ rgbdata_t *FS_CopyImage( rgbdata_t *in )
 }
 
 #if XASH_ENGINE_TESTS
+#define MINIZ_HEADER_FILE_ONLY // implementation lives in img_png.c
+#include "miniz.h"
+#include "img_png.h"
 #include "tests.h"
 
 static void GeneratePixel( byte *pix, uint i, uint j, uint w, uint h, qboolean genAlpha )
@@ -552,6 +555,407 @@ static void Test_CheckImage( const char *name, rgbdata_t *rgb )
 	Mem_Free( load );
 }
 
+enum
+{
+	TEST_KERNEL_RESAMPLE32 = 0,
+	TEST_KERNEL_RESAMPLE24,
+	TEST_KERNEL_FLIP32,
+	TEST_KERNEL_LUMA,
+	TEST_KERNEL_PALETTE,
+};
+
+static const byte *Test_RunImageKernel( int kernel, const byte *src, int w, int h, int outw, int outh, size_t *size )
+{
+	qboolean resampled;
+	word width = w, height = h;
+	static byte *copy;
+
+	switch( kernel )
+	{
+	case TEST_KERNEL_RESAMPLE32:
+		*size = outw * outh * 4;
+		return Image_ResampleInternal( src, w, h, outw, outh, PF_RGBA_32, &resampled );
+	case TEST_KERNEL_RESAMPLE24:
+		*size = outw * outh * 3;
+		return Image_ResampleInternal( src, w, h, outw, outh, PF_RGB_24, &resampled );
+	case TEST_KERNEL_FLIP32:
+		*size = w * h * 4;
+		return Image_FlipInternal( src, &width, &height, PF_RGBA_32, outw );
+	case TEST_KERNEL_LUMA:
+		*size = w * h;
+		return Image_CreateLumaInternal((byte *)src, w, h, PF_INDEXED_32, IMAGE_HAS_LUMA );
+	case TEST_KERNEL_PALETTE:
+		// luma pixels are cleared in place
+		*size = w * h * 4;
+		copy = Mem_Realloc( host.imagepool, copy, w * h * 5 );
+		memcpy( copy, src, w * h );
+		image.width = w;
+		image.height = h;
+		image.flags = IMAGE_HAS_LUMA;
+		Image_GetPaletteQ1();
+		Image_Copy8bitRGBA( copy, copy + w * h, w * h );
+		return copy + w * h;
+	}
+
+	return NULL;
+}
+
+/*
+compare vectorized kernels with plain C versions bit for bit,
+with 'iterations' set prints how long both of them took
+*/
+static void Test_ImageKernel( const char *name, int kernel, const byte *src, int w, int h, int outw, int outh, int iterations )
+{
+	qboolean oldsimd = image.simd;
+	const byte *out = NULL;
+	byte *result[2];
+	double time[2];
+	size_t size = 0;
+	int i, j;
+
+	for( i = 0; i < 2; i++ )
+	{
+		image.simd = i;
+		time[i] = Sys_DoubleTime();
+
+		for( j = 0; j < ( iterations ? iterations : 1 ); j++ )
+			out = Test_RunImageKernel( kernel, src, w, h, outw, outh, &size );
+
+		time[i] = Sys_DoubleTime() - time[i];
+		result[i] = Z_Malloc( size );
+		memcpy( result[i], out, size );
+	}
+
+	image.simd = oldsimd;
+
+	_TASSERT( memcmp( result[0], result[1], size ), Msg( S_ERROR "%s: vectorized output differs (%dx%d, %d %d)\n", name, w, h, outw, outh ))
+
+	if( iterations )
+		Con_Printf( "%s %dx%d: %.2f ms plain, %.2f ms vectorized\n", name, w, h, time[0] * 1000.0 / iterations, time[1] * 1000.0 / iterations );
+
+	Z_Free( result[0] );
+	Z_Free( result[1] );
+}
+
+static void Test_RunImageKernels( void )
+{
+	const int sizes[][4] =
+	{
+	{ 61, 37, 128, 64 },
+	{ 256, 256, 97, 211 },
+	{ 300, 200, 301, 133 },
+	{ 7, 5, 3, 2 },
+	{ 2, 2, 17, 17 },
+	};
+	const int flips[] =
+	{
+		IMAGE_FLIP_X,
+		IMAGE_FLIP_Y,
+		IMAGE_FLIP_X|IMAGE_FLIP_Y,
+		IMAGE_ROT_90,
+		IMAGE_ROT_90|IMAGE_FLIP_X,
+		IMAGE_ROT_90|IMAGE_FLIP_Y,
+		IMAGE_ROT_90|IMAGE_FLIP_X|IMAGE_FLIP_Y,
+	};
+	const int big = 1024;
+	byte *src;
+	uint i, j, seed = 1;
+
+	// noise is the worst case for rounding differences
+	src = Z_Malloc( big * big * 4 );
+	for( i = 0; i < big * big * 4; i++ )
+	{
+		seed = seed * 1103515245 + 12345;
+		src[i] = seed >> 16;
+	}
+
+	for( i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ )
+	{
+		const int *s = sizes[i];
+
+		Test_ImageKernel( "resample32", TEST_KERNEL_RESAMPLE32, src, s[0], s[1], s[2], s[3], 0 );
+		Test_ImageKernel( "resample32", TEST_KERNEL_RESAMPLE32, src, s[2], s[3], s[0], s[1], 0 );
+		Test_ImageKernel( "resample24", TEST_KERNEL_RESAMPLE24, src, s[0], s[1], s[2], s[3], 0 );
+		Test_ImageKernel( "resample24", TEST_KERNEL_RESAMPLE24, src, s[2], s[3], s[0], s[1], 0 );
+
+		for( j = 0; j < sizeof( flips ) / sizeof( flips[0] ); j++ )
+			Test_ImageKernel( "flip32", TEST_KERNEL_FLIP32, src, s[0], s[1], flips[j], 0, 0 );
+
+		Test_ImageKernel( "luma", TEST_KERNEL_LUMA, src, s[0], s[1], 0, 0, 0 );
+		Test_ImageKernel( "palette", TEST_KERNEL_PALETTE, src, s[0], s[1], 0, 0, 0 );
+	}
+
+	// benchmarks
+	Test_ImageKernel( "resample32", TEST_KERNEL_RESAMPLE32, src, big / 2, big / 2, big, big, 4 );
+	Test_ImageKernel( "resample24", TEST_KERNEL_RESAMPLE24, src, big / 2, big / 2, big, big, 4 );
+	Test_ImageKernel( "flip32", TEST_KERNEL_FLIP32, src, big, big, IMAGE_FLIP_X, 0, 4 );
+	Test_ImageKernel( "rot90", TEST_KERNEL_FLIP32, src, big, big, IMAGE_ROT_90, 0, 4 );
+	Test_ImageKernel( "luma", TEST_KERNEL_LUMA, src, big, big, 0, 0, 4 );
+	Test_ImageKernel( "palette", TEST_KERNEL_PALETTE, src, big, big, 0, 0, 4 );
+
+	Image_Reset();
+	Z_Free( src );
+}
+
+static byte Test_PNGPredict( int filter, const byte *row, const byte *prior, uint i, uint bpp )
+{
+	int a = i >= bpp ? row[i - bpp] : 0;
+	int b = prior ? prior[i] : 0;
+	int c = ( prior && i >= bpp ) ? prior[i - bpp] : 0;
+	int p, pa, pb, pc;
+
+	switch( filter )
+	{
+	case PNG_F_SUB: return a;
+	case PNG_F_UP: return b;
+	case PNG_F_AVERAGE: return ( a + b ) >> 1;
+	case PNG_F_PAETH:
+		p = a + b - c;
+		pa = abs( p - a );
+		pb = abs( p - b );
+		pc = abs( p - c );
+		if( pa <= pb && pa <= pc ) return a;
+		if( pb <= pc ) return b;
+		return c;
+	}
+
+	return 0;
+}
+
+static void Test_PNGPutLong( byte *out, uint v )
+{
+	out[0] = v >> 24;
+	out[1] = v >> 16;
+	out[2] = v >> 8;
+	out[3] = v;
+}
+
+static void Test_PNGChunk( byte **out, const char *sign, const byte *data, uint len )
+{
+	uint crc;
+
+	Test_PNGPutLong( *out, len );
+	memcpy( *out + 4, sign, 4 );
+	if( len ) memcpy( *out + 8, data, len );
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, *out + 4, len + 4 );
+	Test_PNGPutLong( *out + 8 + len, CRC32_Final( crc ));
+
+	*out += len + 12;
+}
+
+/*
+encodes samples with filter types cycling from row to row,
+zlib stream is split into IDAT chunks of 'split' bytes
+*/
+static byte *Test_BuildPNG( int colortype, uint bpp, uint w, uint h, const byte *samples, const byte *plte, uint plte_len, const byte *trns, uint trns_len, uint split, qboolean truncate, size_t *size )
+{
+	const byte sign[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	uint rowsize = w * bpp, x, y, i;
+	byte ihdr[13], *filtered, *packed, *buf, *out;
+	mz_ulong packed_size;
+
+	filtered = Z_Malloc(( rowsize + 1 ) * h );
+
+	for( y = 0; y < h; y++ )
+	{
+		const byte *row = samples + y * rowsize;
+		const byte *prior = y ? row - rowsize : NULL;
+		int filter = ( y + w ) % 5;
+
+		filtered[y * ( rowsize + 1 )] = filter;
+		for( x = 0; x < rowsize; x++ )
+			filtered[y * ( rowsize + 1 ) + 1 + x] = row[x] - Test_PNGPredict( filter, row, prior, x, bpp );
+	}
+
+	packed_size = compressBound(( rowsize + 1 ) * h );
+	packed = Z_Malloc( packed_size );
+	compress2( packed, &packed_size, filtered, ( rowsize + 1 ) * h, Z_BEST_SPEED );
+	Z_Free( filtered );
+
+	if( truncate )
+		packed_size /= 2;
+
+	out = buf = Z_Malloc( sizeof( sign ) + 25 + plte_len * 3 + 12 + trns_len + 12 + packed_size + ( packed_size / split + 1 ) * 12 + 12 );
+	memcpy( out, sign, sizeof( sign ));
+	out += sizeof( sign );
+
+	Test_PNGPutLong( ihdr, w );
+	Test_PNGPutLong( ihdr + 4, h );
+	ihdr[8] = 8;
+	ihdr[9] = colortype;
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+	Test_PNGChunk( &out, "IHDR", ihdr, sizeof( ihdr ));
+
+	if( plte ) Test_PNGChunk( &out, "PLTE", plte, plte_len * 3 );
+	if( trns ) Test_PNGChunk( &out, "tRNS", trns, trns_len );
+
+	for( i = 0; i < packed_size; i += split )
+		Test_PNGChunk( &out, "IDAT", packed + i, split < packed_size - i ? split : packed_size - i);
+
+	Test_PNGChunk( &out, "IEND", NULL, 0 );
+	Z_Free( packed );
+
+	*size = out - buf;
+	return buf;
+}
+
+static byte *Test_DecodePNG( const byte *png, size_t size, qboolean simd )
+{
+	qboolean oldsimd = image.simd;
+	byte *out = NULL;
+
+	image.simd = simd;
+	if( Image_LoadPNG( "#test.png", png, size ))
+		out = image.rgba;
+	image.simd = oldsimd;
+	image.rgba = NULL;
+
+	return out;
+}
+
+static void Test_RunPNGType( int colortype, uint w, uint h, uint split, int iterations )
+{
+	const uint bpp = colortype == PNG_CT_RGBA ? 4 : colortype == PNG_CT_RGB ? 3 : colortype == PNG_CT_ALPHA ? 2 : 1;
+	byte plte[256 * 3], trns[256], *samples, *expected, *png, *out[2];
+	uint plte_len = 0, trns_len = 0, i, j, seed = w * 31 + h;
+	double time[2] = { 0 };
+	size_t size;
+
+	samples = Z_Malloc( w * h * bpp );
+	expected = Z_Malloc( w * h * 4 );
+
+	// smooth gradients with some noise, like real textures
+	for( i = 0; i < h; i++ )
+	{
+		for( j = 0; j < w * bpp; j++ )
+		{
+			seed = seed * 1103515245 + 12345;
+			samples[i * w * bpp + j] = ( i * 3 + j / bpp * 2 + j % bpp * 50 ) + (( seed >> 16 ) & 7 );
+		}
+	}
+
+	if( colortype == PNG_CT_PALLETE )
+	{
+		plte_len = 200; // some indices are out of range
+		trns_len = 100;
+		for( i = 0; i < sizeof( plte ); i++ )
+			plte[i] = i * 7;
+		for( i = 0; i < sizeof( trns ); i++ )
+			trns[i] = i * 3;
+	}
+	else if( colortype == PNG_CT_RGB || colortype == PNG_CT_GREY )
+	{
+		// first pixel is transparent
+		trns_len = colortype == PNG_CT_RGB ? 6 : 2;
+		for( i = 0; i < trns_len / 2; i++ )
+		{
+			trns[i * 2] = 0;
+			trns[i * 2 + 1] = samples[i];
+		}
+	}
+
+	for( i = 0; i < w * h; i++ )
+	{
+		const byte *s = samples + i * bpp;
+		byte *e = expected + i * 4;
+
+		switch( colortype )
+		{
+		case PNG_CT_RGBA:
+			memcpy( e, s, 4 );
+			break;
+		case PNG_CT_RGB:
+			memcpy( e, s, 3 );
+			e[3] = ( s[0] == trns[1] && s[1] == trns[3] && s[2] == trns[5] ) ? 0 : 255;
+			break;
+		case PNG_CT_GREY:
+			e[0] = e[1] = e[2] = s[0];
+			e[3] = s[0] == trns[1] ? 0 : 255;
+			break;
+		case PNG_CT_ALPHA:
+			e[0] = e[1] = e[2] = s[0];
+			e[3] = s[1];
+			break;
+		case PNG_CT_PALLETE:
+			if( s[0] < plte_len )
+			{
+				memcpy( e, plte + s[0] * 3, 3 );
+				e[3] = s[0] < trns_len ? trns[s[0]] : 255;
+			}
+			else
+			{
+				e[0] = e[1] = e[2] = 0;
+				e[3] = 255;
+			}
+			break;
+		}
+	}
+
+	png = Test_BuildPNG( colortype, bpp, w, h, samples, plte_len ? plte : NULL, plte_len, trns_len ? trns : NULL, trns_len, split, false, &size );
+
+	for( i = 0; i < 2; i++ )
+	{
+		time[i] = Sys_DoubleTime();
+
+		for( j = 0; j < ( iterations ? iterations : 1 ); j++ )
+		{
+			out[i] = Test_DecodePNG( png, size, i );
+			if( j + 1 < iterations ) Mem_Free( out[i] );
+		}
+
+		time[i] = Sys_DoubleTime() - time[i];
+
+		_TASSERT( !out[i], Msg( S_ERROR "png type %d %ux%u: decoding failed\n", colortype, w, h ))
+		_TASSERT( memcmp( out[i], expected, w * h * 4 ), Msg( S_ERROR "png type %d %ux%u: decoded image differs (%s)\n", colortype, w, h, i ? "vectorized" : "plain" ))
+	}
+
+	if( iterations )
+		Con_Printf( "png type %d %ux%u: %.2f ms plain, %.2f ms vectorized\n", colortype, w, h, time[0] * 1000.0 / iterations, time[1] * 1000.0 / iterations );
+
+	Mem_Free( out[0] );
+	Mem_Free( out[1] );
+	Z_Free( png );
+	Z_Free( samples );
+	Z_Free( expected );
+}
+
+static void Test_RunPNG( void )
+{
+	const int types[] = { PNG_CT_RGBA, PNG_CT_RGB, PNG_CT_GREY, PNG_CT_ALPHA, PNG_CT_PALLETE };
+	const uint sizes[][2] = { { 1, 1 }, { 5, 3 }, { 61, 37 }, { 256, 17 } };
+	byte *samples, *png, *out;
+	size_t size;
+	uint i, j;
+
+	for( i = 0; i < sizeof( types ) / sizeof( types[0] ); i++ )
+	{
+		for( j = 0; j < sizeof( sizes ) / sizeof( sizes[0] ); j++ )
+		{
+			Test_RunPNGType( types[i], sizes[j][0], sizes[j][1], 7, 0 );
+			Test_RunPNGType( types[i], sizes[j][0], sizes[j][1], 65536, 0 );
+		}
+	}
+
+	// truncated stream still gives an image, with missing rows black
+	samples = Z_Malloc( 64 * 64 * 4 );
+	memset( samples, 0xff, 64 * 64 * 4 );
+	png = Test_BuildPNG( PNG_CT_RGBA, 4, 64, 64, samples, NULL, 0, NULL, 0, 100, true, &size );
+	out = Test_DecodePNG( png, size, true );
+	_TASSERT( !out, Msg( S_ERROR "png: truncated image wasn't decoded\n" ))
+	memset( samples, 0, 64 * 4 );
+	_TASSERT( memcmp( out + 63 * 64 * 4, samples, 64 * 4 ), Msg( S_ERROR "png: truncated image has garbage\n" ))
+	Mem_Free( out );
+	Z_Free( png );
+	Z_Free( samples );
+
+	// benchmarks, HUD sprite and skybox side sized
+	Test_RunPNGType( PNG_CT_RGBA, 256, 256, 8192, 16 );
+	Test_RunPNGType( PNG_CT_RGB, 1024, 1024, 8192, 4 );
+	Image_Reset();
+}
+
 void Test_RunImagelib( void )
 {
 	rgbdata_t rgb = { 0 };
@@ -596,6 +1000,9 @@ void Test_RunImagelib( void )
 	}
 
 	Z_Free( rgb.buffer );
+
+	Test_RunImageKernels();
+	Test_RunPNG();
 }
 
 #define IMPLEMENT_IMAGELIB_FUZZ_TARGET( export, target ) \
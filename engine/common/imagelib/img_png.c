@@ -17,6 +17,7 @@ GNU General Public License for more details.
 #include "imagelib.h"
 #include "xash3d_mathlib.h"
 #include "img_png.h"
+#include "xash3d_simd.h"
 
 #if defined(XASH_NO_NETWORK)
 	#include "platform/stub/net_stub.h"
@@ -35,6 +36,397 @@ static const char idat_sign[] = {'I', 'D', 'A', 'T'};
 static const char iend_sign[] = {'I', 'E', 'N', 'D'};
 static const int  iend_crc32 = 0xAE426082;
 
+/*
+==============================================================
+
+ROW DECODING
+
+rows are inflated and unfiltered one by one, each filter needs
+the row above, so rows can't be decoded in parallel. Vector code
+handles a whole pixel at a time for 3 and 4 bytes per pixel
+==============================================================
+*/
+#if XASH_SIMD_SSE2
+// 3 byte pixels are moved as 4 bytes while there is room left in the row,
+// extra byte in the output is overwritten by the next pixel
+static inline __m128i Image_PNGLoadPixel( const byte *p, uint left, uint bpp )
+{
+	uint32_t v = 0;
+
+	if( left >= 4 ) memcpy( &v, p, 4 );
+	else memcpy( &v, p, bpp );
+
+	return _mm_cvtsi32_si128( v );
+}
+
+static inline void Image_PNGStorePixel( byte *p, __m128i x, uint left, uint bpp )
+{
+	uint32_t v = _mm_cvtsi128_si32( x );
+
+	if( left >= 4 ) memcpy( p, &v, 4 );
+	else memcpy( p, &v, bpp );
+}
+
+static inline __m128i Image_PNGAbs16( __m128i x )
+{
+	return _mm_max_epi16( x, _mm_sub_epi16( _mm_setzero_si128(), x ));
+}
+
+static inline void Image_PNGUnfilterSIMD( int filter, const byte *raw, const byte *prior, byte *out, uint rowsize, uint bpp )
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = zero, b, c = zero, x, pa, pb, pc, smin, ma, mb;
+	uint i;
+
+	switch( filter )
+	{
+	case PNG_F_SUB:
+		for( i = 0; i < rowsize; i += bpp )
+		{
+			a = _mm_add_epi8( Image_PNGLoadPixel( raw + i, rowsize - i, bpp ), a );
+			Image_PNGStorePixel( out + i, a, rowsize - i, bpp );
+		}
+		break;
+	case PNG_F_AVERAGE:
+		for( i = 0; i < rowsize; i += bpp )
+		{
+			b = Image_PNGLoadPixel( prior + i, rowsize - i, bpp );
+			// avg_epu8 rounds up, floor it back
+			x = _mm_sub_epi8( _mm_avg_epu8( a, b ), _mm_and_si128( _mm_xor_si128( a, b ), _mm_set1_epi8( 1 )));
+			a = _mm_add_epi8( Image_PNGLoadPixel( raw + i, rowsize - i, bpp ), x );
+			Image_PNGStorePixel( out + i, a, rowsize - i, bpp );
+		}
+		break;
+	case PNG_F_PAETH:
+		for( i = 0; i < rowsize; i += bpp )
+		{
+			b = _mm_unpacklo_epi8( Image_PNGLoadPixel( prior + i, rowsize - i, bpp ), zero );
+			pa = _mm_sub_epi16( b, c );
+			pb = _mm_sub_epi16( a, c );
+			pc = Image_PNGAbs16( _mm_add_epi16( pa, pb ));
+			pa = Image_PNGAbs16( pa );
+			pb = Image_PNGAbs16( pb );
+			smin = _mm_min_epi16( pa, _mm_min_epi16( pb, pc ));
+
+			// a if pa is smallest, then b if pb is, otherwise c
+			ma = _mm_cmpeq_epi16( pa, smin );
+			mb = _mm_andnot_si128( ma, _mm_cmpeq_epi16( pb, smin ));
+			x = _mm_or_si128( _mm_or_si128( _mm_and_si128( ma, a ), _mm_and_si128( mb, b )), _mm_andnot_si128( _mm_or_si128( ma, mb ), c ));
+
+			x = _mm_add_epi8( Image_PNGLoadPixel( raw + i, rowsize - i, bpp ), _mm_packus_epi16( x, zero ));
+			Image_PNGStorePixel( out + i, x, rowsize - i, bpp );
+
+			a = _mm_unpacklo_epi8( x, zero );
+			c = b;
+		}
+		break;
+	}
+}
+#elif XASH_SIMD_NEON
+static inline uint8x8_t Image_PNGLoadPixel( const byte *p, uint left, uint bpp )
+{
+	uint32_t v = 0;
+
+	if( left >= 4 ) memcpy( &v, p, 4 );
+	else memcpy( &v, p, bpp );
+
+	return vreinterpret_u8_u32( vdup_n_u32( v ));
+}
+
+static inline void Image_PNGStorePixel( byte *p, uint8x8_t x, uint left, uint bpp )
+{
+	uint32_t v = vget_lane_u32( vreinterpret_u32_u8( x ), 0 );
+
+	if( left >= 4 ) memcpy( p, &v, 4 );
+	else memcpy( p, &v, bpp );
+}
+
+static inline void Image_PNGUnfilterSIMD( int filter, const byte *raw, const byte *prior, byte *out, uint rowsize, uint bpp )
+{
+	uint8x8_t a = vdup_n_u8( 0 ), b, x;
+	int16x8_t a16 = vdupq_n_s16( 0 ), b16, c16 = vdupq_n_s16( 0 ), pa, pb, pc, smin;
+	uint16x8_t ma, mb;
+	uint i;
+
+	switch( filter )
+	{
+	case PNG_F_SUB:
+		for( i = 0; i < rowsize; i += bpp )
+		{
+			a = vadd_u8( Image_PNGLoadPixel( raw + i, rowsize - i, bpp ), a );
+			Image_PNGStorePixel( out + i, a, rowsize - i, bpp );
+		}
+		break;
+	case PNG_F_AVERAGE:
+		for( i = 0; i < rowsize; i += bpp )
+		{
+			b = Image_PNGLoadPixel( prior + i, rowsize - i, bpp );
+			a = vadd_u8( Image_PNGLoadPixel( raw + i, rowsize - i, bpp ), vhadd_u8( a, b ));
+			Image_PNGStorePixel( out + i, a, rowsize - i, bpp );
+		}
+		break;
+	case PNG_F_PAETH:
+		for( i = 0; i < rowsize; i += bpp )
+		{
+			b16 = vreinterpretq_s16_u16( vmovl_u8( Image_PNGLoadPixel( prior + i, rowsize - i, bpp )));
+			pa = vsubq_s16( b16, c16 );
+			pb = vsubq_s16( a16, c16 );
+			pc = vabsq_s16( vaddq_s16( pa, pb ));
+			pa = vabsq_s16( pa );
+			pb = vabsq_s16( pb );
+			smin = vminq_s16( pa, vminq_s16( pb, pc ));
+
+			// a if pa is smallest, then b if pb is, otherwise c
+			ma = vceqq_s16( pa, smin );
+			mb = vceqq_s16( pb, smin );
+			x = vmovn_u16( vreinterpretq_u16_s16( vbslq_s16( ma, a16, vbslq_s16( mb, b16, c16 ))));
+
+			x = vadd_u8( Image_PNGLoadPixel( raw + i, rowsize - i, bpp ), x );
+			Image_PNGStorePixel( out + i, x, rowsize - i, bpp );
+
+			a16 = vreinterpretq_s16_u16( vmovl_u8( x ));
+			c16 = b16;
+		}
+		break;
+	}
+}
+#endif // XASH_SIMD_NEON
+
+/*
+=============
+Image_PNGUnfilterRow
+
+prior is a zeroed row for the first one
+=============
+*/
+static qboolean Image_PNGUnfilterRow( int filter, const byte *raw, const byte *prior, byte *out, uint rowsize, uint bpp )
+{
+	short	p, a, b, c, pa, pb, pc;
+	uint	i = 0;
+
+	switch( filter )
+	{
+	case PNG_F_NONE:
+		memcpy( out, raw, rowsize );
+		return true;
+	case PNG_F_UP:
+#if XASH_SIMD_SSE2
+		if( image.simd )
+		{
+			for( ; i + 16 <= rowsize; i += 16 )
+			{
+				__m128i r = _mm_loadu_si128((const __m128i *)( raw + i ));
+				__m128i u = _mm_loadu_si128((const __m128i *)( prior + i ));
+				_mm_storeu_si128((__m128i *)( out + i ), _mm_add_epi8( r, u ));
+			}
+		}
+#elif XASH_SIMD_NEON
+		if( image.simd )
+		{
+			for( ; i + 16 <= rowsize; i += 16 )
+				vst1q_u8( out + i, vaddq_u8( vld1q_u8( raw + i ), vld1q_u8( prior + i )));
+		}
+#endif
+		for( ; i < rowsize; i++ )
+			out[i] = raw[i] + prior[i];
+		return true;
+	case PNG_F_SUB:
+	case PNG_F_AVERAGE:
+	case PNG_F_PAETH:
+		break;
+	default:
+		return false;
+	}
+
+#if XASH_SIMD
+	// constant pixel size lets compiler turn memcpy into plain loads
+	if( image.simd && bpp == 4 )
+	{
+		Image_PNGUnfilterSIMD( filter, raw, prior, out, rowsize, 4 );
+		return true;
+	}
+	else if( image.simd && bpp == 3 )
+	{
+		Image_PNGUnfilterSIMD( filter, raw, prior, out, rowsize, 3 );
+		return true;
+	}
+#endif
+
+	switch( filter )
+	{
+	case PNG_F_SUB:
+		for( ; i < bpp; i++ )
+			out[i] = raw[i];
+
+		for( ; i < rowsize; i++ )
+			out[i] = raw[i] + out[i - bpp];
+		break;
+	case PNG_F_AVERAGE:
+		for( ; i < bpp; i++ )
+			out[i] = raw[i] + ( prior[i] >> 1 );
+
+		for( ; i < rowsize; i++ )
+			out[i] = raw[i] + (( out[i - bpp] + prior[i] ) >> 1 );
+		break;
+	case PNG_F_PAETH:
+		for( ; i < bpp; i++ )
+			out[i] = raw[i] + prior[i];
+
+		for( ; i < rowsize; i++ )
+		{
+			a = out[i - bpp];
+			b = prior[i];
+			c = prior[i - bpp];
+			p = a + b - c;
+			pa = abs( p - a );
+			pb = abs( p - b );
+			pc = abs( p - c );
+
+			out[i] = raw[i];
+
+			if( pc < pa && pc < pb )
+				out[i] += c;
+			else if( pb < pa )
+				out[i] += b;
+			else
+				out[i] += a;
+		}
+		break;
+	}
+
+	return true;
+}
+
+/*
+=============
+Image_PNGExpandRow
+
+converts unfiltered row of any type but RGBA to RGBA
+=============
+*/
+static void Image_PNGExpandRow( int colortype, const byte *raw, byte *pixbuf, uint width, const byte *pallete, uint plte_len, const byte *trns, uint trns_len )
+{
+	uint	i, r_alpha = 0, g_alpha = 0, b_alpha = 0;
+
+	switch( colortype )
+	{
+	case PNG_CT_RGB:
+		if( trns_len < 6 )
+			trns = NULL;
+
+		if( trns )
+		{
+			r_alpha = trns[0] << 8 | trns[1];
+			g_alpha = trns[2] << 8 | trns[3];
+			b_alpha = trns[4] << 8 | trns[5];
+		}
+
+		for( i = 0; i < width; i++, raw += 3 )
+		{
+			*pixbuf++ = raw[0];
+			*pixbuf++ = raw[1];
+			*pixbuf++ = raw[2];
+
+			if( trns && r_alpha == raw[0]
+			    && g_alpha == raw[1]
+			    && b_alpha == raw[2] )
+				*pixbuf++ = 0;
+			else
+				*pixbuf++ = 0xFF;
+		}
+		break;
+	case PNG_CT_GREY:
+		if( trns_len < 2 )
+			trns = NULL;
+
+		if( trns )
+			r_alpha = trns[0] << 8 | trns[1];
+
+		for( i = 0; i < width; i++, raw++ )
+		{
+			*pixbuf++ = raw[0];
+			*pixbuf++ = raw[0];
+			*pixbuf++ = raw[0];
+
+			if( trns && r_alpha == raw[0] )
+				*pixbuf++ = 0;
+			else
+				*pixbuf++ = 0xFF;
+		}
+		break;
+	case PNG_CT_ALPHA:
+		for( i = 0; i < width; i++, raw += 2 )
+		{
+			*pixbuf++ = raw[0];
+			*pixbuf++ = raw[0];
+			*pixbuf++ = raw[0];
+			*pixbuf++ = raw[1];
+		}
+		break;
+	case PNG_CT_PALLETE:
+		for( i = 0; i < width; i++, raw++ )
+		{
+			if( raw[0] < plte_len )
+			{
+				*pixbuf++ = pallete[3 * raw[0] + 0];
+				*pixbuf++ = pallete[3 * raw[0] + 1];
+				*pixbuf++ = pallete[3 * raw[0] + 2];
+
+				if( trns && raw[0] < trns_len )
+					*pixbuf++ = trns[raw[0]];
+				else
+					*pixbuf++ = 0xFF;
+			}
+			else
+			{
+				*pixbuf++ = 0;
+				*pixbuf++ = 0;
+				*pixbuf++ = 0;
+				*pixbuf++ = 0xFF;
+			}
+		}
+		break;
+	}
+}
+
+/*
+=============
+Image_PNGNextIDAT
+
+points inflate input to the next IDAT chunk, chunks were validated already
+=============
+*/
+static qboolean Image_PNGNextIDAT( const byte **chunk_p, z_stream *stream )
+{
+	const byte	*p = *chunk_p;
+	uint		chunk_len;
+
+	if( !p )
+		return false;
+
+	while( true )
+	{
+		memcpy( &chunk_len, p, sizeof( chunk_len ));
+		chunk_len = ntohl( chunk_len );
+
+		if( !memcmp( p + sizeof( chunk_len ), iend_sign, sizeof( iend_sign )))
+		{
+			*chunk_p = NULL;
+			return false;
+		}
+
+		if( !memcmp( p + sizeof( chunk_len ), idat_sign, sizeof( idat_sign )))
+		{
+			stream->next_in = p + sizeof( chunk_len ) + sizeof( idat_sign );
+			stream->avail_in = chunk_len;
+			*chunk_p = p + sizeof( chunk_len ) + sizeof( idat_sign ) + chunk_len + sizeof( uint );
+			return true;
+		}
+
+		p += sizeof( chunk_len ) + sizeof( idat_sign ) + chunk_len + sizeof( uint );
+	}
+}
+
 /*
 =============
 Image_LoadPNG
@@ -42,12 +434,12 @@ Image_LoadPNG
 */
 qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesize )
 {
-	int		ret;
-	short		p, a, b, c, pa, pb, pc;
-	byte		*buf_p, *pixbuf, *raw, *prior, *idat_buf = NULL, *uncompressed_buffer = NULL;
+	int		ret = Z_OK;
+	const byte	*idat_first = NULL, *chunk_p;
+	byte		*buf_p, *pixbuf, *prior, *rows;
 	byte		*pallete = NULL, *trns = NULL;
-	uint	 	chunk_len, trns_len, plte_len, crc32, crc32_check, oldsize = 0, newsize = 0, rowsize;
-	uint		uncompressed_size, pixel_size, pixel_count, i, y, filter_type, chunk_sign, r_alpha, g_alpha, b_alpha;
+	uint	 	chunk_len, trns_len = 0, plte_len = 0, crc32, crc32_check, oldsize = 0, rowsize;
+	uint		pixel_size, y, chunk_sign;
 	qboolean 	has_iend_chunk = false;
 	z_stream 	stream = {0};
 	png_t		png_hdr;
@@ -164,14 +556,12 @@ qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesi
 		if( chunk_len > INT_MAX )
 		{
 			Con_DPrintf( S_ERROR "Image_LoadPNG: Found chunk with wrong size (%s)\n", name );
-			if( idat_buf ) Mem_Free( idat_buf );
 			return false;
 		}
 
 		if( chunk_len > filesize - ( buf_p - buffer ))
 		{
 			Con_DPrintf( S_ERROR "Image_LoadPNG: Found chunk with size past file size (%s)\n", name );
-			if( idat_buf ) Mem_Free( idat_buf );
 			return false;
 		}
 
@@ -190,13 +580,12 @@ qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesi
 			pallete = buf_p + sizeof( plte_sign );
 			plte_len = chunk_len / 3;
 		}
-		// get all IDAT chunks data
+		// IDAT chunks are fed to inflate later, right from the file buffer
 		else if( !memcmp( buf_p, idat_sign, sizeof( idat_sign ) ) )
 		{
-			newsize = oldsize + chunk_len;
-			idat_buf = (byte *)Mem_Realloc( host.imagepool, idat_buf, newsize );
-			memcpy( idat_buf + oldsize, buf_p + sizeof( idat_sign ), chunk_len );
-			oldsize = newsize;
+			if( !idat_first )
+				idat_first = buf_p - sizeof( chunk_len );
+			oldsize += chunk_len;
 		}
 		else if( !memcmp( buf_p, iend_sign, sizeof( iend_sign ) ) )
 			has_iend_chunk = true;
@@ -217,7 +606,6 @@ qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesi
 		if( ntohl( crc32 ) != crc32_check )
 		{
 			Con_DPrintf( S_ERROR "Image_LoadPNG: Found chunk with wrong CRC32 sum (%s)\n", name );
-			if( idat_buf ) Mem_Free( idat_buf );
 			return false;
 		}
 
@@ -234,21 +622,18 @@ qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesi
 	if( png_hdr.ihdr_chunk.colortype == PNG_CT_PALLETE && !pallete )
 	{
 		Con_DPrintf( S_ERROR "Image_LoadPNG: PLTE chunk not found (%s)\n", name );
-		Mem_Free( idat_buf );
 		return false;
 	}
 
 	if( !has_iend_chunk )
 	{
 		Con_DPrintf( S_ERROR "Image_LoadPNG: IEND chunk not found (%s)\n", name );
-		Mem_Free( idat_buf );
 		return false;
 	}
 
 	if( chunk_len != 0 )
 	{
 		Con_DPrintf( S_ERROR "Image_LoadPNG: IEND chunk has wrong size %u (%s)\n", chunk_len, name );
-		Mem_Free( idat_buf );
 		return false;
 	}
 
@@ -274,8 +659,7 @@ qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesi
 	}
 
 	image.type = PF_RGBA_32; // always exctracted to 32-bit buffer
-	pixel_count = image.height * image.width;
-	image.size = pixel_count * 4;
+	image.size = image.height * image.width * 4;
 
 	if( png_hdr.ihdr_chunk.colortype & PNG_CT_RGB )
 		image.flags |= IMAGE_HAS_COLOR;
@@ -287,224 +671,81 @@ qboolean Image_LoadPNG( const char *name, const byte *buffer, fs_offset_t filesi
 
 	rowsize = pixel_size * image.width;
 
-	uncompressed_size = image.height * ( rowsize + 1 ); // +1 for filter
-	uncompressed_buffer = Mem_Malloc( host.imagepool, uncompressed_size );
+	// filtered row, zero row standing for the one above the image and two rows to unfilter
+	// non-RGBA images into, RGBA images are unfiltered right into the output
+	rows = Mem_Calloc( host.imagepool, ( rowsize + 1 ) + rowsize * 3 );
+	image.rgba = Mem_Malloc( host.imagepool, image.size );
 
-	stream.next_in = idat_buf;
-	stream.total_in = stream.avail_in = newsize;
-	stream.next_out = uncompressed_buffer;
-	stream.total_out = stream.avail_out = uncompressed_size;
-
-	// uncompress image
 	if( inflateInit2( &stream, MAX_WBITS ) != Z_OK )
 	{
 		Con_DPrintf( S_ERROR "Image_LoadPNG: IDAT chunk decompression failed (%s)\n", name );
-		Mem_Free( uncompressed_buffer );
-		Mem_Free( idat_buf );
+		Mem_Free( rows );
+		Mem_Free( image.rgba );
 		return false;
 	}
 
-	ret = inflate( &stream, Z_NO_FLUSH );
-	inflateEnd( &stream );
+	chunk_p = idat_first;
+	prior = rows + rowsize + 1;
 
-	Mem_Free( idat_buf );
-
-	if( ret != Z_OK && ret != Z_STREAM_END )
+	// inflate, unfilter and expand one row at a time
+	for( y = 0; y < image.height; y++ )
 	{
-		Con_DPrintf( S_ERROR "Image_LoadPNG: IDAT chunk decompression failed (%s)\n", name );
-		Mem_Free( uncompressed_buffer );
-		return false;
-	}
-
-	prior = pixbuf = image.rgba = Mem_Malloc( host.imagepool, image.size );
-
-	i = 0;
+		stream.next_out = rows;
+		stream.avail_out = rowsize + 1;
 
-	raw = uncompressed_buffer;
-
-	if( png_hdr.ihdr_chunk.colortype != PNG_CT_RGBA )
-		prior = pixbuf = raw;
-
-	filter_type = *raw++;
-
-	// decode adaptive filter
-	switch( filter_type )
-	{
-	case PNG_F_NONE:
-	case PNG_F_UP:
-		for( ; i < rowsize; i++ )
-			pixbuf[i] = raw[i];
-		break;
-	case PNG_F_SUB:
-	case PNG_F_PAETH:
-		for( ; i < pixel_size; i++ )
-			pixbuf[i] = raw[i];
-
-		for( ; i < rowsize; i++ )
-			pixbuf[i] = raw[i] + pixbuf[i - pixel_size];
-		break;
-	case PNG_F_AVERAGE:
-		for( ; i < pixel_size; i++ )
-			pixbuf[i] = raw[i];
+		while( stream.avail_out > 0 && ret != Z_STREAM_END )
+		{
+			qboolean more = true;
 
-		for( ; i < rowsize; i++ )
-			pixbuf[i] = raw[i] + ( pixbuf[i - pixel_size] >> 1 );
-		break;
-	default:
-		Con_DPrintf( S_ERROR "Image_LoadPNG: Found unknown filter type (%s)\n", name );
-		Mem_Free( uncompressed_buffer );
-		Mem_Free( image.rgba );
-		return false;
-	}
+			if( stream.avail_in == 0 )
+				more = Image_PNGNextIDAT( &chunk_p, &stream );
 
-	for( y = 1; y < image.height; y++ )
-	{
-		i = 0;
+			// inflate may still hold some output when input is over
+			ret = inflate( &stream, Z_NO_FLUSH );
 
-		pixbuf += rowsize;
-		raw += rowsize;
+			if( ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR )
+				break;
 
-		filter_type = *raw++;
+			if( !more && ret == Z_BUF_ERROR )
+				break;
+		}
 
-		switch( filter_type )
-		{
-		case PNG_F_NONE:
-			for( ; i < rowsize; i++ )
-				pixbuf[i] = raw[i];
+		if( ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR )
 			break;
-		case PNG_F_SUB:
-			for( ; i < pixel_size; i++ )
-				pixbuf[i] = raw[i];
 
-			for( ; i < rowsize; i++ )
-				pixbuf[i] = raw[i] + pixbuf[i - pixel_size];
-			break;
-		case PNG_F_UP:
-			for( ; i < rowsize; i++ )
-				pixbuf[i] = raw[i] + prior[i];
-			break;
-		case PNG_F_AVERAGE:
-			for( ; i < pixel_size; i++ )
-				pixbuf[i] = raw[i] + ( prior[i] >> 1 );
+		// truncated stream, rest of the image is black
+		if( stream.avail_out > 0 )
+			memset( stream.next_out, 0, stream.avail_out );
 
-			for( ; i < rowsize; i++ )
-				pixbuf[i] = raw[i] + ( ( pixbuf[i - pixel_size] + prior[i] ) >> 1 );
-			break;
-		case PNG_F_PAETH:
-			for( ; i < pixel_size; i++ )
-				pixbuf[i] = raw[i] + prior[i];
+		if( png_hdr.ihdr_chunk.colortype == PNG_CT_RGBA )
+			pixbuf = image.rgba + y * rowsize;
+		else pixbuf = rows + rowsize + 1 + rowsize * ( 1 + ( y & 1 ));
 
-			for( ; i < rowsize; i++ )
-			{
-				a = pixbuf[i - pixel_size];
-				b = prior[i];
-				c = prior[i - pixel_size];
-				p = a + b - c;
-				pa = abs( p - a );
-				pb = abs( p - b );
-				pc = abs( p - c );
-
-				pixbuf[i] = raw[i];
-
-				if( pc < pa && pc < pb )
-					pixbuf[i] += c;
-				else if( pb < pa )
-					pixbuf[i] += b;
-				else
-					pixbuf[i] += a;
-			}
-			break;
-		default:
+		if( !Image_PNGUnfilterRow( rows[0], rows + 1, prior, pixbuf, rowsize, pixel_size ))
+		{
 			Con_DPrintf( S_ERROR "Image_LoadPNG: Found unknown filter type (%s)\n", name );
-			Mem_Free( uncompressed_buffer );
+			inflateEnd( &stream );
+			Mem_Free( rows );
 			Mem_Free( image.rgba );
 			return false;
 		}
 
+		if( png_hdr.ihdr_chunk.colortype != PNG_CT_RGBA )
+			Image_PNGExpandRow( png_hdr.ihdr_chunk.colortype, pixbuf, image.rgba + y * image.width * 4, image.width, pallete, plte_len, trns, trns_len );
+
 		prior = pixbuf;
 	}
 
-	pixbuf = image.rgba;
-	raw = uncompressed_buffer;
+	inflateEnd( &stream );
+	Mem_Free( rows );
 
-	switch( png_hdr.ihdr_chunk.colortype )
+	if( y < image.height )
 	{
-	case PNG_CT_RGB:
-		if( trns )
-		{
-			r_alpha = trns[0] << 8 | trns[1];
-			g_alpha = trns[2] << 8 | trns[3];
-			b_alpha = trns[4] << 8 | trns[5];
-		}
-
-		for( y = 0; y < pixel_count; y++, raw += pixel_size )
-		{
-			*pixbuf++ = raw[0];
-			*pixbuf++ = raw[1];
-			*pixbuf++ = raw[2];
-
-			if( trns && r_alpha == raw[0]
-			    && g_alpha == raw[1]
-			    && b_alpha == raw[2] )
-				*pixbuf++ = 0;
-			else
-				*pixbuf++ = 0xFF;
-		}
-		break;
-	case PNG_CT_GREY:
-		if( trns )
-			r_alpha = trns[0] << 8 | trns[1];
-
-		for( y = 0; y < pixel_count; y++, raw += pixel_size )
-		{
-			*pixbuf++ = raw[0];
-			*pixbuf++ = raw[0];
-			*pixbuf++ = raw[0];
-
-			if( trns && r_alpha == raw[0] )
-				*pixbuf++ = 0;
-			else
-				*pixbuf++ = 0xFF;
-		}
-		break;
-	case PNG_CT_ALPHA:
-		for( y = 0; y < pixel_count; y++, raw += pixel_size )
-		{
-			*pixbuf++ = raw[0];
-			*pixbuf++ = raw[0];
-			*pixbuf++ = raw[0];
-			*pixbuf++ = raw[1];
-		}
-		break;
-	case PNG_CT_PALLETE:
-		for( y = 0; y < pixel_count; y++, raw += pixel_size )
-		{
-			if( raw[0] < plte_len )
-			{
-				*pixbuf++ = pallete[3 * raw[0] + 0];
-				*pixbuf++ = pallete[3 * raw[0] + 1];
-				*pixbuf++ = pallete[3 * raw[0] + 2];
-
-				if( trns && raw[0] < trns_len )
-					*pixbuf++ = trns[raw[0]];
-				else
-					*pixbuf++ = 0xFF;
-			}
-			else
-			{
-				*pixbuf++ = 0;
-				*pixbuf++ = 0;
-				*pixbuf++ = 0;
-				*pixbuf++ = 0xFF;
-			}
-		}
-		break;
-	default:
-		break;
+		Con_DPrintf( S_ERROR "Image_LoadPNG: IDAT chunk decompression failed (%s)\n", name );
+		Mem_Free( image.rgba );
+		return false;
 	}
 
-	Mem_Free( uncompressed_buffer );
-
 	return true;
 }
 
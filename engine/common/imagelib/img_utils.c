@@ -15,6 +15,7 @@ GNU General Public License for more details.
 
 #include "imagelib.h"
 #include "xash3d_mathlib.h"
+#include "xash3d_simd.h"
 #include "mod_local.h"
 
 #define LERPBYTE( i )	r = resamplerow1[i]; out[i] = (byte)(((( resamplerow2[i] - r ) * lerp)>>16 ) + r )
@@ -162,6 +163,10 @@ void Image_Init( void )
 	}
 
 	image.tempbuffer = NULL;
+
+#if XASH_SIMD
+	image.simd = !Sys_CheckParm( "-nosimd" );
+#endif
 }
 
 void Image_Shutdown( void )
@@ -585,6 +590,311 @@ void Image_CopyParms( rgbdata_t *src )
 	memcpy( image.fogParams, src->fogParams, sizeof( image.fogParams ));
 }
 
+/*
+==============================================================
+
+VECTORIZED KERNELS
+
+every kernel must produce exactly the same output as the plain C
+loop it replaces, image.simd switches between them at runtime
+==============================================================
+*/
+#if XASH_SIMD_SSE2
+// floor( d * lerp / 65536 ), same as in scalar code, where lerp is 0..65535
+// mulhi treats lerp as signed, so add 'd' back for lerp >= 32768
+static inline __m128i Image_MulLerp_SSE2( __m128i d, __m128i lerp )
+{
+	return _mm_add_epi16( _mm_mulhi_epi16( d, lerp ), _mm_and_si128( d, _mm_srai_epi16( lerp, 15 )));
+}
+
+static inline __m128i Image_Lerp8_SSE2( __m128i a, __m128i b, __m128i lerp )
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i alo = _mm_unpacklo_epi8( a, zero );
+	__m128i ahi = _mm_unpackhi_epi8( a, zero );
+	__m128i lo = _mm_add_epi16( alo, Image_MulLerp_SSE2( _mm_sub_epi16( _mm_unpacklo_epi8( b, zero ), alo ), lerp ));
+	__m128i hi = _mm_add_epi16( ahi, Image_MulLerp_SSE2( _mm_sub_epi16( _mm_unpackhi_epi8( b, zero ), ahi ), lerp ));
+
+	return _mm_packus_epi16( lo, hi );
+}
+
+static inline void Image_Transpose4x4_SSE2( __m128i *r0, __m128i *r1, __m128i *r2, __m128i *r3 )
+{
+	__m128i t0 = _mm_unpacklo_epi32( *r0, *r1 );
+	__m128i t1 = _mm_unpacklo_epi32( *r2, *r3 );
+	__m128i t2 = _mm_unpackhi_epi32( *r0, *r1 );
+	__m128i t3 = _mm_unpackhi_epi32( *r2, *r3 );
+
+	*r0 = _mm_unpacklo_epi64( t0, t1 );
+	*r1 = _mm_unpackhi_epi64( t0, t1 );
+	*r2 = _mm_unpacklo_epi64( t2, t3 );
+	*r3 = _mm_unpackhi_epi64( t2, t3 );
+}
+
+#define Image_Reverse4_SSE2( v ) _mm_shuffle_epi32(( v ), _MM_SHUFFLE( 0, 1, 2, 3 ))
+#elif XASH_SIMD_NEON
+// floor( d * lerp / 65536 ), widened to 32 bits because lerp is 0..65535
+static inline int16x8_t Image_MulLerp_NEON( int16x8_t d, int32x4_t lerplo, int32x4_t lerphi )
+{
+	int32x4_t lo = vshrq_n_s32( vmulq_s32( vmovl_s16( vget_low_s16( d )), lerplo ), 16 );
+	int32x4_t hi = vshrq_n_s32( vmulq_s32( vmovl_s16( vget_high_s16( d )), lerphi ), 16 );
+
+	return vcombine_s16( vmovn_s32( lo ), vmovn_s32( hi ));
+}
+
+static inline uint8x8_t Image_Lerp8_NEON( uint8x8_t a, uint8x8_t b, int32x4_t lerplo, int32x4_t lerphi )
+{
+	int16x8_t a16 = vreinterpretq_s16_u16( vmovl_u8( a ));
+	int16x8_t d = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( b )), a16 );
+
+	return vqmovun_s16( vaddq_s16( a16, Image_MulLerp_NEON( d, lerplo, lerphi )));
+}
+
+static inline void Image_Transpose4x4_NEON( uint32x4_t *r0, uint32x4_t *r1, uint32x4_t *r2, uint32x4_t *r3 )
+{
+	uint32x4x2_t t0 = vtrnq_u32( *r0, *r1 );
+	uint32x4x2_t t1 = vtrnq_u32( *r2, *r3 );
+
+	*r0 = vcombine_u32( vget_low_u32( t0.val[0] ), vget_low_u32( t1.val[0] ));
+	*r1 = vcombine_u32( vget_low_u32( t0.val[1] ), vget_low_u32( t1.val[1] ));
+	*r2 = vcombine_u32( vget_high_u32( t0.val[0] ), vget_high_u32( t1.val[0] ));
+	*r3 = vcombine_u32( vget_high_u32( t0.val[1] ), vget_high_u32( t1.val[1] ));
+}
+
+static inline uint32x4_t Image_Reverse4_NEON( uint32x4_t v )
+{
+	v = vrev64q_u32( v );
+	return vcombine_u32( vget_high_u32( v ), vget_low_u32( v ));
+}
+#endif // XASH_SIMD_NEON
+
+#if XASH_SIMD
+/*
+================
+Image_LerpRowsSIMD
+
+out = row1 + ( row2 - row1 ) * lerp, for every byte
+================
+*/
+static void Image_LerpRowsSIMD( const byte *row1, const byte *row2, byte *out, int count, int lerp )
+{
+	int	i = 0, r;
+#if XASH_SIMD_SSE2
+	__m128i	l = _mm_set1_epi16((short)lerp );
+
+	for( ; i + 16 <= count; i += 16 )
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)( row1 + i ));
+		__m128i b = _mm_loadu_si128((const __m128i *)( row2 + i ));
+		_mm_storeu_si128((__m128i *)( out + i ), Image_Lerp8_SSE2( a, b, l ));
+	}
+#else
+	int32x4_t	l = vdupq_n_s32( lerp );
+
+	for( ; i + 8 <= count; i += 8 )
+		vst1_u8( out + i, Image_Lerp8_NEON( vld1_u8( row1 + i ), vld1_u8( row2 + i ), l, l ));
+#endif
+
+	for( ; i < count; i++ )
+	{
+		r = row1[i];
+		out[i] = (byte)((((row2[i] - r) * lerp)>>16) + r);
+	}
+}
+
+/*
+================
+Image_Resample32LerpLineSIMD
+
+two pixels per iteration while both of them have
+a neighbour to lerp to, returns how many were done
+================
+*/
+static int Image_Resample32LerpLineSIMD( const byte *in, byte *out, int endx, int outwidth, int fstep )
+{
+	int	j, f, x0, x1, l0, l1;
+
+	for( j = 0, f = 0; j + 2 <= outwidth; j += 2, f += fstep * 2 )
+	{
+		x0 = f >> 16;
+		x1 = ( f + fstep ) >> 16;
+
+		if( x1 >= endx )
+			break;
+
+		l0 = f & 0xFFFF;
+		l1 = ( f + fstep ) & 0xFFFF;
+#if XASH_SIMD_SSE2
+		{
+			// a0 a1 b0 b1, where b is the right neighbour of a
+			__m128i p0 = _mm_loadl_epi64((const __m128i *)( in + x0 * 4 ));
+			__m128i p1 = _mm_loadl_epi64((const __m128i *)( in + x1 * 4 ));
+			__m128i v = _mm_unpacklo_epi32( p0, p1 );
+			__m128i l = _mm_set_epi16((short)l1, (short)l1, (short)l1, (short)l1, (short)l0, (short)l0, (short)l0, (short)l0 );
+			__m128i r = Image_Lerp8_SSE2( v, _mm_srli_si128( v, 8 ), l );
+			_mm_storel_epi64((__m128i *)( out + j * 4 ), r );
+		}
+#else
+		{
+			uint32x2x2_t v = vzip_u32( vreinterpret_u32_u8( vld1_u8( in + x0 * 4 )), vreinterpret_u32_u8( vld1_u8( in + x1 * 4 )));
+			uint8x8_t r = Image_Lerp8_NEON( vreinterpret_u8_u32( v.val[0] ), vreinterpret_u8_u32( v.val[1] ), vdupq_n_s32( l0 ), vdupq_n_s32( l1 ));
+			vst1_u8( out + j * 4, r );
+		}
+#endif
+	}
+
+	return j;
+}
+
+/*
+================
+Image_Flip32SIMD
+
+same as generic flip, but for 32-bit pixels only,
+rotation is done by transposing 4x4 pixel blocks
+================
+*/
+static void Image_Flip32SIMD( const byte *in, byte *out, int width, int height, int flags )
+{
+	const uint	*src = (const uint *)in;
+	uint	*dst = (uint *)out;
+	int	row_inc = FBitSet( flags, IMAGE_FLIP_Y ) ? -width : width;
+	int	col_inc = FBitSet( flags, IMAGE_FLIP_X ) ? -1 : 1;
+	int	row_ofs = FBitSet( flags, IMAGE_FLIP_Y ) ? ( height - 1 ) * width : 0;
+	int	col_ofs = FBitSet( flags, IMAGE_FLIP_X ) ? ( width - 1 ) : 0;
+	const uint	*line;
+	int	x, y, yy, i;
+
+	src += row_ofs + col_ofs;
+
+	if( !FBitSet( flags, IMAGE_ROT_90 ))
+	{
+		for( y = 0; y < height; y++, dst += width )
+		{
+			line = src + y * row_inc;
+
+			if( col_inc > 0 )
+			{
+				memcpy( dst, line, width * 4 );
+				continue;
+			}
+
+			// line points to the last pixel
+			for( x = 0; x + 4 <= width; x += 4 )
+			{
+#if XASH_SIMD_SSE2
+				__m128i v = _mm_loadu_si128((const __m128i *)( line - x - 3 ));
+				_mm_storeu_si128((__m128i *)( dst + x ), Image_Reverse4_SSE2( v ));
+#else
+				vst1q_u32( dst + x, Image_Reverse4_NEON( vld1q_u32( line - x - 3 )));
+#endif
+			}
+
+			for( ; x < width; x++ )
+				dst[x] = line[-x];
+		}
+		return;
+	}
+
+	// out[x][y] = source pixel at column x and row y
+	for( x = 0; x + 4 <= width; x += 4 )
+	{
+		for( y = 0; y + 4 <= height; y += 4 )
+		{
+#if XASH_SIMD_SSE2
+			__m128i r[4];
+
+			for( i = 0; i < 4; i++ )
+			{
+				line = src + ( y + i ) * row_inc + x * col_inc;
+				if( col_inc > 0 ) r[i] = _mm_loadu_si128((const __m128i *)line );
+				else r[i] = Image_Reverse4_SSE2( _mm_loadu_si128((const __m128i *)( line - 3 )));
+			}
+
+			Image_Transpose4x4_SSE2( &r[0], &r[1], &r[2], &r[3] );
+
+			for( i = 0; i < 4; i++ )
+				_mm_storeu_si128((__m128i *)( dst + ( x + i ) * height + y ), r[i] );
+#else
+			uint32x4_t r[4];
+
+			for( i = 0; i < 4; i++ )
+			{
+				line = src + ( y + i ) * row_inc + x * col_inc;
+				if( col_inc > 0 ) r[i] = vld1q_u32( line );
+				else r[i] = Image_Reverse4_NEON( vld1q_u32( line - 3 ));
+			}
+
+			Image_Transpose4x4_NEON( &r[0], &r[1], &r[2], &r[3] );
+
+			for( i = 0; i < 4; i++ )
+				vst1q_u32( dst + ( x + i ) * height + y, r[i] );
+#endif
+		}
+
+		// bottom rows that don't fill a block
+		for( i = 0; i < 4; i++ )
+		{
+			for( yy = y; yy < height; yy++ )
+				dst[( x + i ) * height + yy] = src[yy * row_inc + ( x + i ) * col_inc];
+		}
+	}
+
+	// right columns that don't fill a block
+	for( ; x < width; x++ )
+	{
+		for( y = 0; y < height; y++ )
+			dst[x * height + y] = src[y * row_inc + x * col_inc];
+	}
+}
+
+/*
+================
+Image_LumaMaskSIMD
+
+keep pixels >= 224 when 'fullbright' is set, otherwise keep pixels < 224
+================
+*/
+static void Image_LumaMaskSIMD( const byte *in, byte *out, int count, qboolean fullbright )
+{
+	int	i = 0;
+#if XASH_SIMD_SSE2
+	const __m128i	lumastart = _mm_set1_epi8((char)224 );
+	const __m128i	lumaprev = _mm_set1_epi8((char)223 );
+
+	for( ; i + 16 <= count; i += 16 )
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)( in + i ));
+		__m128i mask;
+
+		if( fullbright ) mask = _mm_cmpeq_epi8( _mm_max_epu8( v, lumastart ), v );
+		else mask = _mm_cmpeq_epi8( _mm_min_epu8( v, lumaprev ), v );
+
+		_mm_storeu_si128((__m128i *)( out + i ), _mm_and_si128( v, mask ));
+	}
+#else
+	const uint8x16_t	lumastart = vdupq_n_u8( 224 );
+
+	for( ; i + 16 <= count; i += 16 )
+	{
+		uint8x16_t v = vld1q_u8( in + i );
+		uint8x16_t mask;
+
+		if( fullbright ) mask = vcgeq_u8( v, lumastart );
+		else mask = vcltq_u8( v, lumastart );
+
+		vst1q_u8( out + i, vandq_u8( v, mask ));
+	}
+#endif
+
+	for( ; i < count; i++ )
+	{
+		if( fullbright ) out[i] = in[i] >= 224 ? in[i] : 0;
+		else out[i] = in[i] < 224 ? in[i] : 0;
+	}
+}
+#endif // XASH_SIMD
+
 /*
 ============
 Image_Copy8bitRGBA
@@ -605,6 +915,11 @@ qboolean Image_Copy8bitRGBA( const byte *in, byte *out, int pixels )
 	// this is a base image with luma - clear luma pixels
 	if( image.flags & IMAGE_HAS_LUMA )
 	{
+#if XASH_SIMD
+		if( image.simd )
+			Image_LumaMaskSIMD( fin, fin, image.width * image.height, false );
+		else
+#endif
 		for( i = 0; i < image.width * image.height; i++ )
 			fin[i] = fin[i] < 224 ? fin[i] : 0;
 	}
@@ -663,12 +978,21 @@ qboolean Image_Copy8bitRGBA( const byte *in, byte *out, int pixels )
 
 static void Image_Resample32LerpLine( const byte *in, byte *out, int inwidth, int outwidth )
 {
-	int	j, xi, oldx = 0, f, fstep, endx, lerp;
+	int	j = 0, xi, oldx = 0, f, fstep, endx, lerp;
 
 	fstep = (int)(inwidth * 65536.0f / outwidth);
 	endx = (inwidth-1);
 
-	for( j = 0, f = 0; j < outwidth; j++, f += fstep )
+#if XASH_SIMD
+	// vector code does the most of the line, the rest continues below
+	if( image.simd )
+	{
+		j = Image_Resample32LerpLineSIMD( in, out, endx, outwidth, fstep );
+		out += j * 4;
+	}
+#endif
+
+	for( f = j * fstep; j < outwidth; j++, f += fstep )
 	{
 		xi = f>>16;
 		if( xi != oldx )
@@ -763,6 +1087,15 @@ void Image_Resample32Lerp( const void *indata, int inwidth, int inheight, void *
 				oldy = yi;
 			}
 
+#if XASH_SIMD
+			if( image.simd )
+			{
+				Image_LerpRowsSIMD( resamplerow1, resamplerow2, out, outwidth4, lerp );
+				out += outwidth4;
+				continue;
+			}
+#endif
+
 			j = outwidth - 4;
 
 			while( j >= 0 )
@@ -910,6 +1243,15 @@ void Image_Resample24Lerp( const void *indata, int inwidth, int inheight, void *
 				oldy = yi;
 			}
 
+#if XASH_SIMD
+			if( image.simd )
+			{
+				Image_LerpRowsSIMD( resamplerow1, resamplerow2, out, outwidth3, lerp );
+				out += outwidth3;
+				continue;
+			}
+#endif
+
 			j = outwidth - 4;
 
 			while( j >= 0 )
@@ -1150,6 +1492,11 @@ byte *Image_FlipInternal( const byte *in, word *srcwidth, word *srcheight, int t
 
 	out = image.tempbuffer;
 
+#if XASH_SIMD
+	if( image.simd && samples == 4 )
+		Image_Flip32SIMD( in, out, width, height, flags );
+	else
+#endif
 	if( flip_i )
 	{
 		for( x = 0, line = in + col_ofs; x < width; x++, line += col_inc )
@@ -1193,6 +1540,13 @@ byte *Image_CreateLumaInternal( byte *fin, int width, int height, int type, int
 	case PF_INDEXED_24:
 	case PF_INDEXED_32:
 		out = image.tempbuffer = Mem_Realloc( host.imagepool, image.tempbuffer, width * height );
+#if XASH_SIMD
+		if( image.simd )
+		{
+			Image_LumaMaskSIMD( fin, out, width * height, true );
+			break;
+		}
+#endif
 		for( i = 0; i < width * height; i++ )
 			*out++ = fin[i] >= 224 ? fin[i] : 0;
 		break;
@@ -178,11 +178,33 @@ typedef struct
 	size_t		*count;
 } mlumpinfo_t;
 
+// decompressed PVS rows of the current world, indexed by cluster
+typedef struct pvscache_s
+{
+	byte		*rows;		// rowsize bytes per row
+	int		*slots;		// cluster -> slot, -1 if not cached
+	int		*clusters;	// slot -> cluster
+	int		*prev;		// LRU chain, head is most recently used
+	int		*next;
+	int		head;
+	int		tail;
+	int		numslots;
+	int		numused;
+	int		numclusters;
+	size_t		rowsize;
+	qboolean		resident;		// every row is precomputed, no LRU
+	uint		hits;
+	uint		misses;
+} pvscache_t;
+
+#define PVS_CACHE_MIN_SLOTS	16
+
 world_static_t		world;
 static dbspmodel_t		srcmodel;
 static loadstat_t		loadstat;
 static model_t		*worldmodel;
 static byte		g_visdata[(MAX_MAP_LEAFS+7)/8];	// intermediate buffer
+static pvscache_t		g_pvscache;
 static mlumpstat_t		worldstats[HEADER_LUMPS+EXTRA_LUMPS];
 static mlumpinfo_t		srclumps[HEADER_LUMPS] =
 {
@@ -565,6 +587,10 @@ void Mod_PrintWorldStats_f( void )
 	Con_Printf( "Supports transparency world water: %s\n", FBitSet( world.flags, FWORLD_WATERALPHA ) ? "Yes" : "No" );
 	Con_Printf( "Lighting: %s\n", FBitSet( w->flags, MODEL_COLORED_LIGHTING ) ? "colored" : "monochrome" );
 	Con_Printf( "World total leafs: %d\n", worldmodel->numleafs + 1 );
+	if( g_pvscache.resident )
+		Con_Printf( "PVS cache: %d rows precomputed, %s\n", g_pvscache.numclusters, Q_memprint( g_pvscache.rowsize * g_pvscache.numclusters ));
+	else if( g_pvscache.rows )
+		Con_Printf( "PVS cache: %d of %d rows, %u hits, %u misses\n", g_pvscache.numslots, g_pvscache.numclusters, g_pvscache.hits, g_pvscache.misses );
 	Con_Printf( "original name: ^1%s\n", worldmodel->name );
 	Con_Printf( "internal name: ^2%s\n", world.message[0] ? world.message : "none" );
 	Con_Printf( "map compiler: ^3%s\n", world.compiler[0] ? world.compiler : "unknown" );
@@ -580,28 +606,24 @@ void Mod_PrintWorldStats_f( void )
 */
 /*
 ===================
-Mod_DecompressPVS
+Mod_DecompressPVSRow
+
+unpacks exactly visbytes bytes of RLE vis row
 ===================
 */
-byte *Mod_DecompressPVS( const byte *in, int visbytes )
+static void Mod_DecompressPVSRow( const byte *in, byte *out, int visbytes )
 {
-	byte	*out;
+	byte	*end = out + visbytes;
 	int	c;
 
-	out = g_visdata;
-
 	if( !in )
 	{
 		// no vis info, so make all visible
-		while( visbytes )
-		{
-			*out++ = 0xff;
-			visbytes--;
-		}
-		return g_visdata;
+		memset( out, 0xFF, visbytes );
+		return;
 	}
 
-	do
+	while( out < end )
 	{
 		if( *in )
 		{
@@ -609,17 +631,192 @@ byte *Mod_DecompressPVS( const byte *in, int visbytes )
 			continue;
 		}
 
-		c = in[1];
+		c = Q_min( in[1], end - out );
 		in += 2;
 
-		while( c )
+		memset( out, 0, c );
+		out += c;
+	}
+}
+
+/*
+===================
+Mod_DecompressPVS
+===================
+*/
+byte *Mod_DecompressPVS( const byte *in, int visbytes )
+{
+	Mod_DecompressPVSRow( in, g_visdata, visbytes );
+	return g_visdata;
+}
+
+/*
+===================
+Mod_MergePVS
+
+ORs src bits into dst, a machine word at a time
+===================
+*/
+void Mod_MergePVS( byte *dst, const byte *src, size_t bytes )
+{
+	size_t	a, b;
+
+	// memcpy keeps unaligned buffers safe and compiles to plain loads
+	for( ; bytes >= sizeof( a ); bytes -= sizeof( a ))
+	{
+		memcpy( &a, dst, sizeof( a ));
+		memcpy( &b, src, sizeof( b ));
+		a |= b;
+		memcpy( dst, &a, sizeof( a ));
+		dst += sizeof( a );
+		src += sizeof( b );
+	}
+
+	while( bytes-- )
+		*dst++ |= *src++;
+}
+
+/*
+===================
+Mod_SetupPVSCache
+
+precomputes every vis row if the map fits into budget,
+otherwise allocates LRU slots for as many rows as fit
+===================
+*/
+static void Mod_SetupPVSCache( model_t *mod, size_t budget )
+{
+	pvscache_t	*c = &g_pvscache;
+	mleaf_t		*leaf;
+	int		i;
+
+	memset( c, 0, sizeof( *c ));
+
+	if( !mod->visdata || !world.visbytes || !mod->numsubmodels )
+		return;
+
+	c->numclusters = Q_min( mod->submodels[0].visleafs, mod->numleafs - 1 );
+	c->rowsize = ALIGN( world.visbytes, 16 );
+
+	if( c->numclusters <= 0 )
+		return;
+
+	if( c->rowsize * c->numclusters <= budget )
+	{
+		c->resident = true;
+		c->numslots = c->numused = c->numclusters;
+		c->rows = Mem_Malloc( mod->mempool, c->rowsize * c->numclusters );
+
+		// solid leaf 0 has no visdata, cluster N belongs to leaf N + 1
+		for( i = 0, leaf = mod->leafs + 1; i < c->numclusters; i++, leaf++ )
+			Mod_DecompressPVSRow( leaf->compressed_vis, c->rows + c->rowsize * i, world.visbytes );
+		return;
+	}
+
+	c->numslots = Q_max( budget / c->rowsize, PVS_CACHE_MIN_SLOTS );
+	c->numslots = Q_min( c->numslots, c->numclusters );
+	c->rows = Mem_Malloc( mod->mempool, c->rowsize * c->numslots );
+	c->slots = Mem_Malloc( mod->mempool, sizeof( *c->slots ) * c->numclusters );
+	c->clusters = Mem_Malloc( mod->mempool, sizeof( *c->clusters ) * c->numslots );
+	c->prev = Mem_Malloc( mod->mempool, sizeof( *c->prev ) * c->numslots );
+	c->next = Mem_Malloc( mod->mempool, sizeof( *c->next ) * c->numslots );
+	c->head = c->tail = -1;
+
+	for( i = 0; i < c->numclusters; i++ )
+		c->slots[i] = -1;
+}
+
+/*
+===================
+Mod_PVSCacheUnlink
+===================
+*/
+static void Mod_PVSCacheUnlink( pvscache_t *c, int slot )
+{
+	if( c->prev[slot] >= 0 )
+		c->next[c->prev[slot]] = c->next[slot];
+	else c->head = c->next[slot];
+
+	if( c->next[slot] >= 0 )
+		c->prev[c->next[slot]] = c->prev[slot];
+	else c->tail = c->prev[slot];
+}
+
+/*
+===================
+Mod_PVSCacheLink
+===================
+*/
+static void Mod_PVSCacheLink( pvscache_t *c, int slot )
+{
+	c->prev[slot] = -1;
+	c->next[slot] = c->head;
+
+	if( c->head >= 0 )
+		c->prev[c->head] = slot;
+	else c->tail = slot;
+
+	c->head = slot;
+}
+
+/*
+===================
+Mod_LeafPVS
+
+Returns decompressed PVS row of the world leaf
+NOTE: can return NULL. The row must not be modified.
+It stays valid until map change when the whole map
+is precomputed, otherwise at least until the next call
+===================
+*/
+const byte *Mod_LeafPVS( const mleaf_t *leaf )
+{
+	pvscache_t	*c = &g_pvscache;
+	int		slot;
+
+	if( !leaf || leaf->cluster < 0 )
+		return NULL;
+
+	if( !c->rows || leaf->cluster >= c->numclusters )
+		return Mod_DecompressPVS( leaf->compressed_vis, world.visbytes );
+
+	if( c->resident )
+		return c->rows + c->rowsize * leaf->cluster;
+
+	slot = c->slots[leaf->cluster];
+
+	if( slot >= 0 )
+	{
+		c->hits++;
+
+		if( slot != c->head )
 		{
-			*out++ = 0;
-			c--;
+			Mod_PVSCacheUnlink( c, slot );
+			Mod_PVSCacheLink( c, slot );
 		}
-	} while( out - g_visdata < visbytes );
+		return c->rows + c->rowsize * slot;
+	}
 
-	return g_visdata;
+	c->misses++;
+
+	if( c->numused < c->numslots )
+	{
+		slot = c->numused++;
+	}
+	else
+	{
+		// evict least recently used row
+		slot = c->tail;
+		c->slots[c->clusters[slot]] = -1;
+		Mod_PVSCacheUnlink( c, slot );
+	}
+
+	Mod_DecompressPVSRow( leaf->compressed_vis, c->rows + c->rowsize * slot, world.visbytes );
+	c->clusters[slot] = leaf->cluster;
+	c->slots[leaf->cluster] = slot;
+	Mod_PVSCacheLink( c, slot );
+
+	return c->rows + c->rowsize * slot;
 }
 
 /*
@@ -651,7 +848,7 @@ Returns PVS data for a given point
 NOTE: can return NULL
 ==================
 */
-byte *Mod_GetPVSForPoint( const vec3_t p )
+const byte *Mod_GetPVSForPoint( const vec3_t p )
 {
 	mnode_t	*node;
 	mleaf_t	*leaf = NULL;
@@ -670,9 +867,7 @@ byte *Mod_GetPVSForPoint( const vec3_t p )
 		node = node->children[PlaneDiff( p, node->plane ) <= 0];
 	}
 
-	if( leaf && leaf->cluster >= 0 )
-		return Mod_DecompressPVS( leaf->compressed_vis, world.visbytes );
-	return NULL;
+	return Mod_LeafPVS( leaf );
 }
 
 /*
@@ -683,8 +878,6 @@ Mod_FatPVS_RecursiveBSPNode
 */
 static void Mod_FatPVS_RecursiveBSPNode( const vec3_t org, float radius, byte *visbuffer, int visbytes, mnode_t *node )
 {
-	int	i;
-
 	while( node->contents >= 0 )
 	{
 		float d = PlaneDiff( org, node->plane );
@@ -703,12 +896,7 @@ static void Mod_FatPVS_RecursiveBSPNode( const vec3_t org, float radius, byte *v
 
 	// if this leaf is in a cluster, accumulate the vis bits
 	if(((mleaf_t *)node)->cluster >= 0 )
-	{
-		byte	*vis = Mod_DecompressPVS( ((mleaf_t *)node)->compressed_vis, world.visbytes );
-
-		for( i = 0; i < visbytes; i++ )
-			visbuffer[i] |= vis[i];
-	}
+		Mod_MergePVS( visbuffer, Mod_LeafPVS( (mleaf_t *)node ), visbytes );
 }
 
 /*
@@ -3168,11 +3356,19 @@ void Mod_LoadBrushModel( model_t *mod, const void *buffer, qboolean *loaded )
 	mod->mempool = Mem_AllocPool( poolname );
 	mod->type = mod_brush;
 
+	// rows of the previous world were freed with its mempool
+	if( world.loading )
+		memset( &g_pvscache, 0, sizeof( g_pvscache ));
+
 	// loading all the lumps into heap
 	if( !Mod_LoadBmodelLumps( mod, buffer, world.loading ))
 		return; // there were errors
 
-	if( world.loading ) worldmodel = mod;
+	if( world.loading )
+	{
+		worldmodel = mod;
+		Mod_SetupPVSCache( mod, (size_t)Q_max( mod_pvscache.value, 0.0f ) * 1024 );
+	}
 
 	if( loaded ) *loaded = true;	// all done
 }
@@ -3410,3 +3606,145 @@ int GAME_EXPORT Mod_SaveLump( const char *filename, const int lump, void *lumpda
 	FS_Close( f );
 	return LUMP_SAVE_OK;
 }
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+#define TEST_PVS_CLUSTERS	300
+#define TEST_PVS_LOOKUPS	5000
+
+static uint test_pvs_seed;
+
+static uint Test_PVSRand( void )
+{
+	test_pvs_seed = test_pvs_seed * 1103515245 + 12345;
+	return test_pvs_seed >> 16;
+}
+
+static int Test_CompressPVSRow( const byte *in, int visbytes, byte *out )
+{
+	byte	*start = out;
+	int	i, run;
+
+	for( i = 0; i < visbytes; )
+	{
+		if( in[i] )
+		{
+			*out++ = in[i++];
+			continue;
+		}
+
+		for( run = 0; i < visbytes && !in[i] && run < 255; i++, run++ );
+		*out++ = 0;
+		*out++ = run;
+	}
+
+	return out - start;
+}
+
+static int Test_CheckPVSCache( model_t *mod, const byte *rows, int visbytes, size_t budget, qboolean resident )
+{
+	int	i, mismatches = 0;
+
+	Mod_SetupPVSCache( mod, budget );
+
+	if( g_pvscache.resident != resident )
+		mismatches++;
+
+	for( i = 0; i < TEST_PVS_LOOKUPS; i++ )
+	{
+		// skewed towards low clusters so LRU gets both hits and evictions
+		int		cluster = ( Test_PVSRand() % TEST_PVS_CLUSTERS ) & ( Test_PVSRand() % TEST_PVS_CLUSTERS );
+		const byte	*row = Mod_LeafPVS( mod->leafs + cluster + 1 );
+
+		if( !row || memcmp( row, rows + visbytes * cluster, visbytes ))
+			mismatches++;
+	}
+
+	if( !resident && ( !g_pvscache.hits || !g_pvscache.misses ))
+		mismatches++;
+
+	return mismatches;
+}
+
+static void Test_PVSCache( void )
+{
+	size_t		saved_visbytes = world.visbytes;
+	pvscache_t	saved_cache = g_pvscache;
+	int		visbytes = ( TEST_PVS_CLUSTERS + 7 ) >> 3;
+	byte		*rows, *visdata, *merged, *expected;
+	dmodel_t		submodel;
+	model_t		mod;
+	int		i, j, ofs = 0;
+
+	memset( &mod, 0, sizeof( mod ));
+	memset( &submodel, 0, sizeof( submodel ));
+	mod.mempool = Mem_AllocPool( "PVS Cache Test" );
+	rows = Mem_Calloc( mod.mempool, visbytes * TEST_PVS_CLUSTERS );
+	visdata = Mem_Calloc( mod.mempool, visbytes * 2 * TEST_PVS_CLUSTERS );
+	merged = Mem_Calloc( mod.mempool, visbytes + 1 );
+	expected = Mem_Calloc( mod.mempool, visbytes + 1 );
+	test_pvs_seed = 42;
+
+	submodel.visleafs = TEST_PVS_CLUSTERS;
+	mod.submodels = &submodel;
+	mod.numsubmodels = 1;
+	mod.numleafs = TEST_PVS_CLUSTERS + 1;
+	mod.leafs = Mem_Calloc( mod.mempool, sizeof( *mod.leafs ) * mod.numleafs );
+	mod.visdata = visdata;
+	mod.leafs[0].cluster = -1;
+	world.visbytes = visbytes;
+
+	for( i = 0; i < TEST_PVS_CLUSTERS; i++ )
+	{
+		byte *row = rows + visbytes * i;
+
+		// long zero runs with sparse visible clusters
+		for( j = 0; j < visbytes; j++ )
+			row[j] = ( Test_PVSRand() % 4 ) ? 0 : (byte)Test_PVSRand();
+
+		mod.leafs[i + 1].cluster = i;
+
+		// every 7th leaf has no vis info and sees everything
+		if( i % 7 == 6 )
+		{
+			memset( row, 0xFF, visbytes );
+			continue;
+		}
+
+		mod.leafs[i + 1].compressed_vis = visdata + ofs;
+		ofs += Test_CompressPVSRow( row, visbytes, visdata + ofs );
+	}
+
+	TASSERT_EQi( Test_CheckPVSCache( &mod, rows, visbytes, 1 << 20, true ), 0 );
+	TASSERT_EQi( Test_CheckPVSCache( &mod, rows, visbytes, 0, false ), 0 );
+	TASSERT_EQi( g_pvscache.numslots, PVS_CACHE_MIN_SLOTS );
+	TASSERT_EQi( Test_CheckPVSCache( &mod, rows, visbytes, 40 * ALIGN( visbytes, 16 ), false ), 0 );
+	TASSERT_EQi( g_pvscache.numslots, 40 );
+	TASSERT( Mod_LeafPVS( mod.leafs ) == NULL );
+
+	// word-wide merge must match bytewise OR at any alignment
+	for( i = 0; i < 8; i++ )
+	{
+		int len = visbytes - i;
+
+		memcpy( merged, rows + visbytes * 3, visbytes );
+		memcpy( expected, merged, visbytes );
+
+		for( j = 0; j < len; j++ )
+			expected[i + j] |= rows[visbytes * 5 + i + j];
+
+		Mod_MergePVS( merged + i, rows + visbytes * 5 + i, len );
+		TASSERT( !memcmp( merged, expected, visbytes ));
+	}
+
+	world.visbytes = saved_visbytes;
+	g_pvscache = saved_cache;
+	Mem_FreePool( &mod.mempool );
+}
+
+void Test_RunPVSCache( void )
+{
+	TRUN( Test_PVSCache() );
+}
+#endif /* XASH_ENGINE_TESTS */
@@ -120,6 +120,7 @@ extern world_static_t	world;
 extern poolhandle_t     com_studiocache;
 extern convar_t		mod_studiocache;
 extern convar_t		r_wadtextures;
+extern convar_t		mod_pvscache;
 extern convar_t		r_showhull;
 
 //
@@ -139,6 +140,7 @@ void *Mod_StudioExtradata( model_t *mod );
 model_t *Mod_FindName( const char *name, qboolean trackCRC );
 model_t *Mod_LoadModel( model_t *mod, qboolean crash );
 model_t *Mod_ForName( const char *name, qboolean crash, qboolean trackCRC );
+void Mod_PrefetchModel( const char *name );
 qboolean Mod_ValidateCRC( const char *name, CRC32_t crc );
 void Mod_NeedCRC( const char *name, qboolean needCRC );
 void Mod_FreeUnused( void );
@@ -156,7 +158,9 @@ int Mod_ReadLump( const char *filename, const int lump, void **lumpdata, int *lu
 int Mod_SaveLump( const char *filename, const int lump, void *lumpdata, int lumpsize );
 mleaf_t *Mod_PointInLeaf( const vec3_t p, mnode_t *node );
 int Mod_SampleSizeForFace( msurface_t *surf );
-byte *Mod_GetPVSForPoint( const vec3_t p );
+const byte *Mod_GetPVSForPoint( const vec3_t p );
+const byte *Mod_LeafPVS( const mleaf_t *leaf );
+void Mod_MergePVS( byte *dst, const byte *src, size_t bytes );
 void Mod_UnloadBrushModel( model_t *mod );
 void Mod_PrintWorldStats_f( void );
 
@@ -31,6 +31,11 @@ poolhandle_t      com_studiocache;		// cache for submodels
 CVAR_DEFINE( mod_studiocache, "r_studiocache", "1", FCVAR_ARCHIVE, "enables studio cache for speedup tracing hitboxes" );
 CVAR_DEFINE_AUTO( r_wadtextures, "0", 0, "completely ignore textures in the bsp-file if enabled" );
 CVAR_DEFINE_AUTO( r_showhull, "0", 0, "draw collision hulls 1-3" );
+#if XASH_LOW_MEMORY
+CVAR_DEFINE_AUTO( mod_pvscache, "512", FCVAR_ARCHIVE, "memory budget in kilobytes for decompressed world PVS, applied on map load" );
+#else
+CVAR_DEFINE_AUTO( mod_pvscache, "8192", FCVAR_ARCHIVE, "memory budget in kilobytes for decompressed world PVS, applied on map load" );
+#endif
 
 /*
 ===============================================================================
@@ -136,6 +141,7 @@ void Mod_Init( void )
 	Cvar_RegisterVariable( &mod_studiocache );
 	Cvar_RegisterVariable( &r_wadtextures );
 	Cvar_RegisterVariable( &r_showhull );
+	Cvar_RegisterVariable( &mod_pvscache );
 
 	Cmd_AddCommand( "mapstats", Mod_PrintWorldStats_f, "show stats for currently loaded map" );
 	Cmd_AddCommand( "modellist", Mod_Modellist_f, "display loaded models list" );
@@ -271,7 +277,11 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	Q_strncpy( tempname, mod->name, sizeof( tempname ));
 	COM_FixSlashes( tempname );
 
-	buf = FS_LoadFile( tempname, &length, false );
+	// maybe it was already read in background during precache
+	buf = FS_LoadPrefetchedFile( tempname, &length );
+
+	if( !buf )
+		buf = FS_LoadFile( tempname, &length, false );
 
 	if( !buf )
 	{
@@ -371,6 +381,36 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	return mod;
 }
 
+/*
+==================
+Mod_PrefetchModel
+
+start reading model file in background,
+Mod_LoadModel will pick it up later
+==================
+*/
+void Mod_PrefetchModel( const char *name )
+{
+	char	modname[MAX_QPATH];
+	model_t	*mod;
+	int	i;
+
+	if( !COM_CheckString( name ) || name[0] == '*' )
+		return;
+
+	Q_strncpy( modname, name, sizeof( modname ));
+
+	// already in memory
+	for( i = 0, mod = mod_known; i < mod_numknown; i++, mod++ )
+	{
+		if( mod->mempool && !Q_stricmp( mod->name, modname ))
+			return;
+	}
+
+	COM_FixSlashes( modname );
+	FS_PrefetchFile( modname );
+}
+
 /*
 ==================
 Mod_ForName
@@ -2200,6 +2200,19 @@ HTTP downloader
 =================================================
 */
 
+#define HTTP_MAX_PIPELINE	16	// hard limit for http_pipeline
+#define HTTP_MAX_HEADER		4096	// responses with bigger header are refused
+#define HTTP_MAX_CHUNK_LINE	256	// chunk size line with extensions or trailer field
+#define HTTP_SENDBUF_SIZE	8192	// enough for several requests
+#define HTTP_RECVBUF_MIN	16384
+#define HTTP_RECVBUF_MAX	262144
+
+#if defined( MSG_NOSIGNAL )
+#define HTTP_SEND_FLAGS		MSG_NOSIGNAL // server may close connection at any time, don't get SIGPIPE
+#else
+#define HTTP_SEND_FLAGS		0
+#endif
+
 typedef struct httpserver_s
 {
 	char host[256];
@@ -2213,35 +2226,74 @@ typedef struct httpserver_s
 enum connectionstate
 {
 	HTTP_QUEUE = 0,
-	HTTP_OPENED,
-	HTTP_SOCKET,
-	HTTP_NS_RESOLVED,
-	HTTP_CONNECTED,
-	HTTP_REQUEST,
-	HTTP_REQUEST_SENT,
-	HTTP_RESPONSE_RECEIVED,
+	HTTP_REQUEST_SENT,	// request is in connection pipeline
+	HTTP_RESPONSE_RECEIVED,	// receiving file body
 	HTTP_FREE
 };
 
+enum httpconnstate
+{
+	HTTP_CONN_RESOLVE = 0,
+	HTTP_CONN_OPEN,
+	HTTP_CONN_CLOSED
+};
+
+enum httpchunkstate
+{
+	HTTP_CHUNK_NONE = 0,	// body length is known from Content-Length
+	HTTP_CHUNK_SIZE,	// reading chunk size line
+	HTTP_CHUNK_DATA,	// reading chunk data
+	HTTP_CHUNK_DATA_END,	// reading CRLF after chunk data
+	HTTP_CHUNK_TRAILER	// reading trailer fields after last chunk
+};
+
+struct httpfile_s;
+
+// persistent connection to single server, serves many files
+typedef struct httpconn_s
+{
+	struct httpconn_s *next;
+	httpserver_t *server;
+	int socket;
+	enum httpconnstate state;
+	qboolean keepalive;	// server will not close connection after response
+	int responses;	// complete responses received
+	float blocktime;
+
+	// files in order their requests were sent, first one receives data
+	struct httpfile_s *pipeline[HTTP_MAX_PIPELINE];
+	int numpipeline;
+
+	char sendbuf[HTTP_SENDBUF_SIZE];
+	int sendlen, sendpos;
+
+	char header[HTTP_MAX_HEADER+1]; // response header of first file
+	int headerlen;
+
+	// chunked transfer coding of first file
+	enum httpchunkstate chunkstate;
+	int chunkleft;
+	char chunkline[HTTP_MAX_CHUNK_LINE+1];
+	int chunklinelen;
+
+	byte *recvbuf;	// grows while socket has more data than fits
+	int recvbufsize;
+} httpconn_t;
+
 typedef struct httpfile_s
 {
 	struct httpfile_s *next;
 	httpserver_t *server;
+	httpconn_t *conn;
 	char path[MAX_SYSPATH];
 	file_t *file;
-	int socket;
 	int size;
 	int downloaded;
 	int lastchecksize;
 	float checktime;
-	float blocktime;
 	int id;
 	enum connectionstate state;
 	qboolean process;
-
-	// query or response
-   char buf[BUFSIZ+1];
-   int header_size, query_length, bytes_sent;
 } httpfile_t;
 
 static struct http_static_s
@@ -2249,6 +2301,7 @@ static struct http_static_s
 	// file and server lists
 	httpfile_t *first_file, *last_file;
 	httpserver_t *first_server, *last_server;
+	httpconn_t *first_conn;
 } http;
 
 
@@ -2256,6 +2309,7 @@ static CVAR_DEFINE_AUTO( http_useragent, "", FCVAR_ARCHIVE | FCVAR_PRIVILEGED, "
 static CVAR_DEFINE_AUTO( http_autoremove, "1", FCVAR_ARCHIVE | FCVAR_PRIVILEGED, "remove broken files" );
 static CVAR_DEFINE_AUTO( http_timeout, "45", FCVAR_ARCHIVE | FCVAR_PRIVILEGED, "timeout for http downloader" );
 static CVAR_DEFINE_AUTO( http_maxconnections, "4", FCVAR_ARCHIVE | FCVAR_PRIVILEGED, "maximum http connection number" );
+static CVAR_DEFINE_AUTO( http_pipeline, "4", FCVAR_ARCHIVE | FCVAR_PRIVILEGED, "maximum requests sent over single http connection without waiting for response" );
 
 /*
 ========================
@@ -2276,6 +2330,68 @@ void HTTP_ClearCustomServers( void )
 	}
 }
 
+/*
+==============
+HTTP_DetachFile
+
+Remove file from connection pipeline
+==============
+*/
+static void HTTP_DetachFile( httpconn_t *conn, httpfile_t *file )
+{
+	int i;
+
+	for( i = 0; i < conn->numpipeline; i++ )
+	{
+		if( conn->pipeline[i] != file )
+			continue;
+
+		memmove( &conn->pipeline[i], &conn->pipeline[i + 1], ( conn->numpipeline - i - 1 ) * sizeof( conn->pipeline[0] ));
+		conn->numpipeline--;
+		break;
+	}
+
+	file->conn = NULL;
+}
+
+/*
+==============
+HTTP_CloseConnection
+
+Files that didn't get response are queued again
+==============
+*/
+static void HTTP_CloseConnection( httpconn_t *conn )
+{
+	int i;
+
+	if( conn->state == HTTP_CONN_CLOSED )
+		return;
+
+	if( conn->socket != -1 )
+		closesocket( conn->socket );
+
+	conn->socket = -1;
+
+	for( i = 0; i < conn->numpipeline; i++ )
+	{
+		httpfile_t *file = conn->pipeline[i];
+
+		if( file->file )
+			FS_Close( file->file );
+
+		file->file = NULL;
+		file->conn = NULL;
+		file->state = HTTP_QUEUE;
+	}
+
+	conn->numpipeline = 0;
+	conn->sendlen = conn->sendpos = 0;
+	conn->headerlen = 0;
+	conn->chunkstate = HTTP_CHUNK_NONE;
+	conn->state = HTTP_CONN_CLOSED;
+}
+
 /*
 ==============
 HTTP_FreeFile
@@ -2287,17 +2403,21 @@ static void HTTP_FreeFile( httpfile_t *file, qboolean error )
 {
 	char incname[256];
 
-	// Allways close file and socket
+	// responses can't be matched with requests anymore, drop connection
+	if( file->conn )
+	{
+		httpconn_t *conn = file->conn;
+
+		HTTP_DetachFile( conn, file );
+		HTTP_CloseConnection( conn );
+	}
+
+	// Allways close file
 	if( file->file )
 		FS_Close( file->file );
 
 	file->file = NULL;
 
-	if( file->socket != -1 )
-		closesocket( file->socket );
-
-	file->socket = -1;
-
 	Q_snprintf( incname, 256, "downloaded/%s.incomplete", file->path );
 	if( error )
 	{
@@ -2336,367 +2456,777 @@ static void HTTP_FreeFile( httpfile_t *file, qboolean error )
 	file->state = HTTP_FREE;
 }
 
+/*
+==============
+HTTP_FailConnection
+
+Close connection and skip first or all pipelined files to next server
+==============
+*/
+static void HTTP_FailConnection( httpconn_t *conn, qboolean all )
+{
+	httpfile_t *failed[HTTP_MAX_PIPELINE];
+	int i, count;
+
+	count = all ? conn->numpipeline : ( conn->numpipeline ? 1 : 0 );
+
+	for( i = 0; i < count; i++ )
+		failed[i] = conn->pipeline[i];
+
+	for( i = 0; i < count; i++ )
+		HTTP_DetachFile( conn, failed[i] );
+
+	HTTP_CloseConnection( conn );
+
+	for( i = 0; i < count; i++ )
+		HTTP_FreeFile( failed[i], true );
+}
+
+/*
+==============
+HTTP_ConnectionLost
+
+Server closed connection or socket error
+==============
+*/
+static void HTTP_ConnectionLost( httpconn_t *conn )
+{
+	httpfile_t *file = conn->numpipeline ? conn->pipeline[0] : NULL;
+
+	// server may close persistent connection at any time,
+	// requests that got nothing yet will be sent again
+	if( !file || ( conn->responses > 0 && file->state == HTTP_REQUEST_SENT && !conn->headerlen ))
+		HTTP_CloseConnection( conn );
+	else HTTP_FailConnection( conn, conn->responses == 0 );
+}
+
 /*
 ===================
 HTTP_AutoClean
 
 remove files with HTTP_FREE state from list
+and closed connections
 ===================
 */
 static void HTTP_AutoClean( void )
 {
-	httpfile_t *curfile, *prevfile = 0;
+	httpfile_t **prevfile;
+	httpconn_t **prevconn;
+
+	http.last_file = NULL;
 
 	// clean all files marked to free
-	for( curfile = http.first_file; curfile; curfile = curfile->next )
+	for( prevfile = &http.first_file; *prevfile; )
 	{
+		httpfile_t *curfile = *prevfile;
+
 		if( curfile->state != HTTP_FREE )
 		{
-			prevfile = curfile;
+			http.last_file = curfile;
+			prevfile = &curfile->next;
 			continue;
 		}
 
-		if( curfile == http.first_file )
+		*prevfile = curfile->next;
+		Mem_Free( curfile );
+	}
+
+	// don't keep connections when there is nothing to download
+	for( prevconn = &http.first_conn; *prevconn; )
+	{
+		httpconn_t *conn = *prevconn;
+
+		if( conn->state != HTTP_CONN_CLOSED && http.first_file )
 		{
-			http.first_file = http.first_file->next;
-			Mem_Free( curfile );
-			curfile = http.first_file;
-			if( !curfile )
-				break;
+			prevconn = &conn->next;
 			continue;
 		}
 
-		if( prevfile )
-			prevfile->next = curfile->next;
-		Mem_Free( curfile );
-		curfile = prevfile;
-		if( !curfile )
-			break;
+		HTTP_CloseConnection( conn );
+		*prevconn = conn->next;
+		Mem_Free( conn->recvbuf );
+		Mem_Free( conn );
 	}
-	http.last_file = prevfile;
 }
 
 /*
 ===================
-HTTP_ProcessStream
+HTTP_FindHeader
 
-process incoming data
+returns value of response header field
 ===================
 */
-static qboolean HTTP_ProcessStream( httpfile_t *curfile )
+static const char *HTTP_FindHeader( const char *header, const char *name )
 {
-	char buf[BUFSIZ+1];
-	char *begin = 0;
-	int res;
+	size_t len = Q_strlen( name );
+	const char *p = header;
 
-	if( curfile->header_size >= BUFSIZ )
+	while(( p = Q_strchr( p, '\n' )))
 	{
-		Con_Reportf( S_ERROR "Header to big\n");
-		HTTP_FreeFile( curfile, true );
+		p++;
+
+		if( Q_strnicmp( p, name, len ) || p[len] != ':' )
+			continue;
+
+		p += len + 1;
+		while( *p == ' ' || *p == '\t' )
+			p++;
+
+		return p;
+	}
+
+	return NULL;
+}
+
+/*
+===================
+HTTP_FinishFile
+
+first file in pipeline is received completely
+===================
+*/
+static void HTTP_FinishFile( httpconn_t *conn )
+{
+	httpfile_t *file = conn->pipeline[0];
+
+	conn->chunkstate = HTTP_CHUNK_NONE;
+	HTTP_DetachFile( conn, file );
+	HTTP_FreeFile( file, false ); // success
+
+	if( !conn->keepalive )
+		HTTP_CloseConnection( conn );
+}
+
+/*
+===================
+HTTP_ParseResponse
+
+header of first file in pipeline is received
+===================
+*/
+static qboolean HTTP_ParseResponse( httpconn_t *conn, httpfile_t *file )
+{
+	char name[MAX_SYSPATH];
+	const char *value;
+	qboolean http10;
+
+	Con_Reportf( "HTTP: Got response!\n" );
+
+	if( Q_strncmp( conn->header, "HTTP/1.", 7 ) || Q_atoi( conn->header + 9 ) != 200 )
+	{
+		char *end = Q_strchr( conn->header, '\r' );
+
+		if( !end ) end = Q_strchr( conn->header, '\n' );
+		if( end )
+			*end = 0; // cut string to print out response
+
+		Con_Printf( S_ERROR "%s: bad response: %s\n", file->path, conn->header );
+		HTTP_FailConnection( conn, false );
 		return false;
 	}
 
-	while( ( res = recv( curfile->socket, buf, BUFSIZ - curfile->header_size, 0 )) > 0) // if we got there, we are receiving data
+	http10 = conn->header[7] == '0';
+	value = HTTP_FindHeader( conn->header, "Connection" );
+
+	if( value && !Q_strnicmp( value, "close", 5 ))
+		conn->keepalive = false;
+	else if( http10 ) // 1.0 servers keep connection only if asked
+		conn->keepalive = value && !Q_strnicmp( value, "keep-alive", 10 );
+	else conn->keepalive = true;
+
+	value = HTTP_FindHeader( conn->header, "Transfer-Encoding" );
+
+	if( value )
 	{
-		curfile->blocktime = 0;
+		// Content-Length must be ignored when transfer coding is present,
+		// compressed codings can't be decoded here
+		const char *end = value;
+
+		while( *end && *end != '\r' && *end != '\n' )
+			end++;
 
-		if( curfile->state < HTTP_RESPONSE_RECEIVED ) // Response still not received
+		while( end > value && ( end[-1] == ' ' || end[-1] == '\t' ))
+			end--;
+
+		if( Q_strnicmp( value, "chunked", 7 ) || end - value != 7 )
 		{
-			memcpy( curfile->buf + curfile->header_size, buf, res );
-			curfile->buf[curfile->header_size + res] = 0;
-			begin = Q_strstr( curfile->buf, "\r\n\r\n" );
+			Con_Printf( S_ERROR "%s: unsupported transfer encoding\n", file->path );
+			HTTP_FailConnection( conn, false );
+			return false;
+		}
 
-			if( begin ) // Got full header
-			{
-				int cutheadersize = begin - curfile->buf + 4; // after that begin of data
-				char *length;
+		Con_Reportf( "HTTP: File is sent in chunks\n" );
+		conn->chunkstate = HTTP_CHUNK_SIZE;
+		conn->chunklinelen = 0;
+	}
+	else
+	{
+		value = HTTP_FindHeader( conn->header, "Content-Length" );
 
-				Con_Reportf( "HTTP: Got response!\n" );
+		if( value )
+		{
+			int size = Q_atoi( value );
 
-				if( !Q_strstr( curfile->buf, "200 OK" ))
-				{
-					*begin = 0; // cut string to print out response
-					begin = Q_strchr( curfile->buf, '\r' );
+			Con_Reportf( "HTTP: File size is %d\n", size );
 
-					if( !begin ) begin = Q_strchr( curfile->buf, '\n' );
-					if( begin )
-						*begin = 0;
+			if( ( file->size != -1 ) && ( file->size != size )) // check size if specified, not used
+				Con_Reportf( S_WARN "Server reports wrong file size!\n" );
 
-					Con_Printf( S_ERROR "%s: bad response: %s\n", curfile->path, curfile->buf );
-					HTTP_FreeFile( curfile, true );
-					return false;
-				}
+			file->size = size;
+		}
+		else conn->keepalive = false; // can't find where the next response begins
 
-				// print size
-				length = Q_stristr( curfile->buf, "Content-Length: " );
-				if( length )
-				{
-					int size = Q_atoi( length += 16 );
+		if( file->size == -1 )
+		{
+			// Usually fastdl's reports file size if link is correct
+			Con_Printf( S_ERROR "file size is unknown, refusing download!\n" );
+			HTTP_FailConnection( conn, false );
+			return false;
+		}
+	}
 
-					Con_Reportf( "HTTP: File size is %d\n", size );
+	Q_snprintf( name, sizeof( name ), "downloaded/%s.incomplete", file->path );
+	file->file = FS_Open( name, "wb", true );
 
-					if( ( curfile->size != -1 ) && ( curfile->size != size )) // check size if specified, not used
-						Con_Reportf( S_WARN "Server reports wrong file size!\n" );
+	if( !file->file )
+	{
+		Con_Printf( S_ERROR "cannot open %s!\n", name );
+		HTTP_FailConnection( conn, false );
+		return false;
+	}
 
-					curfile->size = size;
-					curfile->header_size = 0;
-				}
+	file->state = HTTP_RESPONSE_RECEIVED; // got response, let's start download
+	file->downloaded = 0;
+	file->lastchecksize = 0;
+	file->checktime = 0;
+	conn->responses++;
 
-				if( curfile->size == -1 )
-				{
-					// Usually fastdl's reports file size if link is correct
-					Con_Printf( S_ERROR "file size is unknown, refusing download!\n" );
-					HTTP_FreeFile( curfile, true );
-					return false;
-				}
+	if( conn->chunkstate == HTTP_CHUNK_NONE && file->size == 0 )
+		HTTP_FinishFile( conn );
 
-				curfile->state = HTTP_RESPONSE_RECEIVED; // got response, let's start download
-				begin += 4;
+	return true;
+}
 
-				// Write remaining message part
-				if( res - cutheadersize - curfile->header_size > 0 )
-				{
-					int ret = FS_Write( curfile->file, begin, res - cutheadersize - curfile->header_size );
+/*
+===================
+HTTP_ProcessChunkLine
 
-					if( ret != res - cutheadersize - curfile->header_size ) // could not write file
-					{
-						// close it and go to next
-						Con_Printf( S_ERROR "write failed for %s!\n", curfile->path );
-						HTTP_FreeFile( curfile, true );
-						return false;
-					}
-					curfile->downloaded += ret;
-				}
-			}
-			else
-				curfile->header_size += res;
+handles complete line of chunked body
+===================
+*/
+static qboolean HTTP_ProcessChunkLine( httpconn_t *conn, httpfile_t *file )
+{
+	const char *p = conn->chunkline;
+	int size = 0, digits = 0;
+
+	switch( conn->chunkstate )
+	{
+	case HTTP_CHUNK_DATA_END:
+		if( *p )
+			break;
+		conn->chunkstate = HTTP_CHUNK_SIZE;
+		return true;
+	case HTTP_CHUNK_SIZE:
+		for( ; *p; p++, digits++ )
+		{
+			int c = Q_tolower( *p );
+
+			if( c >= '0' && c <= '9' )
+				c -= '0';
+			else if( c >= 'a' && c <= 'f' )
+				c -= 'a' - 10;
+			else break;
+
+			if( size > ( INT_MAX >> 4 ))
+				break;
+
+			size = size << 4 | c;
+		}
+
+		// chunk extensions are ignored
+		if( !digits || ( *p && *p != ';' && *p != ' ' && *p != '\t' ))
+			break;
+
+		if( !size )
+		{
+			conn->chunkstate = HTTP_CHUNK_TRAILER;
+			return true;
 		}
-		else if( res > 0 )
+
+		conn->chunkleft = size;
+		conn->chunkstate = HTTP_CHUNK_DATA;
+		return true;
+	case HTTP_CHUNK_TRAILER:
+		// trailer fields are ignored, empty line ends the body
+		if( !*p )
 		{
-			// data download
-			int ret = FS_Write( curfile->file, buf, res );
+			file->size = file->downloaded;
+			HTTP_FinishFile( conn );
+		}
+		return true;
+	default:
+		break;
+	}
+
+	Con_Printf( S_ERROR "%s: malformed chunked body\n", file->path );
+	HTTP_FailConnection( conn, false );
+	return false;
+}
+
+/*
+===================
+HTTP_ProcessChunked
 
-			if ( ret != res )
+decodes chunked body, returns number of bytes consumed or -1
+===================
+*/
+static int HTTP_ProcessChunked( httpconn_t *conn, httpfile_t *file, const byte *data, int len )
+{
+	int i, ret;
+
+	if( conn->chunkstate == HTTP_CHUNK_DATA )
+	{
+		int towrite = Q_min( len, conn->chunkleft );
+
+		ret = FS_Write( file->file, data, towrite );
+
+		if( ret != towrite )
+		{
+			Con_Printf( S_ERROR "write failed for %s!\n", file->path );
+			HTTP_FailConnection( conn, false );
+			return -1;
+		}
+
+		file->downloaded += ret;
+		file->lastchecksize += ret;
+		conn->chunkleft -= ret;
+
+		if( !conn->chunkleft )
+		{
+			conn->chunkstate = HTTP_CHUNK_DATA_END;
+			conn->chunklinelen = 0;
+		}
+
+		return ret;
+	}
+
+	for( i = 0; i < len; i++ )
+	{
+		if( data[i] != '\n' )
+		{
+			if( conn->chunklinelen >= HTTP_MAX_CHUNK_LINE )
 			{
-				// close it and go to next
-				Con_Printf( S_ERROR "write failed for %s!\n", curfile->path );
-				curfile->state = HTTP_FREE;
-				HTTP_FreeFile( curfile, true );
-				return false;
+				Con_Printf( S_ERROR "%s: malformed chunked body\n", file->path );
+				HTTP_FailConnection( conn, false );
+				return -1;
 			}
 
-			curfile->downloaded += ret;
-			curfile->lastchecksize += ret;
+			conn->chunkline[conn->chunklinelen++] = data[i];
+			continue;
+		}
+
+		if( conn->chunklinelen && conn->chunkline[conn->chunklinelen - 1] == '\r' )
+			conn->chunklinelen--;
+
+		conn->chunkline[conn->chunklinelen] = 0;
+		conn->chunklinelen = 0;
+
+		if( !HTTP_ProcessChunkLine( conn, file ))
+			return -1;
+
+		return i + 1;
+	}
+
+	return len; // need more data
+}
 
-			// as after it will run in same frame
-			if( curfile->checktime > 5 )
+/*
+===================
+HTTP_ProcessStream
+
+split received data between pipelined files
+===================
+*/
+static qboolean HTTP_ProcessStream( httpconn_t *conn, const byte *data, int len )
+{
+	while( len > 0 && conn->state == HTTP_CONN_OPEN )
+	{
+		httpfile_t *file;
+		int ret, towrite;
+
+		if( !conn->numpipeline )
+		{
+			Con_Reportf( S_WARN "HTTP: unexpected data from %s\n", conn->server->host );
+			HTTP_CloseConnection( conn );
+			return false;
+		}
+
+		file = conn->pipeline[0];
+
+		if( file->state < HTTP_RESPONSE_RECEIVED ) // Response still not received
+		{
+			int start = Q_max( conn->headerlen - 3, 0 );
+			int copy = Q_min( len, HTTP_MAX_HEADER - conn->headerlen );
+			char *end;
+
+			memcpy( conn->header + conn->headerlen, data, copy );
+			conn->headerlen += copy;
+			conn->header[conn->headerlen] = 0;
+			end = Q_strstr( conn->header + start, "\r\n\r\n" );
+
+			if( !end ) // need more data
 			{
-				float speed = (float)curfile->lastchecksize / ( 5.0f * 1024 );
+				if( conn->headerlen < HTTP_MAX_HEADER )
+					return true;
 
-				curfile->checktime = 0;
-				Con_Reportf( "download speed %f KB/s\n", speed );
-				curfile->lastchecksize = 0;
+				Con_Reportf( S_ERROR "Header to big\n");
+				HTTP_FailConnection( conn, false );
+				return false;
 			}
+
+			// rest of the data is file body
+			copy -= conn->headerlen - ( end - conn->header + 4 );
+			data += copy;
+			len -= copy;
+			end[2] = 0;
+			conn->headerlen = 0;
+
+			if( !HTTP_ParseResponse( conn, file ))
+				return false;
+
+			continue;
+		}
+
+		if( conn->chunkstate != HTTP_CHUNK_NONE )
+		{
+			if(( ret = HTTP_ProcessChunked( conn, file, data, len )) < 0 )
+				return false;
+
+			data += ret;
+			len -= ret;
+			continue;
 		}
+
+		// data download
+		towrite = Q_min( len, file->size - file->downloaded );
+		ret = FS_Write( file->file, data, towrite );
+
+		if( ret != towrite )
+		{
+			// close it and go to next
+			Con_Printf( S_ERROR "write failed for %s!\n", file->path );
+			HTTP_FailConnection( conn, false );
+			return false;
+		}
+
+		file->downloaded += ret;
+		file->lastchecksize += ret;
+		data += ret;
+		len -= ret;
+
+		if( file->downloaded >= file->size )
+			HTTP_FinishFile( conn );
+	}
+
+	return true;
+}
+
+/*
+===================
+HTTP_UserAgent
+===================
+*/
+static void HTTP_UserAgent( char *useragent, size_t size )
+{
+	if( !COM_CheckStringEmpty( http_useragent.string ) || !Q_strcmp( http_useragent.string, "xash3d" ))
+	{
+		Q_snprintf( useragent, size, "%s/%s (%s-%s; build %d; %s)",
+			XASH_ENGINE_NAME, XASH_VERSION, Q_buildos( ), Q_buildarch( ), Q_buildnum( ), Q_buildcommit( ));
+	}
+	else
+	{
+		Q_strncpy( useragent, http_useragent.string, size );
 	}
-	curfile->checktime += host.frametime;
+}
+
+/*
+===================
+HTTP_QueueRequest
+
+append request to connection send buffer
+===================
+*/
+static qboolean HTTP_QueueRequest( httpconn_t *conn, httpfile_t *file )
+{
+	httpserver_t *server = conn->server;
+	string useragent, host;
+	int len;
+
+	HTTP_UserAgent( useragent, sizeof( useragent ));
+
+	if( server->port != 80 )
+		Q_snprintf( host, sizeof( host ), "%s:%d", server->host, server->port );
+	else Q_strncpy( host, server->host, sizeof( host ));
+
+	len = Q_snprintf( conn->sendbuf + conn->sendlen, sizeof( conn->sendbuf ) - conn->sendlen,
+		"GET %s%s HTTP/1.1\r\n"
+		"Host: %s\r\n"
+		"User-Agent: %s\r\n"
+		"Connection: keep-alive\r\n\r\n", server->path,
+		file->path, host, useragent );
+
+	if( len < 0 ) // wait until previous requests are sent
+	{
+		conn->sendbuf[conn->sendlen] = 0;
+		return false;
+	}
+
+	Con_Reportf( "HTTP: Starting download %s from %s\n", file->path, server->host );
+
+	conn->sendlen += len;
+	conn->pipeline[conn->numpipeline++] = file;
+	file->conn = conn;
+	file->state = HTTP_REQUEST_SENT;
+	file->downloaded = 0;
 
 	return true;
 }
 
 /*
-==============
-HTTP_Run
+===================
+HTTP_GetConnection
+
+find connection that can take one more request
+===================
+*/
+static httpconn_t *HTTP_GetConnection( httpserver_t *server )
+{
+	httpconn_t *conn, *best = NULL;
+	int count = 0;
+
+	for( conn = http.first_conn; conn; conn = conn->next )
+	{
+		int depth;
+
+		if( conn->state == HTTP_CONN_CLOSED )
+			continue;
+
+		count++;
+
+		if( conn->server != server )
+			continue;
+
+		if( !conn->numpipeline )
+			return conn;
+
+		// don't pipeline until server shown it keeps connection open
+		if( conn->responses && conn->keepalive )
+			depth = bound( 1, (int)http_pipeline.value, HTTP_MAX_PIPELINE );
+		else depth = 1;
+
+		if( conn->numpipeline < depth && ( !best || conn->numpipeline < best->numpipeline ))
+			best = conn;
+	}
+
+	if( count && count >= http_maxconnections.value )
+		return best;
+
+	conn = Z_Calloc( sizeof( *conn ));
+	conn->server = server;
+	conn->socket = -1;
+	conn->state = HTTP_CONN_RESOLVE;
+	conn->keepalive = true;
+	conn->recvbufsize = HTTP_RECVBUF_MIN;
+	conn->recvbuf = Z_Malloc( conn->recvbufsize );
+	conn->next = http.first_conn;
+	http.first_conn = conn;
+
+	return conn;
+}
+
+/*
+===================
+HTTP_RunConnection
 
-Download next file block of each active file
-Call every frame
-==============
+connect, send queued requests and receive everything available
+===================
 */
-void HTTP_Run( void )
+static void HTTP_RunConnection( httpconn_t *conn, qboolean *resolving )
 {
-	httpfile_t *curfile;
-	int iActiveCount = 0;
-	int iProgressCount = 0;
-	float flProgress = 0;
-	qboolean fResolving = false;
+	qboolean progress = false;
 
-	for( curfile = http.first_file; curfile; curfile = curfile->next )
+	if( conn->state == HTTP_CONN_RESOLVE )
 	{
 		struct sockaddr_storage addr;
+		char hostport[MAX_VA_STRING];
+		net_gai_state_t res;
+		dword mode;
 
-		if( curfile->state == HTTP_FREE )
-			continue;
-
-		if( curfile->state == HTTP_QUEUE )
-		{
-			char name[MAX_SYSPATH];
-
-			if( iActiveCount > http_maxconnections.value )
-				continue;
-
-			if( !curfile->server )
-			{
-				Con_Printf( S_ERROR "no servers to download %s!\n", curfile->path );
-				HTTP_FreeFile( curfile, true );
-				break;
-			}
-
-			Con_Reportf( "HTTP: Starting download %s from %s\n", curfile->path, curfile->server->host );
-			Q_snprintf( name, sizeof( name ), "downloaded/%s.incomplete", curfile->path );
+		if( *resolving )
+			return;
 
-			curfile->file = FS_Open( name, "wb", true );
+		Q_snprintf( hostport, sizeof( hostport ), "%s:%d", conn->server->host, conn->server->port );
 
-			if( !curfile->file )
-			{
-				Con_Printf( S_ERROR "cannot open %s!\n", name );
-				HTTP_FreeFile( curfile, true );
-				break;
-			}
+		res = NET_StringToSockaddr( hostport, &addr, true, AF_INET );
 
-			curfile->state = HTTP_OPENED;
-			curfile->blocktime = 0;
-			curfile->downloaded = 0;
-			curfile->lastchecksize = 0;
-			curfile->checktime = 0;
+		if( res == NET_EAI_AGAIN )
+		{
+			*resolving = true;
+			return;
 		}
 
-		iActiveCount++;
-
-		if( curfile->state < HTTP_SOCKET ) // Socket is not created
+		if( res == NET_EAI_NONAME )
 		{
-			dword mode;
+			Con_Printf( S_ERROR "failed to resolve server address for %s!\n", conn->server->host );
+			HTTP_FailConnection( conn, true ); // Cannot connect
+			return;
+		}
 
-			curfile->socket = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+		conn->socket = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
 
-			// Now set non-blocking mode
-			// You may skip this if not supported by system,
-			// but download will lock engine, maybe you will need to add manual returns
-			mode = 1;
-			ioctlsocket( curfile->socket, FIONBIO, (void*)&mode );
+		// Now set non-blocking mode
+		// You may skip this if not supported by system,
+		// but download will lock engine, maybe you will need to add manual returns
+		mode = 1;
+		ioctlsocket( conn->socket, FIONBIO, (void*)&mode );
 #if XASH_LINUX
-			// SOCK_NONBLOCK is not portable, so use fcntl
-			fcntl( curfile->socket, F_SETFL, fcntl( curfile->socket, F_GETFL, 0 ) | O_NONBLOCK );
+		// SOCK_NONBLOCK is not portable, so use fcntl
+		fcntl( conn->socket, F_SETFL, fcntl( conn->socket, F_GETFL, 0 ) | O_NONBLOCK );
 #endif
-			curfile->state = HTTP_SOCKET;
-		}
 
-		if( curfile->state < HTTP_NS_RESOLVED )
+		if( connect( conn->socket, (struct sockaddr*)&addr, NET_SockAddrLen( &addr )))
 		{
-			net_gai_state_t res;
-			char hostport[MAX_VA_STRING];
-
-			if( fResolving )
-				continue;
-
-			Q_snprintf( hostport, sizeof( hostport ), "%s:%d", curfile->server->host, curfile->server->port );
-
-			res = NET_StringToSockaddr( hostport, &addr, true, AF_INET );
-
-			if( res == NET_EAI_AGAIN )
+			// Should give EWOOLDBLOCK if try recv too soon
+			if( WSAGetLastError() != WSAEINPROGRESS && WSAGetLastError() != WSAEWOULDBLOCK )
 			{
-				fResolving = true;
-				continue;
-			}
-
-			if( res == NET_EAI_NONAME )
-			{
-				Con_Printf( S_ERROR "failed to resolve server address for %s!\n", curfile->server->host );
-				HTTP_FreeFile( curfile, true ); // Cannot connect
-				break;
+				Con_Printf( S_ERROR "cannot connect to server: %s\n", NET_ErrorString( ));
+				HTTP_FailConnection( conn, true ); // Cannot connect
+				return;
 			}
-			curfile->state = HTTP_NS_RESOLVED;
 		}
 
-		if( curfile->state < HTTP_CONNECTED ) // Connection not enstabilished
-		{
-			int res = connect( curfile->socket, (struct sockaddr*)&addr, NET_SockAddrLen( &addr ) );
+		Con_Reportf( "HTTP: Connecting to %s\n", hostport );
+		conn->state = HTTP_CONN_OPEN;
+		conn->blocktime = 0;
+	}
+
+	while( conn->sendpos < conn->sendlen )
+	{
+		int res = send( conn->socket, conn->sendbuf + conn->sendpos, conn->sendlen - conn->sendpos, HTTP_SEND_FLAGS );
 
-			if( res )
+		if( res < 0 )
+		{
+			// blocking while waiting connection
+			if( WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAENOTCONN )
 			{
-				if( WSAGetLastError() == WSAEINPROGRESS || WSAGetLastError() == WSAEWOULDBLOCK ) // Should give EWOOLDBLOCK if try recv too soon
-					curfile->state = HTTP_CONNECTED;
-				else
-				{
-					Con_Printf( S_ERROR "cannot connect to server: %s\n", NET_ErrorString( ));
-					HTTP_FreeFile( curfile, true ); // Cannot connect
-					break;
-				}
-				continue; // skip to next file
+				Con_Printf( S_ERROR "failed to send request: %s\n", NET_ErrorString( ));
+				HTTP_ConnectionLost( conn );
+				return;
 			}
-			curfile->state = HTTP_CONNECTED;
+			break;
 		}
 
-		if( curfile->state < HTTP_REQUEST ) // Request not formatted
+		conn->sendpos += res;
+		progress = true;
+	}
+
+	if( conn->sendpos == conn->sendlen )
+		conn->sendpos = conn->sendlen = 0;
+
+	// read until socket is empty, data is going to the file anyway
+	while( conn->state == HTTP_CONN_OPEN )
+	{
+		int res = recv( conn->socket, (char *)conn->recvbuf, conn->recvbufsize, 0 );
+
+		if( res > 0 )
 		{
-			string useragent;
+			progress = true;
 
-			if( !COM_CheckStringEmpty( http_useragent.string ) || !Q_strcmp( http_useragent.string, "xash3d" ))
-			{
-				Q_snprintf( useragent, sizeof( useragent ), "%s/%s (%s-%s; build %d; %s)",
-					XASH_ENGINE_NAME, XASH_VERSION, Q_buildos( ), Q_buildarch( ), Q_buildnum( ), Q_buildcommit( ));
-			}
-			else
+			if( !HTTP_ProcessStream( conn, conn->recvbuf, res ))
+				return;
+
+			// socket had more than we could take
+			if( res == conn->recvbufsize && conn->recvbufsize < HTTP_RECVBUF_MAX )
 			{
-				Q_strncpy( useragent, http_useragent.string, sizeof( useragent ));
+				conn->recvbufsize *= 2;
+				conn->recvbuf = Z_Realloc( conn->recvbuf, conn->recvbufsize );
 			}
+			continue;
+		}
 
-			curfile->query_length = Q_snprintf( curfile->buf, sizeof( curfile->buf ),
-				"GET %s%s HTTP/1.0\r\n"
-				"Host: %s\r\n"
-				"User-Agent: %s\r\n\r\n", curfile->server->path,
-				curfile->path, curfile->server->host, useragent );
-			curfile->header_size = 0;
-			curfile->bytes_sent = 0;
-			curfile->state = HTTP_REQUEST;
+		if( res == 0 )
+		{
+			Con_Reportf( "HTTP: %s closed connection\n", conn->server->host );
+			HTTP_ConnectionLost( conn );
+			return;
 		}
 
-		if( curfile->state < HTTP_REQUEST_SENT ) // Request not sent
+		if(( WSAGetLastError( ) != WSAEWOULDBLOCK ) && ( WSAGetLastError( ) != WSAEINPROGRESS ) && ( WSAGetLastError( ) != WSAENOTCONN ))
 		{
-			qboolean wait = false;
+			Con_Reportf( "problem downloading from %s:\n%s\n", conn->server->host, NET_ErrorString( ));
+			HTTP_ConnectionLost( conn );
+			return;
+		}
+		break;
+	}
 
-			while( curfile->bytes_sent < curfile->query_length )
-			{
-				int res = send( curfile->socket, curfile->buf + curfile->bytes_sent, curfile->query_length - curfile->bytes_sent, 0 );
+	// increase counter when blocking
+	if( progress || !conn->numpipeline )
+		conn->blocktime = 0;
+	else conn->blocktime += host.frametime;
 
-				if( res < 0 )
-				{
-					if( WSAGetLastError() != WSAEWOULDBLOCK && WSAGetLastError() != WSAENOTCONN )
-					{
-						Con_Printf( S_ERROR "failed to send request: %s\n", NET_ErrorString( ));
-						HTTP_FreeFile( curfile, true );
-						wait = true;
-						break;
-					}
-					// blocking while waiting connection
-					// increase counter when blocking
-					curfile->blocktime += host.frametime;
-					wait = true;
-
-					if( curfile->blocktime > http_timeout.value )
-					{
-						Con_Printf( S_ERROR "timeout on request send:\n%s\n", curfile->buf );
-						HTTP_FreeFile( curfile, true );
-						break;
-					}
-					break;
-				}
-				else
-				{
-					curfile->bytes_sent += res;
-					curfile->blocktime = 0;
-				}
-			}
+	if( conn->blocktime > http_timeout.value )
+	{
+		Con_Printf( S_ERROR "timeout on receiving data!\n");
+		HTTP_FailConnection( conn, false );
+	}
+}
 
-			if( wait )
-				continue;
+/*
+==============
+HTTP_Run
+
+Download next file block of each active file
+Call every frame
+==============
+*/
+void HTTP_Run( void )
+{
+	httpfile_t *curfile;
+	httpconn_t *conn;
+	int iProgressCount = 0;
+	float flProgress = 0;
+	qboolean fResolving = false;
+
+	// give queued files to connections
+	for( curfile = http.first_file; curfile; curfile = curfile->next )
+	{
+		if( curfile->state != HTTP_QUEUE )
+			continue;
 
-			Con_Reportf( "HTTP: Request sent!\n");
-			memset( curfile->buf, 0, sizeof( curfile->buf ));
-			curfile->state = HTTP_REQUEST_SENT;
+		if( !curfile->server )
+		{
+			Con_Printf( S_ERROR "no servers to download %s!\n", curfile->path );
+			HTTP_FreeFile( curfile, true );
+			continue;
 		}
 
-		if( !HTTP_ProcessStream( curfile ))
-			break;
+		conn = HTTP_GetConnection( curfile->server );
+
+		if( conn )
+			HTTP_QueueRequest( conn, curfile );
+	}
+
+	for( conn = http.first_conn; conn; conn = conn->next )
+	{
+		if( conn->state != HTTP_CONN_CLOSED )
+			HTTP_RunConnection( conn, &fResolving );
+	}
+
+	for( curfile = http.first_file; curfile; curfile = curfile->next )
+	{
+		if( curfile->state != HTTP_RESPONSE_RECEIVED )
+			continue;
 
 		if( curfile->size > 0 )
 		{
@@ -2704,21 +3234,15 @@ void HTTP_Run( void )
 			iProgressCount++;
 		}
 
-		if( curfile->size > 0 && curfile->downloaded >= curfile->size )
-		{
-			HTTP_FreeFile( curfile, false ); // success
-			break;
-		}
-		else if(( WSAGetLastError( ) != WSAEWOULDBLOCK ) && ( WSAGetLastError( ) != WSAEINPROGRESS ))
-			Con_Reportf( "problem downloading %s:\n%s\n", curfile->path, NET_ErrorString( ));
-		else
-			curfile->blocktime += host.frametime;
+		curfile->checktime += host.frametime;
 
-		if( curfile->blocktime > http_timeout.value )
+		if( curfile->checktime > 5 )
 		{
-			Con_Printf( S_ERROR "timeout on receiving data!\n");
-			HTTP_FreeFile( curfile, true );
-			break;
+			float speed = (float)curfile->lastchecksize / ( 5.0f * 1024 );
+
+			curfile->checktime = 0;
+			Con_Reportf( "download speed %f KB/s\n", speed );
+			curfile->lastchecksize = 0;
 		}
 	}
 
@@ -2744,7 +3268,6 @@ void HTTP_AddDownload( const char *path, int size, qboolean process )
 
 	httpfile->size = size;
 	httpfile->downloaded = 0;
-	httpfile->socket = -1;
 	Q_strncpy ( httpfile->path, path, sizeof( httpfile->path ));
 
 	if( http.last_file )
@@ -2886,6 +3409,17 @@ static void HTTP_Clear_f( void )
 {
 	http.last_file = NULL;
 
+	while( http.first_conn )
+	{
+		httpconn_t *conn = http.first_conn;
+
+		http.first_conn = http.first_conn->next;
+
+		HTTP_CloseConnection( conn );
+		Mem_Free( conn->recvbuf );
+		Mem_Free( conn );
+	}
+
 	while( http.first_file )
 	{
 		httpfile_t *file = http.first_file;
@@ -2895,9 +3429,6 @@ static void HTTP_Clear_f( void )
 		if( file->file )
 			FS_Close( file->file );
 
-		if( file->socket != -1 )
-			closesocket( file->socket );
-
 		Mem_Free( file );
 	}
 }
@@ -2997,6 +3528,7 @@ void HTTP_Init( void )
 	Cvar_RegisterVariable( &http_autoremove );
 	Cvar_RegisterVariable( &http_timeout );
 	Cvar_RegisterVariable( &http_maxconnections );
+	Cvar_RegisterVariable( &http_pipeline );
 
 	// Read servers from fastdl.txt
 	line = serverfile = (char *)FS_LoadFile( "fastdl.txt", 0, false );
@@ -3042,3 +3574,282 @@ void HTTP_Shutdown( void )
 
 	http.last_server = NULL;
 }
+
+#if XASH_ENGINE_TESTS && !XASH_WIN32 && !defined( XASH_NO_NETWORK )
+#include "tests.h"
+
+#define TEST_HTTP_FILES	6
+
+static const int test_http_sizes[TEST_HTTP_FILES] = { 11, 0, 300000, 1, 4095, 65536 };
+
+typedef struct
+{
+	int listener;
+	int stop;
+	int connections;
+	int requests;
+} test_httpd_t;
+
+static byte Test_HTTPByte( int file, int pos )
+{
+	return (byte)( file * 31 + pos * 7 + ( pos >> 8 ));
+}
+
+static qboolean Test_HTTPSend( int sock, const void *data, int len )
+{
+	const char *p = data;
+
+	while( len > 0 )
+	{
+		int res = send( sock, p, len, HTTP_SEND_FLAGS );
+
+		if( res <= 0 )
+			return false;
+
+		p += res;
+		len -= res;
+	}
+
+	return true;
+}
+
+static qboolean Test_HTTPRespond( int sock, const char *request )
+{
+	char header[256];
+	byte *body;
+	int i, file, len;
+
+	// GET /fastdl/httptest/fileN.bin HTTP/1.1
+	if( sscanf( request, "GET /fastdl/httptest/file%d.bin", &file ) != 1 || file < 0 || file >= TEST_HTTP_FILES )
+	{
+		// like most servers, drop connection after error
+		len = Q_snprintf( header, sizeof( header ), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n" );
+		Test_HTTPSend( sock, header, len );
+		return false;
+	}
+
+	body = Z_Malloc( test_http_sizes[file] + 1 );
+
+	for( i = 0; i < test_http_sizes[file]; i++ )
+		body[i] = Test_HTTPByte( file, i );
+
+	// odd files are sent in chunks, with extension and trailer
+	if( file & 1 )
+	{
+		int pos, chunk;
+
+		len = Q_snprintf( header, sizeof( header ), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n" );
+		i = Test_HTTPSend( sock, header, len );
+
+		for( pos = 0; i && pos < test_http_sizes[file]; pos += chunk )
+		{
+			chunk = Q_min( test_http_sizes[file] - pos, 3000 + pos % 7 );
+			len = Q_snprintf( header, sizeof( header ), "%X;ext=%d\r\n", chunk, pos );
+			i = Test_HTTPSend( sock, header, len ) && Test_HTTPSend( sock, body + pos, chunk ) && Test_HTTPSend( sock, "\r\n", 2 );
+		}
+
+		len = Q_snprintf( header, sizeof( header ), "0\r\nX-Trailer: %d\r\n\r\n", file );
+		i = i && Test_HTTPSend( sock, header, len );
+	}
+	else
+	{
+		len = Q_snprintf( header, sizeof( header ), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", test_http_sizes[file] );
+		i = Test_HTTPSend( sock, header, len ) && Test_HTTPSend( sock, body, test_http_sizes[file] );
+	}
+
+	Mem_Free( body );
+
+	return i;
+}
+
+// stand-in fastdl server, answers requests in order they came
+static void Test_HTTPServer( void *data )
+{
+	test_httpd_t *httpd = data;
+	char request[8192];
+	int client = -1, len = 0;
+
+	while( !Sys_AtomicLoad( &httpd->stop ))
+	{
+		struct timeval tv = { 0, 10000 };
+		fd_set fds;
+		char *end;
+		int res;
+
+		FD_ZERO( &fds );
+		FD_SET( client != -1 ? client : httpd->listener, &fds );
+
+		if( select(( client != -1 ? client : httpd->listener ) + 1, &fds, NULL, NULL, &tv ) <= 0 )
+			continue;
+
+		if( client == -1 )
+		{
+			client = accept( httpd->listener, NULL, NULL );
+
+			if( client != -1 )
+				httpd->connections++;
+
+			len = 0;
+			continue;
+		}
+
+		res = recv( client, request + len, sizeof( request ) - len - 1, 0 );
+
+		if( res <= 0 )
+		{
+			closesocket( client );
+			client = -1;
+			continue;
+		}
+
+		len += res;
+		request[len] = 0;
+
+		while(( end = Q_strstr( request, "\r\n\r\n" )))
+		{
+			int reqlen = end - request + 4;
+
+			httpd->requests++;
+
+			if( !Test_HTTPRespond( client, request ))
+			{
+				closesocket( client );
+				client = -1;
+				break;
+			}
+
+			memmove( request, request + reqlen, len - reqlen + 1 );
+			len -= reqlen;
+		}
+	}
+
+	if( client != -1 )
+		closesocket( client );
+}
+
+static void Test_HTTPWait( double timeout )
+{
+	double deadline = Sys_DoubleTime() + timeout;
+
+	while( http.first_file && Sys_DoubleTime() < deadline )
+	{
+		HTTP_Run();
+		Sys_Sleep( 1 );
+	}
+}
+
+void Test_RunHTTP( void )
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof( addr );
+	test_httpd_t httpd;
+	sys_thread_t *thread;
+	qboolean initialized = net.initialized;
+	char url[MAX_VA_STRING], name[MAX_SYSPATH];
+	int i, j;
+
+	memset( &httpd, 0, sizeof( httpd ));
+	memset( &addr, 0, sizeof( addr ));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	httpd.listener = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	TASSERT( httpd.listener != -1 );
+
+	if( httpd.listener == -1 )
+		return;
+
+	if( bind( httpd.listener, (struct sockaddr *)&addr, sizeof( addr )) || listen( httpd.listener, 4 )
+		|| getsockname( httpd.listener, (struct sockaddr *)&addr, &addrlen ))
+	{
+		Msg( S_WARN "%s: can't listen on loopback, skipped\n", __func__ );
+		closesocket( httpd.listener );
+		return;
+	}
+
+	thread = Sys_CreateThread( Test_HTTPServer, &httpd );
+
+	if( !thread )
+	{
+		closesocket( httpd.listener );
+		return;
+	}
+
+	Cvar_RegisterVariable( &http_useragent );
+	Cvar_RegisterVariable( &http_autoremove );
+	Cvar_RegisterVariable( &http_timeout );
+	Cvar_RegisterVariable( &http_maxconnections );
+	Cvar_RegisterVariable( &http_pipeline );
+	Cvar_DirectSet( &http_maxconnections, "1" );
+
+	// address is numeric, resolver isn't needed
+	net.initialized = true;
+
+	Q_snprintf( url, sizeof( url ), "http://127.0.0.1:%d/fastdl/", ntohs( addr.sin_port ));
+	HTTP_AddCustomServer( url );
+
+	for( i = 0; i < TEST_HTTP_FILES; i++ )
+	{
+		Q_snprintf( name, sizeof( name ), "httptest/file%d.bin", i );
+		HTTP_AddDownload( name, -1, false );
+	}
+
+	Test_HTTPWait( 10.0 );
+	TASSERT( http.first_file == NULL );
+
+	// all files over one connection
+	TASSERT_EQi( httpd.connections, 1 );
+	TASSERT_EQi( httpd.requests, TEST_HTTP_FILES );
+
+	for( i = 0; i < TEST_HTTP_FILES; i++ )
+	{
+		fs_offset_t size = -1;
+		byte *data;
+		int errors = 0;
+
+		Q_snprintf( name, sizeof( name ), "downloaded/httptest/file%d.bin", i );
+		data = FS_LoadFile( name, &size, false );
+
+		TASSERT( data != NULL );
+		TASSERT_EQi( (int)size, test_http_sizes[i] );
+
+		if( !data )
+			continue;
+
+		for( j = 0; j < size; j++ )
+		{
+			if( data[j] != Test_HTTPByte( i, j ))
+				errors++;
+		}
+
+		TASSERT_EQi( errors, 0 );
+		Mem_Free( data );
+		FS_Delete( name );
+	}
+
+	// missing file is dropped, remaining requests are sent again over new connection
+	HTTP_AddDownload( "httptest/missing.bin", -1, false );
+	HTTP_AddDownload( "httptest/file0.bin", -1, false );
+
+	Test_HTTPWait( 10.0 );
+	TASSERT( http.first_file == NULL );
+	TASSERT( !FS_FileExists( "downloaded/httptest/missing.bin.incomplete", false ));
+	TASSERT( FS_FileExists( "downloaded/httptest/file0.bin", false ));
+	FS_Delete( "downloaded/httptest/file0.bin" );
+
+	HTTP_Clear_f();
+	HTTP_ClearCustomServers();
+	net.initialized = initialized;
+
+	Sys_AtomicStore( &httpd.stop, 1 );
+	Sys_JoinThread( thread );
+	closesocket( httpd.listener );
+}
+#elif XASH_ENGINE_TESTS
+#include "tests.h"
+
+void Test_RunHTTP( void )
+{
+	// stand-in server needs BSD sockets
+}
+#endif /* XASH_ENGINE_TESTS */
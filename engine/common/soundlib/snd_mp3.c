@@ -346,6 +346,7 @@ stream_t *Stream_OpenMPG( const char *filename )
 	stream->channels = sc.channels;
 	stream->rate = sc.rate;
 	stream->width = 2;	// always 16 bit
+	stream->loopstart = -1;
 	stream->ptr = mpeg;
 	stream->type = WF_MPGDATA;
 
@@ -380,7 +380,14 @@ stream_t *Stream_OpenWAV( const char *filename )
 	FS_Read( file, &t, sizeof( t ));
 	sound.width = t / 8;
 
-	sound.loopstart = 0;
+	// looped waves are only streamed as music, sounds need to know it
+	sound.loopstart = -1;
+	last_chunk = iff_data;
+	if( StreamFindNextChunk( file, "cue ", &last_chunk ))
+	{
+		FS_Seek( file, 28, SEEK_CUR );
+		FS_Read( file, &sound.loopstart, sizeof( int ));
+	}
 
 	// find data chunk
 	last_chunk = iff_data;
@@ -402,6 +409,7 @@ stream_t *Stream_OpenWAV( const char *filename )
 	stream->channels = sound.channels;
 	stream->width = sound.width;
 	stream->rate = sound.rate;
+	stream->loopstart = sound.loopstart;
 	stream->type = WF_PCMDATA;
 
 	return stream;
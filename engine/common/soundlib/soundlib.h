@@ -71,6 +71,7 @@ struct stream_s
 	int		channels;	// stream channels
 	int		type;	// wavtype
 	size_t		size;	// total stream size
+	int		loopstart;	// first sample of the loop, -1 if stream has no cue markers
 
 	// current stream state
 	void		*ptr;	// internal decoder state
@@ -41,16 +41,38 @@ GNU General Public License for more details.
 #include <sys/select.h>
 #endif
 
+#define LOG_RING_SIZE	(256 * 1024)
+#define LOG_CHUNK_SIZE	(16 * 1024)
+
 typedef struct {
 	char		title[64];
 	qboolean		log_active;
 	char		log_path[MAX_SYSPATH];
 	FILE		*logfile;
 	int 		logfileno;
+
+	// lines are queued from any thread and written by one writer thread
+	ringbuffer_t	ring;
+	sys_thread_t	*thread;
+	sys_sem_t		*wakeup;
+	sys_sem_t		*drained;	// posted for every waiter when the ring is empty
+	int		shutdown;	// atomic
+	int		active;	// atomic, lines can be queued
+	int		users;	// atomic, threads that use the ring right now
+	int		waiters;	// atomic, threads waiting for the writer
+	uint		written;	// atomic, bytes of the ring already on disk
 } LogData;
 
 static LogData s_ld;
 
+// localtime and strftime are only called once a second
+static struct
+{
+	time_t		time;
+	char		shorttime[16];
+	char		fulltime[32];
+} s_logtime;
+
 char *Sys_Input( void )
 {
 #if XASH_USE_SELECT
@@ -121,6 +143,136 @@ static void Sys_FlushLogfile( void )
 		fflush( s_ld.logfile );
 }
 
+static void Sys_LogWriterThread( void *data )
+{
+	char	chunk[LOG_CHUNK_SIZE];
+	qboolean	done;
+	uint	len;
+	int	i;
+
+	while( 1 )
+	{
+		Sys_SemaphoreTimedWait( s_ld.wakeup, 100 );
+		done = Sys_AtomicLoad( &s_ld.shutdown );
+
+		while(( len = Ring_Read( &s_ld.ring, chunk, sizeof( chunk ))) > 0 )
+		{
+			write( s_ld.logfileno, chunk, len );
+			Sys_AtomicAdd( &s_ld.written, len );
+		}
+
+		for( i = Sys_AtomicLoad( &s_ld.waiters ); i > 0; i-- )
+			Sys_SemaphorePost( s_ld.drained );
+
+		if( done ) break;
+	}
+}
+
+/*
+=================
+Sys_WaitLogWriter
+
+wake up the writer and sleep until it empties the ring
+=================
+*/
+static void Sys_WaitLogWriter( void )
+{
+	Sys_AtomicAdd( &s_ld.waiters, 1 );
+	Sys_SemaphorePost( s_ld.wakeup );
+	Sys_SemaphoreTimedWait( s_ld.drained, 100 );
+	Sys_AtomicAdd( &s_ld.waiters, -1 );
+}
+
+/*
+=================
+Sys_LogWriterEnter
+
+ring can't be freed until Sys_LogWriterLeave
+=================
+*/
+static qboolean Sys_LogWriterEnter( void )
+{
+	Sys_AtomicAdd( &s_ld.users, 1 );
+
+	if( Sys_AtomicLoad( &s_ld.active ))
+		return true;
+
+	Sys_AtomicAdd( &s_ld.users, -1 );
+	return false;
+}
+
+static void Sys_LogWriterLeave( void )
+{
+	Sys_AtomicAdd( &s_ld.users, -1 );
+}
+
+static void Sys_StartLogWriter( void )
+{
+	if( !Ring_Init( &s_ld.ring, LOG_RING_SIZE ))
+		return;
+
+	s_ld.wakeup = Sys_CreateSemaphore( 0 );
+	s_ld.drained = Sys_CreateSemaphore( 0 );
+	s_ld.shutdown = 0;
+	s_ld.written = 0;
+
+	if( s_ld.wakeup && s_ld.drained )
+		s_ld.thread = Sys_CreateThread( Sys_LogWriterThread, NULL );
+
+	if( !s_ld.thread )
+	{
+		Sys_DestroySemaphore( s_ld.wakeup );
+		Sys_DestroySemaphore( s_ld.drained );
+		s_ld.wakeup = s_ld.drained = NULL;
+		Ring_Free( &s_ld.ring );
+		return;
+	}
+
+	Sys_AtomicStore( &s_ld.active, 1 );
+}
+
+static void Sys_StopLogWriter( void )
+{
+	if( !s_ld.thread )
+		return;
+
+	// new lines go straight to the file, let threads
+	// that are queueing lines now get out of the ring
+	Sys_AtomicStore( &s_ld.active, 0 );
+
+	while( Sys_AtomicLoad( &s_ld.users ) > 0 )
+		Sys_WaitLogWriter();
+
+	// thread writes out everything before exit
+	Sys_AtomicStore( &s_ld.shutdown, 1 );
+	Sys_SemaphorePost( s_ld.wakeup );
+	Sys_JoinThread( s_ld.thread );
+	s_ld.thread = NULL;
+
+	Sys_DestroySemaphore( s_ld.wakeup );
+	Sys_DestroySemaphore( s_ld.drained );
+	s_ld.wakeup = s_ld.drained = NULL;
+	Ring_Free( &s_ld.ring );
+}
+
+/*
+=================
+Sys_FlushLog
+
+wait until queued lines are on disk
+=================
+*/
+void Sys_FlushLog( void )
+{
+	if( !Sys_LogWriterEnter( ))
+		return;
+
+	while( Sys_AtomicLoad( &s_ld.written ) != Sys_AtomicLoad( &s_ld.ring.head ))
+		Sys_WaitLogWriter();
+
+	Sys_LogWriterLeave();
+}
+
 void Sys_InitLog( void )
 {
 	const char	*mode;
@@ -151,6 +303,10 @@ void Sys_InitLog( void )
 		fprintf( s_ld.logfile, "=================================================================================\n" );
 		fprintf( s_ld.logfile, "\t%s (build %i commit %s (%s-%s)) started at %s\n", s_ld.title, Q_buildnum(), Q_buildcommit(), Q_buildos(), Q_buildarch(), Q_timestamp( TIME_FULL ) );
 		fprintf( s_ld.logfile, "=================================================================================\n" );
+		Sys_FlushLogfile();
+
+		// everything else goes directly to the descriptor
+		Sys_StartLogWriter();
 	}
 }
 
@@ -174,6 +330,7 @@ void Sys_CloseLog( void )
 	}
 
 	Sys_FlushStdout(); // flush to stdout to ensure all data was written
+	Sys_StopLogWriter();
 
 	if( s_ld.logfile )
 	{
@@ -189,7 +346,7 @@ void Sys_CloseLog( void )
 }
 
 #if XASH_COLORIZE_CONSOLE == true
-static void Sys_WriteEscapeSequenceForColorcode( int fd, int c )
+static const char *Sys_EscapeSequenceForColorcode( int c )
 {
 	static const char *q3ToAnsi[ 8 ] =
 	{
@@ -202,21 +359,35 @@ static void Sys_WriteEscapeSequenceForColorcode( int fd, int c )
 		"\033[35m", // COLOR_MAGENTA
 		"\033[0m", // COLOR_WHITE
 	};
-	const char *esc = q3ToAnsi[c];
 
-	if( c == 7 )
-		write( fd, esc, 4 );
-	else write( fd, esc, 5 );
+	return q3ToAnsi[c];
 }
 #else
-static void Sys_WriteEscapeSequenceForColorcode( int fd, int c ) {}
+static const char *Sys_EscapeSequenceForColorcode( int c ) { return ""; }
 #endif
 
-static void Sys_PrintLogfile( const int fd, const char *logtime, const char *msg, const qboolean colorize )
+static size_t Sys_AppendLogLine( char *out, size_t size, size_t len, const char *s, size_t n )
 {
-	const char *p = msg;
+	if( n > size - 1 - len )
+		n = size - 1 - len;
+	memcpy( out + len, s, n );
+	return len + n;
+}
 
-	write( fd, logtime, Q_strlen( logtime ) );
+/*
+=================
+Sys_FormatLogLine
+
+builds the whole line, so it's written with a single call,
+output is truncated to the buffer size
+=================
+*/
+static size_t Sys_FormatLogLine( char *out, size_t size, const char *logtime, const char *msg, const qboolean colorize )
+{
+	const char *p = msg, *esc;
+	size_t len;
+
+	len = Sys_AppendLogLine( out, size, 0, logtime, Q_strlen( logtime ));
 
 	while( p && *p )
 	{
@@ -224,28 +395,36 @@ static void Sys_PrintLogfile( const int fd, const char *logtime, const char *msg
 
 		if( p == NULL )
 		{
-			write( fd, msg, Q_strlen( msg ));
+			len = Sys_AppendLogLine( out, size, len, msg, Q_strlen( msg ));
 			break;
 		}
 		else if( IsColorString( p ))
 		{
-			if( p != msg )
-				write( fd, msg, p - msg );
+			len = Sys_AppendLogLine( out, size, len, msg, p - msg );
 			msg = p + 2;
 
 			if( colorize )
-				Sys_WriteEscapeSequenceForColorcode( fd, ColorIndex( p[1] ));
+			{
+				esc = Sys_EscapeSequenceForColorcode( ColorIndex( p[1] ));
+				len = Sys_AppendLogLine( out, size, len, esc, Q_strlen( esc ));
+			}
 		}
 		else
 		{
-			write( fd, msg, p - msg + 1 );
+			len = Sys_AppendLogLine( out, size, len, msg, p - msg + 1 );
 			msg = p + 1;
 		}
 	}
 
 	// flush the color
 	if( colorize )
-		Sys_WriteEscapeSequenceForColorcode( fd, 7 );
+	{
+		esc = Sys_EscapeSequenceForColorcode( 7 );
+		len = Sys_AppendLogLine( out, size, len, esc, Q_strlen( esc ));
+	}
+
+	out[len] = '\0';
+	return len;
 }
 
 static void Sys_PrintStdout( const char *logtime, const char *msg )
@@ -280,42 +459,73 @@ static void Sys_PrintStdout( const char *logtime, const char *msg )
 #endif
 
 #elif !XASH_WIN32 // Wcon does the job
-	Sys_PrintLogfile( STDOUT_FILENO, logtime, msg, XASH_COLORIZE_CONSOLE );
+	char	line[MAX_PRINT_MSG + 512];
+	size_t	len;
+
+	len = Sys_FormatLogLine( line, sizeof( line ), logtime, msg, XASH_COLORIZE_CONSOLE );
+	write( STDOUT_FILENO, line, len );
 	Sys_FlushStdout();
 #endif
 }
 
-void Sys_PrintLog( const char *pMsg )
+static void Sys_UpdateLogTime( void )
 {
-	time_t crt_time;
 	const struct tm	*crt_tm;
-	char logtime[32] = "";
-	static char lastchar;
+	time_t		crt_time;
 
 	time( &crt_time );
+
+	if( crt_time == s_logtime.time )
+		return;
+
 	crt_tm = localtime( &crt_time );
+	strftime( s_logtime.shorttime, sizeof( s_logtime.shorttime ), "[%H:%M:%S] ", crt_tm ); //short time
+	strftime( s_logtime.fulltime, sizeof( s_logtime.fulltime ), "[%Y:%m:%d|%H:%M:%S] ", crt_tm ); //full time
+	s_logtime.time = crt_time;
+}
 
-	if( !lastchar || lastchar == '\n')
-		strftime( logtime, sizeof( logtime ), "[%H:%M:%S] ", crt_tm ); //short time
+void Sys_PrintLog( const char *pMsg )
+{
+	char line[MAX_PRINT_MSG + 64];
+	const char *logtime = "";
+	static char lastchar;
+	qboolean newline;
+	size_t len;
+
+	Sys_UpdateLogTime();
+	newline = !lastchar || lastchar == '\n';
+
+	if( newline )
+		logtime = s_logtime.shorttime;
 
 	// spew to stdout
 	Sys_PrintStdout( logtime, pMsg );
 
+	// save last char to detect when line was not ended
+	lastchar = pMsg[Q_strlen( pMsg ) - 1];
+
 	if( !s_ld.logfile )
+		return;
+
+	len = Sys_FormatLogLine( line, sizeof( line ), newline ? s_logtime.fulltime : "", pMsg, false );
+
+	// fatal errors and crashes go straight to the disk, the engine may not live long enough
+	if( host.status == HOST_ERR_FATAL || host.status == HOST_CRASHED || !Sys_LogWriterEnter( ))
 	{
-		// save last char to detect when line was not ended
-		lastchar = pMsg[Q_strlen( pMsg ) - 1];
+		if( host.status != HOST_CRASHED )
+			Sys_FlushLog();
+		write( s_ld.logfileno, line, len );
 		return;
 	}
 
-	if( !lastchar || lastchar == '\n')
-		strftime( logtime, sizeof( logtime ), "[%Y:%m:%d|%H:%M:%S] ", crt_tm ); //full time
-	
-	// save last char to detect when line was not ended
-	lastchar = pMsg[Q_strlen( pMsg ) - 1];
+	while( !Ring_WriteShared( &s_ld.ring, line, len ))
+		Sys_WaitLogWriter();
+
+	// let the lines pile up, the writer also wakes up by itself
+	if( Ring_Used( &s_ld.ring ) >= LOG_RING_SIZE / 4 )
+		Sys_SemaphorePost( s_ld.wakeup );
 
-	Sys_PrintLogfile( s_ld.logfileno, logtime, pMsg, false );
-	Sys_FlushLogfile();
+	Sys_LogWriterLeave();
 }
 
 /*
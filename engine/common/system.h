@@ -80,6 +80,7 @@ void Sys_DestroyConsole( void );
 void Sys_CloseLog( void );
 void Sys_InitLog( void );
 void Sys_PrintLog( const char *pMsg );
+void Sys_FlushLog( void );
 int Sys_LogFileNo( void );
 
 //
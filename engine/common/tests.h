@@ -37,7 +37,14 @@ void Test_RunCmd( void );
 void Test_RunCvar( void );
 void Test_RunCon( void );
 void Test_RunVOX( void );
+void Test_RunSoundMix( void );
+void Test_RunDSP( void );
 void Test_RunIPFilter( void );
+void Test_RunThreads( void );
+void Test_RunHTTP( void );
+void Test_RunParticles( void );
+void Test_RunInterpolation( void );
+void Test_RunPVSCache( void );
 
 #define TEST_LIST_0 \
 	Test_RunLibCommon(); \
@@ -50,10 +57,17 @@ void Test_RunIPFilter( void );
 	Test_RunCon();
 
 #define TEST_LIST_1 \
-	Test_RunImagelib();
+	Test_RunThreads(); \
+	Test_RunImagelib(); \
+	Test_RunPVSCache(); \
+	Test_RunHTTP();
 
 #define TEST_LIST_1_CLIENT \
-	Test_RunVOX();
+	Test_RunVOX(); \
+	Test_RunSoundMix(); \
+	Test_RunDSP(); \
+	Test_RunParticles(); \
+	Test_RunInterpolation();
 
 #endif
 
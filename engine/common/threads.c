@@ -0,0 +1,1242 @@
+/*
+threads.c - portable threads, locks and engine worker pool
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "threads.h"
+#include "xash3d_mathlib.h"
+
+#if XASH_THREADS
+#if XASH_WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+#endif // XASH_THREADS
+
+/*
+==============================================================
+
+SYSTEM THREADS
+
+all objects are allocated with plain malloc, because zone
+allocator uses a mutex itself
+==============================================================
+*/
+#if XASH_THREADS && XASH_WIN32
+struct sys_mutex_s
+{
+	CRITICAL_SECTION cs;
+};
+
+struct sys_sem_s
+{
+	HANDLE handle;
+};
+
+struct sys_thread_s
+{
+	HANDLE handle;
+	void (*func)( void *data );
+	void *data;
+};
+
+sys_mutex_t *Sys_CreateMutex( void )
+{
+	sys_mutex_t *mutex = calloc( 1, sizeof( *mutex ));
+
+	if( mutex ) InitializeCriticalSection( &mutex->cs );
+	return mutex;
+}
+
+void Sys_DestroyMutex( sys_mutex_t *mutex )
+{
+	if( !mutex ) return;
+	DeleteCriticalSection( &mutex->cs );
+	free( mutex );
+}
+
+void Sys_LockMutex( sys_mutex_t *mutex )
+{
+	EnterCriticalSection( &mutex->cs );
+}
+
+void Sys_UnlockMutex( sys_mutex_t *mutex )
+{
+	LeaveCriticalSection( &mutex->cs );
+}
+
+sys_sem_t *Sys_CreateSemaphore( int value )
+{
+	sys_sem_t *sem = calloc( 1, sizeof( *sem ));
+
+	if( !sem ) return NULL;
+
+	sem->handle = CreateSemaphore( NULL, value, 0x7fffffff, NULL );
+
+	if( !sem->handle )
+	{
+		free( sem );
+		return NULL;
+	}
+
+	return sem;
+}
+
+void Sys_DestroySemaphore( sys_sem_t *sem )
+{
+	if( !sem ) return;
+	CloseHandle( sem->handle );
+	free( sem );
+}
+
+void Sys_SemaphorePost( sys_sem_t *sem )
+{
+	ReleaseSemaphore( sem->handle, 1, NULL );
+}
+
+void Sys_SemaphoreWait( sys_sem_t *sem )
+{
+	WaitForSingleObject( sem->handle, INFINITE );
+}
+
+qboolean Sys_SemaphoreTimedWait( sys_sem_t *sem, int msec )
+{
+	return WaitForSingleObject( sem->handle, msec ) == WAIT_OBJECT_0;
+}
+
+static DWORD WINAPI Sys_ThreadStart( LPVOID arg )
+{
+	sys_thread_t *thread = arg;
+
+	thread->func( thread->data );
+	return 0;
+}
+
+sys_thread_t *Sys_CreateThread( void (*func)( void *data ), void *data )
+{
+	sys_thread_t *thread = calloc( 1, sizeof( *thread ));
+
+	if( !thread ) return NULL;
+
+	thread->func = func;
+	thread->data = data;
+	thread->handle = CreateThread( NULL, 0, Sys_ThreadStart, thread, 0, NULL );
+
+	if( !thread->handle )
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+void Sys_JoinThread( sys_thread_t *thread )
+{
+	if( !thread ) return;
+	WaitForSingleObject( thread->handle, INFINITE );
+	CloseHandle( thread->handle );
+	free( thread );
+}
+
+int Sys_CPUCount( void )
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+	return Q_max( 1, (int)info.dwNumberOfProcessors );
+}
+
+void Sys_Yield( void )
+{
+	SwitchToThread();
+}
+#elif XASH_THREADS // POSIX
+struct sys_mutex_s
+{
+	pthread_mutex_t mutex;
+};
+
+struct sys_sem_s
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+	int value;
+};
+
+struct sys_thread_s
+{
+	pthread_t handle;
+	void (*func)( void *data );
+	void *data;
+};
+
+sys_mutex_t *Sys_CreateMutex( void )
+{
+	sys_mutex_t *mutex = calloc( 1, sizeof( *mutex ));
+	pthread_mutexattr_t attr;
+
+	if( !mutex ) return NULL;
+
+	// recursive, so zone allocator may call itself from Mem_Realloc
+	pthread_mutexattr_init( &attr );
+	pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+	pthread_mutex_init( &mutex->mutex, &attr );
+	pthread_mutexattr_destroy( &attr );
+
+	return mutex;
+}
+
+void Sys_DestroyMutex( sys_mutex_t *mutex )
+{
+	if( !mutex ) return;
+	pthread_mutex_destroy( &mutex->mutex );
+	free( mutex );
+}
+
+void Sys_LockMutex( sys_mutex_t *mutex )
+{
+	pthread_mutex_lock( &mutex->mutex );
+}
+
+void Sys_UnlockMutex( sys_mutex_t *mutex )
+{
+	pthread_mutex_unlock( &mutex->mutex );
+}
+
+sys_sem_t *Sys_CreateSemaphore( int value )
+{
+	sys_sem_t *sem = calloc( 1, sizeof( *sem ));
+
+	if( !sem ) return NULL;
+
+	// not using sem_t here, as unnamed semaphores aren't available everywhere
+	pthread_mutex_init( &sem->mutex, NULL );
+	pthread_cond_init( &sem->cond, NULL );
+	sem->value = value;
+
+	return sem;
+}
+
+void Sys_DestroySemaphore( sys_sem_t *sem )
+{
+	if( !sem ) return;
+	pthread_cond_destroy( &sem->cond );
+	pthread_mutex_destroy( &sem->mutex );
+	free( sem );
+}
+
+void Sys_SemaphorePost( sys_sem_t *sem )
+{
+	pthread_mutex_lock( &sem->mutex );
+	sem->value++;
+	pthread_cond_signal( &sem->cond );
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+void Sys_SemaphoreWait( sys_sem_t *sem )
+{
+	pthread_mutex_lock( &sem->mutex );
+	while( sem->value <= 0 )
+		pthread_cond_wait( &sem->cond, &sem->mutex );
+	sem->value--;
+	pthread_mutex_unlock( &sem->mutex );
+}
+
+qboolean Sys_SemaphoreTimedWait( sys_sem_t *sem, int msec )
+{
+	struct timespec ts;
+	struct timeval tv;
+	qboolean ret = true;
+
+	gettimeofday( &tv, NULL );
+	ts.tv_sec = tv.tv_sec + msec / 1000;
+	ts.tv_nsec = tv.tv_usec * 1000 + ( msec % 1000 ) * 1000000;
+
+	if( ts.tv_nsec >= 1000000000 )
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock( &sem->mutex );
+	while( sem->value <= 0 )
+	{
+		if( pthread_cond_timedwait( &sem->cond, &sem->mutex, &ts ) != 0 )
+		{
+			ret = false;
+			break;
+		}
+	}
+	if( ret ) sem->value--;
+	pthread_mutex_unlock( &sem->mutex );
+
+	return ret;
+}
+
+static void *Sys_ThreadStart( void *arg )
+{
+	sys_thread_t *thread = arg;
+
+	thread->func( thread->data );
+	return NULL;
+}
+
+sys_thread_t *Sys_CreateThread( void (*func)( void *data ), void *data )
+{
+	sys_thread_t *thread = calloc( 1, sizeof( *thread ));
+
+	if( !thread ) return NULL;
+
+	thread->func = func;
+	thread->data = data;
+
+	if( pthread_create( &thread->handle, NULL, Sys_ThreadStart, thread ))
+	{
+		free( thread );
+		return NULL;
+	}
+
+	return thread;
+}
+
+void Sys_JoinThread( sys_thread_t *thread )
+{
+	if( !thread ) return;
+	pthread_join( thread->handle, NULL );
+	free( thread );
+}
+
+int Sys_CPUCount( void )
+{
+#if defined( _SC_NPROCESSORS_ONLN )
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+
+	if( count > 0 )
+		return count;
+#endif
+	return 1;
+}
+
+void Sys_Yield( void )
+{
+	sched_yield();
+}
+#else // !XASH_THREADS
+// single threaded stubs, locks are no-op, threads can't be created
+struct sys_mutex_s
+{
+	int dummy;
+};
+
+struct sys_sem_s
+{
+	int value;
+};
+
+sys_mutex_t *Sys_CreateMutex( void )
+{
+	return calloc( 1, sizeof( sys_mutex_t ));
+}
+
+void Sys_DestroyMutex( sys_mutex_t *mutex )
+{
+	free( mutex );
+}
+
+void Sys_LockMutex( sys_mutex_t *mutex )
+{
+}
+
+void Sys_UnlockMutex( sys_mutex_t *mutex )
+{
+}
+
+sys_sem_t *Sys_CreateSemaphore( int value )
+{
+	sys_sem_t *sem = calloc( 1, sizeof( *sem ));
+
+	if( sem ) sem->value = value;
+	return sem;
+}
+
+void Sys_DestroySemaphore( sys_sem_t *sem )
+{
+	free( sem );
+}
+
+void Sys_SemaphorePost( sys_sem_t *sem )
+{
+	sem->value++;
+}
+
+void Sys_SemaphoreWait( sys_sem_t *sem )
+{
+	if( sem->value > 0 )
+		sem->value--;
+}
+
+qboolean Sys_SemaphoreTimedWait( sys_sem_t *sem, int msec )
+{
+	if( sem->value <= 0 )
+		return false;
+	sem->value--;
+	return true;
+}
+
+sys_thread_t *Sys_CreateThread( void (*func)( void *data ), void *data )
+{
+	return NULL;
+}
+
+void Sys_JoinThread( sys_thread_t *thread )
+{
+}
+
+int Sys_CPUCount( void )
+{
+	return 1;
+}
+
+void Sys_Yield( void )
+{
+}
+#endif // !XASH_THREADS
+
+/*
+==============================================================
+
+WORKER POOL
+
+==============================================================
+*/
+typedef struct job_s
+{
+	jobfunc_t	work;
+	jobfunc_t	done;
+	void	*data;
+	struct job_s	*next;
+} job_t;
+
+typedef struct parallel_s
+{
+	jobrange_t	func;
+	void	*data;
+	int	count;
+	int	grain;
+	int	next;	// atomic, next unclaimed index
+	int	helpers;	// helper jobs that may still touch this struct, under jobs.lock
+} parallel_t;
+
+static struct
+{
+	sys_thread_t	*threads[MAX_WORKER_THREADS];
+	int		numthreads;
+	sys_mutex_t	*lock;
+	sys_sem_t		*wakeup;
+	sys_sem_t		*finished;	// posted for every waiter when something it waits for is done
+
+	job_t		*queue;		// waiting for a worker
+	job_t		*queue_tail;
+	job_t		*completed;	// waiting for Job_RunCompletions
+	job_t		*completed_tail;
+	job_t		*freelist;
+
+	int		pending;		// queued or running jobs, under lock
+	int		waiters;		// threads sleeping on finished, under lock
+	qboolean		shutdown;
+} jobs;
+
+static job_t *Job_Alloc( void )
+{
+	job_t *job;
+
+	// called with lock held
+	if( jobs.freelist )
+	{
+		job = jobs.freelist;
+		jobs.freelist = job->next;
+	}
+	else job = malloc( sizeof( *job ));
+
+	if( job ) memset( job, 0, sizeof( *job ));
+
+	return job;
+}
+
+/*
+=================
+Job_WakeWaiters
+
+called with lock held, every waiter checks
+again if it was the thing it's waiting for
+=================
+*/
+static void Job_WakeWaiters( void )
+{
+	for( ; jobs.waiters > 0; jobs.waiters-- )
+		Sys_SemaphorePost( jobs.finished );
+}
+
+/*
+=================
+Job_WaitCounter
+
+sleeps until counter protected by lock drops to zero
+=================
+*/
+static void Job_WaitCounter( const int *counter )
+{
+	Sys_LockMutex( jobs.lock );
+	while( *counter > 0 )
+	{
+		jobs.waiters++;
+		Sys_UnlockMutex( jobs.lock );
+		Sys_SemaphoreWait( jobs.finished );
+		Sys_LockMutex( jobs.lock );
+	}
+	Sys_UnlockMutex( jobs.lock );
+}
+
+static void Job_WorkerThread( void *unused )
+{
+	job_t *job;
+
+	while( 1 )
+	{
+		Sys_SemaphoreWait( jobs.wakeup );
+
+		while( 1 )
+		{
+			Sys_LockMutex( jobs.lock );
+			job = jobs.queue;
+			if( job )
+			{
+				jobs.queue = job->next;
+				if( !jobs.queue )
+					jobs.queue_tail = NULL;
+			}
+			Sys_UnlockMutex( jobs.lock );
+
+			if( !job )
+				break;
+
+			job->work( job->data );
+
+			Sys_LockMutex( jobs.lock );
+			job->next = NULL;
+			if( job->done )
+			{
+				if( jobs.completed_tail )
+					jobs.completed_tail->next = job;
+				else jobs.completed = job;
+				jobs.completed_tail = job;
+			}
+			else
+			{
+				job->next = jobs.freelist;
+				jobs.freelist = job;
+			}
+
+			if( --jobs.pending == 0 )
+				Job_WakeWaiters();
+			Sys_UnlockMutex( jobs.lock );
+		}
+
+		if( jobs.shutdown )
+			break;
+	}
+}
+
+/*
+=================
+Job_Init
+
+spawns worker threads, count can be overriden with -threads
+=================
+*/
+void Job_Init( void )
+{
+	int i, count;
+
+	memset( &jobs, 0, sizeof( jobs ));
+	jobs.lock = Sys_CreateMutex();
+	jobs.wakeup = Sys_CreateSemaphore( 0 );
+	jobs.finished = Sys_CreateSemaphore( 0 );
+
+	// leave one core for the main thread
+	if( !Sys_GetIntFromCmdLine( "-threads", &count ))
+		count = Sys_CPUCount() - 1;
+
+	count = bound( 0, count, MAX_WORKER_THREADS );
+
+	for( i = 0; i < count; i++ )
+	{
+		jobs.threads[i] = Sys_CreateThread( Job_WorkerThread, NULL );
+
+		if( !jobs.threads[i] )
+			break;
+	}
+
+	jobs.numthreads = i;
+
+	if( jobs.numthreads > 0 )
+		Con_Reportf( "Job_Init: started %i worker threads\n", jobs.numthreads );
+}
+
+/*
+=================
+Job_Shutdown
+
+lets workers to finish the queue and stops them
+=================
+*/
+void Job_Shutdown( void )
+{
+	job_t *job;
+	int i;
+
+	if( !jobs.lock )
+		return;
+
+	jobs.shutdown = true;
+
+	for( i = 0; i < jobs.numthreads; i++ )
+		Sys_SemaphorePost( jobs.wakeup );
+
+	for( i = 0; i < jobs.numthreads; i++ )
+		Sys_JoinThread( jobs.threads[i] );
+
+	// finish jobs that are left without workers
+	Job_WaitAll();
+
+	while( jobs.freelist )
+	{
+		job = jobs.freelist;
+		jobs.freelist = job->next;
+		free( job );
+	}
+
+	Sys_DestroySemaphore( jobs.wakeup );
+	Sys_DestroySemaphore( jobs.finished );
+	Sys_DestroyMutex( jobs.lock );
+	memset( &jobs, 0, sizeof( jobs ));
+}
+
+/*
+=================
+Job_Add
+
+queue a job, 'done' is optional
+=================
+*/
+void Job_Add( jobfunc_t work, jobfunc_t done, void *data )
+{
+	job_t *job;
+
+	if( !jobs.numthreads || jobs.shutdown )
+	{
+		work( data );
+		if( done ) done( data );
+		return;
+	}
+
+	Sys_LockMutex( jobs.lock );
+	job = Job_Alloc();
+	if( !job )
+	{
+		Sys_UnlockMutex( jobs.lock );
+		work( data );
+		if( done ) done( data );
+		return;
+	}
+
+	job->work = work;
+	job->done = done;
+	job->data = data;
+
+	if( jobs.queue_tail )
+		jobs.queue_tail->next = job;
+	else jobs.queue = job;
+	jobs.queue_tail = job;
+	jobs.pending++;
+	Sys_UnlockMutex( jobs.lock );
+
+	Sys_SemaphorePost( jobs.wakeup );
+}
+
+/*
+=================
+Job_RunCompletions
+
+main thread only, called once per host frame
+=================
+*/
+void Job_RunCompletions( void )
+{
+	job_t *job, *next;
+
+	if( !jobs.lock )
+		return;
+
+	Sys_LockMutex( jobs.lock );
+	job = jobs.completed;
+	jobs.completed = jobs.completed_tail = NULL;
+	Sys_UnlockMutex( jobs.lock );
+
+	for( ; job; job = next )
+	{
+		next = job->next;
+		job->done( job->data );
+
+		Sys_LockMutex( jobs.lock );
+		job->next = jobs.freelist;
+		jobs.freelist = job;
+		Sys_UnlockMutex( jobs.lock );
+	}
+}
+
+/*
+=================
+Job_WaitAll
+
+blocks until every queued job is finished and completed
+=================
+*/
+void Job_WaitAll( void )
+{
+	job_t *job;
+
+	if( !jobs.lock )
+		return;
+
+	// no workers left, drain the queue here
+	if( jobs.shutdown )
+	{
+		while( 1 )
+		{
+			Sys_LockMutex( jobs.lock );
+			job = jobs.queue;
+			if( job ) jobs.queue = job->next;
+			else jobs.queue_tail = NULL;
+			Sys_UnlockMutex( jobs.lock );
+
+			if( !job ) break;
+
+			job->work( job->data );
+			if( job->done ) job->done( job->data );
+			free( job );
+
+			Sys_LockMutex( jobs.lock );
+			jobs.pending--;
+			Sys_UnlockMutex( jobs.lock );
+		}
+	}
+
+	Job_WaitCounter( &jobs.pending );
+	Job_RunCompletions();
+}
+
+static void Job_ParallelWork( parallel_t *p )
+{
+	int start, end;
+
+	while( 1 )
+	{
+		start = Sys_AtomicAdd( &p->next, p->grain ) - p->grain;
+		if( start >= p->count )
+			break;
+
+		end = Q_min( start + p->grain, p->count );
+		p->func( p->data, start, end );
+	}
+}
+
+static void Job_ParallelHelper( void *data )
+{
+	parallel_t *p = data;
+
+	Job_ParallelWork( p );
+
+	// p is gone as soon as the caller sees zero
+	Sys_LockMutex( jobs.lock );
+	if( --p->helpers == 0 )
+		Job_WakeWaiters();
+	Sys_UnlockMutex( jobs.lock );
+}
+
+/*
+=================
+Job_ParallelFor
+
+splits [0, count) into ranges of 'grain' items and calls func on
+workers and on the calling thread, returns when everything is done
+=================
+*/
+void Job_ParallelFor( jobrange_t func, void *data, int count, int grain )
+{
+	parallel_t p;
+	job_t *job, **prev;
+	int i, numhelpers;
+
+	if( count <= 0 )
+		return;
+
+	grain = Q_max( grain, 1 );
+	numhelpers = Q_min( jobs.numthreads, ( count + grain - 1 ) / grain - 1 );
+
+	if( numhelpers <= 0 || jobs.shutdown )
+	{
+		func( data, 0, count );
+		return;
+	}
+
+	p.func = func;
+	p.data = data;
+	p.count = count;
+	p.grain = grain;
+	p.next = 0;
+	p.helpers = numhelpers;
+
+	// helpers go to the head of the queue, they must not wait for long jobs
+	Sys_LockMutex( jobs.lock );
+	for( i = 0; i < numhelpers; i++ )
+	{
+		if(( job = Job_Alloc( )) == NULL )
+		{
+			p.helpers--;
+			continue;
+		}
+
+		job->work = Job_ParallelHelper;
+		job->data = &p;
+		job->next = jobs.queue;
+		jobs.queue = job;
+		if( !jobs.queue_tail )
+			jobs.queue_tail = job;
+		jobs.pending++;
+	}
+	Sys_UnlockMutex( jobs.lock );
+
+	for( i = 0; i < numhelpers; i++ )
+		Sys_SemaphorePost( jobs.wakeup );
+
+	Job_ParallelWork( &p );
+
+	// nothing left to do, take back helpers that didn't start yet
+	Sys_LockMutex( jobs.lock );
+	jobs.queue_tail = NULL;
+	for( prev = &jobs.queue; *prev; )
+	{
+		job = *prev;
+
+		if( job->data == &p && job->work == Job_ParallelHelper )
+		{
+			*prev = job->next;
+			job->next = jobs.freelist;
+			jobs.freelist = job;
+			p.helpers--;
+			jobs.pending--;
+			continue;
+		}
+
+		jobs.queue_tail = job;
+		prev = &job->next;
+	}
+
+	// the helpers taken back may have been all Job_WaitAll waits for
+	if( jobs.pending == 0 )
+		Job_WakeWaiters();
+	Sys_UnlockMutex( jobs.lock );
+
+	// sleep until running helpers finish their last range
+	Job_WaitCounter( &p.helpers );
+}
+
+int Job_NumWorkers( void )
+{
+	return jobs.numthreads;
+}
+
+/*
+==============================================================
+
+RING BUFFER
+
+==============================================================
+*/
+qboolean Ring_Init( ringbuffer_t *ring, uint size )
+{
+	memset( ring, 0, sizeof( *ring ));
+
+	if( !size || ( size & ( size - 1 )))
+		return false;
+
+	ring->data = malloc( size );
+	if( !ring->data )
+		return false;
+
+	ring->size = size;
+	return true;
+}
+
+void Ring_Free( ringbuffer_t *ring )
+{
+	free( ring->data );
+	memset( ring, 0, sizeof( *ring ));
+}
+
+uint Ring_Used( ringbuffer_t *ring )
+{
+	return Sys_AtomicLoad( &ring->head ) - Sys_AtomicLoad( &ring->tail );
+}
+
+/*
+=================
+Ring_Write
+
+producer side, writes all of the data or nothing
+=================
+*/
+qboolean Ring_Write( ringbuffer_t *ring, const void *data, uint len )
+{
+	uint head = ring->head;
+	uint tail = Sys_AtomicLoad( &ring->tail );
+	uint pos, first;
+
+	if( ring->size - ( head - tail ) < len )
+		return false;
+
+	pos = head & ( ring->size - 1 );
+	first = Q_min( len, ring->size - pos );
+
+	memcpy( ring->data + pos, data, first );
+	memcpy( ring->data, (const byte *)data + first, len - first );
+
+	// publish only after the bytes are in place
+	Sys_AtomicStore( &ring->head, head + len );
+	return true;
+}
+
+/*
+=================
+Ring_WriteShared
+
+multiple producers, writes all of the data or nothing.
+Space is claimed first, so the copies run in parallel, then
+writes are published in the order of claims
+=================
+*/
+qboolean Ring_WriteShared( ringbuffer_t *ring, const void *data, uint len )
+{
+	uint start, tail, pos, first;
+
+	do
+	{
+		start = Sys_AtomicLoad( &ring->reserve );
+		tail = Sys_AtomicLoad( &ring->tail );
+
+		if( ring->size - ( start - tail ) < len )
+			return false;
+	} while( !Sys_AtomicCompareExchange( &ring->reserve, start, start + len ));
+
+	pos = start & ( ring->size - 1 );
+	first = Q_min( len, ring->size - pos );
+
+	memcpy( ring->data + pos, data, first );
+	memcpy( ring->data, (const byte *)data + first, len - first );
+
+	// wait for the writers that claimed space before us
+	while( Sys_AtomicLoad( &ring->head ) != start )
+		Sys_Yield();
+
+	Sys_AtomicStore( &ring->head, start + len );
+	return true;
+}
+
+/*
+=================
+Ring_Read
+
+consumer side, returns number of bytes copied
+=================
+*/
+uint Ring_Read( ringbuffer_t *ring, void *data, uint maxlen )
+{
+	uint tail = ring->tail;
+	uint head = Sys_AtomicLoad( &ring->head );
+	uint pos, first, len;
+
+	len = Q_min( head - tail, maxlen );
+	if( !len )
+		return 0;
+
+	pos = tail & ( ring->size - 1 );
+	first = Q_min( len, ring->size - pos );
+
+	memcpy( data, ring->data + pos, first );
+	memcpy( (byte *)data + first, ring->data, len - first );
+
+	// producer may reuse the space now
+	Sys_AtomicStore( &ring->tail, tail + len );
+	return len;
+}
+
+#if XASH_ENGINE_TESTS
+#include "tests.h"
+
+static int test_work_count;
+static int test_done_count;
+
+static void Test_JobWork( void *data )
+{
+	Sys_AtomicAdd( &test_work_count, 1 );
+}
+
+static void Test_JobDone( void *data )
+{
+	test_done_count++;
+}
+
+static void Test_ParallelSquare( void *data, int start, int end )
+{
+	uint *out = data;
+	int i;
+
+	for( i = start; i < end; i++ )
+		out[i] = (uint)i * i;
+}
+
+// parallel loops from workers and the main thread wait at the same time
+static void Test_JobParallel( void *data )
+{
+	Job_ParallelFor( Test_ParallelSquare, data, 25000, 500 );
+}
+
+#define TEST_RING_BYTES	100000
+
+static void Test_RingProducer( void *data )
+{
+	ringbuffer_t *ring = data;
+	byte chunk[13];
+	uint i, j, len;
+
+	for( i = 0; i < TEST_RING_BYTES; i += len )
+	{
+		len = Q_min( sizeof( chunk ), TEST_RING_BYTES - i );
+
+		for( j = 0; j < len; j++ )
+			chunk[j] = (byte)( i + j );
+
+		while( !Ring_Write( ring, chunk, len ))
+			Sys_Yield();
+	}
+}
+
+#define TEST_RING_PRODUCERS	3
+#define TEST_RING_RECORDS	20000
+
+typedef struct
+{
+	ringbuffer_t	*ring;
+	uint		id;
+} test_ring_producer_t;
+
+static void Test_RingSharedProducer( void *data )
+{
+	test_ring_producer_t *p = data;
+	uint rec[2], i;
+
+	for( i = 0; i < TEST_RING_RECORDS; i++ )
+	{
+		rec[0] = p->id;
+		rec[1] = i;
+
+		while( !Ring_WriteShared( p->ring, rec, sizeof( rec )))
+			Sys_Yield();
+	}
+}
+
+static void Test_RunRingShared( void )
+{
+	test_ring_producer_t producers[TEST_RING_PRODUCERS];
+	sys_thread_t *threads[TEST_RING_PRODUCERS];
+	uint next[TEST_RING_PRODUCERS];
+	uint buf[16];
+	ringbuffer_t ring;
+	int i, numthreads = 0, errors = 0;
+	uint j, len, records = 0;
+
+	TASSERT( Ring_Init( &ring, 64 ));
+
+	// all or nothing, same as single producer
+	TASSERT( Ring_WriteShared( &ring, buf, 40 ));
+	TASSERT( !Ring_WriteShared( &ring, buf, 25 ));
+	TASSERT_EQi( Ring_Read( &ring, buf, sizeof( buf )), 40 );
+	TASSERT( Ring_WriteShared( &ring, buf, 60 ));
+	TASSERT_EQi( Ring_Used( &ring ), 60 );
+	Ring_Free( &ring );
+
+	TASSERT( Ring_Init( &ring, 1024 ));
+
+	for( i = 0; i < TEST_RING_PRODUCERS; i++ )
+	{
+		producers[i].ring = &ring;
+		producers[i].id = i;
+		next[i] = 0;
+
+		if(( threads[numthreads] = Sys_CreateThread( Test_RingSharedProducer, &producers[i] )) != NULL )
+			numthreads++;
+	}
+
+	// every producer's records must come whole and in order
+	while( records < numthreads * TEST_RING_RECORDS )
+	{
+		len = Ring_Read( &ring, buf, sizeof( buf ));
+
+		if( !len )
+		{
+			Sys_Yield();
+			continue;
+		}
+
+		for( j = 0; j < len / sizeof( uint ); j += 2 )
+		{
+			if( buf[j] >= TEST_RING_PRODUCERS || buf[j + 1] != next[buf[j]]++ )
+				errors++;
+			records++;
+		}
+	}
+
+	for( i = 0; i < numthreads; i++ )
+		Sys_JoinThread( threads[i] );
+
+	TASSERT_EQi( errors, 0 );
+	TASSERT_EQi( Ring_Used( &ring ), 0 );
+	Ring_Free( &ring );
+}
+
+static void Test_RunRing( void )
+{
+	ringbuffer_t ring;
+	sys_thread_t *thread;
+	byte buf[64];
+	uint i, j, len, total;
+	int errors = 0;
+
+	TASSERT( !Ring_Init( &ring, 100 ));
+	TASSERT( Ring_Init( &ring, 64 ));
+
+	// single thread, wrapping around the end
+	for( i = 0; i < 10; i++ )
+	{
+		for( j = 0; j < 40; j++ )
+			buf[j] = (byte)( i * 40 + j );
+
+		TASSERT( Ring_Write( &ring, buf, 40 ));
+		TASSERT( !Ring_Write( &ring, buf, 25 ));
+		TASSERT_EQi( Ring_Used( &ring ), 40 );
+
+		memset( buf, 0, sizeof( buf ));
+		TASSERT_EQi( Ring_Read( &ring, buf, sizeof( buf )), 40 );
+
+		for( j = 0; j < 40; j++ )
+		{
+			if( buf[j] != (byte)( i * 40 + j ))
+				errors++;
+		}
+	}
+
+	TASSERT_EQi( errors, 0 );
+	TASSERT_EQi( Ring_Read( &ring, buf, sizeof( buf )), 0 );
+
+	// producer thread, reads of a different size
+	thread = Sys_CreateThread( Test_RingProducer, &ring );
+
+	if( thread )
+	{
+		for( total = 0; total < TEST_RING_BYTES; total += len )
+		{
+			len = Ring_Read( &ring, buf, 17 );
+
+			if( !len )
+			{
+				Sys_Yield();
+				continue;
+			}
+
+			for( j = 0; j < len; j++ )
+			{
+				if( buf[j] != (byte)( total + j ))
+					errors++;
+			}
+		}
+
+		Sys_JoinThread( thread );
+		TASSERT_EQi( errors, 0 );
+		TASSERT_EQi( Ring_Used( &ring ), 0 );
+	}
+
+	Ring_Free( &ring );
+}
+
+void Test_RunThreads( void )
+{
+	uint *arr;
+	int i, errors = 0;
+
+	test_work_count = test_done_count = 0;
+
+	for( i = 0; i < 64; i++ )
+		Job_Add( Test_JobWork, Test_JobDone, NULL );
+
+	Job_WaitAll();
+	TASSERT_EQi( test_work_count, 64 );
+	TASSERT_EQi( test_done_count, 64 );
+
+	arr = Mem_Calloc( host.mempool, sizeof( *arr ) * 100000 );
+	Job_ParallelFor( Test_ParallelSquare, arr, 100000, 1000 );
+
+	for( i = 0; i < 100000; i++ )
+	{
+		if( arr[i] != (uint)i * i )
+			errors++;
+	}
+
+	TASSERT_EQi( errors, 0 );
+
+	memset( arr, 0, sizeof( *arr ) * 100000 );
+	for( i = 1; i < 4; i++ )
+		Job_Add( Test_JobParallel, NULL, arr + i * 25000 );
+	Job_ParallelFor( Test_ParallelSquare, arr, 25000, 500 );
+	Job_WaitAll();
+
+	for( i = 0; i < 100000; i++ )
+	{
+		if( arr[i] != (uint)( i % 25000 ) * ( i % 25000 ))
+			errors++;
+	}
+
+	TASSERT_EQi( errors, 0 );
+	Mem_Free( arr );
+
+	Test_RunRing();
+	Test_RunRingShared();
+}
+#endif /* XASH_ENGINE_TESTS */
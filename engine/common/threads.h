@@ -0,0 +1,134 @@
+/*
+threads.h - portable threads, locks and engine worker pool
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef THREADS_H
+#define THREADS_H
+
+#include "xash3d_types.h"
+
+// same conditions as for asynchronous name resolving,
+// --disable-async-resolve build option turns off threads completely
+#if !XASH_EMSCRIPTEN && !XASH_DOS4GW && !defined XASH_NO_ASYNC_NS_RESOLVE
+#define XASH_THREADS 1
+#else
+#undef XASH_THREADS
+#endif
+
+#define MAX_WORKER_THREADS	16
+
+/*
+==============================================================
+
+ATOMICS
+
+only used for counters and ring buffer indices shared between threads
+==============================================================
+*/
+#if defined( _MSC_VER )
+#include <intrin.h>
+#define Sys_AtomicLoad( ptr )		_InterlockedOr(( volatile long *)( ptr ), 0 )
+#define Sys_AtomicStore( ptr, val )	_InterlockedExchange(( volatile long *)( ptr ), ( val ))
+#define Sys_AtomicAdd( ptr, val )	( _InterlockedExchangeAdd(( volatile long *)( ptr ), ( val )) + ( val ))
+#define Sys_AtomicExchange( ptr, val )	_InterlockedExchange(( volatile long *)( ptr ), ( val ))
+#define Sys_AtomicCompareExchange( ptr, oldval, newval ) \
+	( _InterlockedCompareExchange(( volatile long *)( ptr ), ( newval ), ( oldval )) == ( oldval ))
+#else
+#define Sys_AtomicLoad( ptr )		__atomic_load_n(( ptr ), __ATOMIC_ACQUIRE )
+#define Sys_AtomicStore( ptr, val )	__atomic_store_n(( ptr ), ( val ), __ATOMIC_RELEASE )
+#define Sys_AtomicAdd( ptr, val )	__atomic_add_fetch(( ptr ), ( val ), __ATOMIC_ACQ_REL )
+#define Sys_AtomicExchange( ptr, val )	__atomic_exchange_n(( ptr ), ( val ), __ATOMIC_ACQ_REL )
+#define Sys_AtomicCompareExchange( ptr, oldval, newval ) \
+	__extension__({ __typeof__( *( ptr )) _expected = ( oldval ); \
+	__atomic_compare_exchange_n(( ptr ), &_expected, ( newval ), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ); })
+#endif
+
+/*
+==============================================================
+
+SYSTEM THREADS
+
+opaque handles, all functions are safe to call with threads disabled,
+Sys_CreateThread will fail in that case
+==============================================================
+*/
+typedef struct sys_mutex_s sys_mutex_t;
+typedef struct sys_sem_s sys_sem_t;
+typedef struct sys_thread_s sys_thread_t;
+
+sys_mutex_t *Sys_CreateMutex( void );
+void Sys_DestroyMutex( sys_mutex_t *mutex );
+void Sys_LockMutex( sys_mutex_t *mutex );
+void Sys_UnlockMutex( sys_mutex_t *mutex );
+
+sys_sem_t *Sys_CreateSemaphore( int value );
+void Sys_DestroySemaphore( sys_sem_t *sem );
+void Sys_SemaphorePost( sys_sem_t *sem );
+void Sys_SemaphoreWait( sys_sem_t *sem );
+qboolean Sys_SemaphoreTimedWait( sys_sem_t *sem, int msec );
+
+sys_thread_t *Sys_CreateThread( void (*func)( void *data ), void *data );
+void Sys_JoinThread( sys_thread_t *thread );
+int Sys_CPUCount( void );
+void Sys_Yield( void );
+
+/*
+==============================================================
+
+WORKER POOL
+
+Job_Add runs 'work' on a worker thread and then 'done' on the
+main thread from Job_RunCompletions, so 'done' may safely touch
+engine state. With no workers available, both are called inline.
+==============================================================
+*/
+typedef void (*jobfunc_t)( void *data );
+typedef void (*jobrange_t)( void *data, int start, int end );
+
+void Job_Init( void );
+void Job_Shutdown( void );
+void Job_Add( jobfunc_t work, jobfunc_t done, void *data );
+void Job_RunCompletions( void );
+void Job_WaitAll( void );
+void Job_ParallelFor( jobrange_t func, void *data, int count, int grain );
+int Job_NumWorkers( void );
+
+/*
+==============================================================
+
+RING BUFFER
+
+lock-free byte queue with one consumer thread, size must be a
+power of two. Ring_Write is for a single producer thread,
+Ring_WriteShared lets any number of threads write the same ring,
+only one of them can be used with a ring
+==============================================================
+*/
+typedef struct ringbuffer_s
+{
+	byte	*data;
+	uint	size;
+	uint	head;	// atomic, total bytes written, changed by producer only
+	uint	tail;	// atomic, total bytes read, changed by consumer only
+	uint	reserve;	// atomic, total bytes claimed by shared producers
+} ringbuffer_t;
+
+qboolean Ring_Init( ringbuffer_t *ring, uint size );
+void Ring_Free( ringbuffer_t *ring );
+uint Ring_Used( ringbuffer_t *ring );
+qboolean Ring_Write( ringbuffer_t *ring, const void *data, uint len );
+qboolean Ring_WriteShared( ringbuffer_t *ring, const void *data, uint len );
+uint Ring_Read( ringbuffer_t *ring, void *data, uint maxlen );
+
+#endif // THREADS_H
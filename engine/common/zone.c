@@ -64,6 +64,7 @@ typedef struct mempool_s
 } mempool_t;
 
 static mempool_t *poolchain = NULL; // critical stuff
+static sys_mutex_t *mem_lock = NULL; // worker threads may allocate too
 
 #if XASH_64BIT
 // a1ba: due to mempool being passed with the model through reused 32-bit field
@@ -101,6 +102,7 @@ void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char
 	if( size <= 0 ) return NULL;
 	if( !poolptr ) Sys_Error( "Mem_Alloc: pool == NULL (alloc at %s:%i)\n", filename, fileline );
 
+	Sys_LockMutex( mem_lock );
 	pool = Mem_FindPool( poolptr );
 
 	pool->totalsize += size;
@@ -123,6 +125,8 @@ void *_Mem_Alloc( poolhandle_t poolptr, size_t size, qboolean clear, const char
 	mem->prev = NULL;
 	pool->chain = mem;
 	if( mem->next ) mem->next->prev = mem;
+	Sys_UnlockMutex( mem_lock );
+
 	if( clear )
 		memset((void *)((byte *)mem + sizeof( memheader_t )), 0, mem->size );
 
@@ -184,7 +188,10 @@ static void Mem_FreeBlock( memheader_t *mem, const char *filename, int fileline
 void _Mem_Free( void *data, const char *filename, int fileline )
 {
 	if( data == NULL ) Sys_Error( "Mem_Free: data == NULL (called at %s:%i)\n", filename, fileline );
+
+	Sys_LockMutex( mem_lock );
 	Mem_FreeBlock((memheader_t *)((byte *)data - sizeof( memheader_t )), filename, fileline );
+	Sys_UnlockMutex( mem_lock );
 }
 
 void *_Mem_Realloc( poolhandle_t poolptr, void *memptr, size_t size, qboolean clear, const char *filename, int fileline )
@@ -233,11 +240,16 @@ poolhandle_t _Mem_AllocPool( const char *name, const char *filename, int filelin
 	pool->totalsize = 0;
 	pool->realsize = sizeof( mempool_t );
 	Q_strncpy( pool->name, name, sizeof( pool->name ));
+
+	Sys_LockMutex( mem_lock );
 	pool->next = poolchain;
 	poolchain = pool;
-	
 #if XASH_64BIT
 	pool->idx = ++lastidx;
+#endif
+	Sys_UnlockMutex( mem_lock );
+
+#if XASH_64BIT
 	return pool->idx;
 #else
 	return (poolhandle_t)pool;
@@ -249,6 +261,7 @@ void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline )
 	mempool_t	*pool;
 	mempool_t	**chainaddress;
 
+	Sys_LockMutex( mem_lock );
 	if( *poolptr && ( pool = Mem_FindPool( *poolptr )))
 	{
 		// unlink pool from chain
@@ -265,18 +278,24 @@ void _Mem_FreePool( poolhandle_t *poolptr, const char *filename, int fileline )
 		Q_free( pool );
 		*poolptr = 0;
 	}
+	Sys_UnlockMutex( mem_lock );
 }
 
 void _Mem_EmptyPool( poolhandle_t poolptr, const char *filename, int fileline )
 {
-	mempool_t *pool = Mem_FindPool( poolptr );
+	mempool_t *pool;
+
 	if( !poolptr ) Sys_Error( "Mem_EmptyPool: pool == NULL (emptypool at %s:%i)\n", filename, fileline );
 
+	Sys_LockMutex( mem_lock );
+	pool = Mem_FindPool( poolptr );
+
 	if( pool->sentinel1 != MEMHEADER_SENTINEL1 ) Sys_Error( "Mem_EmptyPool: trashed pool sentinel 1 (allocpool at %s:%i, emptypool at %s:%i)\n", pool->filename, pool->fileline, filename, fileline );
 	if( pool->sentinel2 != MEMHEADER_SENTINEL1 ) Sys_Error( "Mem_EmptyPool: trashed pool sentinel 2 (allocpool at %s:%i, emptypool at %s:%i)\n", pool->filename, pool->fileline, filename, fileline );
 
 	// free memory owned by the pool
 	while( pool->chain ) Mem_FreeBlock( pool->chain, filename, fileline );
+	Sys_UnlockMutex( mem_lock );
 }
 
 static qboolean Mem_CheckAlloc( mempool_t *pool, void *data )
@@ -308,9 +327,14 @@ Check pointer for memory
 qboolean Mem_IsAllocatedExt( poolhandle_t poolptr, void *data )
 {
 	mempool_t	*pool = NULL;
+	qboolean	ret;
+
+	Sys_LockMutex( mem_lock );
 	if( poolptr ) pool = Mem_FindPool( poolptr );
+	ret = Mem_CheckAlloc( pool, data );
+	Sys_UnlockMutex( mem_lock );
 
-	return Mem_CheckAlloc( pool, data );
+	return ret;
 }
 
 static void Mem_CheckHeaderSentinels( void *data, const char *filename, int fileline )
@@ -340,6 +364,8 @@ void _Mem_Check( const char *filename, int fileline )
 	memheader_t *mem;
 	mempool_t   *pool;
 
+	// workers may allocate while chains are walked
+	Sys_LockMutex( mem_lock );
 	for( pool = poolchain; pool; pool = pool->next )
 	{
 		if( pool->sentinel1 != MEMHEADER_SENTINEL1 )
@@ -351,6 +377,7 @@ void _Mem_Check( const char *filename, int fileline )
 	for( pool = poolchain; pool; pool = pool->next )
 		for( mem = pool->chain; mem; mem = mem->next )
 			Mem_CheckHeaderSentinels((void *)((byte *) mem + sizeof(memheader_t)), filename, fileline );
+	Sys_UnlockMutex( mem_lock );
 }
 
 void Mem_PrintStats( void )
@@ -359,12 +386,15 @@ void Mem_PrintStats( void )
 	mempool_t *pool;
 
 	Mem_Check();
+
+	Sys_LockMutex( mem_lock );
 	for( pool = poolchain; pool; pool = pool->next )
 	{
 		count++;
 		size += pool->totalsize;
 		realsize += pool->realsize;
 	}
+	Sys_UnlockMutex( mem_lock );
 
 	Con_Printf( "^3%lu^7 memory pools, totalling: ^1%s\n", count, Q_memprint( size ));
 	Con_Printf( "total allocated size: ^1%s\n", Q_memprint( realsize ));
@@ -378,6 +408,8 @@ void Mem_PrintList( size_t minallocationsize )
 	Mem_Check();
 
 	Con_Printf( "memory pool list:\n""  ^3size                          name\n");
+
+	Sys_LockMutex( mem_lock );
 	for( pool = poolchain; pool; pool = pool->next )
 	{
 		long	changed_size = (long)pool->totalsize - (long)pool->lastchecksize;
@@ -400,6 +432,7 @@ void Mem_PrintList( size_t minallocationsize )
 			if( mem->size >= minallocationsize )
 				Con_Printf( "%10s allocated at %s:%i\n", Q_memprint( mem->size ), mem->filename, mem->fileline );
 	}
+	Sys_UnlockMutex( mem_lock );
 }
 
 /*
@@ -410,4 +443,7 @@ Memory_Init
 void Memory_Init( void )
 {
 	poolchain = NULL; // init mem chain
+
+	if( !mem_lock )
+		mem_lock = Sys_CreateMutex();
 }
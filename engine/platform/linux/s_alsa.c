@@ -327,6 +327,8 @@ void SNDDMA_Activate( qboolean active )
 	if( !dma.initialized )
 		return;
 
+	// pcm handle is used by mixer thread
+	S_LockMixer();
 	s_alsa.paused = !active;
 
 	if( !s_alsa.paused )
@@ -339,6 +341,7 @@ void SNDDMA_Activate( qboolean active )
 		snd_pcm_drain( s_alsa.pcm_handle );
 		snd_pcm_drop( s_alsa.pcm_handle );
 	}
+	S_UnlockMixer();
 }
 
 qboolean VoiceCapture_Init( void )
@@ -51,6 +51,12 @@ void SDLash_Init( void )
 #ifndef SDL_INIT_EVENTS
 #define SDL_INIT_EVENTS 0
 #endif
+#if XASH_SDL == 2
+	// offscreen rendering in ref_soft doesn't need a display, keep user's choice of driver
+	if( Sys_CheckParm( "-offscreen" ))
+		SDL_setenv( "SDL_VIDEODRIVER", "dummy", 0 );
+#endif // XASH_SDL == 2
+
 	if( SDL_Init( SDL_INIT_TIMER | SDL_INIT_VIDEO | SDL_INIT_EVENTS ) )
 	{
 		Sys_Warn( "SDL_Init failed: %s", SDL_GetError() );
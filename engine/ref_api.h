@@ -36,7 +36,10 @@ GNU General Public License for more details.
 // 2. FS functions are removed, instead we have full fs_api_t
 // 3. SlerpBones, CalcBonePosition/Quaternion calls were moved to libpublic/mathlib
 // 4. R_StudioEstimateFrame now has time argument
-#define REF_API_VERSION 4
+// 5. Job_ParallelFor and Job_NumWorkers exported to renderers
+// 6. particles are moved by the engine, CL_DrawParticles gets them packed
+// 7. Profile_Begin and Profile_End to time renderer parts in client frame profiler
+#define REF_API_VERSION 7
 
 
 #define TF_SKY		(TF_SKYSIDE|TF_NOMIPMAP)
@@ -88,6 +91,14 @@ typedef struct
 	int		cull;
 } sortedface_t;
 
+// particle as the renderer draws it, color is from the palette
+typedef struct ref_particle_s
+{
+	vec3_t	org;
+	color24	color;
+	byte	alpha;
+} ref_particle_t;
+
 typedef struct ref_globals_s
 {
 	qboolean developer;
@@ -437,6 +448,15 @@ typedef struct ref_api_s
 	int (*XVK_GetInstanceExtensions)( unsigned int count, const char **pNames );
 	void *(*XVK_GetVkGetInstanceProcAddr)( void );
 	VkSurfaceKHR (*XVK_CreateSurface)( VkInstance instance );
+
+	// engine worker pool, func is called on workers and on the calling thread
+	void (*Job_ParallelFor)( void (*func)( void *data, int start, int end ), void *data, int count, int grain );
+	int (*Job_NumWorkers)( void );
+
+	// client frame profiler zones, they nest and must be closed in the
+	// same frame, main thread only. Name is a string constant
+	void (*Profile_Begin)( const char *name );
+	void (*Profile_End)( void );
 } ref_api_t;
 
 struct mip_s;
@@ -525,7 +545,7 @@ typedef struct ref_interface_s
 	void (*Mod_StudioLoadTextures)( model_t *mod, void *data );
 
 	// efx implementation
-	void (*CL_DrawParticles)( double frametime, particle_t *particles, float partsize );
+	void (*CL_DrawParticles)( const ref_particle_t *particles, int count, float partsize );
 	void (*CL_DrawTracers)( double frametime, particle_t *tracers );
 	void (*CL_DrawBeams)( int fTrans , BEAM *beams );
 	qboolean (*R_BeamCull)( const vec3_t start, const vec3_t end, qboolean pvsOnly );
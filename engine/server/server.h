@@ -115,6 +115,17 @@ typedef struct
 	qboolean		net_log;
 	netadr_t		net_address;
 	file_t		*file;
+
+	// file is written by a separate thread
+	ringbuffer_t	ring;
+	sys_thread_t	*thread;
+	sys_sem_t		*wakeup;
+	int		shutdown;		// atomic
+
+	// date prefix is formatted once a second
+	time_t		lasttime;
+	char		timestamp[32];
+	int		timestamplen;
 } server_log_t;
 
 typedef struct server_s
@@ -138,6 +149,7 @@ typedef struct server_s
 
 	double		lastchecktime;
 	int		lastcheck;	// number of last checked client
+	mleaf_t		*lastcheckleaf;	// view leaf of last checked client, NULL if clientpvs is merged
 
 	char		model_precache[MAX_MODELS][MAX_QPATH];
 	char		sound_precache[MAX_SOUNDS][MAX_QPATH];
@@ -551,7 +563,7 @@ sv_client_t *SV_ClientByName( const char *name );
 void SV_FullClientUpdate( sv_client_t *cl, sizebuf_t *msg );
 void SV_FullUpdateMovevars( sv_client_t *cl, sizebuf_t *msg );
 void SV_GetPlayerStats( sv_client_t *cl, int *ping, int *packet_loss );
-void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl );
+void SV_SendServerdata( sizebuf_t *msg, int playernum );
 void SV_ClientThink( sv_client_t *cl, usercmd_t *cmd );
 void SV_ExecuteClientMessage( sv_client_t *cl, sizebuf_t *msg );
 void SV_ConnectionlessPacket( netadr_t from, sizebuf_t *msg );
@@ -604,6 +616,20 @@ int SV_FindBestBaselineForStatic( int index, entity_state_t **baseline, entity_s
 void SV_WriteFrameToClient( sv_client_t *client, sizebuf_t *msg );
 void SV_BuildClientFrame( sv_client_t *client );
 void SV_SkipUpdates( void );
+void SV_WriteEntitiesToSpectator( sv_client_t *cl, edict_t *host, sizebuf_t *msg );
+
+//
+// sv_demo.c
+//
+void SV_InitDemo( void );
+void SV_Record_f( void );
+void SV_StopRecord_f( void );
+sv_client_t *SV_DemoClient( void );
+void SV_DemoLevelStart( void );
+void SV_DemoLevelEnd( void );
+void SV_DemoFrame( void );
+void SV_DemoStop( void );
+void SV_DemoRecordCommand( sizebuf_t *msg );
 
 //
 // sv_game.c
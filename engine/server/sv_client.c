@@ -1575,7 +1575,7 @@ Sends the first message from the server to a connected client.
 This will be sent on the initial connection and upon each server load.
 ================
 */
-void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl )
+void SV_SendServerdata( sizebuf_t *msg, int playernum )
 {
 	string	message;
 	int	i;
@@ -1593,7 +1593,7 @@ void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl )
 	MSG_WriteLong( msg, PROTOCOL_VERSION );
 	MSG_WriteLong( msg, svs.spawncount );
 	MSG_WriteLong( msg, sv.worldmapCRC );
-	MSG_WriteByte( msg, cl - svs.clients );
+	MSG_WriteByte( msg, playernum );
 	MSG_WriteByte( msg, svs.maxclients );
 	MSG_WriteWord( msg, GI->max_edicts );
 	MSG_WriteWord( msg, MAX_MODELS );
@@ -1614,7 +1614,7 @@ void SV_SendServerdata( sizebuf_t *msg, sv_client_t *cl )
 	Delta_WriteDescriptionToClient( msg );
 
 	// now client know delta and can reading encoded messages
-	SV_FullUpdateMovevars( cl, msg );
+	SV_FullUpdateMovevars( NULL, msg );
 
 	// send the user messages registration
 	for( i = 1; i < MAX_USER_MESSAGES && svgame.msg[i].name[0]; i++ )
@@ -1664,7 +1664,7 @@ static qboolean SV_New_f( sv_client_t *cl )
 		return false;
 
 	// send the serverdata
-	SV_SendServerdata( &msg, cl );
+	SV_SendServerdata( &msg, cl - svs.clients );
 
 	// if the client was connected, tell the game .dll to disconnect him/her.
 	if(( cl->state == cs_spawned ) && cl->edict )
@@ -1018,6 +1018,8 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "redirect", Rcon_Redirect_f, "force enable rcon redirection" );
 	Cmd_AddCommand( "logaddress", SV_SetLogAddress_f, "sets address and port for remote logging host" );
 	Cmd_AddCommand( "log", SV_ServerLog_f, "enables logging to file" );
+	Cmd_AddCommand( "sv_record", SV_Record_f, "record server-side demo following a player" );
+	Cmd_AddCommand( "sv_stoprecord", SV_StopRecord_f, "stop recording server-side demo" );
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -1056,6 +1058,8 @@ void SV_KillOperatorCommands( void )
 	Cmd_RemoveCommand( "redirect" );
 	Cmd_RemoveCommand( "logaddress" );
 	Cmd_RemoveCommand( "log" );
+	Cmd_RemoveCommand( "sv_record" );
+	Cmd_RemoveCommand( "sv_stoprecord" );
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -0,0 +1,827 @@
+/*
+sv_demo.c - server-side demo recording
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "server.h"
+#include "net_encode.h"
+#include "demofile.h"
+
+/*
+==============================================================
+
+Server records the game through a virtual spectator, which
+never appears in svs.clients. It gets every broadcast message,
+sees all entities and follows view of one of the players, so
+the file is the same as client demo and plays with playdemo.
+
+Messages are built on main thread and queued into the ring,
+file is written by a separate thread so slow disks don't stall
+the server frame. Without threads file is written directly.
+==============================================================
+*/
+
+#define DEMO_RING_SIZE	(4 * 1024 * 1024)
+#define DEMO_CHUNK_SIZE	(64 * 1024)
+
+static CVAR_DEFINE_AUTO( sv_demo_updaterate, "30", FCVAR_ARCHIVE, "server-side demo frames per second" );
+static CVAR_DEFINE_AUTO( sv_demo_keyframe_interval, "10", FCVAR_ARCHIVE, "seconds between full updates in server-side demo, used by demo_seek" );
+
+static struct
+{
+	qboolean		recording;
+	qboolean		spawned;		// spectator got signon for current level
+	qboolean		waiting;		// between levels, timestamps are frozen
+	char		name[MAX_QPATH];
+	file_t		*file;
+	poolhandle_t	mempool;
+
+	sv_client_t	client;		// virtual spectator
+	int		playernum;	// followed player
+	uint		sequence;
+	byte		msg_buf[MAX_INIT_MSG];
+
+	demoheader_t	header;
+	demoentry_t	entries[2];
+	demokeyframe_t	*keyframes;
+	int		numkeyframes;
+	int		maxkeyframes;
+	int		fileofs;		// bytes queued so far
+	int		framecount;
+
+	double		starttime;	// sv.time at level start
+	double		nextframetime;
+	float		timebase;		// sum of the previous levels durations
+	float		lastdt;
+	float		lastkeyframe;
+	int		level;
+
+	// commands keyframes can't restore, replayed on seek
+	sizebuf_t		statelog;
+	byte		*statelogdata;
+	int		statelogsize;
+	qboolean		statelogfull;	// keyframes after it would miss commands
+	int		logstart;		// current level start in the state log
+	int		logsent;		// commands before it are already in the file
+
+	// background writer
+	ringbuffer_t	ring;
+	sys_thread_t	*thread;
+	sys_sem_t		*wakeup;
+	sys_sem_t		*drained;		// writer made room in the ring
+	int		blocked;		// atomic, main thread waits for room
+	int		shutdown;		// atomic
+	int		stalls;		// ring was full, main thread had to wait
+	byte		chunk[DEMO_CHUNK_SIZE];	// writer thread only
+} svdemo;
+
+/*
+==================
+SV_DemoWriterThread
+
+==================
+*/
+static void SV_DemoWriterThread( void *data )
+{
+	qboolean	done;
+	uint	len;
+
+	while( 1 )
+	{
+		Sys_SemaphoreTimedWait( svdemo.wakeup, 100 );
+		done = Sys_AtomicLoad( &svdemo.shutdown );
+
+		// drain everything, on shutdown main thread doesn't write anymore
+		while(( len = Ring_Read( &svdemo.ring, svdemo.chunk, sizeof( svdemo.chunk ))) > 0 )
+		{
+			FS_Write( svdemo.file, svdemo.chunk, len );
+
+			if( Sys_AtomicLoad( &svdemo.blocked ))
+				Sys_SemaphorePost( svdemo.drained );
+		}
+
+		if( done ) break;
+	}
+}
+
+/*
+==================
+SV_DemoWrite
+
+==================
+*/
+static void SV_DemoWrite( const void *data, int len )
+{
+	svdemo.fileofs += len;
+
+	if( !svdemo.thread )
+	{
+		FS_Write( svdemo.file, data, len );
+		return;
+	}
+
+	if( Ring_Write( &svdemo.ring, data, len ))
+		return;
+
+	// writer can't keep up, sleep until it frees some room
+	svdemo.stalls++;
+	Sys_AtomicStore( &svdemo.blocked, 1 );
+
+	while( !Ring_Write( &svdemo.ring, data, len ))
+	{
+		Sys_SemaphorePost( svdemo.wakeup );
+		Sys_SemaphoreTimedWait( svdemo.drained, 100 );
+	}
+
+	Sys_AtomicStore( &svdemo.blocked, 0 );
+}
+
+/*
+==================
+SV_DemoWriteCmdHeader
+
+==================
+*/
+static void SV_DemoWriteCmdHeader( byte cmd )
+{
+	float	dt;
+
+	// while level is changing time stands still
+	dt = svdemo.waiting ? svdemo.lastdt : (float)( sv.time - svdemo.starttime );
+
+	SV_DemoWrite( &cmd, sizeof( cmd ));
+	SV_DemoWrite( &dt, sizeof( dt ));
+}
+
+/*
+==================
+SV_DemoWriteMessage
+
+message is written as if it was received by the client
+with incoming sequence of demo frame
+==================
+*/
+static void SV_DemoWriteMessage( byte cmd, sizebuf_t *msg )
+{
+	int	seq[DEMO_SEQUENCE_INTS];
+	int	len = MSG_GetNumBytesWritten( msg );
+
+	if( len <= 0 ) return;
+
+	if( MSG_CheckOverflow( msg ))
+	{
+		Con_Printf( S_ERROR "%s: %s overflowed\n", __func__, MSG_GetName( msg ));
+		return;
+	}
+
+	memset( seq, 0, sizeof( seq ));
+	seq[0] = seq[1] = seq[4] = svdemo.sequence;
+
+	SV_DemoWriteCmdHeader( cmd );
+	SV_DemoWrite( seq, sizeof( seq ));
+	SV_DemoWrite( &len, sizeof( len ));
+	SV_DemoWrite( MSG_GetData( msg ), len );
+
+	if( cmd == dem_read )
+	{
+		svdemo.framecount++;
+		svdemo.lastdt = sv.time - svdemo.starttime;
+	}
+}
+
+/*
+==================
+SV_DemoWriteKeyframe
+
+==================
+*/
+static void SV_DemoWriteKeyframe( void )
+{
+	demokeyframe_t	*k;
+
+	if( svdemo.numkeyframes >= svdemo.maxkeyframes )
+	{
+		svdemo.maxkeyframes = Q_max( 64, svdemo.maxkeyframes * 2 );
+		svdemo.keyframes = Mem_Realloc( svdemo.mempool, svdemo.keyframes, sizeof( *svdemo.keyframes ) * svdemo.maxkeyframes );
+	}
+
+	k = &svdemo.keyframes[svdemo.numkeyframes++];
+	memset( k, 0, sizeof( *k ));
+	k->timestamp = sv.time - svdemo.starttime;
+	k->time = svdemo.timebase + k->timestamp;
+	k->offset = svdemo.fileofs;
+	k->level = svdemo.level;
+	k->logstart = svdemo.logstart;
+	k->logend = svdemo.logsent;
+
+	svdemo.lastkeyframe = k->time;
+}
+
+/*
+==================
+SV_UserMessageName
+
+==================
+*/
+static const char *SV_UserMessageName( int cmd )
+{
+	int	i;
+
+	if( cmd <= svc_lastmsg )
+		return NULL;
+
+	for( i = 1; i < MAX_USER_MESSAGES && svgame.msg[i].name[0]; i++ )
+	{
+		if( svgame.msg[i].number == cmd )
+			return svgame.msg[i].name;
+	}
+
+	return NULL;
+}
+
+/*
+==================
+SV_DemoRecordCommand
+
+reliable message for the demo client, keep it
+if it builds state that full update can't restore
+==================
+*/
+void SV_DemoRecordCommand( sizebuf_t *msg )
+{
+	sizebuf_t	src;
+	int	bits, pos, size, cmd;
+
+	if( !svdemo.recording || !svdemo.statelogdata || svdemo.statelogfull )
+		return;
+
+	bits = MSG_GetNumBitsWritten( msg );
+	if( bits < 8 ) return;
+
+	// multicast buffer holds a single message
+	MSG_StartReading( &src, MSG_GetData( msg ), MSG_GetMaxBytes( msg ), 0, bits );
+	cmd = MSG_ReadServerCmd( &src );
+	if( !Demo_IsStateCommand( cmd, SV_UserMessageName( cmd )))
+		return;
+
+	pos = MSG_GetNumBitsWritten( &svdemo.statelog );
+
+	if( pos + bits > svdemo.statelogsize * 8 )
+	{
+		size = Q_max( svdemo.statelogsize * 2, PAD_NUMBER( BitByte( pos + bits ), 4 ));
+
+		if( size > DEMO_MAX_STATE_LOG )
+		{
+			Con_Printf( S_WARN "%s: state log is full, no more keyframes are written\n", __func__ );
+			svdemo.statelogfull = true;
+			return;
+		}
+
+		svdemo.statelogdata = Mem_Realloc( svdemo.mempool, svdemo.statelogdata, size );
+		svdemo.statelogsize = size;
+		MSG_Init( &svdemo.statelog, "DemoStateLog", svdemo.statelogdata, size );
+		MSG_SeekToBit( &svdemo.statelog, pos, SEEK_SET );
+	}
+
+	MSG_WriteBits( &svdemo.statelog, MSG_GetData( msg ), bits );
+}
+
+/*
+==================
+SV_DemoWriteState
+
+reliable state that comes with signon,
+so a keyframe doesn't depend on earlier messages
+==================
+*/
+static void SV_DemoWriteState( sizebuf_t *msg )
+{
+	sv_client_t	*cur;
+	int		i;
+
+	for( i = 0; i < MAX_LIGHTSTYLES; i++ )
+	{
+		MSG_BeginServerCmd( msg, svc_lightstyle );
+		MSG_WriteByte( msg, i );
+		MSG_WriteString( msg, sv.lightstyles[i].pattern );
+		MSG_WriteFloat( msg, sv.lightstyles[i].time );
+	}
+
+	for( i = 0, cur = svs.clients; i < svs.maxclients; i++, cur++ )
+	{
+		if( cur->edict && cur->state == cs_spawned )
+		{
+			SV_FullClientUpdate( cur, msg );
+			continue;
+		}
+
+		MSG_BeginServerCmd( msg, svc_updateuserinfo );
+		MSG_WriteUBitLong( msg, i, MAX_CLIENT_BITS );
+		MSG_WriteLong( msg, 0 );
+		MSG_WriteOneBit( msg, 0 );
+	}
+
+	// client decodes it from null after the jump
+	SV_FullUpdateMovevars( NULL, msg );
+}
+
+/*
+==================
+SV_DemoClient
+
+virtual spectator, when it's ready to receive messages
+==================
+*/
+sv_client_t *SV_DemoClient( void )
+{
+	if( !svdemo.recording || !svdemo.spawned )
+		return NULL;
+	return &svdemo.client;
+}
+
+/*
+==================
+SV_DemoLevelStart
+
+write signon for a current level
+==================
+*/
+void SV_DemoLevelStart( void )
+{
+	sv_client_t	*cl = &svdemo.client;
+	sv_client_t	*cur;
+	sizebuf_t		msg;
+	int		i;
+
+	if( !svdemo.recording )
+		return;
+
+	if( svdemo.playernum < 0 || svdemo.playernum >= svs.maxclients )
+		svdemo.playernum = 0;
+
+	if( cl->frames ) Mem_Free( cl->frames );
+	cl->frames = Mem_Calloc( svdemo.mempool, sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+	cl->edict = NULL;
+	memset( &cl->events, 0, sizeof( cl->events ));
+	MSG_Clear( &cl->netchan.message );
+	MSG_Clear( &cl->datagram );
+
+	// serverdata, same as SV_New_f
+	MSG_Init( &msg, "DemoSignon", svdemo.msg_buf, sizeof( svdemo.msg_buf ));
+	SV_SendServerdata( &msg, svdemo.playernum );
+
+	MSG_BeginServerCmd( &msg, svc_stufftext );
+	MSG_WriteStringf( &msg, "fullserverinfo \"%s\"\n", SV_Serverinfo( ));
+
+	for( i = 0, cur = svs.clients; i < svs.maxclients; i++, cur++ )
+	{
+		if( !cur->edict || cur->state != cs_spawned )
+			continue;
+		SV_FullClientUpdate( cur, &msg );
+	}
+
+	SV_DemoWriteMessage( dem_norewind, &msg );
+
+	// resources, same as SV_SendRes_f
+	MSG_Init( &msg, "DemoSignon", svdemo.msg_buf, sizeof( svdemo.msg_buf ));
+	SV_SendResources( cl, &msg );
+	SV_DemoWriteMessage( dem_norewind, &msg );
+
+	// spawn, same as SV_PutClientInServer
+	MSG_Init( &msg, "DemoSignon", svdemo.msg_buf, sizeof( svdemo.msg_buf ));
+	MSG_WriteBits( &msg, MSG_GetData( &sv.signon ), MSG_GetNumBitsWritten( &sv.signon ));
+	MSG_BeginServerCmd( &msg, svc_setview );
+	MSG_WriteWord( &msg, svdemo.playernum + 1 );
+	MSG_BeginServerCmd( &msg, svc_signonnum );
+	MSG_WriteByte( &msg, 1 );
+	SV_DemoWriteMessage( dem_norewind, &msg );
+
+	if( svdemo.level == 0 )
+	{
+		// finish off the startup section
+		SV_DemoWriteCmdHeader( dem_stop );
+		svdemo.entries[0].length = svdemo.fileofs - svdemo.entries[0].offset;
+
+		svdemo.entries[1].entrytype = DEMO_NORMAL;
+		svdemo.entries[1].offset = svdemo.fileofs;
+		SV_DemoWriteCmdHeader( dem_jumptime );
+
+		svdemo.level = 1;
+		svdemo.timebase = 0.0f;
+	}
+	else
+	{
+		SV_DemoWriteCmdHeader( dem_jumptime );
+
+		// keyframe times continue from the previous level
+		svdemo.timebase += svdemo.lastdt;
+		svdemo.level++;
+	}
+
+	svdemo.lastdt = 0.0f;
+	svdemo.starttime = sv.time;
+	svdemo.nextframetime = 0.0;
+	svdemo.lastkeyframe = svdemo.timebase - sv_demo_keyframe_interval.value; // full update goes first
+	svdemo.logstart = svdemo.logsent = MSG_GetNumBitsWritten( &svdemo.statelog );
+	cl->delta_sequence = -1;
+	svdemo.spawned = true;
+	svdemo.waiting = false;
+}
+
+/*
+==================
+SV_DemoLevelEnd
+
+==================
+*/
+void SV_DemoLevelEnd( void )
+{
+	sizebuf_t	msg;
+
+	if( !svdemo.recording || !svdemo.spawned )
+		return;
+
+	MSG_Init( &msg, "DemoChanging", svdemo.msg_buf, sizeof( svdemo.msg_buf ));
+	MSG_BeginServerCmd( &msg, svc_changing );
+	MSG_WriteOneBit( &msg, 1 );
+	svdemo.sequence++;
+	SV_DemoWriteMessage( dem_read, &msg );
+
+	svdemo.spawned = false;
+	svdemo.waiting = true;
+}
+
+/*
+==================
+SV_DemoWriteClientData
+
+demo is played by a regular client, not a spectator,
+so it expects full clientdata
+==================
+*/
+static void SV_DemoWriteClientData( sv_client_t *cl, sizebuf_t *msg )
+{
+	client_frame_t	*frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
+	clientdata_t	nullcd;
+	clientdata_t	*from_cd;
+
+	memset( &nullcd, 0, sizeof( nullcd ));
+	memset( &frame->clientdata, 0, sizeof( frame->clientdata ));
+	frame->senttime = host.realtime;
+	frame->ping_time = -1.0f;
+
+	if( cl->edict )
+		svgame.dllFuncs.pfnUpdateClientData( cl->edict, false, &frame->clientdata );
+
+	MSG_BeginServerCmd( msg, svc_clientdata );
+
+	if( cl->delta_sequence == -1 )
+	{
+		MSG_WriteOneBit( msg, 0 );	// no delta-compression
+		from_cd = &nullcd;
+	}
+	else
+	{
+		MSG_WriteOneBit( msg, 1 );	// we are delta-ing from
+		MSG_WriteByte( msg, cl->delta_sequence );
+		from_cd = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK].clientdata;
+	}
+
+	MSG_WriteClientData( msg, from_cd, &frame->clientdata, sv.time );
+
+	// no weapons, end marker
+	MSG_WriteOneBit( msg, 0 );
+}
+
+/*
+==================
+SV_DemoWriteUserCmd
+
+player's view angles for the demo playback
+==================
+*/
+static void SV_DemoWriteUserCmd( sv_client_t *cl )
+{
+	usercmd_t	nullcmd, cmd;
+	sizebuf_t	buf;
+	byte	data[1024];
+	word	bytes;
+
+	memset( &nullcmd, 0, sizeof( nullcmd ));
+	memset( &cmd, 0, sizeof( cmd ));
+
+	if( cl->edict )
+	{
+		cmd = svs.clients[svdemo.playernum].lastcmd;
+		VectorCopy( cl->edict->v.v_angle, cmd.viewangles );
+	}
+
+	MSG_Init( &buf, "UserCmd", data, sizeof( data ));
+	MSG_WriteDeltaUsercmd( &buf, &nullcmd, &cmd );
+	bytes = MSG_GetNumBytesWritten( &buf );
+
+	SV_DemoWriteCmdHeader( dem_usercmd );
+	SV_DemoWrite( &svdemo.sequence, sizeof( int ));
+	SV_DemoWrite( &svdemo.sequence, sizeof( int ));
+	SV_DemoWrite( &bytes, sizeof( bytes ));
+	SV_DemoWrite( data, bytes );
+}
+
+/*
+==================
+SV_DemoFrame
+
+called after messages were sent to the real clients
+==================
+*/
+void SV_DemoFrame( void )
+{
+	sv_client_t	*cl = SV_DemoClient();
+	sv_client_t	*plr;
+	sizebuf_t		msg;
+	qboolean		keyframe;
+	float		time;
+
+	if( !cl || sv.state != ss_active || sv.paused )
+		return;
+
+	if( svdemo.nextframetime > host.realtime )
+		return;
+
+	svdemo.nextframetime = host.realtime + 1.0 / bound( 1.0f, sv_demo_updaterate.value, 100.0f );
+
+	plr = &svs.clients[svdemo.playernum];
+	cl->edict = ( plr->state == cs_spawned ) ? plr->edict : NULL;
+
+	svdemo.sequence++;
+	cl->netchan.outgoing_sequence = svdemo.sequence;
+
+	time = svdemo.timebase + ( sv.time - svdemo.starttime );
+	keyframe = sv_demo_keyframe_interval.value > 0.0f && time - svdemo.lastkeyframe >= sv_demo_keyframe_interval.value;
+
+	// seeking there couldn't restore HUD state
+	if( svdemo.statelogfull )
+		keyframe = false;
+
+	if( keyframe )
+	{
+		cl->delta_sequence = -1;
+		SV_DemoWriteKeyframe();
+	}
+
+	SV_DemoWriteUserCmd( cl );
+
+	MSG_Init( &msg, "DemoFrame", svdemo.msg_buf, sizeof( svdemo.msg_buf ));
+
+	// reliable data goes first, there are no retransmits in the file
+	if( MSG_CheckOverflow( &cl->netchan.message ))
+		Con_Printf( S_WARN "%s: reliable data overflowed, dropped\n", __func__ );
+	else MSG_WriteBits( &msg, MSG_GetData( &cl->netchan.message ), MSG_GetNumBitsWritten( &cl->netchan.message ));
+	MSG_Clear( &cl->netchan.message );
+	svdemo.logsent = MSG_GetNumBitsWritten( &svdemo.statelog );
+
+	if( keyframe )
+		SV_DemoWriteState( &msg );
+
+	MSG_BeginServerCmd( &msg, svc_time );
+	MSG_WriteFloat( &msg, sv.time );
+
+	SV_DemoWriteClientData( cl, &msg );
+	SV_WriteEntitiesToSpectator( cl, cl->edict, &msg );
+
+	if( !MSG_CheckOverflow( &cl->datagram ))
+		MSG_WriteBits( &msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
+	MSG_Clear( &cl->datagram );
+
+	SV_DemoWriteMessage( dem_read, &msg );
+	cl->delta_sequence = svdemo.sequence;
+
+	if( svdemo.thread )
+		Sys_SemaphorePost( svdemo.wakeup );
+}
+
+/*
+==================
+SV_DemoStop
+
+==================
+*/
+void SV_DemoStop( void )
+{
+	int	numentries = 2;
+	int	curpos;
+
+	if( !svdemo.recording )
+		return;
+
+	SV_DemoWriteCmdHeader( dem_stop );
+
+	curpos = svdemo.fileofs;
+	svdemo.entries[1].length = curpos - svdemo.entries[1].offset;
+	svdemo.entries[1].playback_time = svdemo.timebase + svdemo.lastdt;
+	svdemo.entries[1].playback_frames = svdemo.framecount;
+
+	SV_DemoWrite( &numentries, sizeof( numentries ));
+	SV_DemoWrite( svdemo.entries, sizeof( svdemo.entries ));
+
+	if( svdemo.numkeyframes > 0 )
+	{
+		int	id = IDEMOINDEX;
+		int	logbytes;
+
+		SV_DemoWrite( &id, sizeof( id ));
+		SV_DemoWrite( &svdemo.numkeyframes, sizeof( int ));
+		SV_DemoWrite( svdemo.keyframes, sizeof( demokeyframe_t ) * svdemo.numkeyframes );
+
+		// no keyframe states, full updates are in the stream
+		logbytes = MSG_GetNumBytesWritten( &svdemo.statelog );
+		SV_DemoWrite( &logbytes, sizeof( logbytes ));
+		SV_DemoWrite( svdemo.statelogdata, logbytes );
+	}
+
+	if( svdemo.thread )
+	{
+		Sys_AtomicStore( &svdemo.shutdown, 1 );
+		Sys_SemaphorePost( svdemo.wakeup );
+		Sys_JoinThread( svdemo.thread );
+		Sys_DestroySemaphore( svdemo.wakeup );
+		Sys_DestroySemaphore( svdemo.drained );
+		Ring_Free( &svdemo.ring );
+	}
+
+	// touch up the header
+	svdemo.header.directory_offset = curpos;
+	FS_Seek( svdemo.file, 0, SEEK_SET );
+	FS_Write( svdemo.file, &svdemo.header, sizeof( svdemo.header ));
+	FS_Close( svdemo.file );
+
+	Con_Printf( "Completed demo %s\nRecording time: %02d:%02d, frames %i, %i keyframes",
+		svdemo.name, (int)( svdemo.entries[1].playback_time / 60.0f ), (int)fmod( svdemo.entries[1].playback_time, 60.0f ),
+		svdemo.framecount, svdemo.numkeyframes );
+	if( svdemo.stalls ) Con_Printf( ", writer stalled %i times", svdemo.stalls );
+	Con_Printf( "\n" );
+
+	Mem_FreePool( &svdemo.mempool );
+	memset( &svdemo, 0, sizeof( svdemo ));
+}
+
+/*
+==================
+SV_Record_f
+
+sv_record <demoname> [#userid|name]
+==================
+*/
+void SV_Record_f( void )
+{
+	sv_client_t	*cl;
+	const char	*param;
+	string		demoname;
+	int		i;
+
+	if( Cmd_Argc() < 2 || Cmd_Argc() > 3 )
+	{
+		Con_Printf( S_USAGE "sv_record <demoname> [#userid|name]\n" );
+		return;
+	}
+
+	if( svdemo.recording )
+	{
+		Con_Printf( "Already recording %s.\n", svdemo.name );
+		return;
+	}
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "Server is not running.\n" );
+		return;
+	}
+
+	svdemo.playernum = -1;
+
+	if( Cmd_Argc() == 3 )
+	{
+		param = Cmd_Argv( 2 );
+
+		if( *param == '#' && Q_isdigit( param + 1 ))
+			cl = SV_ClientById( Q_atoi( param + 1 ));
+		else cl = SV_ClientByName( param );
+
+		if( !cl )
+		{
+			Con_Printf( "Userid %s is not on the server\n", param );
+			return;
+		}
+
+		svdemo.playernum = cl - svs.clients;
+	}
+	else
+	{
+		// follow first player in game
+		for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+		{
+			if( cl->state == cs_spawned && !FBitSet( cl->flags, FCL_HLTV_PROXY ))
+			{
+				svdemo.playernum = i;
+				break;
+			}
+		}
+	}
+
+	Q_strncpy( demoname, Cmd_Argv( 1 ), sizeof( demoname ));
+	COM_StripExtension( demoname );
+	Q_snprintf( svdemo.name, sizeof( svdemo.name ), "demos/%s.dem", demoname );
+
+	svdemo.file = FS_Open( svdemo.name, "wb", false );
+
+	if( !svdemo.file )
+	{
+		Con_Printf( S_ERROR "couldn't open %s.\n", svdemo.name );
+		return;
+	}
+
+	Con_Printf( "recording to %s.\n", svdemo.name );
+
+	svdemo.mempool = Mem_AllocPool( "Server Demo" );
+	svdemo.recording = true;
+	svdemo.statelogsize = 64 * 1024;
+	svdemo.statelogdata = Mem_Malloc( svdemo.mempool, svdemo.statelogsize );
+	MSG_Init( &svdemo.statelog, "DemoStateLog", svdemo.statelogdata, svdemo.statelogsize );
+	svdemo.statelogfull = false;
+	svdemo.starttime = sv.time;
+
+	// virtual spectator
+	Q_strncpy( svdemo.client.name, "demo", sizeof( svdemo.client.name ));
+	svdemo.client.flags = FCL_HLTV_PROXY;
+	svdemo.client.state = cs_spawned;
+	MSG_Init( &svdemo.client.netchan.message, "DemoReliable", svdemo.client.netchan.message_buf, sizeof( svdemo.client.netchan.message_buf ));
+	MSG_Init( &svdemo.client.datagram, "DemoDatagram", svdemo.client.datagram_buf, sizeof( svdemo.client.datagram_buf ));
+
+	// writer thread is optional
+	if( Ring_Init( &svdemo.ring, DEMO_RING_SIZE ))
+	{
+		svdemo.wakeup = Sys_CreateSemaphore( 0 );
+		svdemo.drained = Sys_CreateSemaphore( 0 );
+
+		if( svdemo.wakeup && svdemo.drained )
+			svdemo.thread = Sys_CreateThread( SV_DemoWriterThread, NULL );
+
+		if( !svdemo.thread )
+		{
+			Sys_DestroySemaphore( svdemo.wakeup );
+			Sys_DestroySemaphore( svdemo.drained );
+			svdemo.wakeup = svdemo.drained = NULL;
+			Ring_Free( &svdemo.ring );
+		}
+	}
+
+	svdemo.header.id = IDEMOHEADER;
+	svdemo.header.dem_protocol = DEMO_PROTOCOL;
+	svdemo.header.net_protocol = PROTOCOL_VERSION;
+	svdemo.header.host_fps = bound( MIN_FPS, host_maxfps.value, MAX_FPS );
+	Q_strncpy( svdemo.header.mapname, sv.name, sizeof( svdemo.header.mapname ));
+	Q_strncpy( svdemo.header.comment, STRING( svgame.edicts->v.message ), sizeof( svdemo.header.comment ));
+	Q_strncpy( svdemo.header.gamedir, GI->gamefolder, sizeof( svdemo.header.gamedir ));
+
+	// directory offset is not known yet
+	SV_DemoWrite( &svdemo.header, sizeof( svdemo.header ));
+
+	svdemo.entries[0].entrytype = DEMO_STARTUP;
+	svdemo.entries[0].offset = svdemo.fileofs;
+
+	SV_DemoLevelStart();
+}
+
+/*
+==================
+SV_StopRecord_f
+
+==================
+*/
+void SV_StopRecord_f( void )
+{
+	if( !svdemo.recording )
+	{
+		Con_Printf( "Not recording a demo.\n" );
+		return;
+	}
+
+	SV_DemoStop();
+}
+
+void SV_InitDemo( void )
+{
+	Cvar_RegisterVariable( &sv_demo_updaterate );
+	Cvar_RegisterVariable( &sv_demo_keyframe_interval );
+}
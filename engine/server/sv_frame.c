@@ -694,6 +694,83 @@ void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 	if( send_pings ) SV_EmitPings( msg );
 }
 
+/*
+==================
+SV_WriteEntitiesToSpectator
+
+virtual spectator of server-side demo has no edict, it sees
+what the followed player sees, without local weapons
+==================
+*/
+void SV_WriteEntitiesToSpectator( sv_client_t *cl, edict_t *host, sizebuf_t *msg )
+{
+	client_frame_t	*frame;
+	entity_state_t	*state;
+	static sv_ents_t	frame_ents;
+	byte		*pvs = NULL, *phs = NULL;
+	sv_client_t	*plr;
+	qboolean		player;
+	edict_t		*ent;
+	int		i, e;
+
+	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
+	frame_ents.num_entities = 0;
+
+	// game dll expects a player as the host, borrow
+	// any other one while the followed player is away
+	for( i = 0, plr = svs.clients; !host && i < svs.maxclients; i++, plr++ )
+	{
+		if( plr->state == cs_spawned && plr->edict && !FBitSet( plr->flags, FCL_HLTV_PROXY ))
+			host = plr->edict;
+	}
+
+	if( host )
+	{
+		plr = SV_ClientFromEdict( host, true );
+		svgame.dllFuncs.pfnSetupVisibility( plr ? plr->pViewEntity : NULL, host, &pvs, &phs );
+	}
+
+	for( e = 1; host && e < svgame.numEntities; e++ )
+	{
+		ent = EDICT_NUM( e );
+		player = ( e <= svs.maxclients );
+
+		if( player )
+		{
+			sv_client_t *plr = &svs.clients[e - 1];
+
+			if( plr->state != cs_spawned || FBitSet( plr->flags, FCL_HLTV_PROXY ))
+				continue;
+		}
+
+		state = &frame_ents.entities[frame_ents.num_entities];
+
+		// no local weapons, host is always sent
+		if( !svgame.dllFuncs.pfnAddToFullPack( state, e, ent, host, 0, player, FBitSet( ent->v.effects, EF_REQUEST_PHS ) ? phs : pvs ))
+			continue;
+
+		// entities are walked in order, no need to sort them
+		if( frame_ents.num_entities < ( MAX_VISIBLE_PACKET - 1 ))
+			frame_ents.num_entities++;
+	}
+
+	// copy the entity states out
+	frame->first_entity = svs.next_client_entities;
+	frame->num_entities = 0;
+
+	for( i = 0; i < frame_ents.num_entities; i++ )
+	{
+		state = &svs.packet_entities[svs.next_client_entities % svs.num_client_entities];
+		*state = frame_ents.entities[i];
+		svs.next_client_entities++;
+		frame->num_entities++;
+	}
+
+	SV_EmitPacketEntities( cl, frame, msg );
+	SV_EmitEvents( cl, frame, msg );
+	if( SV_ShouldUpdatePing( cl )) SV_EmitPings( msg );
+}
+
 /*
 ===============================================================================
 
@@ -826,6 +903,18 @@ void SV_UpdateToReliableMessages( void )
 		}
 	}
 
+	// server-side demo gets the same broadcasts, spectator messages
+	// are written to it directly by SV_Multicast
+	if(( cl = SV_DemoClient( )) != NULL )
+	{
+		if( MSG_GetNumBytesWritten( &sv.reliable_datagram ) < MSG_GetNumBytesLeft( &cl->netchan.message ))
+			MSG_WriteBits( &cl->netchan.message, MSG_GetBuf( &sv.reliable_datagram ), MSG_GetNumBitsWritten( &sv.reliable_datagram ));
+
+		if( MSG_GetNumBytesWritten( &sv.datagram ) < MSG_GetNumBytesLeft( &cl->datagram ))
+			MSG_WriteBits( &cl->datagram, MSG_GetBuf( &sv.datagram ), MSG_GetNumBitsWritten( &sv.datagram ));
+
+	}
+
 	// now clear the reliable and datagram buffers.
 	MSG_Clear( &sv.reliable_datagram );
 	MSG_Clear( &sv.spec_datagram );
@@ -32,7 +32,7 @@ static int GAME_EXPORT pfnModelIndex( const char *m );
 // fatpvs stuff
 static byte fatpvs[MAX_MAP_LEAFS/8];
 static byte fatphs[MAX_MAP_LEAFS/8];
-static byte clientpvs[MAX_MAP_LEAFS/8];	// for find client in PVS
+static byte clientpvs[MAX_MAP_LEAFS/8];	// merged PVS for find client in PVS
 static vec3_t viewPoint[MAX_CLIENTS];
 
 // exports
@@ -405,7 +405,7 @@ MSG_PHS	send to clients potentially audible from org
 */
 static int SV_Multicast( int dest, const vec3_t origin, const edict_t *ent, qboolean usermessage, qboolean filter )
 {
-	byte		*mask = NULL;
+	const byte	*mask = NULL;
 	int		j, numclients = svs.maxclients;
 	sv_client_t	*cl, *current = svs.clients;
 	qboolean		reliable = false;
@@ -508,6 +508,21 @@ static int SV_Multicast( int dest, const vec3_t origin, const edict_t *ent, qboo
 		numsends++;
 	}
 
+	// server-side demo sees everything, except messages for other clients
+	if(( cl = SV_DemoClient( )) != NULL )
+	{
+		if(( dest != MSG_ONE && dest != MSG_ONE_UNRELIABLE ) || current->edict == cl->edict )
+		{
+			sizebuf_t	*msg = ( reliable && !specproxy ) ? &cl->netchan.message : &cl->datagram;
+
+			if( MSG_GetNumBytesWritten( &sv.multicast ) < MSG_GetNumBytesLeft( msg ))
+				MSG_WriteBits( msg, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
+
+			if( reliable && !specproxy )
+				SV_DemoRecordCommand( &sv.multicast );
+		}
+	}
+
 	MSG_Clear( &sv.multicast );
 
 	return numsends; // just for debug
@@ -1710,11 +1725,12 @@ build the new client PVS
 */
 static int SV_CheckClientPVS( int check, qboolean bMergePVS )
 {
-	byte		*pvs;
+	const byte	*pvs;
 	vec3_t		vieworg;
 	sv_client_t	*cl;
-	int		i, j, k;
+	int		i, k;
 	edict_t		*ent = NULL;
+	qboolean		merged = false;
 
 	// cycle to the next one
 	check = bound( 1, check, svs.maxclients );
@@ -1739,12 +1755,11 @@ static int SV_CheckClientPVS( int check, qboolean bMergePVS )
 	}
 
 	cl = SV_ClientFromEdict( ent, true );
-	memset( clientpvs, 0xFF, world.visbytes );
 
-	// get the PVS for the entity
+	// get the PVS for the entity, the row is refetched from PVS cache
+	// in pfnFindClientInPVS unless portal cameras have to be merged
 	VectorAdd( ent->v.origin, ent->v.view_ofs, vieworg );
-	pvs = Mod_GetPVSForPoint( vieworg );
-	if( pvs ) memcpy( clientpvs, pvs, world.visbytes );
+	sv.lastcheckleaf = Mod_PointInLeaf( vieworg, sv.worldmodel->nodes );
 
 	// transition in progress
 	if( !cl ) return i;
@@ -1757,13 +1772,22 @@ static int SV_CheckClientPVS( int check, qboolean bMergePVS )
 		if( !SV_IsValidEdict( view ))
 			continue;
 
+		if( !merged )
+		{
+			pvs = Mod_LeafPVS( sv.lastcheckleaf );
+			if( pvs ) memcpy( clientpvs, pvs, world.visbytes );
+			else memset( clientpvs, 0xFF, world.visbytes );
+			merged = true;
+		}
+
 		VectorAdd( view->v.origin, view->v.view_ofs, vieworg );
 		pvs = Mod_GetPVSForPoint( vieworg );
 
-		for( j = 0; j < world.visbytes && pvs; j++ )
-			SetBits( clientpvs[j], pvs[j] );
+		if( pvs ) Mod_MergePVS( clientpvs, pvs, world.visbytes );
 	}
 
+	if( merged ) sv.lastcheckleaf = NULL;
+
 	return i;
 }
 
@@ -1820,7 +1844,18 @@ static edict_t* GAME_EXPORT pfnFindClientInPVS( edict_t *pEdict )
 
 	leaf = Mod_PointInLeaf( view, sv.worldmodel->nodes );
 
-	if( CHECKVISBIT( clientpvs, leaf->cluster ))
+	if( sv.lastcheckleaf )
+	{
+		const byte *pvs = Mod_LeafPVS( sv.lastcheckleaf );
+
+		// no vis data, everything is visible
+		if( !pvs && leaf->cluster >= 0 )
+			return pClient;
+
+		if( pvs && CHECKVISBIT( pvs, leaf->cluster ))
+			return pClient; // client which currently in PVS
+	}
+	else if( CHECKVISBIT( clientpvs, leaf->cluster ))
 		return pClient; // client which currently in PVS
 
 	return svgame.edicts;
@@ -4001,6 +4036,71 @@ static word GAME_EXPORT pfnPrecacheEvent( int type, const char *psz )
 	return (word)SV_EventIndex( psz );
 }
 
+/*
+=============
+SV_PlaybackEventToClient
+
+=============
+*/
+static void SV_PlaybackEventToClient( sv_client_t *cl, int flags, word eventindex, float delay, int invokerIndex, event_args_t *args )
+{
+	event_state_t	*es;
+	event_info_t	*ei = NULL;
+	int		j, bestslot;
+
+	// reliable event
+	if( FBitSet( flags, FEV_RELIABLE ))
+	{
+		// skipping queue, write direct into reliable datagram
+		SV_PlaybackReliableEvent( &cl->netchan.message, eventindex, delay, args );
+		return;
+	}
+
+	// unreliable event (stores in queue)
+	es = &cl->events;
+	bestslot = -1;
+
+	if( FBitSet( flags, FEV_UPDATE ))
+	{
+		for( j = 0; j < MAX_EVENT_QUEUE; j++ )
+		{
+			ei = &es->ei[j];
+
+			if( ei->index == eventindex && invokerIndex != -1 && invokerIndex == ei->entity_index )
+			{
+				bestslot = j;
+				break;
+			}
+		}
+	}
+
+	if( bestslot == -1 )
+	{
+		for( j = 0; j < MAX_EVENT_QUEUE; j++ )
+		{
+			ei = &es->ei[j];
+
+			if( ei->index == 0 )
+			{
+				// found an empty slot
+				bestslot = j;
+				break;
+			}
+		}
+	}
+
+	// no slot found for this player, oh well
+	if( bestslot == -1 ) return;
+
+	// add event to queue
+	ei->index = eventindex;
+	ei->fire_time = delay;
+	ei->entity_index = invokerIndex;
+	ei->packet_index = -1;
+	ei->flags = flags;
+	ei->args = *args;
+}
+
 /*
 =============
 pfnPlaybackEvent
@@ -4011,10 +4111,8 @@ void GAME_EXPORT SV_PlaybackEventFull( int flags, const edict_t *pInvoker, word
 	float *angles, float fparam1, float fparam2, int iparam1, int iparam2, int bparam1, int bparam2 )
 {
 	sv_client_t	*cl;
-	event_state_t	*es;
 	event_args_t	args;
-	event_info_t	*ei = NULL;
-	int		j, slot, bestslot;
+	int		slot;
 	int		invokerIndex;
 	byte		*mask = NULL;
 	vec3_t		pvspoint;
@@ -4149,58 +4247,14 @@ void GAME_EXPORT SV_PlaybackEventFull( int flags, const edict_t *pInvoker, word
 			continue;	// sending only to invoker
 
 		// all checks passed, send the event
+		SV_PlaybackEventToClient( cl, flags, eventindex, delay, invokerIndex, &args );
+	}
 
-		// reliable event
-		if( FBitSet( flags, FEV_RELIABLE ))
-		{
-			// skipping queue, write direct into reliable datagram
-			SV_PlaybackReliableEvent( &cl->netchan.message, eventindex, delay, &args );
-			continue;
-		}
-
-		// unreliable event (stores in queue)
-		es = &cl->events;
-		bestslot = -1;
-
-		if( FBitSet( flags, FEV_UPDATE ))
-		{
-			for( j = 0; j < MAX_EVENT_QUEUE; j++ )
-			{
-				ei = &es->ei[j];
-
-				if( ei->index == eventindex && invokerIndex != -1 && invokerIndex == ei->entity_index )
-				{
-					bestslot = j;
-					break;
-				}
-			}
-		}
-
-		if( bestslot == -1 )
-		{
-			for( j = 0; j < MAX_EVENT_QUEUE; j++ )
-			{
-				ei = &es->ei[j];
-
-				if( ei->index == 0 )
-				{
-					// found an empty slot
-					bestslot = j;
-					break;
-				}
-			}
-		}
-
-		// no slot found for this player, oh well
-		if( bestslot == -1 ) continue;
-
-		// add event to queue
-		ei->index = eventindex;
-		ei->fire_time = delay;
-		ei->entity_index = invokerIndex;
-		ei->packet_index = -1;
-		ei->flags = flags;
-		ei->args = args;
+	// server-side demo records everything but events for other clients
+	if(( cl = SV_DemoClient( )) != NULL )
+	{
+		if( !FBitSet( flags, FEV_HOSTONLY ) || cl->edict == pInvoker )
+			SV_PlaybackEventToClient( cl, flags, eventindex, delay, invokerIndex, &args );
 	}
 }
 
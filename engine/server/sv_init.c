@@ -654,6 +654,9 @@ void SV_ActivateServer( int runPhysics )
 		if( COM_CheckString( cycle ))
 			Cbuf_AddTextf( "exec %s\n", cycle );
 	}
+
+	// continue server-side demo on a new level
+	SV_DemoLevelStart();
 }
 
 /*
@@ -670,6 +673,8 @@ void SV_DeactivateServer( void )
 	if( !svs.initialized || sv.state == ss_dead )
 		return;
 
+	SV_DemoLevelEnd();
+
 	svgame.globals->time = sv.time;
 	svgame.dllFuncs.pfnServerDeactivate();
 	Host_SetServerState( ss_dead );
@@ -793,7 +798,8 @@ void SV_SetupClients( void )
 #endif
 
 	svs.clients = Z_Realloc( svs.clients, sizeof( sv_client_t ) * svs.maxclients );
-	svs.num_client_entities = svs.maxclients * SV_UPDATE_BACKUP * NUM_PACKET_ENTITIES;
+	// one more for the server-side demo spectator
+	svs.num_client_entities = ( svs.maxclients + 1 ) * SV_UPDATE_BACKUP * NUM_PACKET_ENTITIES;
 	svs.packet_entities = Z_Realloc( svs.packet_entities, sizeof( entity_state_t ) * svs.num_client_entities );
 	Con_Reportf( "%s alloced by server packet entities\n", Q_memprint( sizeof( entity_state_t ) * svs.num_client_entities ));
 
@@ -16,6 +16,59 @@ GNU General Public License for more details.
 #include "common.h"
 #include "server.h"
 
+#define LOG_RING_SIZE	(256 * 1024)
+
+static void Log_WriterThread( void *data )
+{
+	byte	chunk[16 * 1024];
+	qboolean	done;
+	uint	len;
+
+	while( 1 )
+	{
+		Sys_SemaphoreTimedWait( svs.log.wakeup, 100 );
+		done = Sys_AtomicLoad( &svs.log.shutdown );
+
+		while(( len = Ring_Read( &svs.log.ring, chunk, sizeof( chunk ))) > 0 )
+			FS_Write( svs.log.file, chunk, len );
+
+		if( done ) break;
+	}
+}
+
+static void Log_StartWriter( void )
+{
+	if( !Ring_Init( &svs.log.ring, LOG_RING_SIZE ))
+		return;
+
+	svs.log.wakeup = Sys_CreateSemaphore( 0 );
+	svs.log.shutdown = 0;
+	svs.log.thread = Sys_CreateThread( Log_WriterThread, NULL );
+
+	if( !svs.log.thread )
+	{
+		Sys_DestroySemaphore( svs.log.wakeup );
+		svs.log.wakeup = NULL;
+		Ring_Free( &svs.log.ring );
+	}
+}
+
+static void Log_StopWriter( void )
+{
+	if( !svs.log.thread )
+		return;
+
+	// thread writes out everything before exit
+	Sys_AtomicStore( &svs.log.shutdown, 1 );
+	Sys_SemaphorePost( svs.log.wakeup );
+	Sys_JoinThread( svs.log.thread );
+	Sys_DestroySemaphore( svs.log.wakeup );
+	Ring_Free( &svs.log.ring );
+
+	svs.log.thread = NULL;
+	svs.log.wakeup = NULL;
+}
+
 void Log_Open( void )
 {
 	time_t		ltime;
@@ -75,7 +128,11 @@ void Log_Open( void )
 		return;
 	}
 
-	if( fp ) svs.log.file = fp;
+	if( fp )
+	{
+		svs.log.file = fp;
+		Log_StartWriter();
+	}
 	Log_Printf( "Log file started (file \"%s\") (game \"%s\") (version \"%i/" XASH_VERSION "/%d\")\n",
 	szTestFile, Info_ValueForKey( SV_Serverinfo(), "*gamedir" ), PROTOCOL_VERSION, Q_buildnum() );
 }
@@ -85,6 +142,7 @@ void Log_Close( void )
 	if( svs.log.file )
 	{
 		Log_Printf( "Log file closed\n" );
+		Log_StopWriter();
 		FS_Close( svs.log.file );
 	}
 	svs.log.file = NULL;
@@ -101,7 +159,6 @@ void Log_Printf( const char *fmt, ... )
 {
 	va_list		argptr;
 	static char	string[1024];
-	char		*p;
 	time_t		ltime;
 	struct tm	*today;
 	int		len;
@@ -110,17 +167,26 @@ void Log_Printf( const char *fmt, ... )
 		return;
 
 	time( &ltime );
-	today = localtime( &ltime );
 
-	len = Q_snprintf( string, sizeof( string ), "%02i/%02i/%04i - %02i:%02i:%02i: ",
-		today->tm_mon+1, today->tm_mday, 1900 + today->tm_year, today->tm_hour, today->tm_min, today->tm_sec );
+	if( ltime != svs.log.lasttime )
+	{
+		today = localtime( &ltime );
+		svs.log.timestamplen = Q_snprintf( svs.log.timestamp, sizeof( svs.log.timestamp ), "%02i/%02i/%04i - %02i:%02i:%02i: ",
+			today->tm_mon+1, today->tm_mday, 1900 + today->tm_year, today->tm_hour, today->tm_min, today->tm_sec );
+		svs.log.lasttime = ltime;
+	}
 
-	p = string + len;
+	memcpy( string, svs.log.timestamp, svs.log.timestamplen );
 
 	va_start( argptr, fmt );
-	Q_vsnprintf( p, sizeof( string ) - len, fmt, argptr );
+	len = Q_vsnprintf( string + svs.log.timestamplen, sizeof( string ) - svs.log.timestamplen, fmt, argptr );
 	va_end( argptr );
 
+	// truncated
+	if( len < 0 || len >= (int)( sizeof( string ) - svs.log.timestamplen ))
+		len = sizeof( string ) - svs.log.timestamplen - 1;
+	len += svs.log.timestamplen;
+
 	if( svs.log.net_log )
 		Netchan_OutOfBandPrint( NS_SERVER, svs.log.net_address, "log %s", string );
 
@@ -132,7 +198,20 @@ void Log_Printf( const char *fmt, ... )
 
 		// echo to log file
 		if( svs.log.file && mp_logfile.value )
-			FS_Printf( svs.log.file, "%s", string );
+		{
+			if( !svs.log.thread )
+			{
+				FS_Write( svs.log.file, string, len );
+			}
+			else
+			{
+				while( !Ring_Write( &svs.log.ring, string, len ))
+				{
+					Sys_SemaphorePost( svs.log.wakeup );
+					Sys_Yield();
+				}
+			}
+		}
 	}
 }
 
@@ -705,6 +705,9 @@ void Host_ServerFrame( void )
 	// send messages back to the clients that had packets read this frame
 	SV_SendClientMessages ();
 
+	// server-side demo gets the same frame
+	SV_DemoFrame ();
+
 	// clear edict flags for next frame
 	SV_PrepWorldFrame ();
 
@@ -980,6 +983,7 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &sv_userinfo_penalty_attempts );
 	Cvar_RegisterVariable( &sv_fullupdate_penalty_time );
 	Cvar_RegisterVariable( &sv_log_outofband );
+	SV_InitDemo();
 
 	// when we in developer-mode automatically turn cheats on
 	if( host_developer.value ) Cvar_SetValue( "sv_cheats", 1.0f );
@@ -1110,6 +1114,7 @@ void SV_Shutdown( const char *finalmsg )
 		NET_MasterShutdown();
 
 	NET_Config( false, false );
+	SV_DemoStop();
 	SV_DeactivateServer();
 #if XASH_WIN32
 	SV_UnloadProgs();
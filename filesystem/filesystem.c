@@ -2028,9 +2028,9 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 
 	if( !file ) return 0;
 
-	// if necessary, seek to the exact file position we're supposed to be
-	if( file->buff_ind != file->buff_len )
-		lseek( file->handle, file->buff_ind - file->buff_len, SEEK_CUR );
+	// seek to the exact file position we're supposed to be,
+	// reads don't move the handle offset, see FS_ReadAt
+	lseek( file->handle, file->offset + file->position - file->buff_len + file->buff_ind, SEEK_SET );
 
 	// purge cached data
 	FS_Purge( file );
@@ -2047,6 +2047,40 @@ fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
 	return result;
 }
 
+/*
+====================
+FS_ReadAt
+
+handles of files in archives are dup'ed and share the file offset
+with each other, positioned read lets other threads read from the
+same archive meanwhile
+====================
+*/
+static fs_offset_t FS_ReadAt( file_t *file, void *buffer, size_t count )
+{
+#if XASH_POSIX
+	return pread( file->handle, buffer, count, file->offset + file->position );
+#elif XASH_WIN32
+	fs_offset_t	offset = file->offset + file->position;
+	OVERLAPPED	overlapped;
+	DWORD	nb;
+
+	// offset is passed with each read, shared file pointer is ignored
+	memset( &overlapped, 0, sizeof( overlapped ));
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)((uint64_t)offset >> 32 );
+
+	if( !ReadFile( (HANDLE)_get_osfhandle( file->handle ), buffer, (DWORD)count, &nb, &overlapped ))
+		return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+
+	return nb;
+#else
+	// threads are not used on this platform, see threads.h
+	lseek( file->handle, file->offset + file->position, SEEK_SET );
+	return read( file->handle, buffer, count );
+#endif
+}
+
 /*
 ====================
 FS_Read
@@ -2098,8 +2132,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	{
 		if( count > buffersize )
 			count = buffersize;
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, (byte *)buffer + done, count );
+		nb = FS_ReadAt( file, (byte *)buffer + done, count );
 
 		if( nb > 0 )
 		{
@@ -2113,8 +2146,7 @@ fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
 	{
 		if( count > sizeof( file->buff ))
 			count = sizeof( file->buff );
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, file->buff, count );
+		nb = FS_ReadAt( file, file->buff, count );
 
 		if( nb > 0 )
 		{
@@ -0,0 +1,43 @@
+/*
+xash3d_simd.h - vector instruction sets available at compile time
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef XASH3D_SIMD_H
+#define XASH3D_SIMD_H
+
+#include "build.h"
+
+// SSE2 is always present on amd64, x86 builds are targeting pentium-m
+// NEON is always present on aarch64, armv7 only if enabled by compiler flags
+// code using these must always keep the plain C version, which is selected
+// at runtime when vector code is disabled
+#undef XASH_SIMD
+#undef XASH_SIMD_SSE2
+#undef XASH_SIMD_NEON
+
+#if !defined( XASH_NO_SIMD )
+	#if XASH_AMD64 || ( XASH_X86 && ( defined( __SSE2__ ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )))
+		#define XASH_SIMD_SSE2 1
+		#include <emmintrin.h>
+	#elif ( XASH_ARM && XASH_64BIT ) || defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+		#define XASH_SIMD_NEON 1
+		#include <arm_neon.h>
+	#endif
+#endif // !XASH_NO_SIMD
+
+#if XASH_SIMD_SSE2 || XASH_SIMD_NEON
+	#define XASH_SIMD 1
+#endif
+
+#endif // XASH3D_SIMD_H
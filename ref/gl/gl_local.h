@@ -444,7 +444,7 @@ void R_AddDecalVBO( decal_t *pdecal, msurface_t *surf );
 // gl_rpart.c
 //
 void CL_DrawParticlesExternal( const ref_viewpass_t *rvp, qboolean trans_pass, float frametime );
-void CL_DrawParticles( double frametime, particle_t *cl_active_particles, float partsize );
+void CL_DrawParticles( const ref_particle_t *particles, int count, float partsize );
 void CL_DrawTracers( double frametime, particle_t *cl_active_tracers );
 
 
@@ -973,14 +973,20 @@ void R_RenderScene( void )
 		R_AnimateRipples();
 
 	R_CheckGLFog();
+	gEngfuncs.Profile_Begin( "R_DrawWorld" );
 	R_DrawWorld();
+	gEngfuncs.Profile_End();
 	R_CheckFog();
 
 	gEngfuncs.CL_ExtraUpdate ();	// don't let sound get messed up if going slow
 
+	gEngfuncs.Profile_Begin( "R_DrawEntitiesOnList" );
 	R_DrawEntitiesOnList();
+	gEngfuncs.Profile_End();
 
+	gEngfuncs.Profile_Begin( "R_DrawWaterSurfaces" );
 	R_DrawWaterSurfaces();
+	gEngfuncs.Profile_End();
 
 	R_EndGL();
 }
@@ -1135,7 +1141,9 @@ void R_EndFrame( void )
 #endif
 	// flush any remaining 2D bits
 	R_Set2DMode( false );
+	gEngfuncs.Profile_Begin( "GL_SwapBuffers" );
 	gEngfuncs.GL_SwapBuffers();
+	gEngfuncs.Profile_End();
 }
 
 /*
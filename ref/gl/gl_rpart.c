@@ -42,18 +42,17 @@ static color24 gTracerColors[] =
 ================
 CL_DrawParticles
 
-update particle color, position, free expired and draw it
+draw particles packed by the engine
 ================
 */
-void CL_DrawParticles( double frametime, particle_t *cl_active_particles, float partsize )
+void CL_DrawParticles( const ref_particle_t *particles, int count, float partsize )
 {
-	particle_t	*p;
+	const ref_particle_t	*p;
 	vec3_t		right, up;
-	color24		*pColor;
-	int		alpha;
 	float		size;
+	int		i;
 
-	if( !cl_active_particles )
+	if( !count )
 		return;	// nothing to draw?
 
 	pglEnable( GL_BLEND );
@@ -66,49 +65,38 @@ void CL_DrawParticles( double frametime, particle_t *cl_active_particles, float
 
 	pglBegin( GL_QUADS );
 
-	for( p = cl_active_particles; p; p = p->next )
+	for( i = 0, p = particles; i < count; i++, p++ )
 	{
-		if(( p->type != pt_blob ) || ( p->packedColor == 255 ))
-		{
-			size = partsize; // get initial size of particle
-
-			// scale up to keep particles from disappearing
-			size += (p->org[0] - RI.vieworg[0]) * RI.cull_vforward[0];
-			size += (p->org[1] - RI.vieworg[1]) * RI.cull_vforward[1];
-			size += (p->org[2] - RI.vieworg[2]) * RI.cull_vforward[2];
-
-			if( size < 20.0f ) size = partsize;
-			else size = partsize + size * 0.002f;
-
-			// scale the axes by radius
-			VectorScale( RI.cull_vright, size, right );
-			VectorScale( RI.cull_vup, size, up );
-
-			p->color = bound( 0, p->color, 255 );
-			pColor = gEngfuncs.CL_GetPaletteColor( p->color );
-
-			alpha = 255 * (p->die - gpGlobals->time) * 16.0f;
-			if( alpha > 255 || p->type == pt_static )
-				alpha = 255;
-
-			pglColor4ub( gEngfuncs.LightToTexGamma( pColor->r ),
-				gEngfuncs.LightToTexGamma( pColor->g ),
-				gEngfuncs.LightToTexGamma( pColor->b ), alpha );
-
-			pglTexCoord2f( 0.0f, 1.0f );
-			pglVertex3f( p->org[0] - right[0] + up[0], p->org[1] - right[1] + up[1], p->org[2] - right[2] + up[2] );
-			pglTexCoord2f( 0.0f, 0.0f );
-			pglVertex3f( p->org[0] + right[0] + up[0], p->org[1] + right[1] + up[1], p->org[2] + right[2] + up[2] );
-			pglTexCoord2f( 1.0f, 0.0f );
-			pglVertex3f( p->org[0] + right[0] - up[0], p->org[1] + right[1] - up[1], p->org[2] + right[2] - up[2] );
-			pglTexCoord2f( 1.0f, 1.0f );
-			pglVertex3f( p->org[0] - right[0] - up[0], p->org[1] - right[1] - up[1], p->org[2] - right[2] - up[2] );
-			r_stats.c_particle_count++;
-		}
-
-		gEngfuncs.CL_ThinkParticle( frametime, p );
+		size = partsize; // get initial size of particle
+
+		// scale up to keep particles from disappearing
+		size += (p->org[0] - RI.vieworg[0]) * RI.cull_vforward[0];
+		size += (p->org[1] - RI.vieworg[1]) * RI.cull_vforward[1];
+		size += (p->org[2] - RI.vieworg[2]) * RI.cull_vforward[2];
+
+		if( size < 20.0f ) size = partsize;
+		else size = partsize + size * 0.002f;
+
+		// scale the axes by radius
+		VectorScale( RI.cull_vright, size, right );
+		VectorScale( RI.cull_vup, size, up );
+
+		pglColor4ub( gEngfuncs.LightToTexGamma( p->color.r ),
+			gEngfuncs.LightToTexGamma( p->color.g ),
+			gEngfuncs.LightToTexGamma( p->color.b ), p->alpha );
+
+		pglTexCoord2f( 0.0f, 1.0f );
+		pglVertex3f( p->org[0] - right[0] + up[0], p->org[1] - right[1] + up[1], p->org[2] - right[2] + up[2] );
+		pglTexCoord2f( 0.0f, 0.0f );
+		pglVertex3f( p->org[0] + right[0] + up[0], p->org[1] + right[1] + up[1], p->org[2] + right[2] + up[2] );
+		pglTexCoord2f( 1.0f, 0.0f );
+		pglVertex3f( p->org[0] + right[0] - up[0], p->org[1] + right[1] - up[1], p->org[2] + right[2] - up[2] );
+		pglTexCoord2f( 1.0f, 1.0f );
+		pglVertex3f( p->org[0] - right[0] - up[0], p->org[1] - right[1] - up[1], p->org[2] - right[2] - up[2] );
 	}
 
+	r_stats.c_particle_count += count;
+
 	pglEnd();
 	pglDepthMask( GL_TRUE );
 }
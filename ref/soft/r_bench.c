@@ -0,0 +1,260 @@
+/*
+r_bench.c - scripted render benchmark
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "r_local.h"
+
+#define MAX_BENCH_VIEWS	256
+#define BENCH_CSV		"renderbench.csv"
+
+typedef struct
+{
+	vec3_t	origin;
+	vec3_t	angles;
+} benchview_t;
+
+typedef struct
+{
+	double	total, min, max;
+	uint	world_polys;
+	uint	studio_polys;
+	uint	surfcache_misses;
+	uint	surfcache_evictions;
+	uint	surfcache_prebuilt;
+} benchresult_t;
+
+static struct
+{
+	qboolean	pending;
+	qboolean	quit;
+	int	frames;
+	int	numviews;
+	benchview_t	views[MAX_BENCH_VIEWS];
+} swbench;
+
+/*
+===============
+R_LoadBenchViews
+
+every line of the file is "x y z pitch yaw roll"
+===============
+*/
+static int R_LoadBenchViews( const char *filename )
+{
+	char	token[MAX_TOKEN];
+	byte	*afile;
+	char	*pfile;
+	int	i, count = 0;
+
+	afile = gEngfuncs.fsapi->LoadFile( filename, NULL, false );
+	if( !afile ) return 0;
+
+	pfile = (char *)afile;
+
+	while( count < MAX_BENCH_VIEWS && ( pfile = COM_ParseFile( pfile, token, sizeof( token ))) != NULL )
+	{
+		benchview_t *view = &swbench.views[count];
+
+		view->origin[0] = Q_atof( token );
+
+		for( i = 1; i < 6; i++ )
+		{
+			pfile = COM_ParseFile( pfile, token, sizeof( token ));
+
+			if( !pfile )
+				break;
+
+			if( i < 3 ) view->origin[i] = Q_atof( token );
+			else view->angles[i - 3] = Q_atof( token );
+		}
+
+		if( i != 6 )
+		{
+			gEngfuncs.Con_Printf( S_WARN "%s: viewpoint %i is incomplete\n", filename, count + 1 );
+			break;
+		}
+
+		count++;
+	}
+
+	Mem_Free( afile );
+
+	return count;
+}
+
+/*
+===============
+R_BenchView
+
+renders one viewpoint the given number of frames, r_stats
+are summed over all frames
+===============
+*/
+static void R_BenchView( const benchview_t *view, int frames, benchresult_t *res )
+{
+	ref_viewpass_t rvp;
+	int i;
+
+	memset( &rvp, 0, sizeof( rvp ));
+	SetBits( rvp.flags, RF_DRAW_WORLD );
+	rvp.viewport[2] = vid.width;
+	rvp.viewport[3] = vid.height;
+	rvp.fov_x = 90.0f;
+	rvp.fov_y = RAD2DEG( atan( tan( DEG2RAD( rvp.fov_x ) * 0.5 ) * vid.height / vid.width )) * 2.0;
+	VectorCopy( view->origin, rvp.vieworigin );
+	VectorCopy( view->angles, rvp.viewangles );
+
+	memset( res, 0, sizeof( *res ));
+	res->min = 1e9;
+
+	for( i = 0; i < frames; i++ )
+	{
+		double start, time;
+
+		memset( &r_stats, 0, sizeof( r_stats ));
+
+		start = gEngfuncs.pfnTime();
+		R_RenderFrame( &rvp );
+		R_EndFrame();
+		time = ( gEngfuncs.pfnTime() - start ) * 1000.0;
+
+		res->total += time;
+		res->min = Q_min( res->min, time );
+		res->max = Q_max( res->max, time );
+		res->world_polys += r_stats.c_world_polys;
+		res->studio_polys += r_stats.c_studio_polys;
+		res->surfcache_misses += r_stats.c_surfcache_misses;
+		res->surfcache_evictions += r_stats.c_surfcache_evictions;
+		res->surfcache_prebuilt += r_stats.c_surfcache_prebuilt;
+	}
+
+	RI.viewleaf = NULL; // force markleafs next frame
+}
+
+/*
+===============
+R_RunRenderBench
+===============
+*/
+static void R_RunRenderBench( void )
+{
+	file_t	*csv;
+	double	total = 0.0;
+	int	i, frames = swbench.frames;
+
+	csv = gEngfuncs.fsapi->Open( BENCH_CSV, "w", true );
+	if( csv ) gEngfuncs.fsapi->Printf( csv, "view,x,y,z,pitch,yaw,roll,avg_ms,min_ms,max_ms,world_polys,studio_polys,surfcache_misses,surfcache_evictions,surfcache_prebuilt\n" );
+
+	gEngfuncs.Con_Printf( "renderbench %ix%i, %i views, %i frames each, %i workers\n", vid.width, vid.height,
+		swbench.numviews, frames, gEngfuncs.Job_NumWorkers( ));
+
+	for( i = 0; i < swbench.numviews; i++ )
+	{
+		const benchview_t *view = &swbench.views[i];
+		benchresult_t res;
+
+		R_BenchView( view, frames, &res );
+		total += res.total;
+
+		gEngfuncs.Con_Printf( "view %3i: %.3f ms avg, %.3f min, %.3f max, %u wpoly, %u surfaces built\n", i,
+			res.total / frames, res.min, res.max, res.world_polys / frames, res.surfcache_misses / frames );
+
+		if( csv )
+		{
+			gEngfuncs.fsapi->Printf( csv, "%i,%g,%g,%g,%g,%g,%g,%.3f,%.3f,%.3f,%u,%u,%u,%u,%u\n", i,
+				view->origin[0], view->origin[1], view->origin[2], view->angles[0], view->angles[1], view->angles[2],
+				res.total / frames, res.min, res.max, res.world_polys / frames, res.studio_polys / frames,
+				res.surfcache_misses / frames, res.surfcache_evictions / frames, res.surfcache_prebuilt / frames );
+		}
+	}
+
+	gEngfuncs.Con_Printf( "renderbench: %.3f ms per frame%s\n", total / ( frames * swbench.numviews ),
+		csv ? ", results written to " BENCH_CSV : "" );
+
+	if( csv ) gEngfuncs.fsapi->Close( csv );
+
+	if( swbench.quit )
+		gEngfuncs.Cbuf_AddText( "quit\n" );
+}
+
+/*
+===============
+R_CheckRenderBench
+
+called at the start of every frame, runs the benchmark
+once the map is loaded
+===============
+*/
+void R_CheckRenderBench( void )
+{
+	if( !swbench.pending )
+		return;
+
+	if( ENGINE_GET_PARM( PARM_CONNSTATE ) != ca_active || !WORLDMODEL || !vid.buffer )
+		return;
+
+	swbench.pending = false;
+	R_RunRenderBench();
+}
+
+/*
+===============
+R_RenderBench_f
+
+sw_renderbench <viewpoints file|current> [frames] [quit]
+
+can be put on the command line after +map, it waits
+for the map to load. With -offscreen it runs headless
+===============
+*/
+void R_RenderBench_f( void )
+{
+	const char *source;
+
+	if( gEngfuncs.Cmd_Argc() < 2 )
+	{
+		gEngfuncs.Con_Printf( S_USAGE "sw_renderbench <viewpoints file|current> [frames] [quit]\n" );
+		return;
+	}
+
+	source = gEngfuncs.Cmd_Argv( 1 );
+	swbench.frames = 100;
+	swbench.quit = false;
+
+	if( gEngfuncs.Cmd_Argc() > 2 )
+		swbench.frames = Q_max( 1, Q_atoi( gEngfuncs.Cmd_Argv( 2 )));
+
+	if( gEngfuncs.Cmd_Argc() > 3 )
+		swbench.quit = !Q_stricmp( gEngfuncs.Cmd_Argv( 3 ), "quit" );
+
+	if( !Q_stricmp( source, "current" ))
+	{
+		if( !WORLDMODEL )
+		{
+			gEngfuncs.Con_Printf( "sw_renderbench: no map to take the view from\n" );
+			return;
+		}
+
+		VectorCopy( RI.vieworg, swbench.views[0].origin );
+		VectorCopy( RI.viewangles, swbench.views[0].angles );
+		swbench.numviews = 1;
+	}
+	else if(( swbench.numviews = R_LoadBenchViews( source )) == 0 )
+	{
+		gEngfuncs.Con_Printf( S_ERROR "sw_renderbench: no viewpoints in %s\n", source );
+		return;
+	}
+
+	swbench.pending = true;
+}
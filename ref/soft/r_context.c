@@ -318,10 +318,110 @@ void GAME_EXPORT R_SetupSky(const char *skyboxname)
 
 }
 
+// used for 'env' and 'sky' shots
+typedef struct envmap_s
+{
+	vec3_t	angles;
+	int	flags;
+} envmap_t;
+
+static const envmap_t r_skyBoxInfo[6] =
+{
+{{   0, 270, 180}, IMAGE_FLIP_X },
+{{   0,  90, 180}, IMAGE_FLIP_X },
+{{ -90,   0, 180}, IMAGE_FLIP_X },
+{{  90,   0, 180}, IMAGE_FLIP_X },
+{{   0,   0, 180}, IMAGE_FLIP_X },
+{{   0, 180, 180}, IMAGE_FLIP_X },
+};
+
+static const envmap_t r_envMapInfo[6] =
+{
+{{  0,   0,  90}, 0 },
+{{  0, 180, -90}, 0 },
+{{  0,  90,   0}, 0 },
+{{  0, 270, 180}, 0 },
+{{-90, 180, -90}, 0 },
+{{ 90,   0,  90}, 0 }
+};
+
+/*
+===============
+VID_CubemapShot
+
+every side is drawn in the top left corner of the frame and
+read back, so it works with the offscreen output too
+===============
+*/
 qboolean GAME_EXPORT VID_CubemapShot(const char *base, uint size, const float *vieworg, qboolean skyshot)
 {
-	// cubemaps? in my softrender???
-	return false;
+	rgbdata_t	*r_shot, *r_side;
+	byte	*temp, *buffer;
+	string	basename;
+	int	i = 1, flags, result;
+
+	if( !RI.drawWorld || !WORLDMODEL )
+		return false;
+
+	// make sure the specified size is valid
+	while( i < size ) i<<=1;
+
+	if( i != size ) return false;
+	if( size > vid.width || size > vid.height )
+		return false;
+
+	// alloc space
+	temp = Mem_Malloc( r_temppool, size * size * 3 );
+	buffer = Mem_Malloc( r_temppool, size * size * 3 * 6 );
+	r_shot = Mem_Calloc( r_temppool, sizeof( rgbdata_t ));
+	r_side = Mem_Calloc( r_temppool, sizeof( rgbdata_t ));
+
+	// use client vieworg
+	if( !vieworg ) vieworg = RI.vieworg;
+
+	for( i = 0; i < 6; i++ )
+	{
+		if( skyshot )
+		{
+			R_DrawCubemapView( vieworg, r_skyBoxInfo[i].angles, size );
+			flags = r_skyBoxInfo[i].flags;
+		}
+		else
+		{
+			R_DrawCubemapView( vieworg, r_envMapInfo[i].angles, size );
+			flags = r_envMapInfo[i].flags;
+		}
+
+		R_ReadPixels( 0, 0, size, size, temp );
+		r_side->flags = IMAGE_HAS_COLOR;
+		r_side->width = r_side->height = size;
+		r_side->type = PF_RGB_24;
+		r_side->size = r_side->width * r_side->height * 3;
+		r_side->buffer = temp;
+
+		if( flags ) gEngfuncs.Image_Process( &r_side, 0, 0, flags, 0.0f );
+		memcpy( buffer + (size * size * 3 * i), r_side->buffer, size * size * 3 );
+	}
+
+	r_shot->flags = IMAGE_HAS_COLOR;
+	r_shot->flags |= (skyshot) ? IMAGE_SKYBOX : IMAGE_CUBEMAP;
+	r_shot->width = size;
+	r_shot->height = size;
+	r_shot->type = PF_RGB_24;
+	r_shot->size = r_shot->width * r_shot->height * 3 * 6;
+	r_shot->palette = NULL;
+	r_shot->buffer = buffer;
+
+	// make sure what we have right extension
+	Q_strncpy( basename, base, sizeof( basename ));
+	COM_ReplaceExtension( basename, ".tga", sizeof( basename ));
+
+	// write image as 6 sides
+	result = gEngfuncs.FS_SaveImage( basename, r_shot );
+	gEngfuncs.FS_FreeImage( r_shot );
+	gEngfuncs.FS_FreeImage( r_side );
+
+	return result;
 }
 
 void R_InitSkyClouds(mip_t *mt, texture_t *tx, qboolean custom_palette)
@@ -381,7 +481,22 @@ void GAME_EXPORT Mod_SetOrthoBounds(const float *mins, const float *maxs)
 
 qboolean GAME_EXPORT R_SpeedsMessage(char *out, size_t size)
 {
-	return false;
+	if( gEngfuncs.drawFuncs->R_SpeedsMessage != NULL )
+	{
+		if( gEngfuncs.drawFuncs->R_SpeedsMessage( out, size ))
+			return true;
+		// otherwise pass to default handler
+	}
+
+	if( r_speeds->value <= 0 ) return false;
+	if( !out || !size ) return false;
+
+	Q_snprintf( out, size, "surface cache %s%s\n%3i hits, %3i misses\n%3i evictions\n%3i built on workers",
+		Q_memprint( sc_size ), r_cache_thrash ? ", ^1thrashing^7" : "",
+		r_stats.c_surfcache_hits, r_stats.c_surfcache_misses,
+		r_stats.c_surfcache_evictions, r_stats.c_surfcache_prebuilt );
+
+	return true;
 }
 
 byte *GAME_EXPORT Mod_GetCurrentVis( void )
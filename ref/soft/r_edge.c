@@ -774,28 +774,201 @@ int D_MipLevelForScale (float scale)
 
 /*
 ==============
-D_FlatFillSurface
+D_FlatFillSpans
 
 Simple single color fill with no texture mapping
 ==============
 */
-void D_FlatFillSurface (surf_t *surf, int color)
+static void D_FlatFillSpans (const spanstate_t *st, espan_t *pspan)
 {
 	espan_t	*span;
 	pixel_t	*pdest;
 	int		u, u2;
 
-	for (span=surf->spans ; span ; span=span->pnext)
+	for (span=pspan ; span ; span=span->pnext)
 	{
 		pdest = d_viewbuffer + r_screenwidth*span->v;
 		u = span->u;
 		u2 = span->u + span->count - 1;
 		for ( ; u <= u2 ; u++)
-			pdest[u] = color;
+			pdest[u] = st->color;
 	}
 }
 
 
+/*
+==============================================================
+
+SPAN BATCHES
+
+Surfaces are still set up one by one on the main thread, but with
+sw_parallelspans their spans are only recorded together with the
+gradients. At the end of D_DrawSurfaces the screen is cut in bands
+of rows, every band draws its own part of every recorded surface,
+so bands never touch the same pixels in color or z buffer
+==============================================================
+*/
+#define SPAN_BAND_ROWS		16	// rows per job
+#define SPAN_BAND_CHUNK		64	// spans copied on stack at once
+
+static struct
+{
+	spanstate_t	*states;
+	int		numstates;
+	int		maxstates;
+	int		id;		// stamped into surface cache blocks used by the batch
+	qboolean	active;
+} spanbatch = { NULL, 0, 0, 1, false };
+
+/*
+==============
+D_DrawSpanState
+==============
+*/
+static void D_DrawSpanState (const spanstate_t *st, espan_t *pspan)
+{
+	switch (st->type)
+	{
+	case SPANS_FLAT:
+		D_FlatFillSpans (st, pspan);
+		break;
+	case SPANS_TEXTURED:
+		D_DrawSpans16 (st, pspan);
+		break;
+	case SPANS_TURBULENT:
+		D_DrawTurbulentSpans (st, pspan);
+		break;
+	}
+
+	D_DrawZSpans (st, pspan);
+}
+
+/*
+==============
+D_DrawSpanBand
+
+draws spans in rows [first, last) of every batched surface, may run on workers
+==============
+*/
+static void D_DrawSpanBand (void *data, int first, int last)
+{
+	espan_t	chunk[SPAN_BAND_CHUNK];
+	espan_t	*span;
+	int		i, n;
+
+	for (i = 0; i < spanbatch.numstates; i++)
+	{
+		const spanstate_t *st = &spanbatch.states[i];
+
+		n = 0;
+
+		// spans are pushed to the head of the list while scanning
+		// down the screen, so they come sorted bottom to top
+		for (span = st->spans; span && span->v >= first; span = span->pnext)
+		{
+			if (span->v >= last)
+				continue;
+
+			chunk[n] = *span;
+			chunk[n].pnext = &chunk[n + 1];
+
+			if (++n == SPAN_BAND_CHUNK)
+			{
+				chunk[n - 1].pnext = NULL;
+				D_DrawSpanState (st, chunk);
+				n = 0;
+			}
+		}
+
+		if (n)
+		{
+			chunk[n - 1].pnext = NULL;
+			D_DrawSpanState (st, chunk);
+		}
+	}
+}
+
+/*
+==============
+D_FlushSurfaceSpans
+
+draws everything recorded so far, also called when a surface cache
+block used by recorded spans is about to be reused
+==============
+*/
+void D_FlushSurfaceSpans (void)
+{
+	if (!spanbatch.numstates)
+		return;
+
+	gEngfuncs.Job_ParallelFor (D_DrawSpanBand, NULL, vid.height, SPAN_BAND_ROWS);
+
+	spanbatch.numstates = 0;
+	spanbatch.id++;
+}
+
+/*
+==============
+D_SpansUseCache
+==============
+*/
+qboolean D_SpansUseCache (const surfcache_t *cache)
+{
+	return spanbatch.numstates && cache->spanbatch == spanbatch.id;
+}
+
+/*
+==============
+D_SubmitSpans
+
+draws spans of the surface right away or records them for D_FlushSurfaceSpans,
+gradients and texture are copied from the globals set up by D_CalcGradients
+==============
+*/
+static void D_SubmitSpans (surf_t *s, spantype_t type, surfcache_t *cache, const int *turb, int color)
+{
+	spanstate_t	*st, local;
+
+	if (spanbatch.active)
+	{
+		if (spanbatch.numstates == spanbatch.maxstates)
+		{
+			spanbatch.maxstates = Q_max (256, spanbatch.maxstates * 2);
+			spanbatch.states = Mem_Realloc (r_temppool, spanbatch.states, spanbatch.maxstates * sizeof (*spanbatch.states));
+		}
+
+		st = &spanbatch.states[spanbatch.numstates++];
+
+		if (cache)
+			cache->spanbatch = spanbatch.id;
+	}
+	else st = &local;
+
+	st->type = type;
+	st->spans = s->spans;
+	st->sdivzstepu = d_sdivzstepu;
+	st->tdivzstepu = d_tdivzstepu;
+	st->zistepu = d_zistepu;
+	st->sdivzstepv = d_sdivzstepv;
+	st->tdivzstepv = d_tdivzstepv;
+	st->zistepv = d_zistepv;
+	st->sdivzorigin = d_sdivzorigin;
+	st->tdivzorigin = d_tdivzorigin;
+	st->ziorigin = d_ziorigin;
+	st->sadjust = sadjust;
+	st->tadjust = tadjust;
+	st->bbextents = bbextents;
+	st->bbextentt = bbextentt;
+	st->cacheblock = cacheblock;
+	st->cachewidth = cachewidth;
+	st->turb = turb;
+	st->color = color;
+
+	if (!spanbatch.active)
+		D_DrawSpanState (st, st->spans);
+}
+
+
 /*
 ==============
 D_CalcGradients
@@ -896,8 +1069,7 @@ void D_BackgroundSurf (surf_t *s)
 	d_zistepv = 0;
 	d_ziorigin = -0.9;
 
-	D_FlatFillSurface (s, (int)sw_clearcolor.value & 0xFFFF);
-	D_DrawZSpans (s->spans);
+	D_SubmitSpans (s, SPANS_FLAT, NULL, NULL, (int)sw_clearcolor.value & 0xFFFF);
 }
 
 /*
@@ -932,21 +1104,11 @@ void D_TurbulentSurf (surf_t *s)
 
 	D_CalcGradients (pface);
 
-//============
-//PGM
-	// textures that aren't warping are just flowing. Use NonTurbulent8 instead
-#if 0
-	Turbulent8 (s->spans);
-#else
-	if(!(pface->flags & SURF_DRAWTURB))
-		NonTurbulent8 (s->spans);
+	// textures that aren't warping are just flowing
+	if (pface->flags & SURF_DRAWTURB)
+		D_SubmitSpans (s, SPANS_TURBULENT, NULL, sintable + ((int)(gpGlobals->time*SPEED)&(CYCLE-1)), 0);
 	else
-		Turbulent8 (s->spans);
-#endif
-//PGM
-//============
-
-	D_DrawZSpans (s->spans);
+		D_SubmitSpans (s, SPANS_TURBULENT, NULL, blanktable, 0);
 
 	if (s->insubmodel)
 	{
@@ -1079,6 +1241,25 @@ void D_AlphaSurf (surf_t *s)
 }
 
 
+/*
+==============
+D_SurfaceMipLevel
+==============
+*/
+static int D_SurfaceMipLevel (surf_t *s, msurface_t *pface)
+{
+	int	lmiplevel;
+
+	if( pface->flags & SURF_CONVEYOR )
+		lmiplevel = 1;
+	else
+		lmiplevel = D_MipLevelForScale(s->nearzi * scale_for_mip );
+	while( 1 << lmiplevel > gEngfuncs.Mod_SampleSizeForFace(pface))
+		lmiplevel--;
+
+	return lmiplevel;
+}
+
 /*
 ==============
 D_SolidSurf
@@ -1128,12 +1309,7 @@ void D_SolidSurf (surf_t *s)
 	if( !pface )
 		return;
 #if 1
-	if( pface->flags & SURF_CONVEYOR )
-		miplevel = 1;
-	else
-		miplevel = D_MipLevelForScale(s->nearzi * scale_for_mip );
-	while( 1 << miplevel > gEngfuncs.Mod_SampleSizeForFace(pface))
-		miplevel--;
+	miplevel = D_SurfaceMipLevel (s, pface);
 #else
 	{
 		float dot;
@@ -1169,9 +1345,7 @@ void D_SolidSurf (surf_t *s)
 
 	D_CalcGradients (pface);
 
-	D_DrawSpans16 (s->spans);
-
-	D_DrawZSpans (s->spans);
+	D_SubmitSpans (s, SPANS_TEXTURED, pcurrentcache, NULL, 0);
 
 	if (s->insubmodel)
 	{
@@ -1212,11 +1386,52 @@ void D_DrawflatSurfaces (void)
 
 		// make a stable color for each surface by taking the low
 		// bits of the msurface pointer
-		D_FlatFillSurface (s, (uintptr_t)s->msurf & 0xFFFF);
-		D_DrawZSpans (s->spans);
+		D_SubmitSpans (s, SPANS_FLAT, NULL, NULL, (uintptr_t)s->msurf & 0xFFFF);
 	}
 }
 
+/*
+==============
+D_BuildSurfaces
+
+builds surface cache blocks needed by solid surfaces on the engine
+workers before the spans are drawn, drawing finds them in the cache
+==============
+*/
+static void D_BuildSurfaces (void)
+{
+	cl_entity_t	*oldentity = RI.currententity;
+	matrix4x4	lightmatrix;
+	surf_t		*s;
+
+	Matrix4x4_LoadIdentity (lightmatrix);
+
+	for (s = &surfaces[1] ; s<surface_p ; s++)
+	{
+		qboolean	lightidentity = true;
+
+		if (!s->spans || !s->msurf || (s->flags & (SURF_DRAWSKY|SURF_DRAWTURB)))
+			continue;
+
+		// texture animation depends on the entity frame,
+		// dynamic lights are transformed to the brush model space
+		if (s->insubmodel)
+		{
+			RI.currententity = s->entity;
+			Matrix4x4_CreateFromEntity( lightmatrix, RI.currententity->angles, RI.currententity->origin, 1 );
+			lightidentity = false;
+		}
+		else RI.currententity = gEngfuncs.GetEntityByIndex(0);
+
+		// leave the rest to D_SolidSurf when the cache is full
+		if (!D_QueueSurfaceBuild (s->msurf, D_SurfaceMipLevel (s, s->msurf), lightmatrix, lightidentity))
+			break;
+	}
+
+	RI.currententity = oldentity;
+	D_FinishSurfaceBuilds ();
+}
+
 /*
 ==============
 D_DrawSurfaces
@@ -1234,8 +1449,14 @@ void D_DrawSurfaces (void)
 	TransformVector (tr.modelorg, transformed_modelorg);
 	VectorCopy (transformed_modelorg, world_transformed_modelorg);
 
+	// alpha spans blend with what's already drawn, keep them in order
+	spanbatch.active = sw_parallelspans.value && !alphaspans && gEngfuncs.Job_NumWorkers() > 0;
+
 	if (!sw_drawflat.value)
 	{
+		if (sw_parallelsurfaces.value && !alphaspans && gEngfuncs.Job_NumWorkers() > 0)
+			D_BuildSurfaces ();
+
 		for (s = &surfaces[1] ; s<surface_p ; s++)
 		{
 			if (!s->spans)
@@ -1266,6 +1487,9 @@ void D_DrawSurfaces (void)
 	else
 		D_DrawflatSurfaces ();
 
+	D_FlushSurfaceSpans ();
+	spanbatch.active = false;
+
 	//RI.currententity = NULL;	//&r_worldentity;
 	VectorSubtract (RI.vieworg, vec3_origin, tr.modelorg);
 	R_TransformFrustum ();
@@ -1,4 +1,10 @@
 #include "r_local.h"
+#include "xash3d_simd.h"
+#if XASH_POSIX
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #define APIENTRY_LINKAGE static
 #include "../gl/gl_export.h"
 
@@ -12,6 +18,7 @@ struct swblit_s
 	qboolean(*pCreateBuffer)( int width, int height, uint *stride, uint *bpp, uint *r, uint *g, uint *b );
 	uint rotate;
 	qboolean gl1;
+	qboolean simd; // vector conversion gives same colors as vid.screen32
 } swblit;
 
 
@@ -411,7 +418,137 @@ static qboolean R_CreateBuffer_GLES3( int width, int height, uint *stride, uint
 	return true;
 }
 
+/*
+==============================================================
+
+OFFSCREEN OUTPUT
 
+With -offscreen frames are converted to XRGB8888 in memory and
+never presented, so ref_soft runs without a window or a GPU.
+When sw_offscreen_file is set the frame is kept in that file
+mapped into memory instead, a file in /dev/shm makes it shared
+memory other processes can read. The file starts with
+offscreen_header_t, frame is incremented after every blit
+==============================================================
+*/
+#define OFFSCREEN_IDENT	(('F'<<24)+('W'<<16)+('S'<<8)+'X') // little-endian "XSWF"
+
+typedef struct
+{
+	uint32_t	ident;
+	uint32_t	width, height;
+	uint32_t	stride;	// in pixels, 4 bytes each
+	uint32_t	frame;
+	uint32_t	reserved[3];
+} offscreen_header_t;
+
+static struct
+{
+	byte		*pixels;
+	offscreen_header_t	*header;	// set when pixels are mapped from a file
+	size_t		mapsize;
+	int		width, height;
+} swoffscreen;
+
+static void R_FreeOffscreen( void )
+{
+#if XASH_POSIX
+	if( swoffscreen.header )
+		munmap( swoffscreen.header, swoffscreen.mapsize );
+	else
+#endif
+	if( swoffscreen.pixels )
+		free( swoffscreen.pixels );
+
+	swoffscreen.pixels = NULL;
+	swoffscreen.header = NULL;
+	swoffscreen.mapsize = 0;
+}
+
+static qboolean R_MapOffscreen( const char *path, int width, int height )
+{
+#if XASH_POSIX
+	size_t size = sizeof( offscreen_header_t ) + (size_t)width * height * 4;
+	void *map;
+	int fd;
+
+	fd = open( path, O_RDWR|O_CREAT, 0600 );
+	if( fd < 0 )
+		return false;
+
+	if( ftruncate( fd, size ) < 0 )
+	{
+		close( fd );
+		return false;
+	}
+
+	map = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+
+	if( map == MAP_FAILED )
+		return false;
+
+	swoffscreen.header = map;
+	swoffscreen.header->ident = OFFSCREEN_IDENT;
+	swoffscreen.header->width = width;
+	swoffscreen.header->height = height;
+	swoffscreen.header->stride = width;
+	swoffscreen.header->frame = 0;
+	swoffscreen.pixels = (byte *)( swoffscreen.header + 1 );
+	swoffscreen.mapsize = size;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+static qboolean R_CreateBuffer_Offscreen( int width, int height, uint *stride, uint *bpp, uint *r, uint *g, uint *b )
+{
+	R_FreeOffscreen();
+
+	ClearBits( sw_offscreen_file.flags, FCVAR_CHANGED );
+
+	if( COM_CheckStringEmpty( sw_offscreen_file.string ) && !R_MapOffscreen( sw_offscreen_file.string, width, height ))
+		gEngfuncs.Con_Printf( S_ERROR "can't map offscreen frame to %s, keeping it in memory\n", sw_offscreen_file.string );
+
+	if( !swoffscreen.pixels )
+		swoffscreen.pixels = malloc( (size_t)width * height * 4 );
+
+	if( !swoffscreen.pixels )
+		return false;
+
+	swoffscreen.width = width;
+	swoffscreen.height = height;
+
+	*stride = width;
+	*bpp = 4;
+	*r = MASK(8) << 16;
+	*g = MASK(8) << 8;
+	*b = MASK(8);
+
+	return true;
+}
+
+static void *R_Lock_Offscreen( void )
+{
+	// file was changed, map the frame again
+	if( FBitSet( sw_offscreen_file.flags, FCVAR_CHANGED ))
+	{
+		uint stride, bpp, r, g, b;
+
+		if( !R_CreateBuffer_Offscreen( swoffscreen.width, swoffscreen.height, &stride, &bpp, &r, &g, &b ))
+			return NULL;
+	}
+
+	return swoffscreen.pixels;
+}
+
+static void R_Unlock_Offscreen( void )
+{
+	if( swoffscreen.header )
+		swoffscreen.header->frame++;
+}
 
 static int FIRST_BIT( uint mask )
 {
@@ -432,6 +569,151 @@ static int COUNT_BITS( uint mask )
 	return i;
 }
 
+/*
+==============================================================
+
+VECTOR SCREEN CONVERSION
+
+Pixels keep 3-3-2 color in the high byte and the lower bits of
+every channel in the low byte, R_BuildScreenMap scales both parts
+separately and ORs them together. With 8 bits per channel these
+scales are small multiplications and bit moves, so 16 pixels are
+converted at once in byte lanes without looking up the table
+==============================================================
+*/
+#if XASH_SIMD
+#define BLIT_SIMD_PIXELS 16
+
+#if XASH_SIMD_SSE2
+// there are no byte shifts, bits moved in from the neighbour byte are masked out
+#define BLIT_SHR( x, n, mask ) _mm_and_si128( _mm_srli_epi16(( x ), ( n )), _mm_set1_epi8( mask ))
+#define BLIT_SHL( x, n, mask ) _mm_and_si128( _mm_slli_epi16(( x ), ( n )), _mm_set1_epi8( mask ))
+#define BLIT_AND( x, mask ) _mm_and_si128(( x ), _mm_set1_epi8( mask ))
+
+static int R_BlitRow32_SIMD( uint *dst, const pixel_t *src, int count, int rbyte, int gbyte, int bbyte )
+{
+	__m128i lowbyte = _mm_set1_epi16( 0xff );
+	int i;
+
+	for( i = 0; i + BLIT_SIMD_PIXELS <= count; i += BLIT_SIMD_PIXELS )
+	{
+		__m128i p0 = _mm_loadu_si128( (const __m128i *)( src + i ));
+		__m128i p1 = _mm_loadu_si128( (const __m128i *)( src + i + 8 ));
+		__m128i lo = _mm_packus_epi16( _mm_and_si128( p0, lowbyte ), _mm_and_si128( p1, lowbyte ));
+		__m128i hi = _mm_packus_epi16( _mm_srli_epi16( p0, 8 ), _mm_srli_epi16( p1, 8 ));
+		__m128i lo1 = _mm_srli_epi16( lo, 1 ), lo2 = _mm_slli_epi16( lo, 1 );
+		__m128i a, c[4], t0, t1, t2, t3;
+
+		c[0] = c[1] = c[2] = c[3] = _mm_setzero_si128();
+
+		// major is 33 * r, 32.5 * g, 66 * b, minor bits are GBRGBRGB
+		a = BLIT_SHR( hi, 5, 0x07 );
+		c[rbyte] = _mm_or_si128( _mm_add_epi8( BLIT_SHL( a, 5, 0xe0 ), a ),
+			_mm_or_si128( BLIT_AND( lo1, 0x10 ), BLIT_AND( lo2, 0x08 )));
+
+		a = BLIT_SHR( hi, 2, 0x07 );
+		c[gbyte] = _mm_or_si128( _mm_add_epi8( BLIT_SHL( a, 5, 0xe0 ), BLIT_SHR( a, 1, 0x03 )),
+			_mm_or_si128( BLIT_SHR( lo, 3, 0x10 ), _mm_or_si128( BLIT_AND( lo1, 0x08 ), BLIT_AND( lo2, 0x04 ))));
+
+		a = BLIT_AND( hi, 0x03 );
+		c[bbyte] = _mm_or_si128( _mm_add_epi8( BLIT_SHL( a, 6, 0xc0 ), BLIT_SHL( a, 1, 0x06 )),
+			_mm_or_si128( _mm_or_si128( BLIT_AND( lo1, 0x20 ), BLIT_AND( lo2, 0x10 )), _mm_or_si128( BLIT_SHL( lo, 3, 0x08 ), BLIT_SHR( lo, 6, 0x01 ))));
+
+		t0 = _mm_unpacklo_epi8( c[0], c[1] );
+		t1 = _mm_unpackhi_epi8( c[0], c[1] );
+		t2 = _mm_unpacklo_epi8( c[2], c[3] );
+		t3 = _mm_unpackhi_epi8( c[2], c[3] );
+
+		_mm_storeu_si128( (__m128i *)( dst + i ), _mm_unpacklo_epi16( t0, t2 ));
+		_mm_storeu_si128( (__m128i *)( dst + i + 4 ), _mm_unpackhi_epi16( t0, t2 ));
+		_mm_storeu_si128( (__m128i *)( dst + i + 8 ), _mm_unpacklo_epi16( t1, t3 ));
+		_mm_storeu_si128( (__m128i *)( dst + i + 12 ), _mm_unpackhi_epi16( t1, t3 ));
+	}
+
+	return i;
+}
+#elif XASH_SIMD_NEON
+#define BLIT_SHR( x, n, mask ) vandq_u8( vshrq_n_u8(( x ), ( n )), vdupq_n_u8( mask ))
+#define BLIT_SHL( x, n, mask ) vandq_u8( vshlq_n_u8(( x ), ( n )), vdupq_n_u8( mask ))
+#define BLIT_AND( x, mask ) vandq_u8(( x ), vdupq_n_u8( mask ))
+
+static int R_BlitRow32_SIMD( uint *dst, const pixel_t *src, int count, int rbyte, int gbyte, int bbyte )
+{
+	int i;
+
+	for( i = 0; i + BLIT_SIMD_PIXELS <= count; i += BLIT_SIMD_PIXELS )
+	{
+		uint8x16x2_t p = vld2q_u8( (const uint8_t *)( src + i ));
+		uint8x16_t lo = p.val[0], hi = p.val[1];
+		uint8x16_t lo1 = vshrq_n_u8( lo, 1 ), lo2 = vshlq_n_u8( lo, 1 );
+		uint8x16_t a;
+		uint8x16x4_t c;
+
+		c.val[0] = c.val[1] = c.val[2] = c.val[3] = vdupq_n_u8( 0 );
+
+		// major is 33 * r, 32.5 * g, 66 * b, minor bits are GBRGBRGB
+		a = vshrq_n_u8( hi, 5 );
+		c.val[rbyte] = vorrq_u8( vaddq_u8( vshlq_n_u8( a, 5 ), a ),
+			vorrq_u8( BLIT_AND( lo1, 0x10 ), BLIT_AND( lo2, 0x08 )));
+
+		a = BLIT_SHR( hi, 2, 0x07 );
+		c.val[gbyte] = vorrq_u8( vaddq_u8( vshlq_n_u8( a, 5 ), vshrq_n_u8( a, 1 )),
+			vorrq_u8( BLIT_SHR( lo, 3, 0x10 ), vorrq_u8( BLIT_AND( lo1, 0x08 ), BLIT_AND( lo2, 0x04 ))));
+
+		a = BLIT_AND( hi, 0x03 );
+		c.val[bbyte] = vorrq_u8( vaddq_u8( vshlq_n_u8( a, 6 ), vshlq_n_u8( a, 1 )),
+			vorrq_u8( vorrq_u8( BLIT_AND( lo1, 0x20 ), BLIT_AND( lo2, 0x10 )), vorrq_u8( BLIT_SHL( lo, 3, 0x08 ), BLIT_SHR( lo, 6, 0x01 ))));
+
+		vst4q_u8( (uint8_t *)( dst + i ), c );
+	}
+
+	return i;
+}
+#endif // XASH_SIMD_NEON
+#endif // XASH_SIMD
+
+/*
+========================
+R_CheckBlitSIMD
+
+vector code is only used when it gives exactly the same
+colors as the lookup table for every possible pixel
+========================
+*/
+static qboolean R_CheckBlitSIMD( uint rbits, uint gbits, uint bbits )
+{
+#if XASH_SIMD
+	uint rshift = FIRST_BIT( swblit.rmask ), gshift = FIRST_BIT( swblit.gmask ), bshift = FIRST_BIT( swblit.bmask );
+	uint row[256];
+	pixel_t pixels[256];
+	int i, j;
+
+	if( swblit.bpp != 4 || rbits != 8 || gbits != 8 || bbits != 8 )
+		return false;
+
+	if(( rshift & 7 ) || ( gshift & 7 ) || ( bshift & 7 ))
+		return false;
+
+	if( gEngfuncs.Sys_CheckParm( "-nosimd" ))
+		return false;
+
+	for( i = 0; i < 256; i++ )
+	{
+		for( j = 0; j < 256; j++ )
+			pixels[j] = ( i << 8 ) | j;
+
+		R_BlitRow32_SIMD( row, pixels, 256, rshift >> 3, gshift >> 3, bshift >> 3 );
+
+		if( memcmp( row, &vid.screen32[i << 8], sizeof( row )))
+			return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
 void R_BuildScreenMap( void )
 {
 	int i;
@@ -493,6 +775,8 @@ void R_BuildScreenMap( void )
 
 	}
 #endif
+
+	swblit.simd = R_CheckBlitSIMD( rbits, gbits, bbits );
 }
 
 #define FOR_EACH_COLOR(x) 	for( r##x = 0; r##x < BIT(3); r##x++ ) for( g##x = 0; g##x < BIT(3); g##x++ ) for( b##x = 0; b##x < BIT(2); b##x++ )
@@ -623,12 +907,19 @@ void R_BuildBlendMaps( void )
 }
 
 void R_AllocScreen( void );
+static void R_BlitBench_f( void );
 
-void R_InitBlit( qboolean glblit )
+void R_InitBlit( qboolean glblit, qboolean offscreen )
 {
 	R_BuildBlendMaps();
 
-	if( glblit && swblit.gl1 )
+	if( offscreen )
+	{
+		swblit.pLockBuffer = R_Lock_Offscreen;
+		swblit.pUnlockBuffer = R_Unlock_Offscreen;
+		swblit.pCreateBuffer = R_CreateBuffer_Offscreen;
+	}
+	else if( glblit && swblit.gl1 )
 	{
 		swblit.pLockBuffer = R_Lock_GL1;
 		swblit.pUnlockBuffer = R_Unlock_GLES1;
@@ -647,6 +938,14 @@ void R_InitBlit( qboolean glblit )
 		swblit.pCreateBuffer = gEngfuncs.SW_CreateBuffer;
 	}
 	R_AllocScreen();
+
+	gEngfuncs.Cmd_AddCommand( "sw_blitbench", R_BlitBench_f, "time screen conversion with every blit path" );
+}
+
+void R_ShutdownBlit( void )
+{
+	gEngfuncs.Cmd_RemoveCommand( "sw_blitbench" );
+	R_FreeOffscreen();
 }
 
 void R_AllocScreen( void )
@@ -680,31 +979,31 @@ void R_AllocScreen( void )
 	vid.buffer = malloc( vid.width * vid.height*sizeof( pixel_t ) );
 }
 
-void R_BlitScreen( void )
+typedef struct
 {
-	int u, v;
-	void *buffer = swblit.pLockBuffer();
-//	gEngfuncs.Con_Printf("blit begin\n");
-	//memset( vid.buffer, 10, vid.width * vid.height );
+	void *buffer;
+	qboolean simd;
+} blitband_t;
 
-	if( !buffer || gpGlobals->width != vid.width || gpGlobals->height != vid.height )
-	{
-		gEngfuncs.Con_Printf("pre allocscrn\n");
-		R_AllocScreen();
-		gEngfuncs.Con_Printf("post allocscrn\n");
-		return;
-	}
-	//return;
-	//byte *buf = vid.buffer;
+/*
+========================
+R_BlitBand
+
+converts rows [first, last) of vid.buffer, may run on workers
+========================
+*/
+static void R_BlitBand( void *data, int first, int last )
+{
+	blitband_t *band = data;
+	void *buffer = band->buffer;
+	int u, v;
 
-	//#pragma omp parallel for schedule(static)
-	//gEngfuncs.Con_Printf("swblit %d %d", swblit.bpp, vid.height );
 	if( swblit.rotate )
 	{
 		if( swblit.bpp == 2 )
 		{
 			unsigned short *pbuf = buffer;
-			for( v = 0; v < vid.height;v++)
+			for( v = first; v < last; v++ )
 			{
 				uint start = vid.rowbytes * v;
 				uint d = swblit.stride - v - 1;
@@ -721,7 +1020,7 @@ void R_BlitScreen( void )
 		{
 			unsigned int *pbuf = buffer;
 
-			for( v = 0; v < vid.height;v++)
+			for( v = first; v < last; v++ )
 			{
 				uint start = vid.rowbytes * v;
 				uint d = swblit.stride - v - 1;
@@ -737,7 +1036,7 @@ void R_BlitScreen( void )
 		else if( swblit.bpp == 3 )
 		{
 			byte *pbuf = buffer;
-			for( v = 0; v < vid.height;v++)
+			for( v = first; v < last; v++ )
 			{
 				uint start = vid.rowbytes * v;
 				uint d = swblit.stride - v - 1;
@@ -760,7 +1059,7 @@ void R_BlitScreen( void )
 		if( swblit.bpp == 2 )
 		{
 			unsigned short *pbuf = buffer;
-			for( v = 0; v < vid.height;v++)
+			for( v = first; v < last; v++ )
 			{
 				uint start = vid.rowbytes * v;
 				uint dstart = swblit.stride * v;
@@ -775,13 +1074,21 @@ void R_BlitScreen( void )
 		else if( swblit.bpp == 4 )
 		{
 			unsigned int *pbuf = buffer;
+#if XASH_SIMD
+			int rbyte = FIRST_BIT( swblit.rmask ) >> 3, gbyte = FIRST_BIT( swblit.gmask ) >> 3, bbyte = FIRST_BIT( swblit.bmask ) >> 3;
+#endif
 
-			for( v = 0; v < vid.height;v++)
+			for( v = first; v < last; v++ )
 			{
 				uint start = vid.rowbytes * v;
 				uint dstart = swblit.stride * v;
 
-				for( u = 0; u < vid.width; u++ )
+				u = 0;
+#if XASH_SIMD
+				if( band->simd )
+					u = R_BlitRow32_SIMD( &pbuf[dstart], &vid.buffer[start], vid.width, rbyte, gbyte, bbyte );
+#endif
+				for( ; u < vid.width; u++ )
 				{
 					unsigned int s = vid.screen32[vid.buffer[start + u]];
 					pbuf[dstart + u] = s;
@@ -791,7 +1098,7 @@ void R_BlitScreen( void )
 		else if( swblit.bpp == 3 )
 		{
 			byte *pbuf = buffer;
-			for( v = 0; v < vid.height;v++)
+			for( v = first; v < last; v++ )
 			{
 				uint start = vid.rowbytes * v;
 				uint dstart = swblit.stride * v;
@@ -808,11 +1115,98 @@ void R_BlitScreen( void )
 			}
 		}
 	}
+}
+
+/*
+========================
+R_BlitBuffer
+
+rows are split in bands of roughly BLIT_BAND_PIXELS,
+bands are picked up by the engine workers
+========================
+*/
+#define BLIT_BAND_PIXELS 16384
+
+static void R_BlitBuffer( void *buffer, qboolean simd, qboolean parallel )
+{
+	blitband_t band;
+
+	band.buffer = buffer;
+	band.simd = simd;
+
+	if( parallel )
+		gEngfuncs.Job_ParallelFor( R_BlitBand, &band, vid.height, Q_max( 1, BLIT_BAND_PIXELS / vid.width ));
+	else R_BlitBand( &band, 0, vid.height );
+}
+
+void R_BlitScreen( void )
+{
+	void *buffer = swblit.pLockBuffer();
+//	gEngfuncs.Con_Printf("blit begin\n");
+	//memset( vid.buffer, 10, vid.width * vid.height );
+
+	if( !buffer || gpGlobals->width != vid.width || gpGlobals->height != vid.height )
+	{
+		gEngfuncs.Con_Printf("pre allocscrn\n");
+		R_AllocScreen();
+		gEngfuncs.Con_Printf("post allocscrn\n");
+		return;
+	}
+
+	R_BlitBuffer( buffer, swblit.simd, sw_parallelblit.value != 0.0f );
 
 	swblit.pUnlockBuffer();
 //	gEngfuncs.Con_Printf("blit end\n");
 }
 
+/*
+========================
+R_BlitBench_f
+
+times the blit into an offscreen buffer with every
+conversion path and checks that they give the same image
+========================
+*/
+static void R_BlitBench_f( void )
+{
+	static const char *names[] = { "scalar", "simd", "simd + workers" };
+	byte *buffers[3];
+	int frames = 200, height, i, j;
+	size_t size;
+
+	if( gEngfuncs.Cmd_Argc() > 1 )
+		frames = Q_max( 1, Q_atoi( gEngfuncs.Cmd_Argv( 1 )));
+
+	if( !vid.buffer )
+		return;
+
+	// lock buffer has the screen size swapped when rotated
+	height = swblit.rotate ? vid.width : vid.height;
+	size = (size_t)swblit.stride * height * swblit.bpp;
+
+	gEngfuncs.Con_Printf( "blit %ix%i, %i bpp, %i workers, %i frames\n", vid.width, vid.height, swblit.bpp * 8, gEngfuncs.Job_NumWorkers(), frames );
+
+	for( i = 0; i < 3; i++ )
+	{
+		double start;
+
+		buffers[i] = calloc( 1, size );
+
+		if( !buffers[i] )
+			break;
+
+		start = gEngfuncs.pfnTime();
+		for( j = 0; j < frames; j++ )
+			R_BlitBuffer( buffers[i], i > 0 && swblit.simd, i == 2 );
+
+		gEngfuncs.Con_Printf( "%16s: %.3f ms%s\n", names[i], ( gEngfuncs.pfnTime() - start ) * 1000.0 / frames,
+			( i > 0 && memcmp( buffers[0], buffers[i], size )) ? ", MISMATCH" : "" );
+	}
+
+	for( j = 0; j < i; j++ )
+		free( buffers[j] );
+}
+
 static uint32_t Get8888PixelAt( int u, int start )
 {
 	uint32_t s;
@@ -838,6 +1232,33 @@ static uint32_t Get8888PixelAt( int u, int start )
 	return s | 0xFF000000;
 }
 
+/*
+========================
+R_ReadPixels
+
+copies a rectangle of the rendered frame into RGB rows,
+bottom row first like glReadPixels
+========================
+*/
+void R_ReadPixels( int x, int y, int width, int height, byte *rgb )
+{
+	int u, v;
+
+	for( v = 0; v < height; v++ )
+	{
+		uint start = vid.rowbytes * ( y + height - v - 1 ) + x;
+
+		for( u = 0; u < width; u++, rgb += 3 )
+		{
+			uint32_t s = Get8888PixelAt( u, start );
+
+			rgb[0] = ( s >> 16 ) & 0xff;
+			rgb[1] = ( s >> 8 ) & 0xff;
+			rgb[2] = s & 0xff;
+		}
+	}
+}
+
 qboolean GAME_EXPORT VID_ScreenShot( const char *filename, int shot_type )
 {
 	rgbdata_t *r_shot;
@@ -861,7 +1282,7 @@ qboolean GAME_EXPORT VID_ScreenShot( const char *filename, int shot_type )
 
 		for( v = 0; v < vid.height; v++ )
 		{
-			uint start = vid.rowbytes * ( vid.height - v );
+			uint start = vid.rowbytes * ( vid.height - v - 1 );
 			uint d = swblit.stride - v - 1;
 
 			for( u = 0; u < vid.width; u++ )
@@ -877,8 +1298,8 @@ qboolean GAME_EXPORT VID_ScreenShot( const char *filename, int shot_type )
 
 		for( v = 0; v < vid.height;v++)
 		{
-			uint start = vid.rowbytes * ( vid.height - v );
-			uint dstart = swblit.stride * v;
+			uint start = vid.rowbytes * ( vid.height - v - 1 );
+			uint dstart = r_shot->width * v;
 
 			for( u = 0; u < vid.width; u++ )
 			{
@@ -19,9 +19,6 @@ GNU General Public License for more details.
 #include "xash3d_mathlib.h"
 #include "ref_params.h"
 
-//unused, need refactor
-unsigned		blocklights[10240];
-
 /*
 =============================================================================
 
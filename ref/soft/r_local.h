@@ -31,6 +31,7 @@ GNU General Public License for more details.
 #include "com_strings.h"
 #include "pm_movevars.h"
 #include "common/cvar.h"
+#include "xash3d_simd.h"
 typedef struct mip_s mip_t;
 
 typedef	int	fixed8_t;
@@ -318,6 +319,11 @@ typedef struct
 	uint		c_client_ents;	// entities that moved to client
 	double		t_world_node;
 	double		t_world_draw;
+
+	uint		c_surfcache_hits;
+	uint		c_surfcache_misses;	// surfaces lit and built this frame
+	uint		c_surfcache_evictions;
+	uint		c_surfcache_prebuilt;	// built on workers before drawing
 } ref_speeds_t;
 
 extern ref_speeds_t		r_stats;
@@ -522,7 +528,7 @@ void R_AddDecalVBO( decal_t *pdecal, msurface_t *surf );
 // gl_rpart.c
 //
 void CL_DrawParticlesExternal( const ref_viewpass_t *rvp, qboolean trans_pass, float frametime );
-void CL_DrawParticles( double frametime, particle_t *cl_active_particles, float partsize );
+void CL_DrawParticles( const ref_particle_t *particles, int count, float partsize );
 void CL_DrawTracers( double frametime, particle_t *cl_active_tracers );
 
 
@@ -890,6 +896,8 @@ typedef struct
 	int                     surfmip;        // mipmapped ratio of surface texels / world pixels
 	int                     surfwidth;      // in mipmapped texels
 	int                     surfheight;     // in mipmapped texels
+	matrix4x4		lightmatrix;	// brush model transform for dynamic lights
+	qboolean		lightidentity;	// world surface, lightmatrix is unused
 } drawsurf_t;
 
 
@@ -925,15 +933,20 @@ typedef struct clipplane_s
 
 typedef struct surfcache_s
 {
-	struct surfcache_s      *next;
+	struct surfcache_s      *next;			// LRU list or free list of this size class
+	struct surfcache_s      *prev;
 	struct surfcache_s      **owner;                // NULL is an empty chunk of memory
 	int                                     lightadj[MAXLIGHTMAPS]; // checked for strobe flush
 	int                                     dlight;
-	int                                     size;           // including header
+	int                                     size;           // including header, 1 << order
+	int				order;		// size class
+	int				lastframe;	// tr.framecount when drawn last
+	qboolean			prebuilt;	// built by the prepass and not drawn yet
 	unsigned                        width;
 	unsigned                        height;         // DEBUG only needed for debug
 	float                           mipscale;
 	image_t							*image;
+	int				spanbatch;	// last batch of spans that used this block
 	byte                            data[4];        // width*height elements
 } surfcache_t;
 
@@ -1003,7 +1016,6 @@ void D_ViewChanged (void);
 
 extern drawsurf_t       r_drawsurf;
 
-void R_DrawSurface (void);
 
 //extern int              c_surf;
 
@@ -1014,9 +1026,9 @@ extern byte             r_warpbuffer[WARP_WIDTH * WARP_HEIGHT];
 
 extern float    scale_for_mip;
 
-extern qboolean         d_roverwrapped;
-extern surfcache_t      *sc_rover;
-extern surfcache_t      *d_initial_rover;
+extern qboolean         r_cache_thrash;
+extern int              sc_size;
+
 
 extern float    d_sdivzstepu, d_tdivzstepu, d_zistepu;
 extern float    d_sdivzstepv, d_tdivzstepv, d_zistepv;
@@ -1026,10 +1038,36 @@ extern  fixed16_t       sadjust, tadjust;
 extern  fixed16_t       bbextents, bbextentt;
 
 
-void D_DrawSpans16 (espan_t *pspans);
-void D_DrawZSpans (espan_t *pspans);
-void Turbulent8 (espan_t *pspan);
-void NonTurbulent8 (espan_t *pspan);	//PGM
+// spans of one surface with everything needed to draw them, gradients
+// are copied from the globals above once the surface is set up, so
+// spans can be drawn later and on any thread
+typedef enum
+{
+	SPANS_FLAT = 0,
+	SPANS_TEXTURED,
+	SPANS_TURBULENT,
+} spantype_t;
+
+typedef struct spanstate_s
+{
+	spantype_t	type;
+	espan_t		*spans;
+	float		sdivzstepu, tdivzstepu, zistepu;
+	float		sdivzstepv, tdivzstepv, zistepv;
+	float		sdivzorigin, tdivzorigin, ziorigin;
+	fixed16_t	sadjust, tadjust;
+	fixed16_t	bbextents, bbextentt;
+	pixel_t		*cacheblock;
+	int		cachewidth;
+	const int	*turb;		// SPANS_TURBULENT, blanktable for scrolling textures
+	int		color;		// SPANS_FLAT
+} spanstate_t;
+
+void D_DrawSpans16 (const spanstate_t *st, espan_t *pspan);
+void D_DrawZSpans (const spanstate_t *st, espan_t *pspan);
+void D_DrawTurbulentSpans (const spanstate_t *st, espan_t *pspan);
+void D_FlushSurfaceSpans (void);
+qboolean D_SpansUseCache (const surfcache_t *cache);
 
 surfcache_t     *D_CacheSurface (msurface_t *surface, int miplevel);
 
@@ -1094,10 +1132,23 @@ extern convar_t   sw_mipcap;
 extern convar_t   sw_mipscale;
 extern convar_t   sw_surfcacheoverride;
 extern convar_t   sw_texfilt;
+extern convar_t   sw_parallelblit;
+extern convar_t   sw_parallelspans;
+extern convar_t   sw_parallelsurfaces;
+extern convar_t   sw_simd;
+extern convar_t   sw_offscreen_file;
 extern convar_t   r_traceglow;
 extern convar_t   sw_noalphabrushes;
 extern convar_t   r_studio_sort_textures;
 
+// vector versions of the affine span runs and lightmap rows,
+// they give the same pixels as the plain C loops
+#if XASH_SIMD
+#define SW_SIMD ( sw_simd.value != 0.0f )
+#else
+#define SW_SIMD 0
+#endif
+
 extern struct qfrustum_s {
 	mplane_t screenedge[4];
 	clipplane_t     view_clipplanes[4];
@@ -1153,7 +1204,15 @@ void R_DrawBrushModel(cl_entity_t *pent);
 //
 void R_InitCaches (void);
 void R_BlitScreen( void );
-void R_InitBlit( qboolean gl );
+void R_InitBlit( qboolean gl, qboolean offscreen );
+void R_ShutdownBlit( void );
+void R_ReadPixels( int x, int y, int width, int height, byte *rgb );
+
+//
+// r_bench.c
+//
+void R_CheckRenderBench( void );
+void R_RenderBench_f( void );
 qboolean R_SetDisplayTransform( ref_screen_rotation_t rotate, int offset_x, int offset_y, float scale_x, float scale_y );
 
 //
@@ -1170,6 +1229,8 @@ void R_ScanEdges (void);
 //
 void GL_InitRandomTable( void );
 void D_FlushCaches( void );
+qboolean D_QueueSurfaceBuild( msurface_t *surface, int miplevel, const matrix4x4 lightmatrix, qboolean lightidentity );
+void D_FinishSurfaceBuilds( void );
 
 //
 // r_draw.c
@@ -69,6 +69,11 @@ static CVAR_DEFINE_AUTO( sw_notransbrushes, "0", FCVAR_GLCONFIG, "do not apply t
 CVAR_DEFINE_AUTO( sw_noalphabrushes, "0", FCVAR_GLCONFIG, "do not draw brush holes (faster)");
 CVAR_DEFINE_AUTO( r_traceglow, "0", FCVAR_GLCONFIG, "cull flares behind models" );
 CVAR_DEFINE_AUTO( sw_texfilt, "0", FCVAR_GLCONFIG, "texture dither");
+CVAR_DEFINE_AUTO( sw_parallelblit, "1", FCVAR_GLCONFIG, "convert screen to output format on worker threads" );
+CVAR_DEFINE_AUTO( sw_parallelspans, "1", FCVAR_GLCONFIG, "draw world surface spans in screen bands on worker threads" );
+CVAR_DEFINE_AUTO( sw_parallelsurfaces, "1", FCVAR_GLCONFIG, "build lit surfaces on worker threads before drawing spans" );
+CVAR_DEFINE_AUTO( sw_simd, "1", FCVAR_GLCONFIG, "use SSE2 or NEON for span and lightmap kernels" );
+CVAR_DEFINE_AUTO( sw_offscreen_file, "", FCVAR_GLCONFIG, "with -offscreen, map rendered frames to this file, e.g. /dev/shm/xash_frame" );
 static CVAR_DEFINE_AUTO( r_novis, "0", 0, "" );
 
 
@@ -1418,13 +1423,19 @@ void R_EdgeDrawing (void)
 	R_BeginEdgeFrame ();
 
 	// this will prepare edges
+	gEngfuncs.Profile_Begin( "R_RenderWorld" );
 	R_RenderWorld ();
+	gEngfuncs.Profile_End();
 
 	// move brushes to separate list to merge with edges?
+	gEngfuncs.Profile_Begin( "R_DrawBEntitiesOnList" );
 	R_DrawBEntitiesOnList ();
+	gEngfuncs.Profile_End();
 
 	// display all edges
+	gEngfuncs.Profile_Begin( "R_ScanEdges" );
 	R_ScanEdges ();
+	gEngfuncs.Profile_End();
 }
 
 #if 0
@@ -1587,20 +1598,110 @@ void GAME_EXPORT R_RenderScene( void )
 //	R_SetupGL( true );
 	//R_Clear( ~0 );
 
+	gEngfuncs.Profile_Begin( "R_MarkLeaves" );
 	R_MarkLeaves();
+	gEngfuncs.Profile_End();
 	// R_PushDlights (r_worldmodel); ??
 	//R_DrawWorld();
 	R_EdgeDrawing ();
 
 	gEngfuncs.CL_ExtraUpdate ();	// don't let sound get messed up if going slow
 
+	gEngfuncs.Profile_Begin( "R_DrawEntitiesOnList" );
 	R_DrawEntitiesOnList();
+	gEngfuncs.Profile_End();
 
 //	R_DrawWaterSurfaces();
 
 //	R_EndGL();
 }
 
+/*
+================
+R_SpanBench_f
+
+renders the last scene again with plain C and vector kernels,
+serial and in screen bands, times every mode and compares the
+images with the first one. Surface cache is flushed before each
+mode, or every frame with "rebuild", so lit surfaces are built
+by the kernels being tested too
+================
+*/
+static void R_SpanBench_f( void )
+{
+	static const struct
+	{
+		const char *name;
+		int bands, simd;
+	} modes[] =
+	{
+		{ "scalar", 0, 0 },
+		{ "bands", 1, 0 },
+#if XASH_SIMD
+		{ "simd", 0, 1 },
+		{ "bands + simd", 1, 1 },
+#endif
+	};
+	float oldspans = sw_parallelspans.value;
+#if XASH_SIMD
+	float oldsimd = sw_simd.value;
+#endif
+	size_t size = (size_t)vid.width * vid.height * sizeof( pixel_t );
+	pixel_t *reference;
+	qboolean rebuild = false;
+	int frames = 50, i, j;
+
+	if( gEngfuncs.Cmd_Argc() > 1 )
+		frames = Q_max( 1, Q_atoi( gEngfuncs.Cmd_Argv( 1 )));
+
+	if( gEngfuncs.Cmd_Argc() > 2 )
+		rebuild = !Q_stricmp( gEngfuncs.Cmd_Argv( 2 ), "rebuild" );
+
+	if( ENGINE_GET_PARM( PARM_CONNSTATE ) != ca_active || !WORLDMODEL || !vid.buffer )
+	{
+		gEngfuncs.Con_Printf( "sw_spanbench: no scene to render\n" );
+		return;
+	}
+
+	reference = malloc( size );
+	if( !reference )
+		return;
+
+	gEngfuncs.Con_Printf( "spans %ix%i, %i workers, %i frames%s\n", vid.width, vid.height,
+		gEngfuncs.Job_NumWorkers(), frames, rebuild ? ", rebuilding surfaces" : "" );
+
+	for( i = 0; i < ARRAYSIZE( modes ); i++ )
+	{
+		double start;
+
+		gEngfuncs.Cvar_SetValue( "sw_parallelspans", modes[i].bands );
+#if XASH_SIMD
+		gEngfuncs.Cvar_SetValue( "sw_simd", modes[i].simd );
+#endif
+		D_FlushCaches();
+
+		start = gEngfuncs.pfnTime();
+		for( j = 0; j < frames; j++ )
+		{
+			if( rebuild )
+				D_FlushCaches();
+			R_RenderScene();
+		}
+
+		if( i == 0 )
+			memcpy( reference, vid.buffer, size );
+
+		gEngfuncs.Con_Printf( "%16s: %.3f ms%s\n", modes[i].name, ( gEngfuncs.pfnTime() - start ) * 1000.0 / frames,
+			( i > 0 && memcmp( reference, vid.buffer, size )) ? ", MISMATCH" : "" );
+	}
+
+	gEngfuncs.Cvar_SetValue( "sw_parallelspans", oldspans );
+#if XASH_SIMD
+	gEngfuncs.Cvar_SetValue( "sw_simd", oldsimd );
+#endif
+	free( reference );
+}
+
 /*
 ===============
 R_DoResetGamma
@@ -1643,6 +1744,8 @@ R_BeginFrame
 */
 void GAME_EXPORT R_BeginFrame( qboolean clearScene )
 {
+	R_CheckRenderBench();
+
 #if 0 // unused
 	if( R_DoResetGamma( ))
 	{
@@ -1665,6 +1768,9 @@ void GAME_EXPORT R_BeginFrame( qboolean clearScene )
 		ClearBits( vid_gamma->flags, FCVAR_CHANGED );
 	}
 
+	// r_speeds counters are per frame
+	memset( &r_stats, 0, sizeof( r_stats ));
+
 	R_Set2DMode( true );
 
 	// draw buffer stuff
@@ -1761,7 +1867,9 @@ void GAME_EXPORT R_EndFrame( void )
 	R_Set2DMode( false );
 
 	// blit pixels
+	gEngfuncs.Profile_Begin( "R_BlitScreen" );
 	R_BlitScreen();
+	gEngfuncs.Profile_End();
 }
 
 /*
@@ -1897,7 +2005,7 @@ void R_InitTurb (void)
 
 qboolean GAME_EXPORT R_Init( void )
 {
-	qboolean glblit = false;
+	qboolean glblit = false, offscreen;
 
 	RETRIEVE_ENGINE_SHARED_CVAR_LIST();
 
@@ -1917,15 +2025,34 @@ qboolean GAME_EXPORT R_Init( void )
 #ifndef DISABLE_TEXFILTER
 	gEngfuncs.Cvar_RegisterVariable( &sw_texfilt );
 #endif
+	gEngfuncs.Cvar_RegisterVariable( &sw_parallelblit );
+	gEngfuncs.Cvar_RegisterVariable( &sw_parallelspans );
+	gEngfuncs.Cvar_RegisterVariable( &sw_parallelsurfaces );
+#if XASH_SIMD
+	gEngfuncs.Cvar_RegisterVariable( &sw_simd );
+	if( gEngfuncs.Sys_CheckParm( "-nosimd" ))
+		gEngfuncs.Cvar_SetValue( "sw_simd", 0.0f );
+#endif
+	gEngfuncs.Cvar_RegisterVariable( &sw_offscreen_file );
 	gEngfuncs.Cvar_RegisterVariable( &r_novis );
 	gEngfuncs.Cvar_RegisterVariable( &r_studio_sort_textures );
 
 	r_temppool = Mem_AllocPool( "ref_soft zone" );
 
-	glblit = !!gEngfuncs.Sys_CheckParm( "-glblit" );
+	offscreen = !!gEngfuncs.Sys_CheckParm( "-offscreen" );
+	glblit = !offscreen && !!gEngfuncs.Sys_CheckParm( "-glblit" );
 
 	// create the window and set up the context
-	if( !glblit && !gEngfuncs.R_Init_Video( REF_SOFTWARE )) // request software blitter
+	if( offscreen )
+	{
+		// frames never reach the window, it only gives the engine a video mode
+		if( !gEngfuncs.R_Init_Video( REF_SOFTWARE ))
+		{
+			gEngfuncs.R_Free_Video();
+			gEngfuncs.Con_Printf( "no window for offscreen rendering, using default resolution\n" );
+		}
+	}
+	else if( !glblit && !gEngfuncs.R_Init_Video( REF_SOFTWARE )) // request software blitter
 	{
 		gEngfuncs.R_Free_Video();
 		gEngfuncs.Con_Printf("failed to initialize software blitter, fallback to glblit\n");
@@ -1938,7 +2065,7 @@ qboolean GAME_EXPORT R_Init( void )
 		return false;
 	}
 
-	R_InitBlit( glblit );
+	R_InitBlit( glblit, offscreen );
 
 	R_InitImages();
 	// init draw stack
@@ -1953,11 +2080,17 @@ qboolean GAME_EXPORT R_Init( void )
 	R_InitTurb();
 	GL_InitRandomTable();
 
+	gEngfuncs.Cmd_AddCommand( "sw_spanbench", R_SpanBench_f, "time and compare surface spans with plain C and vector kernels, serial and in screen bands" );
+	gEngfuncs.Cmd_AddCommand( "sw_renderbench", R_RenderBench_f, "render frames from a list of viewpoints and report timings, usage: sw_renderbench <file|current> [frames] [quit]" );
+
 	return true;
 }
 
 void GAME_EXPORT R_Shutdown( void )
 {
+	gEngfuncs.Cmd_RemoveCommand( "sw_spanbench" );
+	gEngfuncs.Cmd_RemoveCommand( "sw_renderbench" );
+	R_ShutdownBlit();
 	R_ShutdownImages();
 	gEngfuncs.R_Free_Video();
 }
@@ -23,8 +23,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define NUM_MIPS	4
 
-surfcache_t		*d_initial_rover;
-qboolean		d_roverwrapped;
 int				d_minmip;
 float			d_scalemip[NUM_MIPS-1];
 
@@ -355,8 +353,7 @@ void R_SetupFrameQ (void)
 	r_outofedges = 0;*/
 
 // d_setup
-	d_roverwrapped = false;
-	d_initial_rover = sc_rover;
+	r_cache_thrash = false;
 
 	d_minmip = sw_mipcap.value;
 	if (d_minmip > 3)
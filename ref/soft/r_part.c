@@ -42,18 +42,17 @@ static color24 gTracerColors[] =
 ================
 CL_DrawParticles
 
-update particle color, position, free expired and draw it
+draw particles packed by the engine
 ================
 */
-void GAME_EXPORT CL_DrawParticles( double frametime, particle_t *cl_active_particles, float partsize )
+void GAME_EXPORT CL_DrawParticles( const ref_particle_t *particles, int count, float partsize )
 {
-	particle_t	*p;
+	const ref_particle_t	*p;
 	vec3_t		right, up;
-	color24		*pColor;
-	int		alpha;
-	float		size;
+	float		size, scale;
+	int		i;
 
-	if( !cl_active_particles )
+	if( !count )
 		return;	// nothing to draw?
 
 	//pglEnable( GL_BLEND );
@@ -65,53 +64,39 @@ void GAME_EXPORT CL_DrawParticles( double frametime, particle_t *cl_active_parti
 	//pglTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
 	//pglDepthMask( GL_FALSE );
 
-	for( p = cl_active_particles; p; p = p->next )
+	for( i = 0, p = particles; i < count; i++, p++ )
 	{
-		if(( p->type != pt_blob ) || ( p->packedColor == 255 ))
-		{
-			size = partsize; // get initial size of particle
-
-			// scale up to keep particles from disappearing
-			size += (p->org[0] - RI.vieworg[0]) * RI.cull_vforward[0];
-			size += (p->org[1] - RI.vieworg[1]) * RI.cull_vforward[1];
-			size += (p->org[2] - RI.vieworg[2]) * RI.cull_vforward[2];
-
-			if( size < 20.0f ) size = partsize;
-			else size = partsize + size * 0.002f;
-
-			// scale the axes by radius
-			VectorScale( RI.cull_vright, size, right );
-			VectorScale( RI.cull_vup, size, up );
-
-			p->color = bound( 0, p->color, 255 );
-			pColor = gEngfuncs.CL_GetPaletteColor( p->color );
-
-			alpha = 255 * (p->die - gpGlobals->time) * 16.0f;
-			if( alpha > 255 || p->type == pt_static )
-				alpha = 255;
-
-			//TriColor4ub( gEngfuncs.LightToTexGamma( pColor->r ),
-			//	gEngfuncs.LightToTexGamma( pColor->g ),
-		//		gEngfuncs.LightToTexGamma( pColor->b ), alpha );
-			//TriBrightness( alpha / 255.0f );
-			_TriColor4f(1.0f*alpha/255/255*pColor->r,1.0f*alpha/255/255*pColor->g,1.0f*alpha/255/255* pColor->b,1.0f );
-
-			TriBegin( TRI_QUADS );
-			TriTexCoord2f( 0.0f, 1.0f );
-			TriVertex3f( p->org[0] - right[0] + up[0], p->org[1] - right[1] + up[1], p->org[2] - right[2] + up[2] );
-			TriTexCoord2f( 0.0f, 0.0f );
-			TriVertex3f( p->org[0] + right[0] + up[0], p->org[1] + right[1] + up[1], p->org[2] + right[2] + up[2] );
-			TriTexCoord2f( 1.0f, 0.0f );
-			TriVertex3f( p->org[0] + right[0] - up[0], p->org[1] + right[1] - up[1], p->org[2] + right[2] - up[2] );
-			TriTexCoord2f( 1.0f, 1.0f );
-			TriVertex3f( p->org[0] - right[0] - up[0], p->org[1] - right[1] - up[1], p->org[2] - right[2] - up[2] );
-			TriEnd();
-			r_stats.c_particle_count++;
-		}
-
-		gEngfuncs.CL_ThinkParticle( frametime, p );
+		size = partsize; // get initial size of particle
+
+		// scale up to keep particles from disappearing
+		size += (p->org[0] - RI.vieworg[0]) * RI.cull_vforward[0];
+		size += (p->org[1] - RI.vieworg[1]) * RI.cull_vforward[1];
+		size += (p->org[2] - RI.vieworg[2]) * RI.cull_vforward[2];
+
+		if( size < 20.0f ) size = partsize;
+		else size = partsize + size * 0.002f;
+
+		// scale the axes by radius
+		VectorScale( RI.cull_vright, size, right );
+		VectorScale( RI.cull_vup, size, up );
+
+		scale = 1.0f * p->alpha / 255 / 255;
+		_TriColor4f( scale * p->color.r, scale * p->color.g, scale * p->color.b, 1.0f );
+
+		TriBegin( TRI_QUADS );
+		TriTexCoord2f( 0.0f, 1.0f );
+		TriVertex3f( p->org[0] - right[0] + up[0], p->org[1] - right[1] + up[1], p->org[2] - right[2] + up[2] );
+		TriTexCoord2f( 0.0f, 0.0f );
+		TriVertex3f( p->org[0] + right[0] + up[0], p->org[1] + right[1] + up[1], p->org[2] + right[2] + up[2] );
+		TriTexCoord2f( 1.0f, 0.0f );
+		TriVertex3f( p->org[0] + right[0] - up[0], p->org[1] + right[1] - up[1], p->org[2] + right[2] - up[2] );
+		TriTexCoord2f( 1.0f, 1.0f );
+		TriVertex3f( p->org[0] - right[0] - up[0], p->org[1] - right[1] - up[1], p->org[2] - right[2] - up[2] );
+		TriEnd();
 	}
 
+	r_stats.c_particle_count += count;
+
 	TriEnd();
 	//pglDepthMask( GL_TRUE );
 }
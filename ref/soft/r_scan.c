@@ -31,31 +31,10 @@ int				*r_turb_turb;
 static int				r_turb_spancount;
 int alpha;
 
-void D_DrawTurbulent8Span (void);
 
 
 #if	!id386
 
-/*
-=============
-D_DrawTurbulent8Span
-=============
-*/
-void D_DrawTurbulent8Span (void)
-{
-	int		sturb, tturb;
-
-	do
-	{
-		sturb = ((r_turb_s + r_turb_turb[(r_turb_t>>16)&(CYCLE-1)])>>16)&63;
-		tturb = ((r_turb_t + r_turb_turb[(r_turb_s>>16)&(CYCLE-1)])>>16)&63;
-		*r_turb_pdest++ = *(r_turb_pbase + (tturb<<6) + sturb);
-		r_turb_s += r_turb_sstep;
-		r_turb_t += r_turb_tstep;
-	} while (--r_turb_spancount > 0);
-}
-
-
 /*
 =============
 D_DrawTurbulent8Span
@@ -87,175 +66,164 @@ void D_DrawTurbulent8ZSpan (void)
 
 #endif	// !id386
 
+#if XASH_SIMD
+/*
+==============================================================
+
+VECTOR SPAN RUNS
 
+Texels are still fetched one by one, there are no gathers in
+SSE2 or NEON, but texel offsets and z tests for a whole affine
+run are computed at once and the fetches don't depend on each
+other, so they can overlap
+==============================================================
+*/
+#if XASH_SIMD_SSE2
 /*
 =============
-Turbulent8
+D_SpanOffsets8
+
+offsets of an 8 pixel run in a texture, s >> 16 and t >> 16
+go to the 16-bit halves of each lane, so a multiply-add with
+( 1, texwidth ) gives s + t * texwidth
 =============
 */
-void Turbulent8 (espan_t *pspan)
+static void D_SpanOffsets8( int *ofs, fixed16_t s, fixed16_t t, fixed16_t sstep, fixed16_t tstep, int texwidth )
 {
-	int				count;
-	fixed16_t		snext, tnext;
-	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
-	float			sdivz16stepu, tdivz16stepu, zi16stepu;
-
-	r_turb_turb = sintable + ((int)(gpGlobals->time*SPEED)&(CYCLE-1));
-
-	r_turb_sstep = 0;	// keep compiler happy
-	r_turb_tstep = 0;	// ditto
+	__m128i mul = _mm_set1_epi32(( 1 << 16 ) | texwidth );
+	__m128i hi = _mm_set1_epi32( 0xffff0000 );
+	__m128i sv = _mm_add_epi32( _mm_set1_epi32( s ), _mm_setr_epi32( 0, sstep, sstep * 2, sstep * 3 ));
+	__m128i tv = _mm_add_epi32( _mm_set1_epi32( t ), _mm_setr_epi32( 0, tstep, tstep * 2, tstep * 3 ));
 
-	r_turb_pbase = cacheblock;
-
-	sdivz16stepu = d_sdivzstepu * 16;
-	tdivz16stepu = d_tdivzstepu * 16;
-	zi16stepu = d_zistepu * 16;
+	_mm_storeu_si128( (__m128i *)ofs, _mm_madd_epi16( _mm_or_si128( _mm_and_si128( sv, hi ), _mm_srli_epi32( tv, 16 )), mul ));
 
-	do
-	{
-		r_turb_pdest = (d_viewbuffer +
-				(r_screenwidth * pspan->v) + pspan->u);
-
-		count = pspan->count;
-
-	// calculate the initial s/z, t/z, 1/z, s, and t and clamp
-		du = (float)pspan->u;
-		dv = (float)pspan->v;
-
-		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
-		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
-		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
-		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
-
-		r_turb_s = (int)(sdivz * z) + sadjust;
-		if (r_turb_s > bbextents)
-			r_turb_s = bbextents;
-		else if (r_turb_s < 0)
-			r_turb_s = 0;
-
-		r_turb_t = (int)(tdivz * z) + tadjust;
-		if (r_turb_t > bbextentt)
-			r_turb_t = bbextentt;
-		else if (r_turb_t < 0)
-			r_turb_t = 0;
+	sv = _mm_add_epi32( sv, _mm_set1_epi32( sstep * 4 ));
+	tv = _mm_add_epi32( tv, _mm_set1_epi32( tstep * 4 ));
+	_mm_storeu_si128( (__m128i *)( ofs + 4 ), _mm_madd_epi16( _mm_or_si128( _mm_and_si128( sv, hi ), _mm_srli_epi32( tv, 16 )), mul ));
+}
 
-		do
-		{
-		// calculate s and t at the far end of the span
-			if (count >= 16)
-				r_turb_spancount = 16;
-			else
-				r_turb_spancount = count;
+/*
+=============
+D_TileOffsets8
 
-			count -= r_turb_spancount;
+offsets of an 8 pixel run in a 64x64 tile
+=============
+*/
+static void D_TileOffsets8( int *ofs, fixed16_t s, fixed16_t t, fixed16_t sstep, fixed16_t tstep )
+{
+	__m128i smask = _mm_set1_epi32( 63 ), tmask = _mm_set1_epi32( 63 << 6 );
+	__m128i sv = _mm_add_epi32( _mm_set1_epi32( s ), _mm_setr_epi32( 0, sstep, sstep * 2, sstep * 3 ));
+	__m128i tv = _mm_add_epi32( _mm_set1_epi32( t ), _mm_setr_epi32( 0, tstep, tstep * 2, tstep * 3 ));
 
-			if (count)
-			{
-			// calculate s/z, t/z, zi->fixed s and t at far end of span,
-			// calculate s and t steps across span by shifting
-				sdivz += sdivz16stepu;
-				tdivz += tdivz16stepu;
-				zi += zi16stepu;
-				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+	_mm_storeu_si128( (__m128i *)ofs, _mm_or_si128( _mm_and_si128( _mm_srli_epi32( sv, 16 ), smask ), _mm_and_si128( _mm_srli_epi32( tv, 10 ), tmask )));
 
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
-				else if (snext < 16)
-					snext = 16;	// prevent round-off error on <0 steps from
-								//  from causing overstepping & running off the
-								//  edge of the texture
+	sv = _mm_add_epi32( sv, _mm_set1_epi32( sstep * 4 ));
+	tv = _mm_add_epi32( tv, _mm_set1_epi32( tstep * 4 ));
+	_mm_storeu_si128( (__m128i *)( ofs + 4 ), _mm_or_si128( _mm_and_si128( _mm_srli_epi32( sv, 16 ), smask ), _mm_and_si128( _mm_srli_epi32( tv, 10 ), tmask )));
+}
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
-				else if (tnext < 16)
-					tnext = 16;	// guard against round-off error on <0 steps
+/*
+=============
+D_SpanZMask8
 
-				r_turb_sstep = (snext - r_turb_s) >> 4;
-				r_turb_tstep = (tnext - r_turb_t) >> 4;
-			}
-			else
-			{
-			// calculate s/z, t/z, zi->fixed s and t at last pixel in span (so
-			// can't step off polygon), clamp, calculate s and t steps across
-			// span by division, biasing steps low so we don't run off the
-			// texture
-				spancountminus1 = (float)(r_turb_spancount - 1);
-				sdivz += d_sdivzstepu * spancountminus1;
-				tdivz += d_tdivzstepu * spancountminus1;
-				zi += d_zistepu * spancountminus1;
-				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
-				else if (snext < 16)
-					snext = 16;	// prevent round-off error on <0 steps from
-								//  from causing overstepping & running off the
-								//  edge of the texture
+bit i is set when pixel i of the run passes the z test,
+saturated izi >> 16 compares the same way against 16-bit z
+=============
+*/
+static int D_SpanZMask8( const short *pz, int izi, int izistep )
+{
+	__m128i zv = _mm_add_epi32( _mm_set1_epi32( izi ), _mm_setr_epi32( 0, izistep, izistep * 2, izistep * 3 ));
+	__m128i zlo = _mm_srai_epi32( zv, 16 );
+	__m128i zhi = _mm_srai_epi32( _mm_add_epi32( zv, _mm_set1_epi32( izistep * 4 )), 16 );
+	__m128i fail = _mm_cmpgt_epi16( _mm_loadu_si128( (const __m128i *)pz ), _mm_packs_epi32( zlo, zhi ));
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
-				else if (tnext < 16)
-					tnext = 16;	// guard against round-off error on <0 steps
+	return ~_mm_movemask_epi8( _mm_packs_epi16( fail, fail )) & 0xff;
+}
+#elif XASH_SIMD_NEON
+static void D_SpanOffsets8( int *ofs, fixed16_t s, fixed16_t t, fixed16_t sstep, fixed16_t tstep, int texwidth )
+{
+	const int32_t lanes[4] = { 0, 1, 2, 3 };
+	int32x4_t l = vld1q_s32( lanes );
+	int32x4_t sv = vmlaq_n_s32( vdupq_n_s32( s ), l, sstep );
+	int32x4_t tv = vmlaq_n_s32( vdupq_n_s32( t ), l, tstep );
 
-				if (r_turb_spancount > 1)
-				{
-					r_turb_sstep = (snext - r_turb_s) / (r_turb_spancount - 1);
-					r_turb_tstep = (tnext - r_turb_t) / (r_turb_spancount - 1);
-				}
-			}
+	vst1q_s32( ofs, vmlaq_n_s32( vshrq_n_s32( sv, 16 ), vshrq_n_s32( tv, 16 ), texwidth ));
 
-			r_turb_s = r_turb_s & ((CYCLE<<16)-1);
-			r_turb_t = r_turb_t & ((CYCLE<<16)-1);
+	sv = vaddq_s32( sv, vdupq_n_s32( sstep * 4 ));
+	tv = vaddq_s32( tv, vdupq_n_s32( tstep * 4 ));
+	vst1q_s32( ofs + 4, vmlaq_n_s32( vshrq_n_s32( sv, 16 ), vshrq_n_s32( tv, 16 ), texwidth ));
+}
 
-			D_DrawTurbulent8Span ();
+static void D_TileOffsets8( int *ofs, fixed16_t s, fixed16_t t, fixed16_t sstep, fixed16_t tstep )
+{
+	const int32_t lanes[4] = { 0, 1, 2, 3 };
+	int32x4_t l = vld1q_s32( lanes );
+	int32x4_t smask = vdupq_n_s32( 63 ), tmask = vdupq_n_s32( 63 << 6 );
+	int32x4_t sv = vmlaq_n_s32( vdupq_n_s32( s ), l, sstep );
+	int32x4_t tv = vmlaq_n_s32( vdupq_n_s32( t ), l, tstep );
 
-			r_turb_s = snext;
-			r_turb_t = tnext;
+	vst1q_s32( ofs, vorrq_s32( vandq_s32( vshrq_n_s32( sv, 16 ), smask ), vandq_s32( vshrq_n_s32( tv, 10 ), tmask )));
 
-		} while (count > 0);
+	sv = vaddq_s32( sv, vdupq_n_s32( sstep * 4 ));
+	tv = vaddq_s32( tv, vdupq_n_s32( tstep * 4 ));
+	vst1q_s32( ofs + 4, vorrq_s32( vandq_s32( vshrq_n_s32( sv, 16 ), smask ), vandq_s32( vshrq_n_s32( tv, 10 ), tmask )));
+}
 
-	} while ((pspan = pspan->pnext) != NULL);
+static int D_SpanZMask8( const short *pz, int izi, int izistep )
+{
+	const int32_t lanes[4] = { 0, 1, 2, 3 };
+	const uint16_t bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+	int32x4_t zv = vmlaq_n_s32( vdupq_n_s32( izi ), vld1q_s32( lanes ), izistep );
+	int16x4_t zlo = vqshrn_n_s32( zv, 16 );
+	int16x4_t zhi = vqshrn_n_s32( vaddq_s32( zv, vdupq_n_s32( izistep * 4 )), 16 );
+	uint16x8_t pass = vandq_u16( vcleq_s16( vld1q_s16( pz ), vcombine_s16( zlo, zhi )), vld1q_u16( bits ));
+	uint16x4_t sum = vadd_u16( vget_low_u16( pass ), vget_high_u16( pass ));
+
+	sum = vpadd_u16( sum, sum );
+	sum = vpadd_u16( sum, sum );
+
+	return vget_lane_u16( sum, 0 );
 }
+#endif // XASH_SIMD_NEON
+#endif // XASH_SIMD
 
 
 /*
 =============
-Turbulent8
+D_DrawTurbulentSpans
+
+warping water textures, scrolling textures use the blank
+turbulence table, so they're just flowing
 =============
 */
-void TurbulentZ8 (espan_t *pspan, int alpha1)
+void D_DrawTurbulentSpans (const spanstate_t *st, espan_t *pspan)
 {
-	int				count;
-	fixed16_t		snext, tnext;
+	int				count, spancount, sturb, tturb;
+	pixel_t			*pbase, *pdest;
+	const int		*turb;
+	fixed16_t		s, t, snext, tnext, sstep, tstep;
 	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
 	float			sdivz16stepu, tdivz16stepu, zi16stepu;
-	alpha = alpha1;
-
-	if( alpha > 7 )
-		alpha = 7;
-	if( alpha == 0 )
-		return;
+#if XASH_SIMD
+	// only flowing textures, warp offsets depend on the turbulence table
+	qboolean		simd = SW_SIMD && st->turb == blanktable;
+#endif
 
-	r_turb_turb = sintable + ((int)(gpGlobals->time*SPEED)&(CYCLE-1));
+	turb = st->turb;
 
-	r_turb_sstep = 0;	// keep compiler happy
-	r_turb_tstep = 0;	// ditto
+	sstep = 0;	// keep compiler happy
+	tstep = 0;	// ditto
 
-	r_turb_pbase = cacheblock;
+	pbase = st->cacheblock;
 
-	sdivz16stepu = d_sdivzstepu * 16;
-	tdivz16stepu = d_tdivzstepu * 16;
-	zi16stepu = d_zistepu * 16;
-	r_turb_izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+	sdivz16stepu = st->sdivzstepu * 16;
+	tdivz16stepu = st->tdivzstepu * 16;
+	zi16stepu = st->zistepu * 16;
 
 	do
 	{
-		r_turb_pdest = (d_viewbuffer +
+		pdest = (d_viewbuffer +
 				(r_screenwidth * pspan->v) + pspan->u);
-		r_turb_pz = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
 
 		count = pspan->count;
 
@@ -263,33 +231,32 @@ void TurbulentZ8 (espan_t *pspan, int alpha1)
 		du = (float)pspan->u;
 		dv = (float)pspan->v;
 
-		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
-		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
-		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		sdivz = st->sdivzorigin + dv*st->sdivzstepv + du*st->sdivzstepu;
+		tdivz = st->tdivzorigin + dv*st->tdivzstepv + du*st->tdivzstepu;
+		zi = st->ziorigin + dv*st->zistepv + du*st->zistepu;
 		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
-		r_turb_izi = (int)(zi * 0x8000 * 0x10000);
 
-		r_turb_s = (int)(sdivz * z) + sadjust;
-		if (r_turb_s > bbextents)
-			r_turb_s = bbextents;
-		else if (r_turb_s < 0)
-			r_turb_s = 0;
+		s = (int)(sdivz * z) + st->sadjust;
+		if (s > st->bbextents)
+			s = st->bbextents;
+		else if (s < 0)
+			s = 0;
 
-		r_turb_t = (int)(tdivz * z) + tadjust;
-		if (r_turb_t > bbextentt)
-			r_turb_t = bbextentt;
-		else if (r_turb_t < 0)
-			r_turb_t = 0;
+		t = (int)(tdivz * z) + st->tadjust;
+		if (t > st->bbextentt)
+			t = st->bbextentt;
+		else if (t < 0)
+			t = 0;
 
 		do
 		{
 		// calculate s and t at the far end of the span
 			if (count >= 16)
-				r_turb_spancount = 16;
+				spancount = 16;
 			else
-				r_turb_spancount = count;
+				spancount = count;
 
-			count -= r_turb_spancount;
+			count -= spancount;
 
 			if (count)
 			{
@@ -300,22 +267,22 @@ void TurbulentZ8 (espan_t *pspan, int alpha1)
 				zi += zi16stepu;
 				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
 
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
+				snext = (int)(sdivz * z) + st->sadjust;
+				if (snext > st->bbextents)
+					snext = st->bbextents;
 				else if (snext < 16)
 					snext = 16;	// prevent round-off error on <0 steps from
 								//  from causing overstepping & running off the
 								//  edge of the texture
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
+				tnext = (int)(tdivz * z) + st->tadjust;
+				if (tnext > st->bbextentt)
+					tnext = st->bbextentt;
 				else if (tnext < 16)
 					tnext = 16;	// guard against round-off error on <0 steps
 
-				r_turb_sstep = (snext - r_turb_s) >> 4;
-				r_turb_tstep = (tnext - r_turb_t) >> 4;
+				sstep = (snext - s) >> 4;
+				tstep = (tnext - t) >> 4;
 			}
 			else
 			{
@@ -323,40 +290,60 @@ void TurbulentZ8 (espan_t *pspan, int alpha1)
 			// can't step off polygon), clamp, calculate s and t steps across
 			// span by division, biasing steps low so we don't run off the
 			// texture
-				spancountminus1 = (float)(r_turb_spancount - 1);
-				sdivz += d_sdivzstepu * spancountminus1;
-				tdivz += d_tdivzstepu * spancountminus1;
-				zi += d_zistepu * spancountminus1;
-
+				spancountminus1 = (float)(spancount - 1);
+				sdivz += st->sdivzstepu * spancountminus1;
+				tdivz += st->tdivzstepu * spancountminus1;
+				zi += st->zistepu * spancountminus1;
 				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
+				snext = (int)(sdivz * z) + st->sadjust;
+				if (snext > st->bbextents)
+					snext = st->bbextents;
 				else if (snext < 16)
 					snext = 16;	// prevent round-off error on <0 steps from
 								//  from causing overstepping & running off the
 								//  edge of the texture
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
+				tnext = (int)(tdivz * z) + st->tadjust;
+				if (tnext > st->bbextentt)
+					tnext = st->bbextentt;
 				else if (tnext < 16)
 					tnext = 16;	// guard against round-off error on <0 steps
 
-				if (r_turb_spancount > 1)
+				if (spancount > 1)
 				{
-					r_turb_sstep = (snext - r_turb_s) / (r_turb_spancount - 1);
-					r_turb_tstep = (tnext - r_turb_t) / (r_turb_spancount - 1);
+					sstep = (snext - s) / (spancount - 1);
+					tstep = (tnext - t) / (spancount - 1);
 				}
 			}
 
-			r_turb_s = r_turb_s & ((CYCLE<<16)-1);
-			r_turb_t = r_turb_t & ((CYCLE<<16)-1);
+			s = s & ((CYCLE<<16)-1);
+			t = t & ((CYCLE<<16)-1);
 
-			D_DrawTurbulent8ZSpan ();
+#if XASH_SIMD
+			if (simd && spancount == 16)
+			{
+				int ofs[16], i;
 
-			r_turb_s = snext;
-			r_turb_t = tnext;
+				D_TileOffsets8 (ofs, s, t, sstep, tstep);
+				D_TileOffsets8 (ofs + 8, s + sstep * 8, t + tstep * 8, sstep, tstep);
+				for (i = 0; i < 16; i++)
+					pdest[i] = pbase[ofs[i]];
+
+				pdest += 16;
+			}
+			else
+#endif
+			do
+			{
+				sturb = ((s + turb[(t>>16)&(CYCLE-1)])>>16)&63;
+				tturb = ((t + turb[(s>>16)&(CYCLE-1)])>>16)&63;
+				*pdest++ = *(pbase + (tturb<<6) + sturb);
+				s += sstep;
+				t += tstep;
+			} while (--spancount > 0);
+
+			s = snext;
+			t = tnext;
 
 		} while (count > 0);
 
@@ -364,24 +351,25 @@ void TurbulentZ8 (espan_t *pspan, int alpha1)
 }
 
 
-
-//====================
-//PGM
 /*
 =============
-NonTurbulent8 - this is for drawing scrolling textures. they're warping water textures
-	but the turbulence is automatically 0.
+Turbulent8
 =============
 */
-void NonTurbulent8 (espan_t *pspan)
+void TurbulentZ8 (espan_t *pspan, int alpha1)
 {
 	int				count;
 	fixed16_t		snext, tnext;
 	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
 	float			sdivz16stepu, tdivz16stepu, zi16stepu;
+	alpha = alpha1;
+
+	if( alpha > 7 )
+		alpha = 7;
+	if( alpha == 0 )
+		return;
 
-//	r_turb_turb = sintable + ((int)(r_newrefdef.time*SPEED)&(CYCLE-1));
-	r_turb_turb = blanktable;
+	r_turb_turb = sintable + ((int)(gpGlobals->time*SPEED)&(CYCLE-1));
 
 	r_turb_sstep = 0;	// keep compiler happy
 	r_turb_tstep = 0;	// ditto
@@ -391,11 +379,13 @@ void NonTurbulent8 (espan_t *pspan)
 	sdivz16stepu = d_sdivzstepu * 16;
 	tdivz16stepu = d_tdivzstepu * 16;
 	zi16stepu = d_zistepu * 16;
+	r_turb_izistep = (int)(d_zistepu * 0x8000 * 0x10000);
 
 	do
 	{
 		r_turb_pdest = (d_viewbuffer +
 				(r_screenwidth * pspan->v) + pspan->u);
+		r_turb_pz = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
 
 		count = pspan->count;
 
@@ -407,6 +397,7 @@ void NonTurbulent8 (espan_t *pspan)
 		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
 		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
 		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+		r_turb_izi = (int)(zi * 0x8000 * 0x10000);
 
 		r_turb_s = (int)(sdivz * z) + sadjust;
 		if (r_turb_s > bbextents)
@@ -466,6 +457,7 @@ void NonTurbulent8 (espan_t *pspan)
 				sdivz += d_sdivzstepu * spancountminus1;
 				tdivz += d_tdivzstepu * spancountminus1;
 				zi += d_zistepu * spancountminus1;
+
 				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
 				snext = (int)(sdivz * z) + sadjust;
 				if (snext > bbextents)
@@ -491,7 +483,7 @@ void NonTurbulent8 (espan_t *pspan)
 			r_turb_s = r_turb_s & ((CYCLE<<16)-1);
 			r_turb_t = r_turb_t & ((CYCLE<<16)-1);
 
-			D_DrawTurbulent8Span ();
+			D_DrawTurbulent8ZSpan ();
 
 			r_turb_s = snext;
 			r_turb_t = tnext;
@@ -500,8 +492,7 @@ void NonTurbulent8 (espan_t *pspan)
 
 	} while ((pspan = pspan->pnext) != NULL);
 }
-//PGM
-//====================
+
 
 
 #if	!id386
@@ -530,22 +521,26 @@ D_DrawSpans16
   FIXME: actually make this subdivide by 16 instead of 8!!!
 =============
 */
-void D_DrawSpans16 (espan_t *pspan)
+void D_DrawSpans16 (const spanstate_t *st, espan_t *pspan)
 {
 	int				count, spancount;
 	pixel_t	*pbase, *pdest;
 	fixed16_t		s, t, snext, tnext, sstep, tstep;
 	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
 	float			sdivz8stepu, tdivz8stepu, zi8stepu;
+	int				texwidth = st->cachewidth;
+#if XASH_SIMD
+	qboolean		simd = SW_SIMD && !SW_TEXFILT;
+#endif
 
 	sstep = 0;	// keep compiler happy
 	tstep = 0;	// ditto
 
-	pbase = cacheblock;
+	pbase = st->cacheblock;
 
-	sdivz8stepu = d_sdivzstepu * 8;
-	tdivz8stepu = d_tdivzstepu * 8;
-	zi8stepu = d_zistepu * 8;
+	sdivz8stepu = st->sdivzstepu * 8;
+	tdivz8stepu = st->tdivzstepu * 8;
+	zi8stepu = st->zistepu * 8;
 
 	do
 	{
@@ -558,20 +553,20 @@ void D_DrawSpans16 (espan_t *pspan)
 		du = (float)pspan->u;
 		dv = (float)pspan->v;
 
-		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
-		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
-		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		sdivz = st->sdivzorigin + dv*st->sdivzstepv + du*st->sdivzstepu;
+		tdivz = st->tdivzorigin + dv*st->tdivzstepv + du*st->tdivzstepu;
+		zi = st->ziorigin + dv*st->zistepv + du*st->zistepu;
 		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
 
-		s = (int)(sdivz * z) + sadjust;
-		if (s > bbextents)
-			s = bbextents;
+		s = (int)(sdivz * z) + st->sadjust;
+		if (s > st->bbextents)
+			s = st->bbextents;
 		else if (s < 0)
 			s = 0;
 
-		t = (int)(tdivz * z) + tadjust;
-		if (t > bbextentt)
-			t = bbextentt;
+		t = (int)(tdivz * z) + st->tadjust;
+		if (t > st->bbextentt)
+			t = st->bbextentt;
 		else if (t < 0)
 			t = 0;
 
@@ -594,17 +589,17 @@ void D_DrawSpans16 (espan_t *pspan)
 				zi += zi8stepu;
 				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
 
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
+				snext = (int)(sdivz * z) + st->sadjust;
+				if (snext > st->bbextents)
+					snext = st->bbextents;
 				else if (snext < 8)
 					snext = 8;	// prevent round-off error on <0 steps from
 								//  from causing overstepping & running off the
 								//  edge of the texture
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
+				tnext = (int)(tdivz * z) + st->tadjust;
+				if (tnext > st->bbextentt)
+					tnext = st->bbextentt;
 				else if (tnext < 8)
 					tnext = 8;	// guard against round-off error on <0 steps
 
@@ -618,21 +613,21 @@ void D_DrawSpans16 (espan_t *pspan)
 			  // span by division, biasing steps low so we don't run off the
 			  // texture
 				spancountminus1 = (float)(spancount - 1);
-				sdivz += d_sdivzstepu * spancountminus1;
-				tdivz += d_tdivzstepu * spancountminus1;
-				zi += d_zistepu * spancountminus1;
+				sdivz += st->sdivzstepu * spancountminus1;
+				tdivz += st->tdivzstepu * spancountminus1;
+				zi += st->zistepu * spancountminus1;
 				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
+				snext = (int)(sdivz * z) + st->sadjust;
+				if (snext > st->bbextents)
+					snext = st->bbextents;
 				else if (snext < 8)
 					snext = 8;	// prevent round-off error on <0 steps from
 								//  from causing overstepping & running off the
 								//  edge of the texture
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
+				tnext = (int)(tdivz * z) + st->tadjust;
+				if (tnext > st->bbextentt)
+					tnext = st->bbextentt;
 				else if (tnext < 8)
 					tnext = 8;	// guard against round-off error on <0 steps
 
@@ -645,11 +640,26 @@ void D_DrawSpans16 (espan_t *pspan)
 
 
 			// Drawing phrase
+#if XASH_SIMD
+				if (simd && spancount == 8)
+				{
+					int ofs[8], i;
+
+					D_SpanOffsets8 (ofs, s, t, sstep, tstep, texwidth);
+					for (i = 0; i < 8; i++)
+						pdest[i] = pbase[ofs[i]];
+
+					pdest += 8;
+					s += sstep * 8;
+					t += tstep * 8;
+				}
+				else
+#endif
 				if (!SW_TEXFILT)
 				{
 					do
 					{
-						*pdest++ = *(pbase + (s >> 16) + (t >> 16) * cachewidth);
+						*pdest++ = *(pbase + (s >> 16) + (t >> 16) * texwidth);
 						s += sstep;
 						t += tstep;
 					} while (--spancount > 0);
@@ -676,7 +686,7 @@ void D_DrawSpans16 (espan_t *pspan)
 						iditht = iditht ? iditht -1 : iditht;
 
 
-						*pdest++ = *(pbase + idiths + iditht * cachewidth);
+						*pdest++ = *(pbase + idiths + iditht * texwidth);
 						s += sstep;
 						t += tstep;
 					} while (--spancount > 0);
@@ -901,6 +911,9 @@ void D_BlendSpans16 (espan_t *pspan, int alpha)
 	float			sdivz8stepu, tdivz8stepu, zi8stepu;
 	int izi, izistep;
 	short *pz;
+#if XASH_SIMD
+	qboolean	simd = SW_SIMD && !SW_TEXFILT;
+#endif
 
 	if( alpha > 7 )
 		alpha = 7;
@@ -1017,6 +1030,38 @@ void D_BlendSpans16 (espan_t *pspan, int alpha)
 
 
 			// Drawing phrase
+#if XASH_SIMD
+				if (simd && spancount == 8)
+				{
+					int ofs[8], i, zmask;
+
+					zmask = D_SpanZMask8 (pz, izi, izistep);
+					D_SpanOffsets8 (ofs, s, t, sstep, tstep, cachewidth);
+					for (i = 0; i < 8; i++)
+					{
+						pixel_t btemp;
+
+						if (!(zmask & (1 << i)))
+							continue;
+
+						btemp = pbase[ofs[i]];
+
+						if( btemp != TRANSPARENT_COLOR )
+						{
+							if( alpha != 7 )
+								btemp = BLEND_ALPHA( alpha, btemp, pdest[i]);
+							pdest[i] = btemp;
+						}
+					}
+
+					pdest += 8;
+					pz += 8;
+					izi += izistep * 8;
+					s += sstep * 8;
+					t += tstep * 8;
+				}
+				else
+#endif
 				if (!SW_TEXFILT)
 				{
 					do
@@ -1108,6 +1153,9 @@ void D_AddSpans16 (espan_t *pspan)
 	float			sdivz8stepu, tdivz8stepu, zi8stepu;
 	int izi, izistep;
 	short *pz;
+#if XASH_SIMD
+	qboolean	simd = SW_SIMD && !SW_TEXFILT;
+#endif
 
 	sstep = 0;	// keep compiler happy
 	tstep = 0;	// ditto
@@ -1219,6 +1267,34 @@ void D_AddSpans16 (espan_t *pspan)
 
 
 			// Drawing phrase
+#if XASH_SIMD
+				if (simd && spancount == 8)
+				{
+					int ofs[8], i, zmask;
+
+					zmask = D_SpanZMask8 (pz, izi, izistep);
+					D_SpanOffsets8 (ofs, s, t, sstep, tstep, cachewidth);
+					for (i = 0; i < 8; i++)
+					{
+						pixel_t btemp;
+
+						if (!(zmask & (1 << i)))
+							continue;
+
+						btemp = pbase[ofs[i]];
+
+						if( btemp != TRANSPARENT_COLOR )
+							pdest[i] = BLEND_ADD( btemp, pdest[i]);
+					}
+
+					pdest += 8;
+					pz += 8;
+					izi += izistep * 8;
+					s += sstep * 8;
+					t += tstep * 8;
+				}
+				else
+#endif
 				if (!SW_TEXFILT)
 				{
 					do
@@ -1300,7 +1376,7 @@ void D_AddSpans16 (espan_t *pspan)
 D_DrawZSpans
 =============
 */
-void D_DrawZSpans (espan_t *pspan)
+void D_DrawZSpans (const spanstate_t *st, espan_t *pspan)
 {
 	int				count, doublecount, izistep;
 	int				izi;
@@ -1311,7 +1387,7 @@ void D_DrawZSpans (espan_t *pspan)
 
 // FIXME: check for clamping/range problems
 // we count on FP exceptions being turned off to avoid range problems
-	izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+	izistep = (int)(st->zistepu * 0x8000 * 0x10000);
 
 	do
 	{
@@ -1323,7 +1399,7 @@ void D_DrawZSpans (espan_t *pspan)
 		du = (float)pspan->u;
 		dv = (float)pspan->v;
 
-		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		zi = st->ziorigin + dv*st->zistepv + du*st->zistepu;
 	// we count on FP exceptions being turned off to avoid range problems
 		izi = (int)(zi * 0x8000 * 0x10000);
 
@@ -24,56 +24,73 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 drawsurf_t	r_drawsurf;
 
-uint				lightleft, sourcesstep, blocksize, sourcetstep;
-uint				lightdelta, lightdeltastep;
-uint				lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned		blockdivmask;
-void			*prowdestbase;
-pixel_t	*pbasesource;
-int				surfrowbytes;	// used by ASM files
-unsigned		*r_lightptr;
-int				r_stepback;
-int				r_lightwidth;
-int				r_numhblocks, r_numvblocks;
-pixel_t	*r_source, *r_sourcemax;
-
-void R_DrawSurfaceBlock8_mip0 (void);
-void R_DrawSurfaceBlock8_mip1 (void);
-void R_DrawSurfaceBlock8_mip2 (void);
-void R_DrawSurfaceBlock8_mip3 (void);
-void R_DrawSurfaceBlock8_Generic (void);
-void R_DrawSurfaceBlock8_World (void);
-
-static float worldlux_s, worldlux_t;
-
-static void	(*surfmiptable[4])(void) = {
+// state of one surface being lit and built, every build has its
+// own so the prepass can build several surfaces at once
+typedef struct
+{
+	const drawsurf_t	*ds;
+	uint		blocksize, sourcetstep;
+	int		surfrowbytes;
+	int		stepback;
+	int		lightwidth;
+	int		numvblocks;
+	float		worldlux_s, worldlux_t;
+	pixel_t		*prowdestbase;
+	pixel_t		*pbasesource;
+	pixel_t		*sourcemax;
+	unsigned	*lightptr;
+	unsigned	blocklights[10240];	// allow some very large lightmaps
+} surfbuild_t;
+
+static void R_DrawSurfaceBlock8_mip0 (surfbuild_t *sb);
+static void R_DrawSurfaceBlock8_mip1 (surfbuild_t *sb);
+static void R_DrawSurfaceBlock8_mip2 (surfbuild_t *sb);
+static void R_DrawSurfaceBlock8_mip3 (surfbuild_t *sb);
+static void R_DrawSurfaceBlock8_Generic (surfbuild_t *sb);
+static void R_DrawSurfaceBlock8_World (surfbuild_t *sb);
+
+static void	(*surfmiptable[4])(surfbuild_t *sb) = {
 	R_DrawSurfaceBlock8_mip0,
 	R_DrawSurfaceBlock8_mip1,
 	R_DrawSurfaceBlock8_mip2,
 	R_DrawSurfaceBlock8_mip3
 };
 
-//void R_BuildLightMap (void);
-extern	unsigned		blocklights[10240];	// allow some very large lightmaps
-
-float           surfscale;
 qboolean        r_cache_thrash;         // set if surface cache is thrashing
 
-int         sc_size;
-surfcache_t	*sc_rover, *sc_base;
+// surface cache is a buddy allocator, blocks have power of two sizes
+// from 1 << SC_MIN_ORDER up to the top block size and split or merge
+// with their buddy. Blocks in use are kept in LRU order, when there is
+// no free block of the needed size the least recently drawn are evicted
+#define SC_MIN_ORDER	8
+#define SC_MAX_ORDER	22
+
+int		sc_size;
+static byte	*sc_base;
+static int	sc_toporder;			// order of the largest blocks
+static surfcache_t	sc_free[SC_MAX_ORDER + 1];	// free lists per size class
+static surfcache_t	sc_lru;				// next is the most recently drawn
+
+// surfaces waiting to be built by the prepass
+static struct
+{
+	drawsurf_t	*builds;
+	int		numbuilds;
+	int		maxbuilds;
+} sc_queue;
 
 static int		rtable[MOD_FRAMES][MOD_FRAMES];
 
 #if 1
 
-static void R_BuildLightMap( void );
 /*
 ===============
 R_AddDynamicLights
 ===============
 */
-void R_AddDynamicLights( msurface_t *surf )
+static void R_AddDynamicLights( surfbuild_t *sb )
 {
+	msurface_t	*surf = sb->ds->surf;
 	float		dist, rad, minlight;
 	int		lnum, s, t, sd, td, smax, tmax;
 	float		sl, tl, sacc, tacc;
@@ -110,8 +127,8 @@ void R_AddDynamicLights( msurface_t *surf )
 		dl = gEngfuncs.GetDynamicLight( lnum );
 
 		// transform light origin to local bmodel space
-		if( !tr.modelviewIdentity )
-			Matrix4x4_VectorITransform( RI.objectMatrix, dl->origin, origin_l );
+		if( !sb->ds->lightidentity )
+			Matrix4x4_VectorITransform( sb->ds->lightmatrix, dl->origin, origin_l );
 		else
 			VectorCopy( dl->origin, origin_l );
 
@@ -135,7 +152,7 @@ void R_AddDynamicLights( msurface_t *surf )
 
 		sl = DotProduct( impact, info->lmvecs[0] ) + info->lmvecs[0][3] - info->lightmapmins[0];
 		tl = DotProduct( impact, info->lmvecs[1] ) + info->lmvecs[1][3] - info->lightmapmins[1];
-		bl = blocklights;
+		bl = sb->blocklights;
 
 		for( t = 0, tacc = 0; t < tmax; t++, tacc += sample_size )
 		{
@@ -172,13 +189,14 @@ Combine and scale multiple lightmaps into the floating
 format in r_blocklights
 =================
 */
-static void R_BuildLightMap( void )
+static void R_BuildLightMap( surfbuild_t *sb )
 {
 	int		smax, tmax;
 	uint		*bl, scale;
 	int		i, map, size, s, t;
 	int		sample_size;
-	msurface_t *surf = r_drawsurf.surf;
+	msurface_t *surf = sb->ds->surf;
+	uint		*blocklights = sb->blocklights;
 	mextrasurf_t	*info = surf->info;
 	color24		*lm;
 	qboolean dynamic = 0;
@@ -223,7 +241,7 @@ static void R_BuildLightMap( void )
 
 	// add all the dynamic lights
 	if( surf->dlightframe == tr.framecount )
-		R_AddDynamicLights( surf );
+		R_AddDynamicLights( sb );
 
 	// Put into texture format
 	//stride -= (smax << 2);
@@ -476,21 +494,25 @@ texture_t *R_TextureAnimation( msurface_t *s )
 R_DrawSurface
 ===============
 */
-void R_DrawSurface (void)
+static void R_DrawSurface (surfbuild_t *sb)
 {
+	const drawsurf_t *ds = sb->ds;
 	pixel_t	*basetptr;
 	int				smax, tmax, twidth;
 	int				u;
 	int				soffset, basetoffset, texwidth;
 	int				horzblockstep;
 	pixel_t	*pcolumndest;
-	void			(*pblockdrawer)(void);
+	void			(*pblockdrawer)(surfbuild_t *sb);
 	image_t			*mt;
 	uint sample_size, sample_bits, sample_pot;
+	uint			blockdivshift;
+	int			numhblocks;
+	pixel_t		*source;
 
-	surfrowbytes = r_drawsurf.rowbytes;
+	sb->surfrowbytes = ds->rowbytes;
 
-	sample_size = LM_SAMPLE_SIZE_AUTO(r_drawsurf.surf);
+	sample_size = LM_SAMPLE_SIZE_AUTO(ds->surf);
 	if( sample_size == 16 )
 		sample_bits = 4, sample_pot = sample_size;
 	else
@@ -505,78 +527,77 @@ void R_DrawSurface (void)
 		else
 			sample_pot = 1 << sample_bits;
 	}
-	mt = r_drawsurf.image;
+	mt = ds->image;
 
-	r_source = mt->pixels[r_drawsurf.surfmip];
+	source = mt->pixels[ds->surfmip];
 
 // the fractional light values should range from 0 to (VID_GRADES - 1) << 16
 // from a source range of 0 - 255
 
-	texwidth = mt->width >> r_drawsurf.surfmip;
+	texwidth = mt->width >> ds->surfmip;
 
-	blocksize = sample_pot >> r_drawsurf.surfmip;
-	blockdivshift = sample_bits - r_drawsurf.surfmip;
-	blockdivmask = (1 << blockdivshift) - 1;
+	sb->blocksize = sample_pot >> ds->surfmip;
+	blockdivshift = sample_bits - ds->surfmip;
 
 	if( sample_size == 16 )
-		r_lightwidth = ( r_drawsurf.surf->info->lightextents[0]>>4)+1;
+		sb->lightwidth = ( ds->surf->info->lightextents[0]>>4)+1;
 	else
-		r_lightwidth = ( r_drawsurf.surf->info->lightextents[0] / sample_size ) + 1;
+		sb->lightwidth = ( ds->surf->info->lightextents[0] / sample_size ) + 1;
 
-	r_numhblocks = r_drawsurf.surfwidth >> blockdivshift;
-	r_numvblocks = r_drawsurf.surfheight >> blockdivshift;
+	numhblocks = ds->surfwidth >> blockdivshift;
+	sb->numvblocks = ds->surfheight >> blockdivshift;
 
 
 //==============================
 
 	if( sample_size == 16 )
-		pblockdrawer = surfmiptable[r_drawsurf.surfmip];
+		pblockdrawer = surfmiptable[ds->surfmip];
 	else
 		pblockdrawer = R_DrawSurfaceBlock8_Generic;
 
 // TODO: only needs to be set when there is a display settings change
-	horzblockstep = blocksize;
+	horzblockstep = sb->blocksize;
 
-	smax = mt->width >> r_drawsurf.surfmip;
+	smax = mt->width >> ds->surfmip;
 	twidth = texwidth;
-	tmax = mt->height >> r_drawsurf.surfmip;
-	sourcetstep = texwidth;
-	r_stepback = tmax * twidth;
+	tmax = mt->height >> ds->surfmip;
+	sb->sourcetstep = texwidth;
+	sb->stepback = tmax * twidth;
 
-	r_sourcemax = r_source + (tmax * smax);
+	sb->sourcemax = source + (tmax * smax);
 
 	// glitchy and slow way to draw some lightmap
-	if( r_drawsurf.surf->texinfo->flags & TEX_WORLD_LUXELS )
+	if( ds->surf->texinfo->flags & TEX_WORLD_LUXELS )
 	{
-		worldlux_s = r_drawsurf.surf->extents[0] / r_drawsurf.surf->info->lightextents[0];
-		worldlux_t = r_drawsurf.surf->extents[1] / r_drawsurf.surf->info->lightextents[1];
-		if( worldlux_s == 0 )
-			worldlux_s = 1;
-		if( worldlux_t == 0 )
-			worldlux_t = 1;
-
-		soffset = r_drawsurf.surf->texturemins[0];
-		basetoffset = r_drawsurf.surf->texturemins[1];
-		//soffset =  r_drawsurf.surf->info->lightmapmins[0] * worldlux_s;
-		//basetoffset = r_drawsurf.surf->info->lightmapmins[1] * worldlux_t;
+		sb->worldlux_s = ds->surf->extents[0] / ds->surf->info->lightextents[0];
+		sb->worldlux_t = ds->surf->extents[1] / ds->surf->info->lightextents[1];
+		if( sb->worldlux_s == 0 )
+			sb->worldlux_s = 1;
+		if( sb->worldlux_t == 0 )
+			sb->worldlux_t = 1;
+
+		soffset = ds->surf->texturemins[0];
+		basetoffset = ds->surf->texturemins[1];
+		//soffset =  ds->surf->info->lightmapmins[0] * sb->worldlux_s;
+		//basetoffset = ds->surf->info->lightmapmins[1] * sb->worldlux_t;
 		// << 16 components are to guarantee positive values for %
-		soffset = ((soffset >> r_drawsurf.surfmip) + (smax << 16)) % smax;
-		basetptr = &r_source[((((basetoffset >> r_drawsurf.surfmip)
+		soffset = ((soffset >> ds->surfmip) + (smax << 16)) % smax;
+		basetptr = &source[((((basetoffset >> ds->surfmip)
 			+ (tmax << 16)) % tmax) * twidth)];
 
-		pcolumndest = r_drawsurf.surfdat;
+		pcolumndest = ds->surfdat;
 
-		for (u=0 ; u<r_numhblocks; u++)
+		for (u=0 ; u<numhblocks; u++)
 		{
-			r_lightptr = blocklights + (int)(u/ (worldlux_s+0.5f));
+			sb->lightptr = sb->blocklights + (int)(u/ (sb->worldlux_s+0.5f));
 
-			prowdestbase = pcolumndest;
+			sb->prowdestbase = pcolumndest;
 
-			pbasesource = basetptr + soffset;
+			sb->pbasesource = basetptr + soffset;
 
-			R_DrawSurfaceBlock8_World();
+			R_DrawSurfaceBlock8_World( sb );
 
-			soffset = soffset + blocksize;
+			soffset = soffset + sb->blocksize;
 			if (soffset >= smax)
 				soffset = 0;
 
@@ -585,27 +606,27 @@ void R_DrawSurface (void)
 		return;
 	}
 
-	soffset =  r_drawsurf.surf->info->lightmapmins[0];
-	basetoffset = r_drawsurf.surf->info->lightmapmins[1];
+	soffset =  ds->surf->info->lightmapmins[0];
+	basetoffset = ds->surf->info->lightmapmins[1];
 
 // << 16 components are to guarantee positive values for %
-	soffset = ((soffset >> r_drawsurf.surfmip) + (smax << 16)) % smax;
-	basetptr = &r_source[((((basetoffset >> r_drawsurf.surfmip)
+	soffset = ((soffset >> ds->surfmip) + (smax << 16)) % smax;
+	basetptr = &source[((((basetoffset >> ds->surfmip)
 		+ (tmax << 16)) % tmax) * twidth)];
 
-	pcolumndest = r_drawsurf.surfdat;
+	pcolumndest = ds->surfdat;
 
-	for (u=0 ; u<r_numhblocks; u++)
+	for (u=0 ; u<numhblocks; u++)
 	{
-		r_lightptr = blocklights + u;
+		sb->lightptr = sb->blocklights + u;
 
-		prowdestbase = pcolumndest;
+		sb->prowdestbase = pcolumndest;
 
-		pbasesource = basetptr + soffset;
+		sb->pbasesource = basetptr + soffset;
 
-		(*pblockdrawer)();
+		(*pblockdrawer)( sb );
 
-		soffset = soffset + blocksize;
+		soffset = soffset + sb->blocksize;
 		if (soffset >= smax)
 			soffset = 0;
 
@@ -621,6 +642,78 @@ void R_DrawSurface (void)
 #if	!id386
 #define BLEND_LM(pix, light) vid.colormap[(pix >> 3) | ((light & 0x1f00) << 5)] | ( pix & 7 );
 
+#if XASH_SIMD
+/*
+================
+R_LightRowSIMD
+
+same as the row loops below for count divisible by 8, pixel b
+gets light + ( count - 1 - b ) * lightstep. Colormap indices are
+computed in vector lanes, only the colormap reads stay scalar
+================
+*/
+static void R_LightRowSIMD( pixel_t *prowdest, const pixel_t *psource, int count, uint light, uint lightstep, qboolean transparent )
+{
+	int idx[8], b;
+
+	for( b = 0; b < count; b += 8 )
+	{
+		uint lightb = light + ( count - 1 - b ) * lightstep;
+#if XASH_SIMD_SSE2
+		__m128i p = _mm_loadu_si128( (const __m128i *)( psource + b ));
+		__m128i p3 = _mm_srli_epi16( p, 3 );
+		__m128i mask = _mm_set1_epi32( 0x1f00 ), zero = _mm_setzero_si128();
+		__m128i l = _mm_sub_epi32( _mm_set1_epi32( lightb ), _mm_setr_epi32( 0, lightstep, lightstep * 2, lightstep * 3 ));
+		__m128i d, trans;
+
+		_mm_storeu_si128( (__m128i *)idx, _mm_or_si128( _mm_unpacklo_epi16( p3, zero ), _mm_slli_epi32( _mm_and_si128( l, mask ), 5 )));
+		l = _mm_sub_epi32( l, _mm_set1_epi32( lightstep * 4 ));
+		_mm_storeu_si128( (__m128i *)( idx + 4 ), _mm_or_si128( _mm_unpackhi_epi16( p3, zero ), _mm_slli_epi32( _mm_and_si128( l, mask ), 5 )));
+
+		d = _mm_cvtsi32_si128( vid.colormap[idx[0]] );
+		d = _mm_insert_epi16( d, vid.colormap[idx[1]], 1 );
+		d = _mm_insert_epi16( d, vid.colormap[idx[2]], 2 );
+		d = _mm_insert_epi16( d, vid.colormap[idx[3]], 3 );
+		d = _mm_insert_epi16( d, vid.colormap[idx[4]], 4 );
+		d = _mm_insert_epi16( d, vid.colormap[idx[5]], 5 );
+		d = _mm_insert_epi16( d, vid.colormap[idx[6]], 6 );
+		d = _mm_insert_epi16( d, vid.colormap[idx[7]], 7 );
+		d = _mm_or_si128( d, _mm_and_si128( p, _mm_set1_epi16( 7 )));
+		if( transparent )
+		{
+			trans = _mm_cmpeq_epi16( p, _mm_set1_epi16( TRANSPARENT_COLOR ));
+			d = _mm_or_si128( _mm_andnot_si128( trans, d ), _mm_and_si128( trans, _mm_set1_epi16( TRANSPARENT_COLOR )));
+		}
+		_mm_storeu_si128( (__m128i *)( prowdest + b ), d );
+#elif XASH_SIMD_NEON
+		const uint32_t lanes[4] = { 0, 1, 2, 3 };
+		uint16x8_t p = vld1q_u16( psource + b );
+		uint16x8_t p3 = vshrq_n_u16( p, 3 );
+		uint32x4_t mask = vdupq_n_u32( 0x1f00 );
+		uint32x4_t l = vmlsq_n_u32( vdupq_n_u32( lightb ), vld1q_u32( lanes ), lightstep );
+		uint16x8_t d;
+
+		vst1q_u32( (uint32_t *)idx, vorrq_u32( vmovl_u16( vget_low_u16( p3 )), vshlq_n_u32( vandq_u32( l, mask ), 5 )));
+		l = vsubq_u32( l, vdupq_n_u32( lightstep * 4 ));
+		vst1q_u32( (uint32_t *)( idx + 4 ), vorrq_u32( vmovl_u16( vget_high_u16( p3 )), vshlq_n_u32( vandq_u32( l, mask ), 5 )));
+
+		d = vdupq_n_u16( vid.colormap[idx[0]] );
+		d = vsetq_lane_u16( vid.colormap[idx[1]], d, 1 );
+		d = vsetq_lane_u16( vid.colormap[idx[2]], d, 2 );
+		d = vsetq_lane_u16( vid.colormap[idx[3]], d, 3 );
+		d = vsetq_lane_u16( vid.colormap[idx[4]], d, 4 );
+		d = vsetq_lane_u16( vid.colormap[idx[5]], d, 5 );
+		d = vsetq_lane_u16( vid.colormap[idx[6]], d, 6 );
+		d = vsetq_lane_u16( vid.colormap[idx[7]], d, 7 );
+		d = vorrq_u16( d, vandq_u16( p, vdupq_n_u16( 7 )));
+		if( transparent )
+			d = vbslq_u16( vceqq_u16( p, vdupq_n_u16( TRANSPARENT_COLOR )), vdupq_n_u16( TRANSPARENT_COLOR ), d );
+		vst1q_u16( prowdest + b, d );
+#endif
+	}
+}
+#endif // XASH_SIMD
+
 /*
 ================
 R_DrawSurfaceBlock8_World
@@ -628,36 +721,46 @@ R_DrawSurfaceBlock8_World
 Does not draw lightmap correclty, but scale it correctly. Better than nothing
 ================
 */
-void R_DrawSurfaceBlock8_World (void)
+static void R_DrawSurfaceBlock8_World (surfbuild_t *sb)
 {
 	int				v, i, b;
 	uint lightstep, lighttemp, light;
+	uint lightleft, lightright, lightleftstep, lightrightstep;
 	pixel_t	pix, *psource, *prowdest;
+	unsigned *lightptr = sb->lightptr;
+	uint blocksize = sb->blocksize;
+#if XASH_SIMD
+	qboolean simd = SW_SIMD && !( blocksize & 7 );
+#endif
 	int lightpos = 0;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[(lightpos/r_lightwidth) * r_lightwidth];
-		lightright = r_lightptr[(lightpos/r_lightwidth) * r_lightwidth+1];
-		lightpos += r_lightwidth / worldlux_s;
-		lightleftstep = (r_lightptr[(lightpos/r_lightwidth) * r_lightwidth] - lightleft) >> (4-r_drawsurf.surfmip);
-		lightrightstep =(r_lightptr[(lightpos/r_lightwidth) * r_lightwidth+1] - lightright) >> (4-r_drawsurf.surfmip);
+		lightleft = lightptr[(lightpos/sb->lightwidth) * sb->lightwidth];
+		lightright = lightptr[(lightpos/sb->lightwidth) * sb->lightwidth+1];
+		lightpos += sb->lightwidth / sb->worldlux_s;
+		lightleftstep = (lightptr[(lightpos/sb->lightwidth) * sb->lightwidth] - lightleft) >> (4-sb->ds->surfmip);
+		lightrightstep =(lightptr[(lightpos/sb->lightwidth) * sb->lightwidth+1] - lightright) >> (4-sb->ds->surfmip);
 
 		for (i=0 ; i<blocksize ; i++)
 		{
 			lighttemp = lightleft - lightright;
-			lightstep = lighttemp >> (4-r_drawsurf.surfmip);
+			lightstep = lighttemp >> (4-sb->ds->surfmip);
 
 			light = lightright;
 
+#if XASH_SIMD
+			if( simd )
+				R_LightRowSIMD( prowdest, psource, blocksize, light, lightstep, true );
+			else
+#endif
 			for (b=blocksize-1; b>=0; b--)
 			{
-				//pix = psource[(uint)(b * worldlux_s)];
+				//pix = psource[(uint)(b * sb->worldlux_s)];
 				pix = psource[b];
 				prowdest[b] = BLEND_LM(pix, light);
 				if( pix == TRANSPARENT_COLOR )
@@ -667,14 +770,14 @@ void R_DrawSurfaceBlock8_World (void)
 				light += lightstep;
 			}
 
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowbytes;
+			prowdest += sb->surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -684,32 +787,42 @@ void R_DrawSurfaceBlock8_World (void)
 R_DrawSurfaceBlock8_Generic
 ================
 */
-void R_DrawSurfaceBlock8_Generic (void)
+static void R_DrawSurfaceBlock8_Generic (surfbuild_t *sb)
 {
 	int				v, i, b;
 	uint lightstep, lighttemp, light;
+	uint lightleft, lightright, lightleftstep, lightrightstep;
 	pixel_t	pix, *psource, *prowdest;
+	unsigned *lightptr = sb->lightptr;
+	uint blocksize = sb->blocksize;
+#if XASH_SIMD
+	qboolean simd = SW_SIMD && !( blocksize & 7 );
+#endif
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> (4-r_drawsurf.surfmip);
-		lightrightstep = (r_lightptr[1] - lightright) >> (4-r_drawsurf.surfmip);
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += sb->lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> (4-sb->ds->surfmip);
+		lightrightstep = (lightptr[1] - lightright) >> (4-sb->ds->surfmip);
 
 		for (i=0 ; i<blocksize ; i++)
 		{
 			lighttemp = lightleft - lightright;
-			lightstep = lighttemp >> (4-r_drawsurf.surfmip);
+			lightstep = lighttemp >> (4-sb->ds->surfmip);
 
 			light = lightright;
 
+#if XASH_SIMD
+			if( simd )
+				R_LightRowSIMD( prowdest, psource, blocksize, light, lightstep, true );
+			else
+#endif
 			for (b=blocksize-1; b>=0; b--)
 			{
 				pix = psource[b];
@@ -721,14 +834,14 @@ void R_DrawSurfaceBlock8_Generic (void)
 				light += lightstep;
 			}
 
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowbytes;
+			prowdest += sb->surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -738,24 +851,28 @@ void R_DrawSurfaceBlock8_Generic (void)
 R_DrawSurfaceBlock8_mip0
 ================
 */
-void R_DrawSurfaceBlock8_mip0 (void)
+static void R_DrawSurfaceBlock8_mip0 (surfbuild_t *sb)
 {
 	int				v, i, b;
 	uint lightstep, lighttemp, light;
+	uint lightleft, lightright, lightleftstep, lightrightstep;
 	pixel_t	pix, *psource, *prowdest;
+	unsigned *lightptr = sb->lightptr;
+#if XASH_SIMD
+	qboolean simd = SW_SIMD;
+#endif
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 4;
-		lightrightstep = (r_lightptr[1] - lightright) >> 4;
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += sb->lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 4;
+		lightrightstep = (lightptr[1] - lightright) >> 4;
 
 		for (i=0 ; i<16 ; i++)
 		{
@@ -764,6 +881,11 @@ void R_DrawSurfaceBlock8_mip0 (void)
 
 			light = lightright;
 
+#if XASH_SIMD
+			if( simd )
+				R_LightRowSIMD( prowdest, psource, 16, light, lightstep, true );
+			else
+#endif
 			for (b=15; b>=0; b--)
 			{
 				pix = psource[b];
@@ -777,14 +899,14 @@ void R_DrawSurfaceBlock8_mip0 (void)
 				light += lightstep;
 			}
 
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowbytes;
+			prowdest += sb->surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -794,24 +916,28 @@ void R_DrawSurfaceBlock8_mip0 (void)
 R_DrawSurfaceBlock8_mip1
 ================
 */
-void R_DrawSurfaceBlock8_mip1 (void)
+static void R_DrawSurfaceBlock8_mip1 (surfbuild_t *sb)
 {
 	int				v, i, b;
 	uint lightstep, lighttemp, light;
+	uint lightleft, lightright, lightleftstep, lightrightstep;
 	pixel_t	pix, *psource, *prowdest;
+	unsigned *lightptr = sb->lightptr;
+#if XASH_SIMD
+	qboolean simd = SW_SIMD;
+#endif
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 3;
-		lightrightstep = (r_lightptr[1] - lightright) >> 3;
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += sb->lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 3;
+		lightrightstep = (lightptr[1] - lightright) >> 3;
 
 		for (i=0 ; i<8 ; i++)
 		{
@@ -820,6 +946,11 @@ void R_DrawSurfaceBlock8_mip1 (void)
 
 			light = lightright;
 
+#if XASH_SIMD
+			if( simd )
+				R_LightRowSIMD( prowdest, psource, 8, light, lightstep, false );
+			else
+#endif
 			for (b=7; b>=0; b--)
 			{
 				pix = psource[b];
@@ -829,14 +960,14 @@ void R_DrawSurfaceBlock8_mip1 (void)
 				light += lightstep;
 			}
 
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowbytes;
+			prowdest += sb->surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -846,24 +977,25 @@ void R_DrawSurfaceBlock8_mip1 (void)
 R_DrawSurfaceBlock8_mip2
 ================
 */
-void R_DrawSurfaceBlock8_mip2 (void)
+static void R_DrawSurfaceBlock8_mip2 (surfbuild_t *sb)
 {
 	int				v, i, b;
 	uint lightstep, lighttemp, light;
+	uint lightleft, lightright, lightleftstep, lightrightstep;
 	pixel_t	pix, *psource, *prowdest;
+	unsigned *lightptr = sb->lightptr;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 2;
-		lightrightstep = (r_lightptr[1] - lightright) >> 2;
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += sb->lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 2;
+		lightrightstep = (lightptr[1] - lightright) >> 2;
 
 		for (i=0 ; i<4 ; i++)
 		{
@@ -881,14 +1013,14 @@ void R_DrawSurfaceBlock8_mip2 (void)
 				light += lightstep;
 			}
 
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowbytes;
+			prowdest += sb->surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -898,24 +1030,25 @@ void R_DrawSurfaceBlock8_mip2 (void)
 R_DrawSurfaceBlock8_mip3
 ================
 */
-void R_DrawSurfaceBlock8_mip3 (void)
+static void R_DrawSurfaceBlock8_mip3 (surfbuild_t *sb)
 {
 	int				v, i, b;
 	uint lightstep, lighttemp, light;
+	uint lightleft, lightright, lightleftstep, lightrightstep;
 	pixel_t	pix, *psource, *prowdest;
+	unsigned *lightptr = sb->lightptr;
 
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = sb->pbasesource;
+	prowdest = sb->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<sb->numvblocks ; v++)
 	{
-	// FIXME: make these locals?
 	// FIXME: use delta rather than both right and left, like ASM?
-		lightleft = r_lightptr[0];
-		lightright = r_lightptr[1];
-		r_lightptr += r_lightwidth;
-		lightleftstep = (r_lightptr[0] - lightleft) >> 1;
-		lightrightstep = (r_lightptr[1] - lightright) >> 1;
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += sb->lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 1;
+		lightrightstep = (lightptr[1] - lightright) >> 1;
 
 		for (i=0 ; i<2 ; i++)
 		{
@@ -933,14 +1066,14 @@ void R_DrawSurfaceBlock8_mip3 (void)
 				light += lightstep;
 			}
 
-			psource += sourcetstep;
+			psource += sb->sourcetstep;
 			lightright += lightrightstep;
 			lightleft += lightleftstep;
-			prowdest += surfrowbytes;
+			prowdest += sb->surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= sb->sourcemax)
+			psource -= sb->stepback;
 	}
 }
 
@@ -973,27 +1106,103 @@ void R_InitCaches (void)
 		pix = vid.width * vid.height * 2;
 		if (pix > 64000)
 			size += (pix-64000)*3;
+
+		// blocks are rounded up to power of two sizes,
+		// a quarter of every block is unused on average
+		size += size / 3;
 	}
 
-	// round up to page size
-	size = (size + 8191) & ~8191;
+	// largest blocks can't be larger than the cache
+	for (sc_toporder = SC_MAX_ORDER; sc_toporder > SC_MIN_ORDER && (1 << sc_toporder) > size; sc_toporder--);
+
+	// round up to the largest block size
+	size = (size + (1 << sc_toporder) - 1) & ~((1 << sc_toporder) - 1);
 
 	gEngfuncs.Con_Printf ("%s surface cache\n", Q_memprint(size));
 
-	sc_size = size;
 	if( sc_base )
 	{
 		D_FlushCaches(  );
 		Mem_Free( sc_base );
 	}
-	sc_base = (surfcache_t *)Mem_Calloc(r_temppool,size);
-	sc_rover = sc_base;
+	sc_size = size;
+	sc_base = Mem_Calloc(r_temppool,size);
 
-	sc_base->next = NULL;
-	sc_base->owner = NULL;
-	sc_base->size = sc_size;
+	D_FlushCaches ();
 }
 
+/*
+==================
+D_SCUnlink
+==================
+*/
+static void D_SCUnlink (surfcache_t *c)
+{
+	c->prev->next = c->next;
+	c->next->prev = c->prev;
+}
+
+/*
+==================
+D_SCLink
+==================
+*/
+static void D_SCLink (surfcache_t *c, surfcache_t *head)
+{
+	c->next = head->next;
+	c->prev = head;
+	head->next->prev = c;
+	head->next = c;
+}
+
+/*
+==================
+D_SCFree
+
+returns the block to the free lists, merging it with its free buddies
+==================
+*/
+static void D_SCFree (surfcache_t *c)
+{
+	int	order = c->order;
+
+	while (order < sc_toporder)
+	{
+		surfcache_t	*buddy = (surfcache_t *)(sc_base + (((byte *)c - sc_base) ^ (1 << order)));
+
+		// blocks in use always have an owner
+		if (buddy->owner || buddy->order != order)
+			break;
+
+		D_SCUnlink (buddy);
+		if (buddy < c)
+			c = buddy;
+		order++;
+	}
+
+	c->owner = NULL;
+	c->order = order;
+	c->size = 1 << order;
+	D_SCLink (c, &sc_free[order]);
+}
+
+/*
+==================
+D_SCEvict
+==================
+*/
+static void D_SCEvict (surfcache_t *c)
+{
+	if (D_SpansUseCache (c))
+		D_FlushSurfaceSpans ();
+
+	D_SCUnlink (c);
+	if (c->owner)
+		*c->owner = NULL;
+	D_SCFree (c);
+
+	r_stats.c_surfcache_evictions++;
+}
 
 /*
 ==================
@@ -1003,32 +1212,48 @@ D_FlushCaches
 void D_FlushCaches( void )
 {
 	surfcache_t     *c;
+	int		i;
+
+	if( !sc_base )
+		return;
 
 	// if newmap, surfaces already freed
-	if( !tr.map_unload )
+	if( !tr.map_unload && sc_lru.next )
 	{
-		for(c = sc_base ; c ; c = c->next )
+		for( c = sc_lru.next; c != &sc_lru; c = c->next )
 		{
 			if ( c->owner )
 				*c->owner = NULL;
 		}
 	}
 
-	sc_rover = sc_base;
-	sc_base->next = NULL;
-	sc_base->owner = NULL;
-	sc_base->size = sc_size;
+	// everything becomes free blocks of the largest size
+	sc_lru.next = sc_lru.prev = &sc_lru;
+	for( i = 0; i <= SC_MAX_ORDER; i++ )
+		sc_free[i].next = sc_free[i].prev = &sc_free[i];
+
+	for( i = sc_size - ( 1 << sc_toporder ); i >= 0; i -= 1 << sc_toporder )
+	{
+		c = (surfcache_t *)( sc_base + i );
+		c->order = sc_toporder;
+		c->size = 1 << sc_toporder;
+		c->owner = NULL;
+		D_SCLink( c, &sc_free[sc_toporder] );
+	}
 }
 
 /*
 =================
 D_SCAlloc
+
+new block is linked as the most recently drawn, when keepframe is set
+blocks drawn in this frame are not evicted and NULL is returned instead
 =================
 */
-surfcache_t     *D_SCAlloc (int width, int size)
+static surfcache_t *D_SCAlloc (int width, int size, qboolean keepframe)
 {
 	surfcache_t             *new;
-	qboolean                wrapped_this_time;
+	int			order, i;
 
 	if ((width < 0) )// || (width > 256))
 		gEngfuncs.Host_Error ("D_SCAlloc: bad cache width %d\n", width);
@@ -1037,79 +1262,72 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		gEngfuncs.Host_Error ("D_SCAlloc: bad cache size %d\n", size);
 
 	size = (int)&((surfcache_t *)0)->data[size];
-	size = (size + 3) & ~3;
-	if (size > sc_size)
-		gEngfuncs.Host_Error ("D_SCAlloc: %i > cache size of %i",size, sc_size);
+	for (order = SC_MIN_ORDER; (1 << order) < size; order++);
 
-// if there is not size bytes after the rover, reset to the start
-	wrapped_this_time = false;
+	if (order > sc_toporder)
+		gEngfuncs.Host_Error ("D_SCAlloc: %i > cache block size of %i", size, 1 << sc_toporder);
 
-	if ( !sc_rover || (byte *)sc_rover - (byte *)sc_base > sc_size - size)
+// evict least recently drawn blocks until some free block is large enough
+	while (1)
 	{
-		if (sc_rover)
-		{
-			wrapped_this_time = true;
-		}
-		sc_rover = sc_base;
-	}
+		surfcache_t	*victim;
 
-// colect and free surfcache_t blocks until the rover block is large enough
-	new = sc_rover;
-	if (sc_rover->owner)
-		*sc_rover->owner = NULL;
+		for (i = order; i <= sc_toporder && sc_free[i].next == &sc_free[i]; i++);
 
-	while (new->size < size)
-	{
-	// free another
-		sc_rover = sc_rover->next;
-		if (!sc_rover)
+		if (i <= sc_toporder)
+			break;
+
+		victim = sc_lru.prev;
+		if (victim == &sc_lru)
 			gEngfuncs.Host_Error ("D_SCAlloc: hit the end of memory");
-		if (sc_rover->owner)
-			*sc_rover->owner = NULL;
 
-		new->size += sc_rover->size;
-		new->next = sc_rover->next;
+		if (victim->lastframe == tr.framecount)
+		{
+			if (keepframe)
+				return NULL;
+			r_cache_thrash = true;
+		}
+
+		D_SCEvict (victim);
 	}
 
-// create a fragment out of any leftovers
-	if (new->size - size > 256)
+	new = sc_free[i].next;
+	D_SCUnlink (new);
+
+// split down to the needed size, upper halves become free
+	while (i > order)
 	{
-		sc_rover = (surfcache_t *)( (byte *)new + size);
-		sc_rover->size = new->size - size;
-		sc_rover->next = new->next;
-		sc_rover->width = 0;
-		sc_rover->owner = NULL;
-		new->next = sc_rover;
-		new->size = size;
+		surfcache_t	*buddy;
+
+		i--;
+		buddy = (surfcache_t *)((byte *)new + (1 << i));
+		buddy->order = i;
+		buddy->size = 1 << i;
+		buddy->owner = NULL;
+		D_SCLink (buddy, &sc_free[i]);
 	}
-	else
-		sc_rover = new->next;
 
+	new->order = order;
+	new->size = 1 << order;
 	new->width = width;
 // DEBUG
 	if (width > 0)
-		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
+		new->height = (new->size - sizeof(*new) + sizeof(new->data)) / width;
 
 	new->owner = NULL;              // should be set properly after return
-
-	if (d_roverwrapped)
-	{
-		if (wrapped_this_time || (sc_rover >= d_initial_rover))
-			r_cache_thrash = true;
-	}
-	else if (wrapped_this_time)
-	{
-		d_roverwrapped = true;
-	}
+	new->spanbatch = 0;
+	new->prebuilt = false;
+	new->lastframe = tr.framecount;
+	D_SCLink (new, &sc_lru);
 
 	return new;
 }
 
 //=============================================================================
 void R_DecalComputeBasis( msurface_t *surf, int flags, vec3_t textureSpaceBasis[3] );
-void R_DrawSurfaceDecals( void )
+static void R_DrawSurfaceDecals( const drawsurf_t *ds )
 {
-	msurface_t *fa = r_drawsurf.surf;
+	msurface_t *fa = ds->surf;
 	decal_t *p;
 
 	for( p = fa->pdecals; p; p = p->pnext)
@@ -1140,10 +1358,10 @@ void R_DrawSurfaceDecals( void )
 			x = DotProduct( p->position, textureU ) + textureU[3] - fa->texturemins[0] - w/2;
 			y = DotProduct( p->position, textureV ) + textureV[3] - fa->texturemins[1] - h/2;
 
-			x = x >> r_drawsurf.surfmip;
-			y = y >> r_drawsurf.surfmip;
-			w = w >> r_drawsurf.surfmip;
-			h = h >> r_drawsurf.surfmip;
+			x = x >> ds->surfmip;
+			y = y >> ds->surfmip;
+			w = w >> ds->surfmip;
+			h = h >> ds->surfmip;
 
 			if( w < 1 || h < 1 )
 				continue;
@@ -1153,15 +1371,15 @@ void R_DrawSurfaceDecals( void )
 				s1 += (-x)*(s2-s1) / w;
 				x = 0;
 			}
-			if( x + w > r_drawsurf.surfwidth )
+			if( x + w > ds->surfwidth )
 			{
-				s2 -= (x + w - r_drawsurf.surfwidth) * (s2 - s1)/ w ;
-				w = r_drawsurf.surfwidth - x;
+				s2 -= (x + w - ds->surfwidth) * (s2 - s1)/ w ;
+				w = ds->surfwidth - x;
 			}
-			if( y + h > r_drawsurf.surfheight )
+			if( y + h > ds->surfheight )
 			{
-				t2 -= (y + h - r_drawsurf.surfheight) * (t2 - t1) / h;
-				h = r_drawsurf.surfheight - y;
+				t2 -= (y + h - ds->surfheight) * (t2 - t1) / h;
+				h = ds->surfheight - y;
 			}
 
 			if( s1 < 0 )
@@ -1195,7 +1413,7 @@ void R_DrawSurfaceDecals( void )
 			else
 				skip = 0;
 
-			dest = ((pixel_t*)r_drawsurf.surfdat) + y * r_drawsurf.rowbytes + x;
+			dest = ((pixel_t*)ds->surfdat) + y * ds->rowbytes + x;
 
 			for (v=0 ; v<height ; v++)
 			{
@@ -1237,7 +1455,7 @@ void R_DrawSurfaceDecals( void )
 
 					}
 				}
-				dest += r_drawsurf.rowbytes;
+				dest += ds->rowbytes;
 			}
 	}
 
@@ -1245,17 +1463,44 @@ void R_DrawSurfaceDecals( void )
 
 /*
 ================
-D_CacheSurface
+D_BuildSurface
+
+lights and draws the surface into its cache block, may run on workers
 ================
 */
-surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+static void D_BuildSurface (const drawsurf_t *ds)
+{
+	surfbuild_t	sb;
+
+	sb.ds = ds;
+
+	// calculate the lightings
+	R_BuildLightMap (&sb);
+
+	// rasterize the surface into the cache
+	R_DrawSurface (&sb);
+	R_DrawSurfaceDecals (ds);
+}
+
+/*
+================
+D_SetupSurface
+
+finds or allocates the cache block for the surface and fills the
+description to build it, build is false if the block is still good
+================
+*/
+static surfcache_t *D_SetupSurface (msurface_t *surface, int miplevel, drawsurf_t *ds, qboolean prepass, qboolean *build)
 {
 	surfcache_t     *cache;
+	float		surfscale;
 	int maps;
+
+	*build = false;
 //
 // if the surface is animating or flashing, flush the cache
 //
-	r_drawsurf.image = R_GetTexture(R_TextureAnimation (surface)->gl_texturenum);
+	ds->image = R_GetTexture(R_TextureAnimation (surface)->gl_texturenum);
 
 	// does not support conveyors with world luxels now
 	if( surface->texinfo->flags & TEX_WORLD_LUXELS )
@@ -1265,20 +1510,21 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 	{
 		if( miplevel >= 1)
 		{
-			surface->extents[0] = surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( r_drawsurf.surf ) * 2 ;
-			surface->info->lightmapmins[0] = -surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( r_drawsurf.surf );
+			surface->extents[0] = surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( surface ) * 2 ;
+			surface->info->lightmapmins[0] = -surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( surface );
 		}
 		else
 		{
-			surface->extents[0] = surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( r_drawsurf.surf ) ;
-			surface->info->lightmapmins[0] = -surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( r_drawsurf.surf )/2;
+			surface->extents[0] = surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( surface ) ;
+			surface->info->lightmapmins[0] = -surface->info->lightextents[0] * LM_SAMPLE_SIZE_AUTO( surface )/2;
 		}
 	}
 	/// todo: port this
-	//r_drawsurf.lightadj[0] = r_newrefdef.lightstyles[surface->styles[0]].white*128;
-	//r_drawsurf.lightadj[1] = r_newrefdef.lightstyles[surface->styles[1]].white*128;
-	//r_drawsurf.lightadj[2] = r_newrefdef.lightstyles[surface->styles[2]].white*128;
-	//r_drawsurf.lightadj[3] = r_newrefdef.lightstyles[surface->styles[3]].white*128;
+	//ds->lightadj[0] = r_newrefdef.lightstyles[surface->styles[0]].white*128;
+	//ds->lightadj[1] = r_newrefdef.lightstyles[surface->styles[1]].white*128;
+	//ds->lightadj[2] = r_newrefdef.lightstyles[surface->styles[2]].white*128;
+	//ds->lightadj[3] = r_newrefdef.lightstyles[surface->styles[3]].white*128;
+	memset( ds->lightadj, 0, sizeof( ds->lightadj ));
 
 //
 // see if the cache holds apropriate data
@@ -1296,12 +1542,18 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 
 
 	if (cache && !cache->dlight && surface->dlightframe != tr.framecount
-			&& cache->image == r_drawsurf.image
-			&& cache->lightadj[0] == r_drawsurf.lightadj[0]
-			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
-			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
-			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
+			&& cache->image == ds->image
+			&& cache->lightadj[0] == ds->lightadj[0]
+			&& cache->lightadj[1] == ds->lightadj[1]
+			&& cache->lightadj[2] == ds->lightadj[2]
+			&& cache->lightadj[3] == ds->lightadj[3] )
+	{
+		// move to the head of LRU
+		D_SCUnlink (cache);
+		D_SCLink (cache, &sc_lru);
+		cache->lastframe = tr.framecount;
 		return cache;
+	}
 
 	if( surface->dlightframe == tr.framecount )
 	{
@@ -1317,20 +1569,20 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 // determine shape of surface
 //
 	surfscale = 1.0 / (1<<miplevel);
-	r_drawsurf.surfmip = miplevel;
+	ds->surfmip = miplevel;
 	if( surface->flags & SURF_CONVEYOR )
-		r_drawsurf.surfwidth = surface->extents[0] >> miplevel;
+		ds->surfwidth = surface->extents[0] >> miplevel;
 	else
-		r_drawsurf.surfwidth = surface->info->lightextents[0] >> miplevel;
-	r_drawsurf.rowbytes = r_drawsurf.surfwidth;
-	r_drawsurf.surfheight = surface->info->lightextents[1] >> miplevel;
+		ds->surfwidth = surface->info->lightextents[0] >> miplevel;
+	ds->rowbytes = ds->surfwidth;
+	ds->surfheight = surface->info->lightextents[1] >> miplevel;
 
 	// use texture space if world luxels used
 	if( surface->texinfo->flags & TEX_WORLD_LUXELS )
 	{
-		r_drawsurf.surfwidth = surface->extents[0] >> miplevel;
-		r_drawsurf.rowbytes = r_drawsurf.surfwidth;
-		r_drawsurf.surfheight = surface->extents[1] >> miplevel;
+		ds->surfwidth = surface->extents[0] >> miplevel;
+		ds->rowbytes = ds->surfwidth;
+		ds->surfheight = surface->extents[1] >> miplevel;
 	}
 
 
@@ -1339,44 +1591,158 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 //
 	if (!cache)     // if a texture just animated, don't reallocate it
 	{
-		cache = D_SCAlloc (r_drawsurf.surfwidth,
-						   r_drawsurf.surfwidth * r_drawsurf.surfheight * 2);
+		cache = D_SCAlloc (ds->surfwidth,
+						   ds->surfwidth * ds->surfheight * 2, prepass);
+		if (!cache)
+			return NULL;
 		CACHESPOT(surface)[miplevel] = cache;
 		cache->owner = &CACHESPOT(surface)[miplevel];
 		cache->mipscale = surfscale;
 	}
+	else
+	{
+		if (D_SpansUseCache (cache))
+		{
+			// recorded spans still read the old image
+			D_FlushSurfaceSpans ();
+		}
+
+		D_SCUnlink (cache);
+		D_SCLink (cache, &sc_lru);
+		cache->lastframe = tr.framecount;
+	}
 
 	if (surface->dlightframe == tr.framecount)
 		cache->dlight = 1;
 	else
 		cache->dlight = 0;
 
-	r_drawsurf.surfdat = (pixel_t *)cache->data;
+	ds->surfdat = (pixel_t *)cache->data;
 
-	cache->image = r_drawsurf.image;
-	cache->lightadj[0] = r_drawsurf.lightadj[0];
-	cache->lightadj[1] = r_drawsurf.lightadj[1];
-	cache->lightadj[2] = r_drawsurf.lightadj[2];
-	cache->lightadj[3] = r_drawsurf.lightadj[3];
+	cache->image = ds->image;
+	cache->lightadj[0] = ds->lightadj[0];
+	cache->lightadj[1] = ds->lightadj[1];
+	cache->lightadj[2] = ds->lightadj[2];
+	cache->lightadj[3] = ds->lightadj[3];
 	for( maps = 0; maps < MAXLIGHTMAPS && surface->styles[maps] != 255; maps++ )
 	{
 		surface->cached_light[maps] = tr.lightstylevalue[surface->styles[maps]];
 	}
-//
-// draw and light the surface texture
-//
-	r_drawsurf.surf = surface;
 
-	//c_surf++;
+	ds->surf = surface;
+	*build = true;
 
-	// calculate the lightings
-	R_BuildLightMap ( );
+	return cache;
+}
 
-	// rasterize the surface into the cache
-	R_DrawSurface ();
-	R_DrawSurfaceDecals();
+/*
+================
+D_CacheSurface
+================
+*/
+surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+{
+	surfcache_t	*cache = CACHESPOT(surface)[miplevel];
+	qboolean	build;
+
+	// built by the prepass for this frame, dlights included,
+	// D_SetupSurface would rebuild dlit surfaces once again
+	if (cache && cache->prebuilt && cache->lastframe == tr.framecount)
+	{
+		cache->prebuilt = false;
+		r_stats.c_surfcache_misses++;
+		return cache;
+	}
+
+	Matrix4x4_Copy( r_drawsurf.lightmatrix, RI.objectMatrix );
+	r_drawsurf.lightidentity = tr.modelviewIdentity;
+
+	cache = D_SetupSurface (surface, miplevel, &r_drawsurf, false, &build);
+
+	if (build)
+	{
+		cache->prebuilt = false;
+		r_stats.c_surfcache_misses++;
+
+		//c_surf++;
+		D_BuildSurface (&r_drawsurf);
+	}
+	else
+	{
+		cache->prebuilt = false; // may be left from an earlier frame
+		r_stats.c_surfcache_hits++;
+	}
 
 	return cache;
 }
 
+/*
+================
+D_QueueSurfaceBuild
+
+sets up the cache block for the surface, building it is left for
+D_FinishSurfaceBuilds, returns false when the cache is full
+================
+*/
+qboolean D_QueueSurfaceBuild( msurface_t *surface, int miplevel, const matrix4x4 lightmatrix, qboolean lightidentity )
+{
+	surfcache_t	*cache = CACHESPOT( surface )[miplevel];
+	drawsurf_t	*ds;
+	qboolean	build;
+
+	// conveyors change the surface extents for the mip level, blocks that
+	// were already set up this frame may be rebuilt in place while drawing
+	if( FBitSet( surface->flags, SURF_CONVEYOR ) || ( cache && cache->lastframe == tr.framecount ))
+		return true;
+
+	if( sc_queue.numbuilds == sc_queue.maxbuilds )
+	{
+		sc_queue.maxbuilds = Q_max( 256, sc_queue.maxbuilds * 2 );
+		sc_queue.builds = Mem_Realloc( r_temppool, sc_queue.builds, sc_queue.maxbuilds * sizeof( *sc_queue.builds ));
+	}
+
+	ds = &sc_queue.builds[sc_queue.numbuilds];
+	Matrix4x4_Copy( ds->lightmatrix, lightmatrix );
+	ds->lightidentity = lightidentity;
+
+	cache = D_SetupSurface( surface, miplevel, ds, true, &build );
+
+	if( !cache )
+		return false;
+
+	if( build )
+	{
+		cache->prebuilt = true;
+		sc_queue.numbuilds++;
+		r_stats.c_surfcache_prebuilt++;
+	}
+
+	return true;
+}
+
+/*
+================
+D_BuildSurfaceRange
+================
+*/
+static void D_BuildSurfaceRange( void *data, int start, int end )
+{
+	for( ; start < end; start++ )
+		D_BuildSurface( &sc_queue.builds[start] );
+}
+
+/*
+================
+D_FinishSurfaceBuilds
 
+builds all queued surfaces on the engine workers
+================
+*/
+void D_FinishSurfaceBuilds( void )
+{
+	if( !sc_queue.numbuilds )
+		return;
+
+	gEngfuncs.Job_ParallelFor( D_BuildSurfaceRange, NULL, sc_queue.numbuilds, 1 );
+	sc_queue.numbuilds = 0;
+}
@@ -51,18 +51,17 @@ static color24 gTracerColors[] =
 ================
 CL_DrawParticles
 
-update particle color, position, free expired and draw it
+draw particles packed by the engine
 ================
 */
-void CL_DrawParticles( double frametime, particle_t *cl_active_particles, float partsize )
+void CL_DrawParticles( const ref_particle_t *particles, int count, float partsize )
 {
-	particle_t	*p;
+	const ref_particle_t	*p;
 	vec3_t		right, up;
-	color24		*pColor;
-	int		alpha;
 	float		size;
+	int		i;
 
-	if( !cl_active_particles )
+	if( !count )
 		return;	// nothing to draw?
 
 	TriRenderMode( kRenderTransAlpha );
@@ -70,51 +69,39 @@ void CL_DrawParticles( double frametime, particle_t *cl_active_particles, float
 
 	TriBegin( TRI_QUADS );
 
-	for( p = cl_active_particles; p; p = p->next )
+	for( i = 0, p = particles; i < count; i++, p++ )
 	{
-		if(( p->type != pt_blob ) || ( p->packedColor == 255 ))
-		{
-			size = partsize; // get initial size of particle
-
-			// scale up to keep particles from disappearing
-			// FIXME are these really the same?
-			vec3_t cull_vforward, cull_vup, cull_vright;
-			VectorCopy(g_camera.vforward, cull_vforward);
-			VectorCopy(g_camera.vup, cull_vup);
-			VectorCopy(g_camera.vright, cull_vright);
-			size += (p->org[0] - g_camera.vieworg[0]) * cull_vforward[0];
-			size += (p->org[1] - g_camera.vieworg[1]) * cull_vforward[1];
-			size += (p->org[2] - g_camera.vieworg[2]) * cull_vforward[2];
-
-			if( size < 20.0f ) size = partsize;
-			else size = partsize + size * 0.002f;
-
-			// scale the axes by radius
-			VectorScale( cull_vright, size, right );
-			VectorScale( cull_vup, size, up );
-
-			p->color = bound( 0, p->color, 255 );
-			pColor = gEngine.CL_GetPaletteColor( p->color );
-
-			alpha = 255 * (p->die - gpGlobals->time) * 16.0f;
-			if( alpha > 255 || p->type == pt_static )
-				alpha = 255;
-
-			TriColor4ub_( gEngine.LightToTexGamma( pColor->r ),
-				gEngine.LightToTexGamma( pColor->g ),
-				gEngine.LightToTexGamma( pColor->b ), alpha );
-
-			TriTexCoord2f( 0.0f, 1.0f );
-			TriVertex3f( p->org[0] - right[0] + up[0], p->org[1] - right[1] + up[1], p->org[2] - right[2] + up[2] );
-			TriTexCoord2f( 0.0f, 0.0f );
-			TriVertex3f( p->org[0] + right[0] + up[0], p->org[1] + right[1] + up[1], p->org[2] + right[2] + up[2] );
-			TriTexCoord2f( 1.0f, 0.0f );
-			TriVertex3f( p->org[0] + right[0] - up[0], p->org[1] + right[1] - up[1], p->org[2] + right[2] - up[2] );
-			TriTexCoord2f( 1.0f, 1.0f );
-			TriVertex3f( p->org[0] - right[0] - up[0], p->org[1] - right[1] - up[1], p->org[2] - right[2] - up[2] );
-		}
-
-		gEngine.CL_ThinkParticle( frametime, p );
+		size = partsize; // get initial size of particle
+
+		// scale up to keep particles from disappearing
+		// FIXME are these really the same?
+		vec3_t cull_vforward, cull_vup, cull_vright;
+		VectorCopy(g_camera.vforward, cull_vforward);
+		VectorCopy(g_camera.vup, cull_vup);
+		VectorCopy(g_camera.vright, cull_vright);
+		size += (p->org[0] - g_camera.vieworg[0]) * cull_vforward[0];
+		size += (p->org[1] - g_camera.vieworg[1]) * cull_vforward[1];
+		size += (p->org[2] - g_camera.vieworg[2]) * cull_vforward[2];
+
+		if( size < 20.0f ) size = partsize;
+		else size = partsize + size * 0.002f;
+
+		// scale the axes by radius
+		VectorScale( cull_vright, size, right );
+		VectorScale( cull_vup, size, up );
+
+		TriColor4ub_( gEngine.LightToTexGamma( p->color.r ),
+			gEngine.LightToTexGamma( p->color.g ),
+			gEngine.LightToTexGamma( p->color.b ), p->alpha );
+
+		TriTexCoord2f( 0.0f, 1.0f );
+		TriVertex3f( p->org[0] - right[0] + up[0], p->org[1] - right[1] + up[1], p->org[2] - right[2] + up[2] );
+		TriTexCoord2f( 0.0f, 0.0f );
+		TriVertex3f( p->org[0] + right[0] + up[0], p->org[1] + right[1] + up[1], p->org[2] + right[2] + up[2] );
+		TriTexCoord2f( 1.0f, 0.0f );
+		TriVertex3f( p->org[0] + right[0] - up[0], p->org[1] + right[1] - up[1], p->org[2] + right[2] - up[2] );
+		TriTexCoord2f( 1.0f, 1.0f );
+		TriVertex3f( p->org[0] - right[0] - up[0], p->org[1] - right[1] - up[1], p->org[2] - right[2] - up[2] );
 	}
 
 	const vec4_t color = { 1, 1, 1, 1 }; // pColor->r / 255.f, pColor->g / 255.f, pColor->b / 255.f, 1.f };
@@ -1,6 +1,7 @@
 #pragma once
 
 typedef struct particle_s particle_t;
+typedef struct ref_particle_s ref_particle_t;
 
-void CL_DrawParticles( double frametime, particle_t *particles, float partsize );
+void CL_DrawParticles( const ref_particle_t *particles, int count, float partsize );
 void CL_DrawTracers( double frametime, particle_t *tracers );